@@ -0,0 +1,48 @@
+# Genera la tabella completa del filtro Crypto1 (2^20 bit, 128 KB)
+# usata da mfcuk_crypto.cpp quando è definito CRYPTO1_FILTER20_TABLE.
+# Eseguito da PlatformIO prima della build (extra_scripts = pre:...).
+
+import os
+
+Import("env")
+
+FB = 0xf22c
+FA = 0xd938
+FC = 0xEC57E80A
+
+
+def crypto1_filter(x):
+    i  = (FB >> (x & 0xf) & 1) << 4
+    i |= (FA >> (x >> 4 & 0xf) & 1) << 3
+    i |= (FB >> (x >> 8 & 0xf) & 1) << 2
+    i |= (FB >> (x >> 12 & 0xf) & 1) << 1
+    i |= (FA >> (x >> 16 & 0xf) & 1)
+    return FC >> i & 1
+
+
+def generate(path):
+    words = []
+    for w in range(1 << 15):
+        v = 0
+        for b in range(32):
+            v |= crypto1_filter(w << 5 | b) << b
+        words.append(v)
+
+    with open(path, "w") as f:
+        f.write("// Generato da scripts/gen_crypto1_filter20.py, non modificare\n")
+        f.write("#ifndef _CRYPTO1_FILTER20_H_\n#define _CRYPTO1_FILTER20_H_\n\n")
+        f.write("static const uint32_t crypto1_filter20_table[32768] = {\n")
+        for i in range(0, len(words), 8):
+            f.write("    " + ", ".join("0x%08x" % v for v in words[i:i + 8]) + ",\n")
+        f.write("};\n\n#endif // _CRYPTO1_FILTER20_H_\n")
+
+
+flags = env.get("BUILD_FLAGS", [])
+if any("CRYPTO1_FILTER20_TABLE" in str(f) for f in flags):
+    out_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")
+    out_file = os.path.join(out_dir, "crypto1_filter20.h")
+    if not os.path.exists(out_file):
+        os.makedirs(out_dir, exist_ok=True)
+        print("[CRYPTO] Generazione tabella filtro a 20 bit")
+        generate(out_file)
+    env.Append(CPPPATH=[out_dir])
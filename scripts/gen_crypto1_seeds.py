@@ -0,0 +1,86 @@
+# Genera l'immagine dei semi delle metà dello stato Crypto1 (1 MB) letta da
+# mfcuk_crypto_seeds.cpp: 4 bitmap su 2^21 bit, una per coppia di primi bit
+# di keystream della metà.
+# Da PlatformIO (extra_scripts = pre:...) genera l'immagine nella build e
+# aggiunge il target "uploadseeds" che la scrive nella partizione crypto1:
+#   pio run -e esp32dev_seeds -t uploadseeds
+# Da riga di comando, per i test su host (CRYPTO1_SEEDS=<file>):
+#   python3 scripts/gen_crypto1_seeds.py crypto1_seeds.bin
+
+import os
+import struct
+import sys
+
+FB = 0xf22c
+FA = 0xd938
+FC = 0xEC57E80A
+
+SEEDS_MAGIC = 0x44533143      # "C1SD"
+SEEDS_VERSION = 1
+SEEDS_CLASSES = 4
+SEEDS_WORDS = 1 << 16
+SEEDS_LABEL = "crypto1"
+
+
+def crypto1_filter(x):
+    i  = (FB >> (x & 0xf) & 1) << 4
+    i |= (FA >> (x >> 4 & 0xf) & 1) << 3
+    i |= (FB >> (x >> 8 & 0xf) & 1) << 2
+    i |= (FB >> (x >> 12 & 0xf) & 1) << 1
+    i |= (FA >> (x >> 16 & 0xf) & 1)
+    return FC >> i & 1
+
+
+def generate(path):
+    f20 = bytes(crypto1_filter(x) for x in range(1 << 20))
+    words = [[0] * SEEDS_WORDS for _ in range(SEEDS_CLASSES)]
+
+    # Seme y (21 bit) nella classe b0 | b1 << 1 con filter(y >> 1) == b0 e filter(y) == b1
+    for y in range(1 << 21):
+        c = f20[y >> 1] | f20[y & 0xfffff] << 1
+        words[c][y >> 5] |= 1 << (y & 31)
+
+    with open(path, "wb") as f:
+        f.write(struct.pack("<IHHII", SEEDS_MAGIC, SEEDS_VERSION, SEEDS_CLASSES, SEEDS_WORDS, 0))
+        for c in range(SEEDS_CLASSES):
+            f.write(struct.pack("<%dI" % SEEDS_WORDS, *words[c]))
+
+
+def partition_offset(csv_path, label):
+    with open(csv_path) as f:
+        for line in f:
+            cols = [c.strip() for c in line.split("#")[0].split(",")]
+            if len(cols) >= 4 and cols[0] == label:
+                return cols[3]
+    return None
+
+
+if __name__ == "__main__":
+    generate(sys.argv[1] if len(sys.argv) > 1 else "crypto1_seeds.bin")
+    sys.exit(0)
+
+Import("env")
+
+out_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")
+out_file = os.path.join(out_dir, "crypto1_seeds.bin")
+if not os.path.exists(out_file):
+    os.makedirs(out_dir, exist_ok=True)
+    print("[CRYPTO] Generazione immagine dei semi delle metà dello stato")
+    generate(out_file)
+
+csv_path = os.path.join(env.subst("$PROJECT_DIR"), env.GetProjectOption("board_build.partitions", ""))
+offset = partition_offset(csv_path, SEEDS_LABEL) if os.path.isfile(csv_path) else None
+if offset is None:
+    print("[CRYPTO] Partizione '%s' assente in %s: target uploadseeds non disponibile" % (SEEDS_LABEL, csv_path))
+else:
+    env.AddCustomTarget(
+        name="uploadseeds",
+        dependencies=None,
+        actions=[
+            env.VerboseAction(env.AutodetectUploadPort, "Ricerca della porta..."),
+            '"$PYTHONEXE" "$UPLOADER" --chip esp32 --port "$UPLOAD_PORT" --baud $UPLOAD_SPEED '
+            'write_flash %s "%s"' % (offset, out_file),
+        ],
+        title="Upload semi Crypto1",
+        description="Scrive l'immagine dei semi nella partizione %s (%s)" % (SEEDS_LABEL, offset),
+    )
@@ -0,0 +1,41 @@
+# Genera le tabelle posizione/stato del PRNG a 16 bit dei nonce Mifare
+# (2 x 128 KB in flash) usate da mfcuk_crypto_prng.cpp.
+# Eseguito da PlatformIO prima della build (extra_scripts = pre:...).
+
+import os
+
+Import("env")
+
+PRNG_PERIOD = 65535
+
+
+def generate(path):
+    # Stessa numerazione di mfoc: la metà alta del nonce (byte invertiti)
+    # individua la posizione nella sequenza, la metà bassa è 16 passi avanti
+    pos = [0xffff] * 65536
+    seq = []
+    x = 1
+    for i in range(PRNG_PERIOD):
+        v = (x & 0xff) << 8 | x >> 8
+        pos[v] = i
+        seq.append(v)
+        x = x >> 1 | ((x ^ x >> 2 ^ x >> 3 ^ x >> 5) & 1) << 15
+
+    with open(path, "w") as f:
+        f.write("// Generato da scripts/gen_prng_table.py, non modificare\n")
+        f.write("#ifndef _CRYPTO1_PRNG_TABLE_H_\n#define _CRYPTO1_PRNG_TABLE_H_\n\n")
+        for name, values in (("prng_pos_table", pos), ("prng_seq_table", seq)):
+            f.write("static const uint16_t %s[%d] = {\n" % (name, len(values)))
+            for i in range(0, len(values), 16):
+                f.write("    " + ", ".join("0x%04x" % v for v in values[i:i + 16]) + ",\n")
+            f.write("};\n\n")
+        f.write("#endif // _CRYPTO1_PRNG_TABLE_H_\n")
+
+
+out_dir = os.path.join(env.subst("$BUILD_DIR"), "generated")
+out_file = os.path.join(out_dir, "crypto1_prng_table.h")
+if not os.path.exists(out_file):
+    os.makedirs(out_dir, exist_ok=True)
+    print("[CRYPTO] Generazione tabelle PRNG dei nonce")
+    generate(out_file)
+env.Append(CPPPATH=[out_dir], CPPDEFINES=["CRYPTO1_PRNG_TABLE"])
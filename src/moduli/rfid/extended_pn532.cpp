@@ -23,40 +23,35 @@ bool Extended_PN532::readResponse(uint8_t* buffer, uint8_t length, uint16_t time
     return true;
 }
 
+// Seleziona la carta nel campo e invia AUTH A sul blocco 0 con InCommunicateThru:
+// la carta risponde con nt in chiaro (4 byte senza CRC)
 bool Extended_PN532::mifareClassicGetNT(uint8_t* nt) {
-    // Implementazione migliorata con gestione degli errori
-    uint8_t timeout = 0;
-    const uint8_t MAX_TIMEOUT = 2;
+    uint8_t uid[7];
+    uint8_t uidLength;
+    uint16_t atqa;
+    uint8_t sak;
+    uint8_t auth[2] = {MIFARE_CMD_AUTH_A, 0};
+    uint8_t resp[8];
+    uint8_t n = sizeof(resp);
+    bool ok;
     
-    while (timeout < MAX_TIMEOUT) {
-        pn532_packetbuffer[0] = MIFARE_CMD_AUTH_A;  // Comando auth
-        pn532_packetbuffer[1] = 0;  // Blocco 0
-        
-        // Tentativo con timeout progressivo
-        if (!sendCommandCheckAck(pn532_packetbuffer, 2, 500 + (timeout * 200))) {
-            Serial.println("[PN532] Errore invio comando AUTH per NT");
-            timeout++;
-            delay(50);
-            continue;
-        }
-        
-        // Attesa breve per stabilizzazione
-        delay(30);
-        
-        // Usa readResponse invece di readdata con timeout progressivo
-        if (!readResponse(pn532_packetbuffer, 4, 800 + (timeout * 300))) {
-            Serial.println("[PN532] Errore lettura risposta NT");
-            timeout++;
-            delay(50);
-            continue;
-        }
-        
-        memcpy(nt, pn532_packetbuffer, 4);
-        return true;
+    if (!fastListTarget(uid, &uidLength, &atqa, &sak)) {
+        Serial.println("[PN532] Nessuna carta per mifareClassicGetNT");
+        return false;
     }
     
-    Serial.println("[PN532] Timeout finale in mifareClassicGetNT");
-    return false;
+    // Il CRC viene aggiunto in trasmissione, ma nt non ne ha: va disattivata
+    // solo la verifica in ricezione
+    if (!writeRegister(PN532_CIU_RX_MODE, 0x00)) return false;
+    ok = communicateThru(auth, sizeof(auth), 0, resp, &n) && n == 4;
+    writeRegister(PN532_CIU_RX_MODE, 0x80);
+    
+    if (!ok) {
+        Serial.println("[PN532] Nessun nt in risposta ad AUTH");
+        return false;
+    }
+    memcpy(nt, resp, 4);
+    return true;
 }
 
 bool Extended_PN532::mifareClassicGetAR(uint8_t* nr, uint8_t* ar) {
@@ -153,6 +148,195 @@ bool Extended_PN532::resetI2CBus() {
     return true;
 }
 
+// Legge un frame di risposta direttamente dal bus I2C
+// response riceve il codice di risposta seguito dai dati, senza TFI
+bool Extended_PN532::readFrame(uint8_t* response, uint8_t* responseLength, uint16_t timeout) {
+    uint8_t frame[PN532_FRAME_MAX + 1];
+    uint32_t start = millis();
+    uint8_t n, len, sum, i;
+    
+    // Ogni lettura I2C inizia con il byte di stato: bit 0 = risposta pronta
+    while (true) {
+        if (Wire.requestFrom((uint8_t)PN532_I2C_ADDRESS, (uint8_t)1) == 1 && (Wire.read() & 0x01)) break;
+        if (millis() - start > timeout) return false;
+        delay(1);
+    }
+    
+    n = Wire.requestFrom((uint8_t)PN532_I2C_ADDRESS, (uint8_t)sizeof(frame));
+    for (i = 0; i < n; i++) frame[i] = Wire.read();
+    
+    // [stato] 00 00 FF LEN LCS D5 <risposta> <dati> DCS 00
+    if (n < 9 || frame[1] != 0x00 || frame[2] != 0x00 || frame[3] != 0xFF) return false;
+    len = frame[4];
+    if ((uint8_t)(len + frame[5]) != 0 || len < 2 || len + 7 > n || frame[6] != PN532_PN532TOHOST) return false;
+    for (sum = 0, i = 0; i < len; i++) sum += frame[6 + i];
+    if ((uint8_t)(sum + frame[6 + len]) != 0) return false;
+    
+    if (len - 1 > *responseLength) return false;
+    *responseLength = len - 1;
+    memcpy(response, frame + 7, len - 1);
+    return true;
+}
+
+// Invia un comando e restituisce i dati della risposta (dopo il codice di risposta)
+bool Extended_PN532::sendRawCommand(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength,
+                                    uint16_t timeout) {
+    uint8_t frame[PN532_FRAME_MAX];
+    uint8_t n = sizeof(frame);
+    
+    if (!sendCommandCheckAck(cmd, cmdlen, timeout)) return false;
+    if (!readFrame(frame, &n, timeout) || n < 1 || frame[0] != (uint8_t)(cmd[0] + 1)) return false;
+    if (n - 1 > *responseLength) return false;
+    
+    *responseLength = n - 1;
+    memcpy(response, frame + 1, n - 1);
+    return true;
+}
+
+int8_t Extended_PN532::fastAuth(uint8_t block, uint8_t keyType, const uint8_t* key, const uint8_t* uid4) {
+    uint8_t cmd[14];
+    uint8_t status;
+    uint8_t n = 1;
+    
+    cmd[0] = PN532_COMMAND_INDATAEXCHANGE;
+    cmd[1] = 1;                                 // Tg
+    cmd[2] = keyType ? MIFARE_CMD_AUTH_B : MIFARE_CMD_AUTH_A;
+    cmd[3] = block;
+    memcpy(cmd + 4, key, 6);
+    memcpy(cmd + 10, uid4, 4);
+    
+    if (!sendRawCommand(cmd, sizeof(cmd), &status, &n) || n < 1) return -1;
+    
+    // 0x14: errore di autenticazione Mifare, la carta torna in IDLE
+    switch (status & 0x3F) {
+        case 0x00: return 1;
+        case 0x14: return 0;
+        default:   return -1;
+    }
+}
+
+bool Extended_PN532::fastReselect(const uint8_t* uid, uint8_t uidLength) {
+    uint8_t cmd[3 + 10];
+    uint8_t resp[PN532_FRAME_MAX];
+    uint8_t n = sizeof(resp);
+    
+    // InListPassiveTarget con l'UID come InitiatorData: il PN532 seleziona
+    // direttamente quella carta
+    cmd[0] = PN532_COMMAND_INLISTPASSIVETARGET;
+    cmd[1] = 1;                                 // MaxTg
+    cmd[2] = PN532_MIFARE_ISO14443A;
+    memcpy(cmd + 3, uid, uidLength);
+    
+    return sendRawCommand(cmd, 3 + uidLength, resp, &n, 2 * PN532_FAST_TIMEOUT) && n >= 1 && resp[0] == 1;
+}
+
+bool Extended_PN532::fastListTarget(uint8_t* uid, uint8_t* uidLength, uint16_t* atqa, uint8_t* sak) {
+    uint8_t cmd[3] = {PN532_COMMAND_INLISTPASSIVETARGET, 1, PN532_MIFARE_ISO14443A};
+    uint8_t resp[PN532_FRAME_MAX];
+    uint8_t n = sizeof(resp);
+    
+    // NbTg Tg SENS_RES(2) SEL_RES NFCIDLength NFCID
+    if (!sendRawCommand(cmd, sizeof(cmd), resp, &n, 2 * PN532_FAST_TIMEOUT) || n < 6 || resp[0] != 1) return false;
+    if (resp[5] > 7 || resp[5] < 4 || n < 6 + resp[5]) return false;
+    
+    *atqa = (uint16_t)resp[2] << 8 | resp[3];
+    *sak = resp[4];
+    *uidLength = resp[5];
+    memcpy(uid, resp + 6, resp[5]);
+    return true;
+}
+
+bool Extended_PN532::fastReadBlock(uint8_t block, uint8_t* data) {
+    uint8_t cmd[4] = {PN532_COMMAND_INDATAEXCHANGE, 1, MIFARE_CMD_READ, block};
+    uint8_t resp[17];
+    uint8_t n = sizeof(resp);
+    
+    if (!sendRawCommand(cmd, sizeof(cmd), resp, &n) || n != 17 || (resp[0] & 0x3F) != 0) return false;
+    memcpy(data, resp + 1, 16);
+    return true;
+}
+
+bool Extended_PN532::fastWriteBlock(uint8_t block, const uint8_t* data) {
+    uint8_t cmd[4 + 16] = {PN532_COMMAND_INDATAEXCHANGE, 1, MIFARE_CMD_WRITE, block};
+    uint8_t status;
+    uint8_t n = 1;
+    
+    memcpy(cmd + 4, data, 16);
+    return sendRawCommand(cmd, sizeof(cmd), &status, &n) && n >= 1 && (status & 0x3F) == 0;
+}
+
+bool Extended_PN532::writeRegisters(const uint16_t* addr, const uint8_t* values, uint8_t n) {
+    uint8_t cmd[1 + 3 * 8];
+    uint8_t resp[4];
+    uint8_t len = sizeof(resp);
+    
+    if (n > 8) return false;
+    cmd[0] = PN532_COMMAND_WRITEREGISTER;
+    for (uint8_t i = 0; i < n; i++) {
+        cmd[1 + 3 * i] = addr[i] >> 8;
+        cmd[2 + 3 * i] = addr[i] & 0xFF;
+        cmd[3 + 3 * i] = values[i];
+        if (addr[i] == PN532_CIU_BIT_FRAMING) bitFraming = values[i] & 0x07;
+    }
+    return sendRawCommand(cmd, 1 + 3 * n, resp, &len);
+}
+
+bool Extended_PN532::readRegister(uint16_t addr, uint8_t* value) {
+    uint8_t cmd[3] = {PN532_COMMAND_READREGISTER, (uint8_t)(addr >> 8), (uint8_t)(addr & 0xFF)};
+    uint8_t n = 1;
+    
+    return sendRawCommand(cmd, sizeof(cmd), value, &n) && n == 1;
+}
+
+bool Extended_PN532::setRawFraming(bool raw) {
+    // Scritture assolute: a 106 kbps ISO14443A i bit di velocità e framing sono zero
+    static const uint16_t regs[] = {PN532_CIU_TX_MODE, PN532_CIU_RX_MODE, PN532_CIU_MANUAL_RCV,
+                                    PN532_CIU_STATUS2, PN532_CIU_BIT_FRAMING};
+    uint8_t values[] = {(uint8_t)(raw ? 0x00 : 0x80), (uint8_t)(raw ? 0x00 : 0x80), (uint8_t)(raw ? 0x10 : 0x00),
+                        0x00, 0x00};
+    uint8_t timing[5] = {PN532_COMMAND_RFCONFIGURATION, 0x02, 0x00, 0x0B,
+                         (uint8_t)(raw ? PN532_RAW_RF_TIMEOUT : PN532_DEFAULT_RF_TIMEOUT)};
+    uint8_t resp[4];
+    uint8_t n = sizeof(resp);
+    
+    if (!writeRegisters(regs, values, sizeof(values))) return false;
+    return sendRawCommand(timing, sizeof(timing), resp, &n);
+}
+
+bool Extended_PN532::communicateThru(const uint8_t* tx, uint8_t txLen, uint8_t txLastBits, uint8_t* rx,
+                                     uint8_t* rxLen) {
+    uint8_t cmd[PN532_FRAME_MAX];
+    uint8_t resp[PN532_FRAME_MAX];
+    uint8_t n = sizeof(resp);
+    
+    if (txLen + 1 > (int)sizeof(cmd)) return false;
+    
+    // BitFraming si riscrive solo quando cambia: un comando I2C in meno per frame
+    if ((txLastBits & 0x07) != bitFraming && !writeRegister(PN532_CIU_BIT_FRAMING, txLastBits & 0x07)) {
+        bitFraming = 0xFF;
+        return false;
+    }
+    
+    cmd[0] = PN532_COMMAND_INCOMMUNICATETHRU;
+    memcpy(cmd + 1, tx, txLen);
+    
+    // Stato diverso da zero: timeout (0x01), collisione, buffer... niente dati validi
+    if (!sendRawCommand(cmd, txLen + 1, resp, &n) || n < 1 || (resp[0] & 0x3F) != 0) return false;
+    if (n - 1 > *rxLen) return false;
+    
+    *rxLen = n - 1;
+    memcpy(rx, resp + 1, n - 1);
+    return true;
+}
+
+bool Extended_PN532::setField(bool on) {
+    uint8_t cmd[3] = {PN532_COMMAND_RFCONFIGURATION, 0x01, (uint8_t)(on ? 0x01 : 0x00)};
+    uint8_t resp[4];
+    uint8_t n = sizeof(resp);
+    
+    return sendRawCommand(cmd, sizeof(cmd), resp, &n);
+}
+
 // Implementazione robusta di mifareClassicGetNT con retry automatici
 bool Extended_PN532::robustMifareClassicGetNT(uint8_t* nt, uint8_t maxRetries) {
     Serial.println("[PN532] robustMifareClassicGetNT: tentativo con gestione errori");
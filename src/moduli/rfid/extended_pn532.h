@@ -10,6 +10,24 @@
 #define MIFARE_CMD_READ           0x30
 #define MIFARE_CMD_WRITE          0xA0
 
+// Frame PN532 più lungo letto dal percorso rapido (preambolo e checksum compresi)
+#define PN532_FRAME_MAX           64
+
+// Timeout dei comandi del percorso rapido (ms)
+#define PN532_FAST_TIMEOUT        50
+
+// Registri del CIU (interfaccia contactless) accessibili con Read/WriteRegister
+#define PN532_CIU_TX_MODE         0x6302    // bit 7: TxCRCEn
+#define PN532_CIU_RX_MODE         0x6303    // bit 7: RxCRCEn
+#define PN532_CIU_MANUAL_RCV      0x630D    // bit 4: ParityDisable
+#define PN532_CIU_STATUS2         0x6338    // bit 3: MFCrypto1On
+#define PN532_CIU_BIT_FRAMING     0x633D    // bit 0-2: TxLastBits
+
+// Timeout di risposta della carta in InCommunicateThru (codifica di
+// RFConfiguration 0x02: 0x05 = 1.6 ms, 0x0A = 51.2 ms, valore di fabbrica)
+#define PN532_RAW_RF_TIMEOUT      0x05
+#define PN532_DEFAULT_RF_TIMEOUT  0x0A
+
 class Extended_PN532 : public Adafruit_PN532 {
     friend class PN532;  // Per accedere ai membri privati di Adafruit_PN532
 public:
@@ -29,9 +47,38 @@ public:
     bool robustMifareClassicGetNT(uint8_t* nt, uint8_t maxRetries = 5);
     bool robustMifareClassicGetAR(uint8_t* nr, uint8_t* ar, uint8_t maxRetries = 5);
     
+    // Percorso rapido per gli attacchi a dizionario: un solo comando PN532 per
+    // tentativo, senza i ritardi e i retry della libreria
+    // uid4: i 4 byte di UID usati dall'autenticazione (gli ultimi per UID da 7 byte)
+    // Ritorna 1 se la chiave è corretta, 0 se è sbagliata (carta da riselezionare), -1 se la carta non risponde
+    int8_t fastAuth(uint8_t block, uint8_t keyType, const uint8_t* key, const uint8_t* uid4);
+    // Riseleziona la carta con UID noto dopo un'autenticazione fallita (niente anticollisione)
+    bool fastReselect(const uint8_t* uid, uint8_t uidLength);
+    // Seleziona la prima carta nel campo e ne restituisce UID, ATQA e SAK
+    bool fastListTarget(uint8_t* uid, uint8_t* uidLength, uint16_t* atqa, uint8_t* sak);
+    bool fastReadBlock(uint8_t block, uint8_t* data);
+    bool fastWriteBlock(uint8_t block, const uint8_t* data);
+    
+    // Accesso ai registri del PN532 (più registri in un solo comando)
+    bool writeRegisters(const uint16_t* addr, const uint8_t* values, uint8_t n);
+    bool writeRegister(uint16_t addr, uint8_t value) { return writeRegisters(&addr, &value, 1); }
+    bool readRegister(uint16_t addr, uint8_t* value);
+    
+    // Frame grezzi: con raw CRC e parità automatici e Crypto1 del PN532 sono
+    // disattivati e il timeout di risposta è ridotto a PN532_RAW_RF_TIMEOUT
+    bool setRawFraming(bool raw);
+    // Trasmette txLen byte (txLastBits bit validi nell'ultimo, 0 = 8) e
+    // restituisce i byte ricevuti così come arrivano dalla carta
+    bool communicateThru(const uint8_t* tx, uint8_t txLen, uint8_t txLastBits, uint8_t* rx, uint8_t* rxLen);
+    // Accende o spegne il campo RF
+    bool setField(bool on);
+    
 private:
     uint8_t pn532_packetbuffer[64];
-    bool sendRawCommand(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength);
+    uint8_t bitFraming = 0xFF;      // Ultimo TxLastBits scritto (0xFF = sconosciuto)
+    bool sendRawCommand(uint8_t* cmd, uint8_t cmdlen, uint8_t* response, uint8_t* responseLength,
+                        uint16_t timeout = PN532_FAST_TIMEOUT);
+    bool readFrame(uint8_t* response, uint8_t* responseLength, uint16_t timeout);
     bool resetI2CBus();
 };
 
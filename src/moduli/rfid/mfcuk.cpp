@@ -19,7 +19,13 @@
 #include "mfcuk_types.h"
 #include "mfcuk_utils.h"
 #include "mfcuk_crypto.h"
+#include "mfcuk_crypto_bs.h"
+#include "mfcuk_crypto_prng.h"
+#include "mfcuk_crypto_parallel.h"
+#include "mfcuk_nonce.h"
+#include "mfcuk_fingerprint.h"
 #include "rfid.h"
+#include "rfid_session.h"
 #include "../../lib/input/input.h"
 #include "../../core/common/virtualkeyboard.h"
 #include "../../core/common/common.h"
@@ -120,7 +126,7 @@ void mfcuk_menu() {
  * Permette di impostare tutti i parametri dell'attacco
  */
 void mfcuk_config() {
-    const char* voci[] = {"Set Key", "Key Type", "Target", "Mode", "Timing", "Tempo descr.", "Esci"};
+    const char* voci[] = {"Set Key", "Key Type", "Target", "Mode", "Timing", "Tempo descr.", "Benchmark", "Esci"};
     const int vociCount = sizeof(voci)/sizeof(voci[0]);
     int selezione = 0;
     int top = 0;
@@ -169,7 +175,8 @@ void mfcuk_config() {
                 case 5: display.print("T. update: ");
                          display.print(mfcuk_desc_update_time/1000);
                          display.print("s"); break;
-                case 6: display.print("Torna al menu MFCUK"); break;
+                case 6: display.print("Chiavi/s Crypto1"); break;
+                case 7: display.print("Torna al menu MFCUK"); break;
             }
             
             display.display();
@@ -221,7 +228,8 @@ void mfcuk_config() {
                     if(t > 0) mfcuk_desc_update_time = t*1000;
                     break;
                 }
-                case 6: return;  // Esci
+                case 6: mfcuk_run_benchmark(); break;     // Benchmark Crypto1
+                case 7: return;  // Esci
             }
             
             needRedraw = true;
@@ -330,49 +338,48 @@ void mfcuk_set_target() {
 }
 
 /**
- * Imposta la modalità di attacco (Darkside/Nested)
+ * Imposta la modalità di attacco (Auto/Darkside/Nested)
  */
 void mfcuk_set_mode() {
+    static const MfcukAttackMode modes[] = {ATTACK_MODE_AUTO, ATTACK_MODE_DARKSIDE, ATTACK_MODE_NESTED};
+    static const char* names[] = {"Auto", "Darkside", "Nested"};
+    const int numModes = sizeof(modes) / sizeof(modes[0]);
     bool needRedraw = true;
+    int current = 0;
+    
+    for (int i = 0; i < numModes; i++) {
+        if (gConfig.mode == modes[i]) current = i;
+    }
     
     while(true) {
         if(needRedraw) {
             display.clearDisplay();
             common::println("Attack Mode", 0, 0, 1, SSD1306_WHITE);
             
-            // Darkside option
-            if(gConfig.mode == ATTACK_MODE_DARKSIDE) {
-                common::println("* ", 0, 10, 1, SSD1306_WHITE);
-            } else {
-                common::println("  ", 0, 10, 1, SSD1306_WHITE);
-            }
-            common::println("Darkside", 20, 10, 1, SSD1306_WHITE);
-            
-            // Nested option
-            if(gConfig.mode == ATTACK_MODE_NESTED) {
-                common::println("* ", 0, 20, 1, SSD1306_WHITE);
-            } else {
-                common::println("  ", 0, 20, 1, SSD1306_WHITE);
+            for (int i = 0; i < numModes; i++) {
+                common::println(i == current ? "* " : "  ", 0, 10 + i * 10, 1, SSD1306_WHITE);
+                common::println(names[i], 20, 10 + i * 10, 1, SSD1306_WHITE);
             }
-            common::println("Nested", 20, 20, 1, SSD1306_WHITE);
             
-            display.setCursor(0, 40);
+            display.setCursor(0, 44);
             display.print("UP/DWN per cambiare, RST per uscire");
             display.display();
             needRedraw = false;
         }
         
-        // Seleziona Darkside
+        // Modalità precedente
         if(digitalRead(buttonPin_UP) == LOW) {
             common::debounceButton(buttonPin_UP, 50);
-            gConfig.mode = ATTACK_MODE_DARKSIDE;
+            current = (current + numModes - 1) % numModes;
+            gConfig.mode = modes[current];
             needRedraw = true;
         }
         
-        // Seleziona Nested
+        // Modalità successiva
         else if(digitalRead(buttonPin_DWN) == LOW) {
             common::debounceButton(buttonPin_DWN, 50);
-            gConfig.mode = ATTACK_MODE_NESTED;
+            current = (current + 1) % numModes;
+            gConfig.mode = modes[current];
             needRedraw = true;
         }
         
@@ -453,6 +460,46 @@ void mfcuk_update_progress(int progress, const char* status) {
     display.display();
 }
 
+/**
+ * Esegue il benchmark Crypto1 (scalare, bitsliced e bitsliced su entrambi
+ * i core) e mostra le chiavi/s insieme allo speedup delle distanze PRNG
+ */
+void mfcuk_run_benchmark() {
+    Crypto1BsBench bench;
+    PrngBench prng;
+    uint32_t par_single_kps, par_kps;
+    bool par_ok;
+    char line[32];
+    
+    display.clearDisplay();
+    common::println("Benchmark Crypto1", 0, 0, 1, SSD1306_WHITE);
+    common::println("Attendere...", 0, 12, 1, SSD1306_WHITE);
+    display.display();
+    
+    crypto1_bs_benchmark(32768, &bench);
+    crypto1_parallel_benchmark(32768, &par_single_kps, &par_kps, &par_ok);
+    prng_benchmark(256, &prng);
+    
+    display.clearDisplay();
+    common::println("Benchmark Crypto1", 0, 0, 1, SSD1306_WHITE);
+    sprintf(line, "Scal: %u k/s", (unsigned)bench.scalar_kps);
+    common::println(line, 0, 9, 1, SSD1306_WHITE);
+    sprintf(line, "BS%d: %u k/s", CRYPTO1_BS_LANES, (unsigned)bench.bs_kps);
+    common::println(line, 0, 18, 1, SSD1306_WHITE);
+    sprintf(line, "Par%d: %u k/s", CRYPTO1_PAR_MAX_WORKERS, (unsigned)par_kps);
+    common::println(line, 0, 27, 1, SSD1306_WHITE);
+    common::println(bench.match_ok && prng.match_ok && par_ok ? "Verifica OK" : "Verifica ERRORE", 0, 36, 1, SSD1306_WHITE);
+    sprintf(line, "PRNG dist: x%u", (unsigned)(prng.dist_slow_us / (prng.dist_fast_us ? prng.dist_fast_us : 1)));
+    common::println(line, 0, 45, 1, SSD1306_WHITE);
+    common::println("RST per uscire", 0, 54, 1, SSD1306_WHITE);
+    display.display();
+    
+    while (digitalRead(buttonPin_RST) == HIGH) {
+        delay(10);
+    }
+    common::debounceButton(buttonPin_RST, 50);
+}
+
 /**
  * Salva il risultato dell'attacco su file
  */
@@ -476,6 +523,28 @@ void mfcuk_save_result(const String& result) {
     delay(2000);
 }
 
+/**
+ * Riconosce carta e PRNG sulla sessione aperta e verifica la chiave nota
+ * @return Attacco consigliato (FINGERPRINT_ATTACK_*)
+ */
+static uint8_t mfcuk_fingerprint_card(CardSession* session, MfcukConfig* config, const char** reason) {
+    CardFingerprint fp;
+    NonceAcq acq;
+    bool have_key;
+    
+    fingerprint_classify(&fp, session->sak, session->atqa, session->uid_len);
+    if (fp.card != FINGERPRINT_CARD_NOT_CLASSIC && nonce_pn532_begin(&acq, session)) {
+        if (!fingerprint_probe(&fp, &acq, get_block_number_by_sector(config->target_sector, 3))) {
+            Serial.println("[MFCUK] La carta non risponde agli AUTH in chiaro");
+        }
+        nonce_pn532_end(session);
+    }
+    
+    have_key = rfid_session_auth(session, config->known_sector, config->known_key_type, config->known_key.bytes) == 1;
+    fingerprint_print(&fp);
+    return fingerprint_select_attack(&fp, have_key, reason);
+}
+
 /**
  * Esegue l'attacco MFCUK
  * Questa funzione è il punto di ingresso dell'interfaccia utente per gli attacchi
@@ -496,8 +565,10 @@ bool mfcuk_run(MfcukConfig* config, uint8_t* key_out) {
     // Preparazione per l'attacco
     mfcuk_update_progress(0, "Inizializzazione...");
     
-    // Attesa carta
-    if (!rfid_wait_for_tag(5000)) {
+    // Attesa carta: la sessione resta aperta per tutto l'attacco e gli
+    // attacchi ne riusano l'UID (rfid_get_uid) invece di rilevare di nuovo la carta
+    CardSession session;
+    if (!rfid_session_open(&session, 5000)) {
         common::println("Nessuna carta", 0, 0, 1, SSD1306_WHITE);
         common::println("rilevata", 0, 12, 1, SSD1306_WHITE);
         display.display();
@@ -505,8 +576,39 @@ bool mfcuk_run(MfcukConfig* config, uint8_t* key_out) {
         return false;
     }
     
+    // Riconoscimento della carta: in modalità Auto sceglie l'attacco, nelle
+    // altre segnala solo una scelta che su questa carta non può riuscire
+    mfcuk_update_progress(5, "Riconoscimento...");
+    const char* reason = "";
+    uint8_t attack = mfcuk_fingerprint_card(&session, config, &reason);
+    MfcukAttackMode mode = ATTACK_MODE_NONE;
+    
+    switch(attack) {
+        case FINGERPRINT_ATTACK_DARKSIDE: mode = ATTACK_MODE_DARKSIDE; break;
+        case FINGERPRINT_ATTACK_MFOC_NESTED: mode = ATTACK_MODE_MFOC_NESTED; break;
+        case FINGERPRINT_ATTACK_BACKDOOR: mode = ATTACK_MODE_BACKDOOR; break;
+        case FINGERPRINT_ATTACK_HARDNESTED: mode = ATTACK_MODE_HARDNESTED; break;
+    }
+    Serial.printf("[MFCUK] Attacco consigliato: %s\n", reason);
+    
+    if (config->mode != ATTACK_MODE_AUTO) {
+        if (mode != config->mode) {
+            Serial.println("[MFCUK] Attenzione: la modalità scelta non è quella consigliata per questa carta");
+        }
+        mode = config->mode;
+    } else if (mode == ATTACK_MODE_NONE) {
+        display.clearDisplay();
+        common::println("Nessun attacco", 0, 0, 1, SSD1306_WHITE);
+        common::println("applicabile", 0, 12, 1, SSD1306_WHITE);
+        common::println("Dettagli su seriale", 0, 36, 1, SSD1306_WHITE);
+        display.display();
+        delay(2000);
+        rfid_session_close(&session);
+        return false;
+    }
+    
     // Esegue l'attacco selezionato
-    switch(config->mode) {
+    switch(mode) {
         case ATTACK_MODE_DARKSIDE:
             mfcuk_update_progress(10, "Darkside attack...");
             success = mfcuk_darkside_attack(config, key);
@@ -517,12 +619,31 @@ bool mfcuk_run(MfcukConfig* config, uint8_t* key_out) {
             success = mfcuk_nested_attack(config, key);
             break;
         
+        case ATTACK_MODE_BACKDOOR:
+            mfcuk_update_progress(10, "Backdoor Gen1a...");
+            success = mfcuk_backdoor_attack(config, key);
+            break;
+        
+        case ATTACK_MODE_HARDNESTED:
+            mfcuk_update_progress(10, "Hardnested...");
+            success = mfcuk_hardnested_attack(config, key);
+            break;
+        
+        case ATTACK_MODE_MFOC_NESTED:
+            mfcuk_update_progress(10, "Nested MFOC...");
+            success = mfcuk_mfoc_nested_attack(config, key);
+            break;
+        
         default:
             mfcuk_update_progress(100, "Modalità non supportata");
             delay(2000);
+            rfid_session_close(&session);
             return false;
     }
     
+    rfid_session_report(&session);
+    rfid_session_close(&session);
+    
     // Mostra risultato
     if (success) {
         bytes_to_hex(key, keyHex, MIFARE_KEY_SIZE);
@@ -40,6 +40,7 @@ void mfcuk_set_target();
 void mfcuk_set_mode();
 void mfcuk_set_timing();
 void mfcuk_update_progress(int progress, const char* status);
+void mfcuk_run_benchmark();
 
 // Funzioni di configurazione
 void mfcuk_set_default_config();
@@ -0,0 +1,85 @@
+/**
+ * MFCUK - Arena di memoria per gli attacchi
+ */
+
+#include "mfcuk_arena.h"
+
+#ifdef ARDUINO
+#define ARENA_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#include <stdio.h>
+#define ARENA_LOG(...) printf(__VA_ARGS__)
+#endif
+
+bool mfcuk_arena_init(MfcukArena* a, size_t capacity) {
+    memset(a, 0, sizeof(*a));
+
+    capacity &= ~(size_t)(MFCUK_ARENA_ALIGN - 1);
+    if (capacity == 0) return false;
+
+    a->base = (uint8_t*)malloc(capacity);
+    if (a->base == NULL) return false;
+
+    a->capacity = capacity;
+    return true;
+}
+
+bool mfcuk_arena_init_heap(MfcukArena* a, size_t min_bytes, size_t max_bytes) {
+    size_t size = max_bytes;
+
+#ifdef ARDUINO
+    size_t avail = ESP.getMaxAllocHeap();
+    avail = avail > MFCUK_ARENA_RESERVE ? avail - MFCUK_ARENA_RESERVE : 0;
+    if (size > avail) size = avail;
+#endif
+
+    if (size < min_bytes) {
+        memset(a, 0, sizeof(*a));
+        return false;
+    }
+    return mfcuk_arena_init(a, size);
+}
+
+void mfcuk_arena_free(MfcukArena* a) {
+    if (a->base) free(a->base);
+    memset(a, 0, sizeof(*a));
+}
+
+void* mfcuk_arena_alloc(MfcukArena* a, size_t bytes) {
+    size_t size = (bytes + MFCUK_ARENA_ALIGN - 1) & ~(size_t)(MFCUK_ARENA_ALIGN - 1);
+    void* p;
+
+    if (a->base == NULL || size > a->capacity - a->used) {
+        a->failures++;
+        return NULL;
+    }
+
+    p = a->base + a->used;
+    a->used += size;
+    if (a->used > a->peak) a->peak = a->used;
+    return p;
+}
+
+void* mfcuk_arena_calloc(MfcukArena* a, size_t bytes) {
+    void* p = mfcuk_arena_alloc(a, bytes);
+
+    if (p) memset(p, 0, bytes);
+    return p;
+}
+
+MfcukArenaMark mfcuk_arena_mark(const MfcukArena* a) {
+    return a->used;
+}
+
+void mfcuk_arena_reset(MfcukArena* a, MfcukArenaMark mark) {
+    if (mark < a->used) a->used = mark;
+}
+
+size_t mfcuk_arena_remaining(const MfcukArena* a) {
+    return a->capacity - a->used;
+}
+
+void mfcuk_arena_report(const MfcukArena* a, const char* label) {
+    ARENA_LOG("[%s] Arena: %u/%u byte, picco %u, rifiuti %u\n", label, (unsigned)a->used,
+              (unsigned)a->capacity, (unsigned)a->peak, (unsigned)a->failures);
+}
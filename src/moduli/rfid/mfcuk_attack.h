@@ -7,14 +7,18 @@
 
 #include <Arduino.h>
 #include "mfcuk_types.h"
+#include "mfcuk_nonce.h"
+#include "mfcuk_arena.h"
 
 // Dichiarazioni per gli attacchi
 bool mfcuk_darkside_attack(MfcukConfig* config, uint8_t* key);
 bool mfcuk_nested_attack(MfcukConfig* config, uint8_t* key);
+bool mfcuk_backdoor_attack(MfcukConfig* config, uint8_t* key);
+bool mfcuk_hardnested_attack(MfcukConfig* config, uint8_t* key);
+bool mfcuk_mfoc_nested_attack(MfcukConfig* config, uint8_t* key);
 
 // Funzioni di utilità per gli attacchi
-bool mfcuk_collect_nonces(uint32_t uid, uint8_t block, MifareKey* known_key, uint8_t key_type, uint32_t* nonces, int max_nonces, int* num_collected);
-bool mfcuk_recover_key_darkside(uint32_t uid, uint32_t* nonces, int num_nonces, MifareKey* key);
-bool mfcuk_recover_key_nested(uint32_t uid, MifareKey* known_key, uint8_t target_sector, uint8_t target_key_type, uint32_t* distances, int num_distances, MifareKey* recovered_key);
+uint32_t mfcuk_collect_nonces(MfcukConfig* config, uint8_t mode, NonceAcq* acq, MfcukArena* arena, uint64_t* keys, uint32_t max_keys);
+bool mfcuk_verify_candidates(MfcukConfig* config, NonceAcq* acq, const uint64_t* keys, uint32_t num_keys, uint8_t* key);
 
 #endif // _MFCUK_ATTACK_H_
@@ -7,55 +7,78 @@
 
 #include "mfcuk_crypto.h"
 
-// Tabella di lookup per il filtro non lineare
-static const uint8_t filter_table[] = {
-    0x00, 0x10, 0x20, 0x30, 0x10, 0x00, 0x30, 0x20,
-    0x20, 0x30, 0x00, 0x10, 0x30, 0x20, 0x10, 0x00,
-};
+#ifdef CRYPTO1_FILTER20_TABLE
+// Tabella completa del filtro (2^20 bit, 128 KB) generata in fase di build
+// da scripts/gen_crypto1_filter20.py; essendo const resta in flash
+#include "crypto1_filter20.h"
+#endif
+
+// Funzioni booleane del filtro non lineare codificate come tabelle di verità
+// (fa = 0xd938 e fb = 0xf22c lavorano su nibble, fc combina i 5 bit risultanti)
+#define CRYPTO1_FB0  0xf22c0
+#define CRYPTO1_FA1  0x6c9c0
+#define CRYPTO1_FB2  0x3c8b0
+#define CRYPTO1_FB3  0x1e458
+#define CRYPTO1_FA4  0x0d938
+#define CRYPTO1_FC   0xEC57E80A
 
 /**
  * Inizializza uno stato Crypto1 con una chiave a 48 bit
+ * La chiave è nel formato restituito da bytes_to_num (byte 0 più significativo)
  */
 void crypto1_init(Crypto1State *state, uint64_t key) {
     state->odd = state->even = 0;
     
-    // Carica la chiave a 48 bit nello stato iniziale
+    // Carica la chiave a 48 bit nello stato iniziale (bit invertiti per byte)
     for (int i = 47; i > 0; i -= 2) {
-        state->odd  = (state->odd  << 1) | ((key >> (i - 1)) & 1);
-        state->even = (state->even << 1) | ((key >> i) & 1);
+        state->odd  = (state->odd  << 1) | CRYPTO1_BIT(key, (i - 1) ^ 7);
+        state->even = (state->even << 1) | CRYPTO1_BIT(key, i ^ 7);
     }
 }
 
 /**
  * Funzione filtro non lineare per Crypto1
+ * Usa solo i 20 bit meno significativi di una metà dello stato
  */
 uint32_t crypto1_filter(uint32_t in) {
-    uint32_t x = 0;
+    uint32_t f;
     
-    // Applica il filtro non lineare a specifici bit di input
-    x  = filter_table[((in >> 0) & 1) | ((in >> 2) & 2) | ((in >> 4) & 4) | ((in >> 6) & 8)];
-    x |= filter_table[((in >> 8) & 1) | ((in >> 10) & 2) | ((in >> 12) & 4) | ((in >> 14) & 8)] << 1;
-    x |= filter_table[((in >> 16) & 1) | ((in >> 18) & 2) | ((in >> 20) & 4) | ((in >> 22) & 8)] << 2;
-    x |= filter_table[((in >> 24) & 1) | ((in >> 26) & 2) | ((in >> 28) & 4) | ((in >> 30) & 8)] << 3;
+    // Applica fa/fb ai cinque nibble e fc al risultato
+    f  = (CRYPTO1_FB0 >> (in & 0xf)) & 16;
+    f |= (CRYPTO1_FA1 >> ((in >> 4) & 0xf)) & 8;
+    f |= (CRYPTO1_FB2 >> ((in >> 8) & 0xf)) & 4;
+    f |= (CRYPTO1_FB3 >> ((in >> 12) & 0xf)) & 2;
+    f |= (CRYPTO1_FA4 >> ((in >> 16) & 0xf)) & 1;
     
-    return x;
+    return CRYPTO1_BIT(CRYPTO1_FC, f);
+}
+
+/**
+ * Parità di una parola a 32 bit
+ */
+uint8_t crypto1_parity(uint32_t x) {
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    return CRYPTO1_BIT(0x6996, x & 0xf);
 }
 
 /**
  * Aggiorna lo stato Crypto1 con un bit di input
+ * Calcola il feedback lineare, lo inserisce nella metà pari e scambia le metà
  */
 void update_contribution(Crypto1State *state, uint8_t in) {
-    int feedback;
+    uint32_t feedin, t;
     
-    // Aggiorna il registro pari
-    feedback = (state->even & 1) ^ ((state->even >> 16) & 1) ^ 
-               ((state->even >> 19) & 1) ^ ((state->even >> 21) & 1) ^ in;
-    state->even = state->even >> 1 | (feedback << 23);
+    feedin  = in & 1;
+    feedin ^= LF_POLY_ODD & state->odd;
+    feedin ^= LF_POLY_EVEN & state->even;
+    state->even = (state->even << 1) | crypto1_parity(feedin);
     
-    // Aggiorna il registro dispari
-    feedback = (state->odd & 1) ^ ((state->odd >> 16) & 1) ^ 
-               ((state->odd >> 19) & 1) ^ ((state->odd >> 21) & 1);
-    state->odd = state->odd >> 1 | (feedback << 23);
+    // Scambia le metà: il bit appena inserito diventa il bit 0 di 'odd'
+    t = state->odd;
+    state->odd = state->even;
+    state->even = t;
 }
 
 /**
@@ -64,15 +87,15 @@ void update_contribution(Crypto1State *state, uint8_t in) {
 uint8_t crypto1_bit(Crypto1State *state, uint8_t in, uint8_t is_encrypted) {
     uint8_t out;
     
-    // Calcola il bit di output usando il filtro
-    out = crypto1_filter(state->odd) ^ crypto1_filter(state->even);
+    // Calcola il bit di keystream usando il filtro sulla metà dispari
+    out = crypto1_filter(state->odd);
     
     // Se il bit è criptato, XOR l'input con l'output per decifrarlo
     if (is_encrypted)
         in ^= out;
     
     // Aggiorna lo stato con il bit di input
-    update_contribution(state, in);
+    update_contribution(state, in & 1);
     
     return out;
 }
@@ -81,12 +104,172 @@ uint8_t crypto1_bit(Crypto1State *state, uint8_t in, uint8_t is_encrypted) {
  * Processa un byte con Crypto1
  */
 void crypto1_byte(Crypto1State *state, uint8_t *in, uint8_t *out, uint8_t is_encrypted) {
+    uint8_t data = (in != NULL) ? *in : 0;
     *out = 0;
     
     // Processa il byte bit per bit
     for (int i = 0; i < 8; i++) {
-        *out |= (crypto1_bit(state, (*in >> i) & 1, is_encrypted) << i);
+        *out |= (crypto1_bit(state, (data >> i) & 1, is_encrypted) << i);
+    }
+}
+
+/**
+ * Processa una parola a 32 bit con Crypto1
+ * I byte sono trattati nell'ordine in cui viaggiano in aria (big-endian)
+ */
+uint32_t crypto1_word(Crypto1State *state, uint32_t in, uint8_t is_encrypted) {
+    uint32_t out = 0;
+    
+    for (int i = 0; i < 32; i++) {
+        out |= (uint32_t)crypto1_bit(state, CRYPTO1_BEBIT(in, i), is_encrypted) << (i ^ 24);
+    }
+    
+    return out;
+}
+
+// ----- Passo multi-bit guidato da tabelle -----
+
+// Filtro spezzato in due tabelle: i 12 bit bassi (nibble 0-2) danno i bit
+// 4..2 dell'indice di fc, gli 8 bit alti (nibble 3-4) i bit 1..0
+uint8_t crypto1_filter_lo[4096];
+uint8_t crypto1_filter_hi[256];
+
+// Contributo lineare di ogni byte dello stato e dell'input sugli 8 bit di
+// feedback prodotti da 8 passi consecutivi (senza retroazione del keystream)
+static uint8_t crypto1_lin_odd[3][256];
+static uint8_t crypto1_lin_even[3][256];
+static uint8_t crypto1_lin_in[256];
+
+static bool crypto1_tables_ready = false;
+
+/**
+ * Calcola gli 8 bit di feedback di 8 passi non cifrati a partire da uno stato
+ * Usato solo per costruire le tabelle lineari
+ */
+static uint8_t crypto1_feedback8(uint32_t odd, uint32_t even, uint8_t in) {
+    Crypto1State s = {odd, even};
+    uint8_t out = 0;
+    
+    for (int i = 0; i < 8; i++) {
+        update_contribution(&s, (in >> i) & 1);
+        out |= (s.odd & 1) << i;
+    }
+    
+    return out;
+}
+
+/**
+ * Prepara le tabelle del filtro e del feedback lineare (circa 6 KB di RAM)
+ */
+void crypto1_tables_init() {
+    if (crypto1_tables_ready) return;
+    
+    for (uint32_t x = 0; x < 4096; x++) {
+        crypto1_filter_lo[x] = ((CRYPTO1_FB0 >> (x & 0xf)) & 16) |
+                               ((CRYPTO1_FA1 >> ((x >> 4) & 0xf)) & 8) |
+                               ((CRYPTO1_FB2 >> ((x >> 8) & 0xf)) & 4);
+    }
+    for (uint32_t x = 0; x < 256; x++) {
+        crypto1_filter_hi[x] = ((CRYPTO1_FB3 >> (x & 0xf)) & 2) |
+                               ((CRYPTO1_FA4 >> ((x >> 4) & 0xf)) & 1);
     }
+    
+    // Il feedback è lineare: ogni tabella è la XOR dei contributi dei singoli bit
+    for (int b = 0; b < 3; b++) {
+        for (uint32_t v = 0; v < 256; v++) {
+            crypto1_lin_odd[b][v]  = crypto1_feedback8(v << (8 * b), 0, 0);
+            crypto1_lin_even[b][v] = crypto1_feedback8(0, v << (8 * b), 0);
+        }
+    }
+    for (uint32_t v = 0; v < 256; v++) {
+        crypto1_lin_in[v] = crypto1_feedback8(0, 0, v);
+    }
+    
+    crypto1_tables_ready = true;
+}
+
+/**
+ * Filtro tramite tabelle: un accesso alla tabella completa in flash
+ * oppure due accessi alle tabelle spezzate in RAM
+ */
+static inline uint32_t crypto1_filter_tab(uint32_t in) {
+#ifdef CRYPTO1_FILTER20_TABLE
+    in &= 0xfffff;
+    return (crypto1_filter20_table[in >> 5] >> (in & 31)) & 1;
+#else
+    return CRYPTO1_BIT(CRYPTO1_FC, crypto1_filter_lo[in & 0xfff] | crypto1_filter_hi[(in >> 12) & 0xff]);
+#endif
+}
+
+/**
+ * Versione esportata del filtro a tabelle
+ */
+uint32_t crypto1_filter_fast(uint32_t in) {
+    crypto1_tables_init();
+    return crypto1_filter_tab(in);
+}
+
+/**
+ * Processa un byte con Crypto1 tramite tabelle
+ * Senza retroazione del keystream gli 8 bit di feedback sono una funzione
+ * lineare dello stato: 7 accessi alle tabelle li producono tutti, poi
+ * 8 accessi al filtro sulle finestre dello stato finale danno il keystream.
+ * Con is_encrypted ogni bit dipende dal keystream precedente, quindi si
+ * procede bit per bit usando comunque il filtro a tabelle.
+ */
+uint8_t crypto1_byte_fast(Crypto1State *state, uint8_t in, uint8_t is_encrypted) {
+    uint32_t odd = state->odd, even = state->even;
+    uint8_t out = 0;
+    
+    crypto1_tables_init();
+    
+    if (is_encrypted) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t ks = crypto1_filter_tab(odd);
+            uint32_t feedin = (((in >> i) ^ ks) & 1) ^ (LF_POLY_ODD & odd) ^ (LF_POLY_EVEN & even);
+            uint32_t t = (even << 1) | crypto1_parity(feedin);
+            even = odd;
+            odd = t;
+            out |= ks << i;
+        }
+    } else {
+        uint8_t fb = crypto1_lin_odd[0][odd & 0xff] ^ crypto1_lin_odd[1][(odd >> 8) & 0xff] ^
+                     crypto1_lin_odd[2][(odd >> 16) & 0xff] ^ crypto1_lin_even[0][even & 0xff] ^
+                     crypto1_lin_even[1][(even >> 8) & 0xff] ^ crypto1_lin_even[2][(even >> 16) & 0xff] ^
+                     crypto1_lin_in[in];
+        
+        // I bit di feedback pari finiscono in 'even', quelli dispari in 'odd'
+        odd  = (odd << 4)  | (((fb >> 1) & 1) << 3) | (((fb >> 3) & 1) << 2) | (((fb >> 5) & 1) << 1) | ((fb >> 7) & 1);
+        even = (even << 4) | ((fb & 1) << 3) | (((fb >> 2) & 1) << 2) | (((fb >> 4) & 1) << 1) | ((fb >> 6) & 1);
+        
+        // Il passo k filtra la metà dispari di quel momento, che è una finestra dello stato finale
+        out  = crypto1_filter_tab(odd >> 4);
+        out |= crypto1_filter_tab(even >> 3) << 1;
+        out |= crypto1_filter_tab(odd >> 3) << 2;
+        out |= crypto1_filter_tab(even >> 2) << 3;
+        out |= crypto1_filter_tab(odd >> 2) << 4;
+        out |= crypto1_filter_tab(even >> 1) << 5;
+        out |= crypto1_filter_tab(odd >> 1) << 6;
+        out |= crypto1_filter_tab(even) << 7;
+    }
+    
+    state->odd = odd;
+    state->even = even;
+    return out;
+}
+
+/**
+ * Processa una parola a 32 bit tramite tabelle (4 passi da un byte)
+ * Stesso ordine dei bit di crypto1_word
+ */
+uint32_t crypto1_word_fast(Crypto1State *state, uint32_t in, uint8_t is_encrypted) {
+    uint32_t out = 0;
+    
+    for (int b = 3; b >= 0; b--) {
+        out |= (uint32_t)crypto1_byte_fast(state, (in >> (8 * b)) & 0xff, is_encrypted) << (8 * b);
+    }
+    
+    return out;
 }
 
 /**
@@ -110,67 +293,190 @@ void crypto1_destroy(Crypto1State* state) {
 }
 
 /**
- * Calcola il successore del generatore PRNG
+ * Verifica una chiave candidata contro una autenticazione catturata
+ * Ricostruisce il keystream del reader e controlla che {ar} decifrato
+ * corrisponda a suc^64(nt)
  */
-uint32_t prng_successor(uint32_t x, uint32_t n) {
-    uint32_t i, nonce = x;
+bool crypto1_test_key(const Crypto1Auth* auth, uint64_t key) {
+    Crypto1State state;
+    uint32_t ks2;
     
-    for (i = 0; i < n; i++) {
-        nonce = ((nonce << 16) ^ (nonce >> 16)) + nonce;
+    crypto1_init(&state, key);
+    crypto1_word_fast(&state, auth->uid ^ auth->nt, 0);
+    crypto1_word_fast(&state, auth->nr_enc, 1);
+    ks2 = crypto1_word_fast(&state, 0, 0);
+    
+    return (auth->ar_enc ^ ks2) == prng_successor(auth->nt, 64);
+}
+
+// ----- Rollback dello stato ed estrazione della chiave -----
+
+/**
+ * Riavvolge lo stato di un passo (inverso di crypto1_bit)
+ * Il bit uscito dalla metà pari viene ricalcolato dal feedback
+ * @return bit di keystream prodotto in quel passo
+ */
+uint8_t crypto1_rollback_bit(Crypto1State *state, uint8_t in, uint8_t is_encrypted) {
+    uint32_t out, t;
+    uint8_t ret;
+    
+    // Annulla lo scambio delle metà; i bit oltre il 24 non fanno parte dello stato
+    state->odd &= 0xffffff;
+    t = state->odd;
+    state->odd = state->even;
+    state->even = t;
+    
+    out  = state->even & 1;
+    out ^= LF_POLY_EVEN & (state->even >>= 1);
+    out ^= LF_POLY_ODD & state->odd;
+    out ^= in & 1;
+    ret = crypto1_filter(state->odd);
+    if (is_encrypted)
+        out ^= ret;
+    
+    state->even |= (uint32_t)crypto1_parity(out) << 23;
+    return ret;
+}
+
+/**
+ * Riavvolge un byte (stesso ordine dei bit di crypto1_byte)
+ */
+uint8_t crypto1_rollback_byte(Crypto1State *state, uint8_t in, uint8_t is_encrypted) {
+    uint8_t out = 0;
+    
+    for (int i = 7; i >= 0; i--) {
+        out |= crypto1_rollback_bit(state, (in >> i) & 1, is_encrypted) << i;
     }
     
-    return nonce;
+    return out;
 }
 
 /**
- * Implementazione dell'algoritmo Darkside per il recupero delle chiavi
- * Versione semplificata - in una implementazione completa sarebbe più complesso
+ * Riavvolge una parola a 32 bit (stesso ordine dei bit di crypto1_word)
  */
-bool darkside_key_recovery(uint32_t uid, uint32_t nonce, uint64_t *key) {
-    // Questa è una versione semplificata solo per dimostrare la struttura
-    // L'implementazione completa richiederebbe l'intero algoritmo di attacco darkside
+uint32_t crypto1_rollback_word(Crypto1State *state, uint32_t in, uint8_t is_encrypted) {
+    uint32_t out = 0;
     
-    // In una implementazione reale, si calcolerebbero le chiavi candidate basate su
-    // UID e nonce raccolti, e si verificherebbero contro il lettore
+    for (int i = 31; i >= 0; i--) {
+        out |= (uint32_t)crypto1_rollback_bit(state, CRYPTO1_BEBIT(in, i), is_encrypted) << (i ^ 24);
+    }
     
-    // Implementazione di esempio (non funzionante, solo come placeholder)
-    uint64_t candidate_key = 0;
-    bool found = false;
+    return out;
+}
+
+/**
+ * Estrae la chiave da uno stato appena inizializzato (inverso di crypto1_init)
+ */
+uint64_t crypto1_get_key(const Crypto1State *state) {
+    uint64_t key = 0;
     
-    // Nota: implementazione reale richiede un'analisi più complessa dei dati raccolti
-    // e la verifica delle chiavi candidate con autenticazioni di prova
+    for (int i = 0; i < 24; i++) {
+        key |= (uint64_t)CRYPTO1_BIT(state->odd, i) << ((2 * i) ^ 7);
+        key |= (uint64_t)CRYPTO1_BIT(state->even, i) << ((2 * i + 1) ^ 7);
+    }
     
-    if (found) {
-        *key = candidate_key;
-        return true;
+    return key;
+}
+
+static int crypto1_key_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Ordina le chiavi in place ed elimina i duplicati
+ * @return numero di chiavi uniche
+ */
+uint32_t crypto1_keys_sort_unique(uint64_t* keys, uint32_t n) {
+    uint32_t j = 0;
+    
+    if (n == 0) return 0;
+    qsort(keys, n, sizeof(uint64_t), crypto1_key_compare);
+    
+    for (uint32_t i = 1; i < n; i++) {
+        if (keys[i] != keys[j]) keys[++j] = keys[i];
+    }
+    
+    return j + 1;
+}
+
+/**
+ * Converte un blocco di stati candidati in chiavi
+ * Ogni stato viene riavvolto lungo le parole di rb; il risultato è
+ * ordinato e senza duplicati
+ * @return numero di chiavi scritte in keys
+ */
+uint32_t crypto1_states_to_keys(const Crypto1State* states, uint32_t n, const Crypto1Rollback* rb, uint64_t* keys) {
+    for (uint32_t i = 0; i < n; i++) {
+        Crypto1State s = states[i];
+        
+        for (int w = rb->count - 1; w >= 0; w--) {
+            crypto1_rollback_word(&s, rb->in[w], rb->is_encrypted[w]);
+        }
+        keys[i] = crypto1_get_key(&s);
     }
     
-    return false;
+    return crypto1_keys_sort_unique(keys, n);
+}
+
+/**
+ * Prepara un estrattore: gli stati ricevuti vengono convertiti a blocchi
+ * di CRYPTO1_KEY_BATCH e passati al sink
+ */
+void crypto1_key_extractor_init(Crypto1KeyExtractor* kx, const Crypto1Rollback* rb, crypto1_key_sink sink, void* ctx) {
+    memset(kx, 0, sizeof(*kx));
+    kx->rollback = *rb;
+    kx->sink = sink;
+    kx->sink_ctx = ctx;
+}
+
+/**
+ * Converte il blocco in attesa e lo consegna al sink
+ */
+bool crypto1_key_extractor_flush(Crypto1KeyExtractor* kx) {
+    uint32_t n;
+    
+    if (kx->count == 0 || kx->stopped) return !kx->stopped;
+    
+    n = crypto1_states_to_keys(kx->batch, kx->count, &kx->rollback, kx->keys);
+    kx->count = 0;
+    kx->total_keys += n;
+    
+    if (!kx->sink(kx->keys, n, kx->sink_ctx)) kx->stopped = true;
+    
+    return !kx->stopped;
 }
 
 /**
- * Implementazione dell'algoritmo Nested per il recupero delle chiavi
- * Versione semplificata - in una implementazione completa sarebbe più complesso
+ * Aggiunge uno stato candidato; ha la firma di una callback di recupero
+ * (ctx è il Crypto1KeyExtractor) e può essere passata direttamente
+ * a lfsr_recovery32/lfsr_recovery64
  */
-bool nested_key_recovery(uint32_t* distances, int numDistances, uint64_t* key) {
-    // Questa è una versione semplificata solo per dimostrare la struttura
-    // L'implementazione completa richiederebbe la ricerca di stati validi basati
-    // sulle distanze tra nonce
+bool crypto1_key_extractor_add(const Crypto1State* state, void* ctx) {
+    Crypto1KeyExtractor* kx = (Crypto1KeyExtractor*)ctx;
     
-    // In una implementazione reale, si analizzerebbero le distanze per trovare
-    // gli stati interni candidati del PRNG e si ricostruirebbe la chiave
+    kx->batch[kx->count++] = *state;
+    kx->total_states++;
     
-    // Implementazione di esempio (non funzionante, solo come placeholder)
-    uint64_t candidate_key = 0;
-    bool found = false;
+    if (kx->count == CRYPTO1_KEY_BATCH) return crypto1_key_extractor_flush(kx);
     
-    // Nota: implementazione reale richiede un'analisi delle distanze tra nonce
-    // e una ricerca dello spazio degli stati interni validi
+    return true;
+}
+
+/**
+ * Sink che accoda le chiavi nel buffer di un Crypto1KeyBuffer
+ * A fine raccolta crypto1_keys_sort_unique elimina i duplicati tra blocchi
+ */
+bool crypto1_key_buffer_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    Crypto1KeyBuffer* kb = (Crypto1KeyBuffer*)ctx;
     
-    if (found) {
-        *key = candidate_key;
-        return true;
+    for (uint32_t i = 0; i < n; i++) {
+        if (kb->count < kb->max) {
+            kb->keys[kb->count++] = keys[i];
+        } else {
+            kb->dropped++;
+        }
     }
     
-    return false;
+    return true;
 }
@@ -8,14 +8,76 @@
 #ifndef _MFCUK_CRYPTO_H_
 #define _MFCUK_CRYPTO_H_
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
 
 // Struttura per lo stato Crypto1
+// Il LFSR a 48 bit è diviso in due metà da 24 bit: i bit in posizione
+// pari del registro finiscono in 'even', quelli in posizione dispari in 'odd'
 typedef struct {
     uint32_t odd;     // bit dispari
     uint32_t even;    // bit pari
 } Crypto1State;
 
+// Traccia di una autenticazione catturata (lato reader)
+// nr_enc e ar_enc sono i valori cifrati così come viaggiano in aria
+typedef struct {
+    uint32_t uid;     // UID della carta (primi 4 byte)
+    uint32_t nt;      // Nonce della carta in chiaro
+    uint32_t nr_enc;  // {nr} nonce del reader cifrato
+    uint32_t ar_enc;  // {ar} risposta del reader cifrata
+} Crypto1Auth;
+
+// {nt} di un'autenticazione nested con i bit di parità ricevuti: con la
+// chiave giusta le parità dei primi 3 byte tornano
+typedef struct {
+    uint32_t uid;     // UID della carta (primi 4 byte)
+    uint32_t nt_enc;  // {nt} cifrato così come viaggia in aria
+    uint8_t  par;     // Parità ricevute (bit i = byte i)
+} Crypto1EncNonce;
+
+// Parole immesse nel LFSR dopo l'inizializzazione, nell'ordine in cui sono
+// state elaborate: il rollback le percorre dall'ultima alla prima
+// (es. nested: {uid^nt, in chiaro}; autenticazione: {uid^nt}, {nr} cifrato, 0, 0)
+#define CRYPTO1_ROLLBACK_MAX  4
+
+typedef struct {
+    uint32_t in[CRYPTO1_ROLLBACK_MAX];
+    uint8_t  is_encrypted[CRYPTO1_ROLLBACK_MAX];
+    uint8_t  count;
+} Crypto1Rollback;
+
+// Estrazione delle chiavi a blocchi da un flusso di stati candidati
+#define CRYPTO1_KEY_BATCH  64
+
+// Riceve un blocco di chiavi ordinate e senza duplicati; false per interrompere
+typedef bool (*crypto1_key_sink)(const uint64_t* keys, uint32_t n, void* ctx);
+
+typedef struct {
+    Crypto1State batch[CRYPTO1_KEY_BATCH];
+    uint64_t keys[CRYPTO1_KEY_BATCH];
+    uint32_t count;             // Stati in attesa nel blocco
+    Crypto1Rollback rollback;
+    crypto1_key_sink sink;
+    void* sink_ctx;
+    uint32_t total_states;      // Stati ricevuti
+    uint32_t total_keys;        // Chiavi consegnate al sink
+    bool stopped;               // Il sink ha chiesto di interrompere
+} Crypto1KeyExtractor;
+
+// Sink che accumula le chiavi in un buffer del chiamante
+typedef struct {
+    uint64_t* keys;
+    uint32_t count;
+    uint32_t max;
+    uint32_t dropped;           // Chiavi scartate per buffer pieno
+} Crypto1KeyBuffer;
+
 // Costanti per LFSR (Linear Feedback Shift Register)
 #define FEEDBACK_IN_1   0x04
 #define FEEDBACK_IN_2   0x08
@@ -23,23 +85,56 @@ typedef struct {
 #define LF_POLY_ODD    0x29CE5C
 #define LF_POLY_EVEN   0x870804
 
+// Estrazione di un bit (BEBIT: ordine dei byte invertito, come in aria)
+#define CRYPTO1_BIT(x, n)   (((x) >> (n)) & 1)
+#define CRYPTO1_BEBIT(x, n) CRYPTO1_BIT(x, (n) ^ 24)
+
 // Funzioni principali Crypto1
 void crypto1_init(Crypto1State *state, uint64_t key);
 void crypto1_byte(Crypto1State *state, uint8_t *in, uint8_t *out, uint8_t is_encrypted);
+uint32_t crypto1_word(Crypto1State *state, uint32_t in, uint8_t is_encrypted);
 uint8_t crypto1_bit(Crypto1State *state, uint8_t in, uint8_t is_encrypted);
 uint32_t crypto1_filter(uint32_t in);
+uint8_t crypto1_parity(uint32_t x);
+
+// Passo multi-bit guidato da tabelle (keystream di 8 o 32 bit per chiamata)
+void crypto1_tables_init();
+uint32_t crypto1_filter_fast(uint32_t in);
+uint8_t crypto1_byte_fast(Crypto1State *state, uint8_t in, uint8_t is_encrypted);
+uint32_t crypto1_word_fast(Crypto1State *state, uint32_t in, uint8_t is_encrypted);
+
+// Tabelle del filtro spezzato, valide dopo crypto1_tables_init()
+extern uint8_t crypto1_filter_lo[4096];
+extern uint8_t crypto1_filter_hi[256];
+
+// Filtro in linea per i cicli interni (richiede crypto1_tables_init)
+static inline uint32_t crypto1_filter_inline(uint32_t in) {
+    return (0xEC57E80A >> (crypto1_filter_lo[in & 0xfff] | crypto1_filter_hi[(in >> 12) & 0xff])) & 1;
+}
 
 // Funzioni di gestione dello stato
 Crypto1State* crypto1_create(uint64_t key);
 void crypto1_destroy(Crypto1State* state);
 void update_contribution(Crypto1State *state, uint8_t in);
 
-// Funzioni per PRNG
+// Funzioni per PRNG (tabelle e distanze in mfcuk_crypto_prng.h)
 uint32_t prng_successor(uint32_t x, uint32_t n);
 
-// Funzioni per il recupero delle chiavi
-bool darkside_key_recovery(uint32_t uid, uint32_t nonce, uint64_t *key);
-bool nested_key_recovery(uint32_t* distances, int numDistances, uint64_t* key);
-bool darkside_crack(uint32_t nt, uint32_t nr, uint32_t ar, uint64_t *key);
+// Verifica scalare di una chiave contro una autenticazione catturata
+bool crypto1_test_key(const Crypto1Auth* auth, uint64_t key);
+
+// Rollback dello stato (inverso di crypto1_bit/byte/word) ed estrazione della chiave
+uint8_t crypto1_rollback_bit(Crypto1State *state, uint8_t in, uint8_t is_encrypted);
+uint8_t crypto1_rollback_byte(Crypto1State *state, uint8_t in, uint8_t is_encrypted);
+uint32_t crypto1_rollback_word(Crypto1State *state, uint32_t in, uint8_t is_encrypted);
+uint64_t crypto1_get_key(const Crypto1State *state);
+
+// Conversione a blocchi stato -> chiave senza allocazioni per candidato
+uint32_t crypto1_states_to_keys(const Crypto1State* states, uint32_t n, const Crypto1Rollback* rb, uint64_t* keys);
+uint32_t crypto1_keys_sort_unique(uint64_t* keys, uint32_t n);
+void crypto1_key_extractor_init(Crypto1KeyExtractor* kx, const Crypto1Rollback* rb, crypto1_key_sink sink, void* ctx);
+bool crypto1_key_extractor_add(const Crypto1State* state, void* ctx);
+bool crypto1_key_extractor_flush(Crypto1KeyExtractor* kx);
+bool crypto1_key_buffer_sink(const uint64_t* keys, uint32_t n, void* ctx);
 
 #endif // _MFCUK_CRYPTO_H_
@@ -0,0 +1,289 @@
+/**
+ * MFCUK - Crypto1 bitsliced
+ *
+ * Il LFSR è memorizzato come una sequenza di "slice": slice[pos + a] contiene
+ * il bit di età a (0 = ultimo bit inserito) di tutte le chiavi della lane.
+ * Nella rappresentazione odd/even di Crypto1State il bit i di 'odd' ha età 2i
+ * e il bit i di 'even' ha età 2i+1. Ogni passo inserisce una nuova slice in
+ * testa, quindi non serve nessuno shift della parola.
+ */
+
+#include "mfcuk_crypto_bs.h"
+
+#ifndef ARDUINO
+#include <time.h>
+#endif
+
+// Passi totali di una verifica: uid^nt (32) + {nr} (32) + {ar} (32)
+#define BS_STEPS      96
+#define BS_STATE_BITS CRYPTO1_BS_STATE_BITS
+
+// Passi per le parità di {nt}: l'ultima usa il keystream del bit 24
+#define BS_NONCE_STEPS 25
+
+// Età dei bit che entrano nel feedback lineare (LF_POLY_ODD/LF_POLY_EVEN)
+#define BS_FEEDBACK(s) ((s)[4] ^ (s)[5] ^ (s)[6] ^ (s)[8] ^ (s)[12] ^ (s)[18] ^ \
+                        (s)[20] ^ (s)[22] ^ (s)[23] ^ (s)[28] ^ (s)[30] ^ (s)[32] ^ \
+                        (s)[33] ^ (s)[35] ^ (s)[37] ^ (s)[38] ^ (s)[42] ^ (s)[47])
+
+/**
+ * Tempo in microsecondi per il benchmark
+ */
+static uint32_t bs_micros() {
+#ifdef ARDUINO
+    return micros();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+#endif
+}
+
+/**
+ * Funzioni booleane del filtro in forma bitsliced
+ * bs_fa corrisponde alla tabella 0xd938, bs_fb a 0xf22c, bs_fc a 0xEC57E80A
+ */
+static inline crypto1_bs_t bs_fa(crypto1_bs_t y0, crypto1_bs_t y1, crypto1_bs_t y2, crypto1_bs_t y3) {
+    return ((y0 | y1) ^ (y0 & y3)) ^ (y2 & ((y0 ^ y1) | y3));
+}
+
+static inline crypto1_bs_t bs_fb(crypto1_bs_t y0, crypto1_bs_t y1, crypto1_bs_t y2, crypto1_bs_t y3) {
+    return ((y0 & y1) | y2) ^ ((y0 ^ y1) & (y2 | y3));
+}
+
+static inline crypto1_bs_t bs_fc(crypto1_bs_t y0, crypto1_bs_t y1, crypto1_bs_t y2,
+                                 crypto1_bs_t y3, crypto1_bs_t y4) {
+    return (y0 | ((y1 | y4) & (y3 ^ y4))) ^ ((y0 ^ (y1 & y3)) & ((y2 ^ y3) | (y1 & y4)));
+}
+
+/**
+ * Filtro non lineare su 32/64 stati: il nibble k della metà dispari
+ * ha i bit alle età 8k, 8k+2, 8k+4, 8k+6
+ */
+static inline crypto1_bs_t bs_filter(const crypto1_bs_t* s) {
+    crypto1_bs_t n0 = bs_fb(s[6],  s[4],  s[2],  s[0]);
+    crypto1_bs_t n1 = bs_fa(s[14], s[12], s[10], s[8]);
+    crypto1_bs_t n2 = bs_fb(s[22], s[20], s[18], s[16]);
+    crypto1_bs_t n3 = bs_fb(s[30], s[28], s[26], s[24]);
+    crypto1_bs_t n4 = bs_fa(s[38], s[36], s[34], s[32]);
+    return bs_fc(n4, n3, n2, n1, n0);
+}
+
+/**
+ * Trasposizione in place di una matrice di bit WxW (W = CRYPTO1_BS_LANES)
+ * Convenzione MSB-first: il bit (W-1-c) della riga r diventa il bit (W-1-r) della riga c
+ */
+static void bs_transpose(crypto1_bs_t* a) {
+    int j = CRYPTO1_BS_LANES / 2;
+    crypto1_bs_t m = ~(crypto1_bs_t)0 >> j;
+
+    for (; j != 0; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < CRYPTO1_BS_LANES; k = (k + j + 1) & ~j) {
+            crypto1_bs_t t = (a[k] ^ (a[k + j] >> j)) & m;
+            a[k] ^= t;
+            a[k + j] ^= (t << j);
+        }
+    }
+}
+
+/**
+ * Carica le chiavi nelle slice (trasposizione chiave -> lane)
+ * Dopo crypto1_init il bit di età a dello stato è il bit (a ^ 7) della chiave,
+ * quindi basta trasporre le chiavi senza simulare l'inizializzazione
+ */
+static void bs_load_keys(crypto1_bs_t* s, const uint64_t* keys, int num_keys) {
+    crypto1_bs_t m[CRYPTO1_BS_LANES];
+
+    for (int part = 0; part * CRYPTO1_BS_LANES < BS_STATE_BITS; part++) {
+        int shift = part * CRYPTO1_BS_LANES;
+
+        memset(m, 0, sizeof(m));
+        for (int lane = 0; lane < num_keys; lane++) {
+            m[CRYPTO1_BS_LANES - 1 - lane] = (crypto1_bs_t)(keys[lane] >> shift);
+        }
+        bs_transpose(m);
+
+        for (int a = 0; a < BS_STATE_BITS; a++) {
+            int b = (a ^ 7) - shift;
+            if (b >= 0 && b < CRYPTO1_BS_LANES) {
+                s[a] = m[CRYPTO1_BS_LANES - 1 - b];
+            }
+        }
+    }
+}
+
+/**
+ * Verifica fino a CRYPTO1_BS_LANES chiavi in un solo passaggio
+ */
+crypto1_bs_t crypto1_bs_test_batch(const Crypto1Auth* auth, const uint64_t* keys, int num_keys) {
+    crypto1_bs_t slices[BS_STATE_BITS + BS_STEPS];
+    crypto1_bs_t alive;
+    uint32_t uid_nt = auth->uid ^ auth->nt;
+    uint32_t ks2_expected = auth->ar_enc ^ prng_successor(auth->nt, 64);
+    int pos = BS_STEPS;
+    int i;
+
+    if (num_keys <= 0) return 0;
+    if (num_keys > CRYPTO1_BS_LANES) num_keys = CRYPTO1_BS_LANES;
+    alive = (num_keys == CRYPTO1_BS_LANES) ? ~(crypto1_bs_t)0 : (((crypto1_bs_t)1 << num_keys) - 1);
+
+    bs_load_keys(&slices[pos], keys, num_keys);
+
+    // Fase 1: uid^nt in chiaro, il keystream non serve
+    for (i = 0; i < 32; i++) {
+        crypto1_bs_t in = CRYPTO1_BEBIT(uid_nt, i) ? ~(crypto1_bs_t)0 : 0;
+        crypto1_bs_t fb = BS_FEEDBACK(&slices[pos]) ^ in;
+        slices[--pos] = fb;
+    }
+
+    // Fase 2: {nr} cifrato, il bit in chiaro è {nr} ^ keystream
+    for (i = 0; i < 32; i++) {
+        crypto1_bs_t in = CRYPTO1_BEBIT(auth->nr_enc, i) ? ~(crypto1_bs_t)0 : 0;
+        crypto1_bs_t ks = bs_filter(&slices[pos]);
+        crypto1_bs_t fb = BS_FEEDBACK(&slices[pos]) ^ in ^ ks;
+        slices[--pos] = fb;
+    }
+
+    // Fase 3: confronto del keystream con {ar} ^ suc^64(nt), uscita anticipata
+    for (i = 0; i < 32 && alive; i++) {
+        crypto1_bs_t expected = CRYPTO1_BEBIT(ks2_expected, i) ? ~(crypto1_bs_t)0 : 0;
+        crypto1_bs_t ks = bs_filter(&slices[pos]);
+        crypto1_bs_t fb = BS_FEEDBACK(&slices[pos]);
+        alive &= ~(ks ^ expected);
+        slices[--pos] = fb;
+    }
+
+    return alive;
+}
+
+/**
+ * Verifica N chiavi candidate a blocchi di CRYPTO1_BS_LANES
+ */
+size_t crypto1_bs_test_keys(const Crypto1Auth* auth, const uint64_t* keys, size_t num_keys,
+                            uint64_t* matches, size_t max_matches) {
+    size_t found = 0;
+
+    for (size_t base = 0; base < num_keys; base += CRYPTO1_BS_LANES) {
+        int batch = (num_keys - base > (size_t)CRYPTO1_BS_LANES) ? CRYPTO1_BS_LANES : (int)(num_keys - base);
+        crypto1_bs_t mask = crypto1_bs_test_batch(auth, &keys[base], batch);
+
+        while (mask) {
+            int lane = __builtin_ctzll((unsigned long long)mask);
+            if (matches != NULL && found < max_matches) {
+                matches[found] = keys[base + lane];
+            }
+            found++;
+            mask &= mask - 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Il nonce avanza lo stato in modalità cifrata (entra uid ^ nt in chiaro).
+ * La parità del byte i è cifrata con il keystream del primo bit del byte
+ * i+1: confrontata con la parità di {nt}, la differenza è la parità del
+ * keystream del byte i più quel bit
+ */
+crypto1_bs_t crypto1_bs_test_nonces(const crypto1_bs_t* state, const Crypto1EncNonce* nonces, int num_nonces,
+                                    crypto1_bs_t alive) {
+    crypto1_bs_t slices[BS_STATE_BITS + BS_NONCE_STEPS];
+
+    for (int n = 0; n < num_nonces && alive; n++) {
+        uint32_t in_word = nonces[n].uid ^ nonces[n].nt_enc;
+        crypto1_bs_t acc = 0;
+        int pos = BS_NONCE_STEPS;
+
+        memcpy(&slices[pos], state, sizeof(crypto1_bs_t) * BS_STATE_BITS);
+        for (int i = 0; i < BS_NONCE_STEPS && alive; i++) {
+            crypto1_bs_t ks = bs_filter(&slices[pos]);
+            crypto1_bs_t in, fb;
+
+            if (i > 0 && (i & 7) == 0) {
+                int byte = (i >> 3) - 1;
+                uint8_t enc = nonces[n].nt_enc >> (24 - 8 * byte);
+                uint8_t expected = ((nonces[n].par >> byte) & 1) ^ crypto1_parity(enc) ^ 1;
+
+                alive &= ~(acc ^ ks ^ (expected ? ~(crypto1_bs_t)0 : 0));
+                acc = 0;
+            }
+            if (i == BS_NONCE_STEPS - 1) break;
+
+            acc ^= ks;
+            in = CRYPTO1_BEBIT(in_word, i) ? ~(crypto1_bs_t)0 : 0;
+            fb = BS_FEEDBACK(&slices[pos]) ^ in ^ ks;
+            slices[--pos] = fb;
+        }
+    }
+    return alive;
+}
+
+crypto1_bs_t crypto1_bs_test_nonce_batch(const Crypto1EncNonce* nonces, int num_nonces, const uint64_t* keys,
+                                         int num_keys) {
+    crypto1_bs_t state[BS_STATE_BITS];
+    crypto1_bs_t alive;
+
+    if (num_keys <= 0) return 0;
+    if (num_keys > CRYPTO1_BS_LANES) num_keys = CRYPTO1_BS_LANES;
+    alive = (num_keys == CRYPTO1_BS_LANES) ? ~(crypto1_bs_t)0 : (((crypto1_bs_t)1 << num_keys) - 1);
+
+    bs_load_keys(state, keys, num_keys);
+    return crypto1_bs_test_nonces(state, nonces, num_nonces, alive);
+}
+
+/**
+ * Genera una chiave pseudo-casuale deterministica per il benchmark
+ */
+static uint64_t bs_bench_key(uint32_t i) {
+    uint64_t x = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+    x ^= x >> 29;
+    return x & 0xFFFFFFFFFFFFULL;
+}
+
+/**
+ * Benchmark chiavi/secondo: percorso scalare vs bitsliced
+ * Usa una traccia reale (chiave FFFFFFFFFFFF) e inserisce la chiave
+ * corretta in mezzo al flusso per controllare che entrambi la trovino
+ */
+void crypto1_bs_benchmark(uint32_t num_keys, Crypto1BsBench* result) {
+    const Crypto1Auth auth = {0x9c599b32, 0x82a4166c, 0xa1e458ce, 0x6eea41e0};
+    const uint64_t control_key = 0xFFFFFFFFFFFFULL;
+    uint64_t batch[CRYPTO1_BS_LANES];
+    uint32_t scalar_hits = 0, bs_hits = 0;
+    uint32_t start;
+
+    if (num_keys < (uint32_t)CRYPTO1_BS_LANES) num_keys = CRYPTO1_BS_LANES;
+    num_keys -= num_keys % CRYPTO1_BS_LANES;
+
+    // Percorso scalare
+    start = bs_micros();
+    for (uint32_t i = 0; i < num_keys; i++) {
+        uint64_t key = (i == num_keys / 2) ? control_key : bs_bench_key(i);
+        if (crypto1_test_key(&auth, key)) scalar_hits++;
+    }
+    result->scalar_us = bs_micros() - start;
+
+    // Percorso bitsliced
+    start = bs_micros();
+    for (uint32_t base = 0; base < num_keys; base += CRYPTO1_BS_LANES) {
+        for (int lane = 0; lane < CRYPTO1_BS_LANES; lane++) {
+            uint32_t i = base + lane;
+            batch[lane] = (i == num_keys / 2) ? control_key : bs_bench_key(i);
+        }
+        bs_hits += crypto1_bs_test_keys(&auth, batch, CRYPTO1_BS_LANES, NULL, 0);
+    }
+    result->bs_us = bs_micros() - start;
+
+    result->num_keys = num_keys;
+    result->scalar_kps = result->scalar_us ? (uint32_t)((uint64_t)num_keys * 1000000ULL / result->scalar_us) : 0;
+    result->bs_kps = result->bs_us ? (uint32_t)((uint64_t)num_keys * 1000000ULL / result->bs_us) : 0;
+    result->match_ok = (scalar_hits >= 1) && (bs_hits == scalar_hits);
+
+#ifdef ARDUINO
+    Serial.printf("[CRYPTO] Benchmark %u chiavi, %d lane\n", (unsigned)num_keys, CRYPTO1_BS_LANES);
+    Serial.printf("[CRYPTO] Scalare:    %u chiavi/s\n", (unsigned)result->scalar_kps);
+    Serial.printf("[CRYPTO] Bitsliced:  %u chiavi/s\n", (unsigned)result->bs_kps);
+    Serial.printf("[CRYPTO] Verifica:   %s\n", result->match_ok ? "OK" : "ERRORE");
+#endif
+}
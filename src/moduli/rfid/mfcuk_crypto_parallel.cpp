@@ -0,0 +1,447 @@
+/**
+ * MFCUK - Verifica parallela delle chiavi candidate
+ *
+ * Ogni worker possiede un intervallo [next, end) protetto da uno spinlock:
+ * il proprietario stacca blocchi dalla testa, un worker rimasto senza
+ * lavoro prende la metà alta dell'intervallo più grande. I lock non sono
+ * mai annidati e proteggono poche istruzioni, quindi bastano gli atomici
+ * del compilatore su entrambe le piattaforme.
+ */
+
+#include "mfcuk_crypto_parallel.h"
+
+#ifdef ARDUINO
+#include <esp_task_wdt.h>
+#else
+#include <time.h>
+#include <thread>
+#include <chrono>
+#endif
+
+#define PAR_LOAD(x)      __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define PAR_STORE(x, v)  __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+// Lettura indicativa di un limite altrui (ricontrollata sotto lock):
+// Xtensa non ha atomici a 64 bit, una lettura spezzata è innocua
+#ifdef ARDUINO
+#define PAR_PEEK64(x)    (*(volatile uint64_t*)&(x))
+#define PAR_SET64(x, v)  ((x) = (v))
+#else
+#define PAR_PEEK64(x)    __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define PAR_SET64(x, v)  __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#endif
+
+typedef struct ParJob ParJob;
+
+typedef struct {
+    uint64_t next;
+    uint64_t end;
+    uint32_t lock;
+    // Contatori scritti solo dal worker proprietario
+    uint64_t processed;
+    uint32_t chunks;
+    uint32_t steals;
+    // Argomento del task
+    ParJob*  job;
+    int      index;
+    uint32_t alive;         // Task avviato: se no, il suo intervallo va preso per intero
+} ParWorker;
+
+struct ParJob {
+    ParWorker w[CRYPTO1_PAR_MAX_WORKERS];
+    int       workers;
+    uint32_t  chunk;
+    crypto1_chunk_fn fn;
+    void*     ctx;
+    uint32_t  stop;         // Richiesto da fn
+    uint32_t  cancel;       // Richiesto dal chiamante
+    uint32_t  active;       // Worker ancora in esecuzione
+    uint32_t  go;           // Avvio dopo la creazione di tutti i task
+};
+
+/**
+ * Tempo in microsecondi per statistiche e benchmark
+ */
+static uint32_t par_micros() {
+#ifdef ARDUINO
+    return micros();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+#endif
+}
+
+static inline void par_lock(uint32_t* lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED));
+    }
+}
+
+static inline void par_unlock(uint32_t* lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Stacca un blocco dalla testa dell'intervallo del worker
+ */
+static bool par_take(ParJob* job, ParWorker* self, uint64_t* begin, uint64_t* end) {
+    bool ok = false;
+
+    par_lock(&self->lock);
+    if (self->next < self->end) {
+        *begin = self->next;
+        *end = (self->end - self->next > job->chunk) ? self->next + job->chunk : self->end;
+        PAR_SET64(self->next, *end);
+        ok = true;
+    }
+    par_unlock(&self->lock);
+
+    return ok;
+}
+
+/**
+ * Ruba la metà alta dell'intervallo più grande tra gli altri worker
+ * Sotto un blocco di lavoro residuo non conviene: lo finisce il proprietario,
+ * a meno che il suo task non sia mai partito
+ */
+static bool par_steal(ParJob* job, ParWorker* self) {
+    ParWorker* victim = NULL;
+    uint64_t best = 0, begin = 0, end = 0;
+
+    // Scelta approssimata senza lock, verificata sotto lock
+    for (int i = 0; i < job->workers; i++) {
+        ParWorker* v = &job->w[i];
+        uint64_t next = PAR_PEEK64(v->next);
+        uint64_t last = PAR_PEEK64(v->end);
+        uint64_t min = v->alive ? job->chunk : 0;
+        if (v != self && last > next && last - next > min && last - next > best) {
+            best = last - next;
+            victim = v;
+        }
+    }
+    if (victim == NULL) return false;
+
+    par_lock(&victim->lock);
+    if (victim->end > victim->next) {
+        uint64_t left = victim->end - victim->next;
+        if (!victim->alive) {
+            begin = victim->next;
+        } else if (left > job->chunk) {
+            begin = victim->next + left / 2;
+        }
+        if (!victim->alive || left > job->chunk) {
+            end = victim->end;
+            PAR_SET64(victim->end, begin);
+        }
+    }
+    par_unlock(&victim->lock);
+
+    if (begin == end) return false;
+
+    par_lock(&self->lock);
+    PAR_SET64(self->next, begin);
+    PAR_SET64(self->end, end);
+    par_unlock(&self->lock);
+
+    self->steals++;
+    return true;
+}
+
+/**
+ * Watchdog: reset a ogni blocco e una pausa periodica per i task idle,
+ * che altrimenti non girerebbero sul core occupato
+ */
+static void par_feed_watchdog(uint32_t* last_yield) {
+#ifdef ARDUINO
+    esp_task_wdt_reset();
+    if (millis() - *last_yield >= CRYPTO1_PAR_YIELD_MS) {
+        vTaskDelay(1);
+        *last_yield = millis();
+    }
+#else
+    (void)last_yield;
+#endif
+}
+
+static void par_worker(ParWorker* self) {
+    ParJob* job = self->job;
+    uint32_t last_yield = 0;
+    uint64_t begin, end;
+
+    while (!PAR_LOAD(job->go)) {
+#ifdef ARDUINO
+        vTaskDelay(1);
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+#ifdef ARDUINO
+    esp_task_wdt_add(NULL);
+    last_yield = millis();
+#endif
+
+    while (!PAR_LOAD(job->stop) && !PAR_LOAD(job->cancel)) {
+        if (!par_take(job, self, &begin, &end)) {
+            if (par_steal(job, self)) continue;
+            break;
+        }
+
+        if (!job->fn(job->ctx, begin, end, self->index)) PAR_STORE(job->stop, 1);
+        self->processed += end - begin;
+        self->chunks++;
+        par_feed_watchdog(&last_yield);
+    }
+
+#ifdef ARDUINO
+    esp_task_wdt_delete(NULL);
+#endif
+
+    // Ultimo accesso al job: dopo il decremento il chiamante può ritornare
+    __atomic_sub_fetch(&job->active, 1, __ATOMIC_ACQ_REL);
+}
+
+#ifdef ARDUINO
+static void par_worker_task(void* arg) {
+    par_worker((ParWorker*)arg);
+    vTaskDelete(NULL);
+}
+#endif
+
+bool crypto1_parallel_run(uint64_t total, uint32_t chunk, int workers, crypto1_chunk_fn fn, void* ctx,
+                          crypto1_idle_fn idle, void* idle_ctx, Crypto1ParallelStats* stats) {
+    ParJob job;
+    uint32_t start = par_micros();
+    int started = 0;
+
+#ifdef ARDUINO
+    int max_workers = CRYPTO1_PAR_MAX_WORKERS;
+#else
+    int max_workers = (int)std::thread::hardware_concurrency();
+    if (max_workers > CRYPTO1_PAR_MAX_WORKERS) max_workers = CRYPTO1_PAR_MAX_WORKERS;
+    if (max_workers < 1) max_workers = 1;
+#endif
+
+    if (workers <= 0 || workers > max_workers) workers = max_workers;
+    if (chunk == 0) chunk = CRYPTO1_PAR_CHUNK;
+
+    memset(&job, 0, sizeof(job));
+    job.workers = workers;
+    job.chunk = chunk;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.active = workers;
+
+    // Partizione iniziale in parti uguali
+    for (int i = 0; i < workers; i++) {
+        job.w[i].job = &job;
+        job.w[i].index = i;
+        job.w[i].alive = 1;
+        job.w[i].next = total / workers * i;
+        job.w[i].end = (i == workers - 1) ? total : total / workers * (i + 1);
+    }
+
+#ifdef ARDUINO
+    // Un worker per core; se un task non parte il suo intervallo viene rubato dagli altri
+    for (int i = 0; i < workers; i++) {
+        char name[16];
+        sprintf(name, "crypto1_par%d", i);
+        if (xTaskCreatePinnedToCore(par_worker_task, name, CRYPTO1_PAR_STACK, &job.w[i], 1, NULL, i % 2) == pdPASS) {
+            started++;
+        } else {
+            job.w[i].alive = 0;
+            __atomic_sub_fetch(&job.active, 1, __ATOMIC_ACQ_REL);
+        }
+    }
+
+    PAR_STORE(job.go, 1);
+    if (started == 0) {
+        // Nessun task disponibile: un solo worker sul task chiamante, che ruba tutto
+        job.w[0].alive = 1;
+        job.active = 1;
+        par_worker(&job.w[0]);
+    }
+
+    while (PAR_LOAD(job.active) > 0) {
+        if (idle && !PAR_LOAD(job.cancel) && !idle(idle_ctx)) PAR_STORE(job.cancel, 1);
+        delay(10);
+    }
+#else
+    std::thread threads[CRYPTO1_PAR_MAX_WORKERS];
+
+    for (int i = 0; i < workers; i++) {
+        threads[i] = std::thread(par_worker, &job.w[i]);
+        started++;
+    }
+    PAR_STORE(job.go, 1);
+
+    while (PAR_LOAD(job.active) > 0) {
+        if (idle && !PAR_LOAD(job.cancel) && !idle(idle_ctx)) PAR_STORE(job.cancel, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (int i = 0; i < workers; i++) threads[i].join();
+#endif
+
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        for (int i = 0; i < workers; i++) {
+            stats->processed += job.w[i].processed;
+            stats->chunks += job.w[i].chunks;
+            stats->steals += job.w[i].steals;
+        }
+        stats->elapsed_ms = (par_micros() - start) / 1000;
+        stats->workers = started ? started : 1;
+        stats->stopped = job.stop != 0;
+        stats->cancelled = job.cancel != 0;
+    }
+
+    return job.cancel == 0;
+}
+
+// ----- Verifica di una lista di chiavi -----
+
+// Verifica su auth oppure, se NULL, sulle parità dei nonce nested
+typedef struct {
+    const Crypto1Auth* auth;
+    const Crypto1EncNonce* nonces;
+    int num_nonces;
+    const uint64_t* keys;
+    uint64_t* matches;
+    uint32_t max_matches;
+    uint32_t found;             // Incrementato atomicamente dai worker
+    bool stop_on_first;
+} ParTestCtx;
+
+static bool par_test_chunk(void* ctx, uint64_t begin, uint64_t end, int worker) {
+    ParTestCtx* t = (ParTestCtx*)ctx;
+    bool hit = false;
+
+    (void)worker;
+    for (uint64_t i = begin; i < end; i += CRYPTO1_BS_LANES) {
+        int n = (end - i < (uint64_t)CRYPTO1_BS_LANES) ? (int)(end - i) : CRYPTO1_BS_LANES;
+        crypto1_bs_t mask = t->auth ? crypto1_bs_test_batch(t->auth, t->keys + i, n)
+                                    : crypto1_bs_test_nonce_batch(t->nonces, t->num_nonces, t->keys + i, n);
+
+        for (int lane = 0; mask; lane++, mask >>= 1) {
+            if (mask & 1) {
+                uint32_t slot = __atomic_fetch_add(&t->found, 1, __ATOMIC_RELAXED);
+                if (t->matches && slot < t->max_matches) t->matches[slot] = t->keys[i + lane];
+                hit = true;
+            }
+        }
+        if (hit && t->stop_on_first) return false;
+    }
+
+    return true;
+}
+
+size_t crypto1_parallel_test_keys(const Crypto1Auth* auth, const uint64_t* keys, size_t num_keys,
+                                  uint64_t* matches, size_t max_matches, bool stop_on_first,
+                                  crypto1_idle_fn idle, void* idle_ctx, Crypto1ParallelStats* stats) {
+    ParTestCtx t;
+
+    t.auth = auth;
+    t.nonces = NULL;
+    t.num_nonces = 0;
+    t.keys = keys;
+    t.matches = matches;
+    t.max_matches = (uint32_t)max_matches;
+    t.found = 0;
+    t.stop_on_first = stop_on_first;
+
+    crypto1_parallel_run(num_keys, CRYPTO1_PAR_CHUNK, 0, par_test_chunk, &t, idle, idle_ctx, stats);
+
+    return t.found;
+}
+
+size_t crypto1_parallel_test_nonces(const Crypto1EncNonce* nonces, int num_nonces, const uint64_t* keys,
+                                    size_t num_keys, uint64_t* matches, size_t max_matches, bool stop_on_first,
+                                    crypto1_idle_fn idle, void* idle_ctx, Crypto1ParallelStats* stats) {
+    ParTestCtx t;
+
+    t.auth = NULL;
+    t.nonces = nonces;
+    t.num_nonces = num_nonces;
+    t.keys = keys;
+    t.matches = matches;
+    t.max_matches = (uint32_t)max_matches;
+    t.found = 0;
+    t.stop_on_first = stop_on_first;
+
+    crypto1_parallel_run(num_keys, CRYPTO1_PAR_CHUNK, 0, par_test_chunk, &t, idle, idle_ctx, stats);
+
+    return t.found;
+}
+
+// ----- Benchmark -----
+
+typedef struct {
+    const Crypto1Auth* auth;
+    uint64_t control_key;
+    uint64_t control_index;
+    uint32_t found;
+} ParBenchCtx;
+
+/**
+ * Stessa sequenza di chiavi pseudo-casuali di crypto1_bs_benchmark
+ */
+static uint64_t par_bench_key(uint64_t i) {
+    uint64_t x = (uint64_t)(uint32_t)i * 0x9E3779B97F4A7C15ULL;
+    x ^= x >> 29;
+    return x & 0xFFFFFFFFFFFFULL;
+}
+
+static bool par_bench_chunk(void* ctx, uint64_t begin, uint64_t end, int worker) {
+    ParBenchCtx* b = (ParBenchCtx*)ctx;
+    uint64_t batch[CRYPTO1_BS_LANES];
+
+    (void)worker;
+    for (uint64_t i = begin; i < end; i += CRYPTO1_BS_LANES) {
+        int n = (end - i < (uint64_t)CRYPTO1_BS_LANES) ? (int)(end - i) : CRYPTO1_BS_LANES;
+        crypto1_bs_t mask;
+
+        for (int lane = 0; lane < n; lane++) {
+            batch[lane] = (i + lane == b->control_index) ? b->control_key : par_bench_key(i + lane);
+        }
+        mask = crypto1_bs_test_batch(b->auth, batch, n);
+        while (mask) {
+            __atomic_fetch_add(&b->found, (uint32_t)(mask & 1), __ATOMIC_RELAXED);
+            mask >>= 1;
+        }
+    }
+
+    return true;
+}
+
+void crypto1_parallel_benchmark(uint32_t num_keys, uint32_t* single_kps, uint32_t* parallel_kps, bool* match_ok) {
+    const Crypto1Auth auth = {0x9c599b32, 0x82a4166c, 0xa1e458ce, 0x6eea41e0};
+    ParBenchCtx b;
+    Crypto1ParallelStats st;
+    uint32_t start, us, found_single;
+
+    b.auth = &auth;
+    b.control_key = 0xFFFFFFFFFFFFULL;
+    b.control_index = num_keys / 2;
+
+    b.found = 0;
+    start = par_micros();
+    crypto1_parallel_run(num_keys, CRYPTO1_PAR_CHUNK, 1, par_bench_chunk, &b, NULL, NULL, &st);
+    us = par_micros() - start;
+    *single_kps = us ? (uint32_t)((uint64_t)num_keys * 1000000ULL / us) : 0;
+    found_single = b.found;
+
+    b.found = 0;
+    start = par_micros();
+    crypto1_parallel_run(num_keys, CRYPTO1_PAR_CHUNK, 0, par_bench_chunk, &b, NULL, NULL, &st);
+    us = par_micros() - start;
+    *parallel_kps = us ? (uint32_t)((uint64_t)num_keys * 1000000ULL / us) : 0;
+
+    *match_ok = (found_single >= 1) && (b.found == found_single);
+
+#ifdef ARDUINO
+    Serial.printf("[CRYPTO] Parallelo: %u chiavi/s con 1 worker, %u chiavi/s con %d (furti %u)\n",
+                  (unsigned)*single_kps, (unsigned)*parallel_kps, st.workers, (unsigned)st.steals);
+#endif
+}
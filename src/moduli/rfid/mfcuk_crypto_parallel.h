@@ -0,0 +1,79 @@
+/**
+ * MFCUK - Verifica parallela delle chiavi candidate
+ *
+ * Esecutore a work-stealing per i passi esaustivi: lo spazio [0, total)
+ * viene diviso tra i worker (i due core Xtensa su ESP32, std::thread su
+ * host), ciascuno consuma a blocchi la propria parte e quando la esaurisce
+ * ruba metà del resto al worker più carico. Il task chiamante resta libero
+ * per display e pulsante RST; l'annullamento è cooperativo a ogni blocco.
+ */
+
+#ifndef _MFCUK_CRYPTO_PARALLEL_H_
+#define _MFCUK_CRYPTO_PARALLEL_H_
+
+#include "mfcuk_crypto_bs.h"
+
+// Worker massimi: un task per core su ESP32
+#ifdef ARDUINO
+#define CRYPTO1_PAR_MAX_WORKERS  2
+#else
+#define CRYPTO1_PAR_MAX_WORKERS  16
+#endif
+
+// Elementi per blocco di default (pochi ms di lavoro su ESP32)
+#define CRYPTO1_PAR_CHUNK  1024
+
+// Ogni quanto un worker cede la CPU ai task idle (watchdog)
+#define CRYPTO1_PAR_YIELD_MS  100
+
+// Stack dei worker su ESP32 (byte)
+#define CRYPTO1_PAR_STACK  8192
+
+// Elabora gli elementi [begin, end); false per fermare tutti i worker (es. chiave trovata)
+typedef bool (*crypto1_chunk_fn)(void* ctx, uint64_t begin, uint64_t end, int worker);
+
+// Chiamata periodica nel task chiamante; false per annullare
+typedef bool (*crypto1_idle_fn)(void* ctx);
+
+typedef struct {
+    uint64_t processed;     // Elementi elaborati
+    uint32_t chunks;        // Blocchi elaborati
+    uint32_t steals;        // Furti riusciti
+    uint32_t elapsed_ms;
+    int      workers;
+    bool     stopped;       // Fermato da crypto1_chunk_fn
+    bool     cancelled;     // Annullato da crypto1_idle_fn
+} Crypto1ParallelStats;
+
+/**
+ * Esegue fn su [0, total) a blocchi di 'chunk' elementi
+ * @param workers numero di worker (0 = tutti i core disponibili)
+ * @return false se annullato
+ */
+bool crypto1_parallel_run(uint64_t total, uint32_t chunk, int workers, crypto1_chunk_fn fn, void* ctx,
+                          crypto1_idle_fn idle, void* idle_ctx, Crypto1ParallelStats* stats);
+
+/**
+ * Verifica in parallelo (bitsliced su ogni worker) una lista di chiavi
+ * @param stop_on_first ferma tutti i worker alla prima chiave compatibile
+ * @return numero di chiavi compatibili (in matches fino a max_matches, ordine non garantito)
+ */
+size_t crypto1_parallel_test_keys(const Crypto1Auth* auth, const uint64_t* keys, size_t num_keys,
+                                  uint64_t* matches, size_t max_matches, bool stop_on_first,
+                                  crypto1_idle_fn idle, void* idle_ctx, Crypto1ParallelStats* stats);
+
+/**
+ * Come crypto1_parallel_test_keys, contro le parità di {nt} di autenticazioni
+ * nested (crypto1_bs_test_nonce_batch) invece che contro una traccia completa
+ */
+size_t crypto1_parallel_test_nonces(const Crypto1EncNonce* nonces, int num_nonces, const uint64_t* keys,
+                                    size_t num_keys, uint64_t* matches, size_t max_matches, bool stop_on_first,
+                                    crypto1_idle_fn idle, void* idle_ctx, Crypto1ParallelStats* stats);
+
+/**
+ * Chiavi/secondo della verifica bitsliced su un worker e su tutti
+ * (stesse chiavi pseudo-casuali e chiave di controllo di crypto1_bs_benchmark)
+ */
+void crypto1_parallel_benchmark(uint32_t num_keys, uint32_t* single_kps, uint32_t* parallel_kps, bool* match_ok);
+
+#endif // _MFCUK_CRYPTO_PARALLEL_H_
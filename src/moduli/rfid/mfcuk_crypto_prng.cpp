@@ -0,0 +1,192 @@
+/**
+ * MFCUK - PRNG dei nonce Mifare
+ *
+ * Numerazione delle posizioni come in mfoc: la metà alta del nonce (16 bit)
+ * identifica la posizione p nella sequenza del LFSR, la metà bassa è lo
+ * stato alla posizione p + 16. Le tabelle sono generate in build da
+ * scripts/gen_prng_table.py e, essendo const, restano in flash.
+ */
+
+#include "mfcuk_crypto_prng.h"
+
+#ifdef CRYPTO1_PRNG_TABLE
+#include "crypto1_prng_table.h"
+#endif
+
+#ifndef ARDUINO
+#include <time.h>
+#endif
+
+#define PRNG_POS_INVALID  0xffff
+
+/**
+ * Tempo in microsecondi per il benchmark
+ */
+static uint32_t prng_micros() {
+#ifdef ARDUINO
+    return micros();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+#endif
+}
+
+/**
+ * Calcola il successore del generatore PRNG un passo alla volta
+ * Il PRNG della carta è un LFSR a 16 bit (x^16 + x^14 + x^13 + x^11 + 1)
+ * che lavora sul nonce con i byte in ordine invertito
+ */
+uint32_t prng_successor_slow(uint32_t x, uint32_t n) {
+    x = (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+
+    while (n--) {
+        x = (x >> 1) | (((x >> 16) ^ (x >> 18) ^ (x >> 19) ^ (x >> 21)) << 31);
+    }
+
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+/**
+ * Distanza iterativa: avanza 'from' finché la metà alta coincide con 'to'
+ */
+static uint32_t prng_distance_slow(uint32_t from, uint32_t to) {
+    uint32_t n;
+
+    for (n = 0; n < PRNG_PERIOD; n++) {
+        if ((from >> 16) == (to >> 16)) return n;
+        from = prng_successor_slow(from, 1);
+    }
+
+    return PRNG_DISTANCE_INVALID;
+}
+
+#ifdef CRYPTO1_PRNG_TABLE
+
+/**
+ * Nonce alla posizione p (p < PRNG_PERIOD)
+ */
+static inline uint32_t prng_nonce_at(uint32_t p) {
+    uint32_t q = p + 16;
+
+    if (q >= PRNG_PERIOD) q -= PRNG_PERIOD;
+    return ((uint32_t)prng_seq_table[p] << 16) | prng_seq_table[q];
+}
+
+bool prng_valid_nonce(uint32_t nt) {
+    uint32_t p = prng_pos_table[nt >> 16];
+
+    return p != PRNG_POS_INVALID && prng_nonce_at(p) == nt;
+}
+
+uint32_t nonce_distance(uint32_t from, uint32_t to) {
+    uint32_t pf, pt;
+
+    if (!prng_valid_nonce(from) || !prng_valid_nonce(to)) return PRNG_DISTANCE_INVALID;
+
+    pf = prng_pos_table[from >> 16];
+    pt = prng_pos_table[to >> 16];
+    return pt >= pf ? pt - pf : pt + PRNG_PERIOD - pf;
+}
+
+/**
+ * Successore con le tabelle; i valori che non sono nonce del PRNG
+ * (es. parole di test arbitrarie) passano dal percorso iterativo
+ */
+uint32_t prng_successor(uint32_t x, uint32_t n) {
+    uint32_t p;
+
+    if (!prng_valid_nonce(x)) return prng_successor_slow(x, n);
+
+    p = (prng_pos_table[x >> 16] + n % PRNG_PERIOD) % PRNG_PERIOD;
+    return prng_nonce_at(p);
+}
+
+#else
+
+// Build senza tabelle generate: stesso comportamento, costo lineare
+
+/**
+ * La metà alta, usata come registro, deve generare la metà bassa in 16 passi
+ */
+bool prng_valid_nonce(uint32_t nt) {
+    return (nt >> 16) != 0 && prng_successor_slow(nt >> 16, 16) == nt;
+}
+
+uint32_t nonce_distance(uint32_t from, uint32_t to) {
+    if (!prng_valid_nonce(from) || !prng_valid_nonce(to)) return PRNG_DISTANCE_INVALID;
+    return prng_distance_slow(from, to);
+}
+
+uint32_t prng_successor(uint32_t x, uint32_t n) {
+    return prng_successor_slow(x, n);
+}
+
+#endif
+
+/**
+ * Benchmark su coppie di nonce a distanza pseudo-casuale
+ * Il percorso iterativo costa in media PRNG_PERIOD/2 passi per distanza
+ */
+void prng_benchmark(uint32_t num_queries, PrngBench* result) {
+    const uint32_t seed = PRNG_REFERENCE_NONCE;
+    uint32_t acc_slow = 0, acc_fast = 0;
+    uint32_t mismatches = 0;
+    uint32_t start, i;
+
+    if (num_queries == 0) num_queries = 1;
+
+    // Distanze (le coppie sono generate allo stesso modo nei due percorsi)
+    start = prng_micros();
+    for (i = 0; i < num_queries; i++) {
+        uint32_t d = (i * 40503u + 17) % PRNG_PERIOD;
+        uint32_t from = prng_successor(seed, i * 97);
+        acc_slow += prng_distance_slow(from, prng_successor(from, d));
+    }
+    result->dist_slow_us = prng_micros() - start;
+
+    start = prng_micros();
+    for (i = 0; i < num_queries; i++) {
+        uint32_t d = (i * 40503u + 17) % PRNG_PERIOD;
+        uint32_t from = prng_successor(seed, i * 97);
+        uint32_t dist = nonce_distance(from, prng_successor(from, d));
+        acc_fast += dist;
+        if (dist != d) mismatches++;
+    }
+    result->dist_fast_us = prng_micros() - start;
+
+    if (acc_slow != acc_fast) mismatches++;
+
+    // Successori
+    acc_slow = acc_fast = 0;
+    start = prng_micros();
+    for (i = 0; i < num_queries; i++) {
+        acc_slow ^= prng_successor_slow(seed, (i * 40503u + 17) % PRNG_PERIOD);
+    }
+    result->suc_slow_us = prng_micros() - start;
+
+    start = prng_micros();
+    for (i = 0; i < num_queries; i++) {
+        acc_fast ^= prng_successor(seed, (i * 40503u + 17) % PRNG_PERIOD);
+    }
+    result->suc_fast_us = prng_micros() - start;
+    if (acc_slow != acc_fast) mismatches++;
+
+    result->num_queries = num_queries;
+#ifdef CRYPTO1_PRNG_TABLE
+    result->table = true;
+#else
+    result->table = false;
+#endif
+    result->match_ok = (mismatches == 0);
+
+#ifdef ARDUINO
+    Serial.printf("[CRYPTO] Benchmark PRNG %u interrogazioni (%s)\n", (unsigned)num_queries,
+                  result->table ? "tabelle" : "senza tabelle");
+    Serial.printf("[CRYPTO] Distanza:   %u us iterativa, %u us tabella\n",
+                  (unsigned)result->dist_slow_us, (unsigned)result->dist_fast_us);
+    Serial.printf("[CRYPTO] Successore: %u us iterativo, %u us tabella\n",
+                  (unsigned)result->suc_slow_us, (unsigned)result->suc_fast_us);
+    Serial.printf("[CRYPTO] Verifica:   %s\n", result->match_ok ? "OK" : "ERRORE");
+#endif
+}
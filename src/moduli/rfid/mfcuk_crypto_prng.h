@@ -0,0 +1,56 @@
+/**
+ * MFCUK - PRNG dei nonce Mifare
+ *
+ * Il nonce della carta è una finestra di 32 bit sull'uscita di un LFSR a
+ * 16 bit (periodo 65535). Con le tabelle posizione/stato generate in build
+ * distanza e successore costano un accesso in flash invece di fino a 65535
+ * passi del registro.
+ */
+
+#ifndef _MFCUK_CRYPTO_PRNG_H_
+#define _MFCUK_CRYPTO_PRNG_H_
+
+#include "mfcuk_crypto.h"
+
+// Periodo del LFSR a 16 bit
+#define PRNG_PERIOD  65535
+
+// Distanza non definita (nonce non generato dal PRNG)
+#define PRNG_DISTANCE_INVALID  0xFFFFFFFF
+
+// Nonce reale di una carta Mifare Classic, punto di partenza noto della sequenza
+#define PRNG_REFERENCE_NONCE  0x01200145
+
+// Risultati del benchmark iterativo vs tabelle
+typedef struct {
+    uint32_t num_queries;     // Interrogazioni per ciascun percorso
+    uint32_t dist_slow_us;    // nonce_distance iterativa (us)
+    uint32_t dist_fast_us;    // nonce_distance a tabella (us)
+    uint32_t suc_slow_us;     // prng_successor iterativo (us)
+    uint32_t suc_fast_us;     // prng_successor a tabella (us)
+    bool     table;           // Tabelle disponibili in questa build
+    bool     match_ok;        // I due percorsi danno gli stessi risultati
+} PrngBench;
+
+/**
+ * true se nt è una finestra valida del PRNG (metà bassa = metà alta 16 passi dopo)
+ */
+bool prng_valid_nonce(uint32_t nt);
+
+/**
+ * Passi del PRNG per andare da 'from' a 'to' (0..PRNG_PERIOD-1)
+ * @return PRNG_DISTANCE_INVALID se uno dei due nonce non è valido
+ */
+uint32_t nonce_distance(uint32_t from, uint32_t to);
+
+/**
+ * Successore iterativo, un passo per ciclo (riferimento per test e benchmark)
+ */
+uint32_t prng_successor_slow(uint32_t x, uint32_t n);
+
+/**
+ * Misura distanze e successori con il percorso iterativo e con le tabelle
+ */
+void prng_benchmark(uint32_t num_queries, PrngBench* result);
+
+#endif // _MFCUK_CRYPTO_PRNG_H_
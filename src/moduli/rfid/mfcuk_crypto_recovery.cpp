@@ -0,0 +1,473 @@
+/**
+ * MFCUK - Recupero dello stato Crypto1
+ *
+ * Le due metà dello stato producono i bit di keystream alternati, quindi
+ * si possono ricostruire indipendentemente: per ogni metà si parte dai
+ * 2^20 valori compatibili con il primo bit e si estende un bit alla volta
+ * scartando i rami incompatibili (compattazione in place della tabella).
+ * Ogni voce tiene negli 8 bit alti il contributo della metà al feedback
+ * degli ultimi 4 passi: dopo ogni 4 estensioni le tabelle si ordinano e si
+ * accoppiano solo le voci con contributi uguali.
+ *
+ * Le tabelle complete occupano circa 4 MB, troppi per l'ESP32: una prima
+ * passata conta le voci per ciascun valore del primo contributo, poi i
+ * valori vengono raggruppati in modo che ogni gruppo stia nel budget e
+ * ogni gruppo viene ricostruito ed elaborato separatamente.
+ *
+ * Con la partizione dei semi (mfcuk_crypto_seeds.h) ogni ricostruzione
+ * parte dai prefissi già estesi di un bit e compatibili con i primi due
+ * bit di keystream, letti dalla flash, invece di filtrare i 2^20 prefissi.
+ */
+
+#include "mfcuk_crypto_recovery.h"
+#include "mfcuk_crypto_seeds.h"
+
+#ifndef ARDUINO
+#include <time.h>
+#endif
+
+// Parità in linea (crypto1_parity non è inlinabile tra unità diverse)
+#define REC_PARITY(x) ((uint32_t)__builtin_parity(x))
+
+// Prefissi iniziali di una metà (bit usati dal filtro)
+#define REC_PREFIXES  (1UL << 20)
+
+// Foglie massime di un prefisso dopo 8 estensioni (2^8) più margine
+#define REC_LEAF_CAP  264
+
+// Maschere per l'aggiornamento dei contributi delle due metà
+#define REC_ODD_M1    (LF_POLY_EVEN << 1 | 1)
+#define REC_ODD_M2    (LF_POLY_ODD << 1)
+#define REC_EVEN_M1   LF_POLY_ODD
+#define REC_EVEN_M2   (LF_POLY_EVEN << 1 | 1)
+
+// Contesto della ricerca ricorsiva
+typedef struct {
+    crypto1_state_cb cb;
+    void* ctx;
+    uint32_t* o_limit;      // Fine dell'area della metà dispari (spazio di crescita incluso)
+    uint32_t* e_limit;      // Fine dell'area della metà pari
+    uint32_t states;
+    bool stop;
+    bool overflow;
+} RecoveryCtx;
+
+static uint32_t rec_budget = 0;
+
+/**
+ * Tempo in millisecondi per il report
+ */
+static uint32_t rec_millis() {
+#ifdef ARDUINO
+    return millis();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+#endif
+}
+
+/**
+ * Spazio di crescita lasciato dopo una tabella di n voci
+ */
+static inline uint32_t rec_headroom(uint32_t n) {
+    return (n >> 3) + 256;
+}
+
+/**
+ * Aggiorna gli 8 bit alti di una voce con i contributi al feedback
+ */
+static inline void rec_contribution(uint32_t* item, uint32_t m1, uint32_t m2) {
+    uint32_t p = *item >> 25;
+
+    p = p << 1 | REC_PARITY(*item & m1);
+    p = p << 1 | REC_PARITY(*item & m2);
+    *item = p << 24 | (*item & 0xffffff);
+}
+
+/**
+ * Estende ogni voce di un bit senza tracciare i contributi
+ * Le voci incompatibili vengono sostituite dall'ultima della tabella
+ */
+static inline void rec_extend_simple(uint32_t* tbl, uint32_t** end, int bit) {
+    for (*tbl <<= 1; tbl <= *end; *++tbl <<= 1) {
+        uint32_t f0 = crypto1_filter_inline(*tbl);
+        uint32_t f1 = crypto1_filter_inline(*tbl | 1);
+
+        if (f0 ^ f1) {
+            *tbl |= f0 ^ bit;
+        } else if (f0 == (uint32_t)bit) {
+            *++*end = tbl[1];
+            tbl[1] = tbl[0] | 1;
+            tbl++;
+        } else {
+            *tbl-- = *(*end)--;
+        }
+    }
+}
+
+/**
+ * Estende ogni voce di un bit aggiornando i contributi
+ * @param limit fine dell'area utilizzabile
+ * @return false se la tabella supera l'area disponibile
+ */
+static inline bool rec_extend(uint32_t* tbl, uint32_t** end, int bit, uint32_t m1, uint32_t m2,
+                              uint32_t in, const uint32_t* limit) {
+    in <<= 24;
+
+    for (*tbl <<= 1; tbl <= *end; *++tbl <<= 1) {
+        uint32_t f0 = crypto1_filter_inline(*tbl);
+        uint32_t f1 = crypto1_filter_inline(*tbl | 1);
+
+        if (f0 ^ f1) {
+            *tbl |= f0 ^ bit;
+            rec_contribution(tbl, m1, m2);
+            *tbl ^= in;
+        } else if (f0 == (uint32_t)bit) {
+            if (*end + 2 >= limit) return false;
+            *++*end = tbl[1];
+            tbl[1] = tbl[0] | 1;
+            rec_contribution(tbl, m1, m2);
+            *tbl++ ^= in;
+            rec_contribution(tbl, m1, m2);
+            *tbl ^= in;
+        } else {
+            *tbl-- = *(*end)--;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Primo elemento del bucket (stessi 8 bit alti) che termina in stop
+ * La tabella deve essere ordinata
+ */
+static uint32_t* rec_binsearch(uint32_t* start, uint32_t* stop) {
+    uint32_t mid, val = *stop & 0xff000000;
+
+    while (start != stop) {
+        if (start[(mid = (stop - start) >> 1)] > val)
+            stop = &start[mid];
+        else
+            start += mid + 1;
+    }
+
+    return start;
+}
+
+static int rec_compare(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void rec_merge(uint32_t* o_head, uint32_t* o_tail, uint64_t oks,
+                      uint32_t* e_head, uint32_t* e_tail, uint64_t eks,
+                      int rem, uint32_t in, RecoveryCtx* rc);
+
+/**
+ * Estende le due metà di 4 bit (o dei bit rimanenti) e le riaccoppia
+ * Con rem == -1 le voci rimaste vengono combinate negli stati finali
+ */
+static void rec_recover(uint32_t* o_head, uint32_t* o_tail, uint64_t oks,
+                        uint32_t* e_head, uint32_t* e_tail, uint64_t eks,
+                        int rem, uint32_t in, RecoveryCtx* rc) {
+    if (rem == -1) {
+        Crypto1State s;
+
+        for (uint32_t* e = e_head; e <= e_tail && !rc->stop; ++e) {
+            *e = *e << 1 ^ REC_PARITY(*e & LF_POLY_EVEN) ^ !!(in & 4);
+            for (uint32_t* o = o_head; o <= o_tail; ++o) {
+                s.even = *o & 0xffffff;
+                s.odd = (*e ^ REC_PARITY(*o & LF_POLY_ODD)) & 0xffffff;
+                rc->states++;
+                if (!rc->cb(&s, rc->ctx)) {
+                    rc->stop = true;
+                    break;
+                }
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < 4 && rem--; i++) {
+        oks >>= 1;
+        eks >>= 1;
+        in >>= 2;
+
+        if (!rec_extend(o_head, &o_tail, oks & 1, REC_ODD_M1, REC_ODD_M2, 0, rc->o_limit)) {
+            rc->overflow = true;
+            return;
+        }
+        if (o_head > o_tail) return;
+
+        if (!rec_extend(e_head, &e_tail, eks & 1, REC_EVEN_M1, REC_EVEN_M2, in & 3, rc->e_limit)) {
+            rc->overflow = true;
+            return;
+        }
+        if (e_head > e_tail) return;
+    }
+
+    rec_merge(o_head, o_tail, oks, e_head, e_tail, eks, rem, in, rc);
+}
+
+/**
+ * Ordina le due tabelle e ricorre su ogni coppia di bucket con gli stessi
+ * contributi, partendo dalla coda: la crescita di un bucket sovrascrive
+ * solo voci già elaborate
+ */
+static void rec_merge(uint32_t* o_head, uint32_t* o_tail, uint64_t oks,
+                      uint32_t* e_head, uint32_t* e_tail, uint64_t eks,
+                      int rem, uint32_t in, RecoveryCtx* rc) {
+    uint32_t *o, *e;
+
+    qsort(o_head, o_tail - o_head + 1, sizeof(uint32_t), rec_compare);
+    qsort(e_head, e_tail - e_head + 1, sizeof(uint32_t), rec_compare);
+
+    while (o_tail >= o_head && e_tail >= e_head && !rc->stop && !rc->overflow) {
+        if (((*o_tail ^ *e_tail) >> 24) == 0) {
+            o_tail = rec_binsearch(o_head, o = o_tail);
+            e_tail = rec_binsearch(e_head, e = e_tail);
+            rec_recover(o_tail--, o, oks, e_tail--, e, eks, rem, in, rc);
+        } else if (*o_tail > *e_tail) {
+            o_tail = rec_binsearch(o_head, o_tail) - 1;
+        } else {
+            e_tail = rec_binsearch(e_head, e_tail) - 1;
+        }
+    }
+}
+
+/**
+ * Estende un singolo prefisso fino al primo confronto dei contributi
+ * (4 estensioni semplici + 4 con contributi, come il primo giro di crapto1)
+ * @param first prima estensione da fare: 1 per un prefisso di 20 bit, 2 per
+ *        un seme di 21 bit già esteso
+ * @return numero di voci risultanti in buf
+ */
+static uint32_t rec_expand(uint32_t x, int first, uint64_t ks, uint32_t in, uint32_t m1, uint32_t m2, uint32_t* buf) {
+    uint32_t* end = buf;
+    int i;
+
+    buf[0] = x;
+    for (i = first; i <= 4; i++) {
+        rec_extend_simple(buf, &end, (ks >> i) & 1);
+        if (end < buf) return 0;
+    }
+    for (i = 5; i <= 8; i++) {
+        in >>= 2;
+        rec_extend(buf, &end, (ks >> i) & 1, m1, m2, in & 3, buf + REC_LEAF_CAP);
+        if (end < buf) return 0;
+    }
+
+    return end - buf + 1;
+}
+
+/**
+ * Ricostruisce le voci di una metà: con counts conta le voci per bucket,
+ * altrimenti accoda a *tail quelle con bucket in [lo, hi)
+ */
+static void rec_build_half(uint64_t ks, uint32_t in, uint32_t m1, uint32_t m2, uint32_t* leaf,
+                           uint32_t* counts, uint32_t lo, uint32_t hi, uint32_t** tail) {
+    const uint32_t* seeds = crypto1_seeds_class(ks & 1, (ks >> 1) & 1);
+    uint32_t n;
+
+    if (seeds != NULL) {
+        for (uint32_t w = 0; w < CRYPTO1_SEEDS_WORDS; w++) {
+            for (uint32_t bits = seeds[w]; bits; bits &= bits - 1) {
+                n = rec_expand(w << 5 | __builtin_ctz(bits), 2, ks, in, m1, m2, leaf);
+                while (n--) {
+                    uint32_t b = leaf[n] >> 24;
+
+                    if (counts) counts[b]++;
+                    else if (b >= lo && b < hi) *++*tail = leaf[n];
+                }
+            }
+#ifdef ARDUINO
+            if ((w & 0x1fff) == 0) yield();
+#endif
+        }
+        return;
+    }
+
+    for (uint32_t x = 0; x < REC_PREFIXES; x++) {
+        if (crypto1_filter_inline(x) != (ks & 1)) continue;
+        n = rec_expand(x, 1, ks, in, m1, m2, leaf);
+        while (n--) {
+            uint32_t b = leaf[n] >> 24;
+
+            if (counts) counts[b]++;
+            else if (b >= lo && b < hi) *++*tail = leaf[n];
+        }
+#ifdef ARDUINO
+        if ((x & 0xffff) == 0) yield();
+#endif
+    }
+}
+
+/**
+ * Motore comune a lfsr_recovery32 e lfsr_recovery64
+ * @param oks/eks bit di keystream delle due metà (bit 0 = primo)
+ * @param rem estensioni rimanenti dopo le 5 iniziali
+ * @param in input già riordinato per le estensioni della metà pari
+ */
+static bool lfsr_recovery(uint64_t oks, uint64_t eks, int rem, uint32_t in,
+                          crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats) {
+    Crypto1RecoveryStats local;
+    RecoveryCtx rc;
+    uint32_t leaf_buf[REC_LEAF_CAP + 2];
+    uint32_t* leaf = leaf_buf + 1;
+    uint32_t* counts;
+    uint32_t* block = NULL;
+    uint32_t budget, max_entries, block_entries = 0;
+    uint32_t start = rec_millis();
+
+    if (stats == NULL) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    memset(&rc, 0, sizeof(rc));
+    rc.cb = cb;
+    rc.ctx = ctx;
+
+    budget = rec_budget ? rec_budget : CRYPTO1_RECOVERY_HEAP;
+#ifdef ARDUINO
+    if (budget > ESP.getMaxAllocHeap() - 16384) budget = ESP.getMaxAllocHeap() - 16384;
+#endif
+    max_entries = budget / sizeof(uint32_t);
+
+    crypto1_tables_init();
+
+    counts = (uint32_t*)calloc(512, sizeof(uint32_t));
+    if (counts == NULL) return false;
+
+    // Passata di conteggio: voci per ciascun valore del primo contributo
+    rec_build_half(oks, 0, REC_ODD_M1, REC_ODD_M2, leaf, counts, 0, 0, NULL);
+    rec_build_half(eks, in, REC_EVEN_M1, REC_EVEN_M2, leaf, counts + 256, 0, 0, NULL);
+
+    // Elaborazione a gruppi di bucket contigui che stanno nel budget
+    for (uint32_t lo = 0; lo < 256 && !rc.stop; ) {
+        uint32_t go = 0, ge = 0, hi = lo, need;
+
+        while (hi < 256) {
+            uint32_t no = go + counts[hi], ne = ge + counts[256 + hi];
+            need = no + rec_headroom(no) + ne + rec_headroom(ne) + 3;
+            if (need > max_entries && hi > lo) break;
+            go = no;
+            ge = ne;
+            hi++;
+        }
+        need = go + rec_headroom(go) + ge + rec_headroom(ge) + 3;
+
+        if (need > max_entries) {
+            // Un solo bucket non entra nel budget
+            rc.overflow = true;
+            break;
+        }
+
+        if (need > block_entries) {
+            free(block);
+            block = (uint32_t*)malloc(need * sizeof(uint32_t));
+            if (block == NULL) {
+                rc.overflow = true;
+                break;
+            }
+            block_entries = need;
+            if (need * sizeof(uint32_t) > stats->peak_bytes) stats->peak_bytes = need * sizeof(uint32_t);
+        }
+
+        uint32_t* o_head = block + 1;
+        uint32_t* o_tail = o_head - 1;
+        uint32_t* e_head = o_head + go + rec_headroom(go) + 1;
+        uint32_t* e_tail = e_head - 1;
+        rc.o_limit = e_head - 1;
+        rc.e_limit = e_head + ge + rec_headroom(ge);
+
+        // Ricostruzione delle voci del gruppo
+        rec_build_half(oks, 0, REC_ODD_M1, REC_ODD_M2, leaf, NULL, lo, hi, &o_tail);
+        rec_build_half(eks, in, REC_EVEN_M1, REC_EVEN_M2, leaf, NULL, lo, hi, &e_tail);
+
+        stats->passes++;
+        if (o_tail >= o_head && e_tail >= e_head) {
+            rec_merge(o_head, o_tail, oks >> 8, e_head, e_tail, eks >> 8, rem - 4, in >> 8, &rc);
+        }
+        if (rc.overflow) break;
+
+        lo = hi;
+    }
+
+    free(block);
+    free(counts);
+
+    stats->states = rc.states;
+    stats->elapsed_ms = rec_millis() - start;
+    stats->complete = !rc.stop && !rc.overflow;
+
+    return !rc.overflow;
+}
+
+/**
+ * Recupera gli stati compatibili con 32 bit di keystream
+ * Gli stati restituiti sono quelli dopo la generazione di ks2
+ */
+bool lfsr_recovery32(uint32_t ks2, uint32_t in, crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats) {
+    uint64_t oks = 0, eks = 0;
+    int i;
+
+    for (i = 31; i >= 0; i -= 2) oks = oks << 1 | CRYPTO1_BEBIT(ks2, i);
+    for (i = 30; i >= 0; i -= 2) eks = eks << 1 | CRYPTO1_BEBIT(ks2, i);
+
+    // Riordina l'input come lo consumano le estensioni della metà pari
+    in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00);
+
+    return lfsr_recovery(oks, eks, 11, in << 1, cb, ctx, stats);
+}
+
+/**
+ * Recupera lo stato da 64 bit di keystream consecutivi
+ * Gli stati restituiti sono quelli dopo la generazione di ks3
+ */
+bool lfsr_recovery64(uint32_t ks2, uint32_t ks3, crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats) {
+    uint64_t oks = 0, eks = 0;
+    int i;
+
+    for (i = 31; i >= 0; i -= 2) oks = oks << 1 | CRYPTO1_BEBIT(ks3, i);
+    for (i = 31; i >= 0; i -= 2) oks = oks << 1 | CRYPTO1_BEBIT(ks2, i);
+    for (i = 30; i >= 0; i -= 2) eks = eks << 1 | CRYPTO1_BEBIT(ks3, i);
+    for (i = 30; i >= 0; i -= 2) eks = eks << 1 | CRYPTO1_BEBIT(ks2, i);
+
+    return lfsr_recovery(oks, eks, 27, 0, cb, ctx, stats);
+}
+
+/**
+ * Recupero Nested: il keystream ks1 = {nt} ^ nt è stato generato
+ * immettendo uid ^ nt nel LFSR appena inizializzato con la chiave
+ */
+bool nested_key_recovery(uint32_t uid, uint32_t nt, uint32_t nt_enc, crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats) {
+    return lfsr_recovery32(nt_enc ^ nt, uid ^ nt, cb, ctx, stats);
+}
+
+/**
+ * Recupero Nested fino alle chiavi: ogni stato candidato viene riavvolto
+ * di uid ^ nt e convertito in chiave; il sink riceve blocchi ordinati
+ */
+bool nested_recover_keys(uint32_t uid, uint32_t nt, uint32_t nt_enc, crypto1_key_sink sink, void* ctx,
+                         Crypto1RecoveryStats* stats) {
+    Crypto1Rollback rb = {{uid ^ nt}, {0}, 1};
+    Crypto1KeyExtractor* kx;
+    bool ok;
+
+    kx = (Crypto1KeyExtractor*)malloc(sizeof(Crypto1KeyExtractor));
+    if (kx == NULL) return false;
+
+    crypto1_key_extractor_init(kx, &rb, sink, ctx);
+    ok = nested_key_recovery(uid, nt, nt_enc, crypto1_key_extractor_add, kx, stats);
+    if (ok) crypto1_key_extractor_flush(kx);
+
+    free(kx);
+    return ok;
+}
+
+/**
+ * Imposta il budget di memoria del recupero
+ */
+void lfsr_recovery_set_budget(uint32_t bytes) {
+    rec_budget = bytes;
+}
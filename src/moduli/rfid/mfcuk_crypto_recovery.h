@@ -0,0 +1,71 @@
+/**
+ * MFCUK - Recupero dello stato Crypto1
+ *
+ * Ricostruzione dello stato interno del LFSR a partire da 32 o 64 bit di
+ * keystream (lfsr_recovery32 / lfsr_recovery64 nello stile di crapto1).
+ * Le due metà dello stato vengono estese separatamente e poi unite per
+ * confronto ordinato; la memoria è limitata elaborando i bucket a gruppi.
+ */
+
+#ifndef _MFCUK_CRYPTO_RECOVERY_H_
+#define _MFCUK_CRYPTO_RECOVERY_H_
+
+#include "mfcuk_crypto.h"
+
+// Memoria massima per le tabelle delle metà dello stato
+// Su ESP32 viene comunque limitata al blocco libero più grande dell'heap
+#ifndef CRYPTO1_RECOVERY_HEAP
+#ifdef ARDUINO
+#define CRYPTO1_RECOVERY_HEAP  (160 * 1024)
+#else
+#define CRYPTO1_RECOVERY_HEAP  (16 * 1024 * 1024)
+#endif
+#endif
+
+// Callback chiamata per ogni stato candidato (stato dopo il keystream)
+// Ritorna false per interrompere la ricerca
+typedef bool (*crypto1_state_cb)(const Crypto1State* state, void* ctx);
+
+// Statistiche di un recupero
+typedef struct {
+    uint32_t states;        // Stati candidati trovati
+    uint32_t passes;        // Gruppi di bucket elaborati (1 = tutto in memoria)
+    uint32_t peak_bytes;    // Memoria allocata per le tabelle
+    uint32_t elapsed_ms;    // Durata del recupero
+    bool     complete;      // false se interrotto dalla callback o per memoria
+} Crypto1RecoveryStats;
+
+/**
+ * Recupera gli stati compatibili con 32 bit di keystream
+ * @param ks2 keystream osservato
+ * @param in  valore immesso nel LFSR mentre veniva generato ks2 (es. uid^nt)
+ * @return false solo in caso di memoria insufficiente
+ */
+bool lfsr_recovery32(uint32_t ks2, uint32_t in, crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats);
+
+/**
+ * Recupera lo stato da 64 bit consecutivi di keystream generati senza input
+ * (tipicamente ks2 = {ar}^suc64(nt) e ks3 = {at}^suc96(nt))
+ */
+bool lfsr_recovery64(uint32_t ks2, uint32_t ks3, crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats);
+
+/**
+ * Recupero Nested: stati candidati dopo la cifratura del nonce della carta
+ * @param nt nonce in chiaro predetto dalla distanza
+ * @param nt_enc nonce cifrato {nt} ricevuto dalla carta
+ */
+bool nested_key_recovery(uint32_t uid, uint32_t nt, uint32_t nt_enc, crypto1_state_cb cb, void* ctx, Crypto1RecoveryStats* stats);
+
+/**
+ * Recupero Nested fino alle chiavi candidate, consegnate a blocchi di
+ * CRYPTO1_KEY_BATCH (ordinati e senza duplicati) al sink
+ */
+bool nested_recover_keys(uint32_t uid, uint32_t nt, uint32_t nt_enc, crypto1_key_sink sink, void* ctx,
+                         Crypto1RecoveryStats* stats);
+
+/**
+ * Imposta il budget di memoria del recupero (0 = CRYPTO1_RECOVERY_HEAP)
+ */
+void lfsr_recovery_set_budget(uint32_t bytes);
+
+#endif // _MFCUK_CRYPTO_RECOVERY_H_
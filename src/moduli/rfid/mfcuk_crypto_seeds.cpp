@@ -0,0 +1,152 @@
+/**
+ * MFCUK - Semi precalcolati delle metà dello stato
+ *
+ * L'immagine resta in flash (o nella page cache su host): qui si tiene
+ * solo il puntatore alla mappatura e l'handle per rilasciarla.
+ */
+
+#include "mfcuk_crypto_seeds.h"
+#include "mfcuk_crypto.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#define SEEDS_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SEEDS_LOG(...) printf(__VA_ARGS__)
+#endif
+
+// Parole verificate per classe all'apertura
+#define SEEDS_SAMPLES  16
+
+static const uint32_t* seeds_map = NULL;
+static bool seeds_tried = false;
+static bool seeds_enabled = true;
+
+#ifdef ARDUINO
+static spi_flash_mmap_handle_t seeds_handle;
+#else
+static size_t seeds_size = 0;
+#endif
+
+/**
+ * Ricalcola una parola della bitmap di una classe
+ */
+static uint32_t seeds_word(uint32_t cls, uint32_t w) {
+    uint32_t v = 0;
+
+    for (uint32_t j = 0; j < 32; j++) {
+        uint32_t y = w << 5 | j;
+
+        if (crypto1_filter(y >> 1) == (cls & 1) && crypto1_filter(y & 0xfffff) == (cls >> 1)) v |= 1UL << j;
+    }
+    return v;
+}
+
+/**
+ * Intestazione e un campione di parole sparse: un'immagine di un'altra
+ * versione o una partizione cancellata (0xFF) non passano
+ */
+static bool seeds_check(const uint8_t* image) {
+    const Crypto1SeedsHeader* h = (const Crypto1SeedsHeader*)image;
+    const uint32_t* words = (const uint32_t*)(image + sizeof(Crypto1SeedsHeader));
+
+    if (h->magic != CRYPTO1_SEEDS_MAGIC || h->version != CRYPTO1_SEEDS_VERSION ||
+        h->classes != CRYPTO1_SEEDS_CLASSES || h->class_words != CRYPTO1_SEEDS_WORDS) {
+        return false;
+    }
+    for (uint32_t c = 0; c < CRYPTO1_SEEDS_CLASSES; c++) {
+        for (uint32_t i = 0; i < SEEDS_SAMPLES; i++) {
+            uint32_t w = (i * 4099 + c * 977) % CRYPTO1_SEEDS_WORDS;
+
+            if (words[c * CRYPTO1_SEEDS_WORDS + w] != seeds_word(c, w)) return false;
+        }
+    }
+    return true;
+}
+
+bool crypto1_seeds_open(const char* name) {
+    const void* image = NULL;
+
+    crypto1_seeds_close();
+    seeds_tried = true;
+    if (name == NULL) return false;
+
+#ifdef ARDUINO
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           (esp_partition_subtype_t)CRYPTO1_SEEDS_SUBTYPE, name);
+
+    if (part == NULL || part->size < CRYPTO1_SEEDS_BYTES) {
+        SEEDS_LOG("[CRYPTO] Partizione dei semi '%s' assente, recupero senza semi\n", name);
+        return false;
+    }
+    if (esp_partition_mmap(part, 0, CRYPTO1_SEEDS_BYTES, SPI_FLASH_MMAP_DATA, &image, &seeds_handle) != ESP_OK) {
+        SEEDS_LOG("[CRYPTO] Mappatura della partizione dei semi fallita\n");
+        return false;
+    }
+    if (!seeds_check((const uint8_t*)image)) {
+        spi_flash_munmap(seeds_handle);
+        SEEDS_LOG("[CRYPTO] Partizione dei semi non valida, da riscrivere (uploadseeds)\n");
+        return false;
+    }
+#else
+    struct stat st;
+    int fd = open(name, O_RDONLY);
+
+    if (fd < 0) return false;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < CRYPTO1_SEEDS_BYTES) {
+        close(fd);
+        return false;
+    }
+    image = mmap(NULL, CRYPTO1_SEEDS_BYTES, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return false;
+    if (!seeds_check((const uint8_t*)image)) {
+        munmap((void*)image, CRYPTO1_SEEDS_BYTES);
+        SEEDS_LOG("[CRYPTO] Immagine dei semi %s non valida\n", name);
+        return false;
+    }
+    seeds_size = CRYPTO1_SEEDS_BYTES;
+#endif
+
+    seeds_map = (const uint32_t*)((const uint8_t*)image + sizeof(Crypto1SeedsHeader));
+    SEEDS_LOG("[CRYPTO] Semi delle metà dello stato mappati da %s (%u KB)\n", name,
+              (unsigned)(CRYPTO1_SEEDS_BYTES / 1024));
+    return true;
+}
+
+void crypto1_seeds_close() {
+    if (seeds_map == NULL) return;
+
+#ifdef ARDUINO
+    spi_flash_munmap(seeds_handle);
+#else
+    munmap((void*)((const uint8_t*)seeds_map - sizeof(Crypto1SeedsHeader)), seeds_size);
+#endif
+    seeds_map = NULL;
+}
+
+void crypto1_seeds_enable(bool on) {
+    seeds_enabled = on;
+}
+
+const uint32_t* crypto1_seeds_class(uint32_t b0, uint32_t b1) {
+    if (!seeds_enabled) return NULL;
+    if (!seeds_tried) {
+#ifdef ARDUINO
+        crypto1_seeds_open(CRYPTO1_SEEDS_LABEL);
+#else
+        crypto1_seeds_open(getenv(CRYPTO1_SEEDS_ENV));
+#endif
+    }
+    if (seeds_map == NULL) return NULL;
+    return seeds_map + ((b0 & 1) | (b1 & 1) << 1) * CRYPTO1_SEEDS_WORDS;
+}
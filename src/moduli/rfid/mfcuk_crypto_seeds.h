@@ -0,0 +1,70 @@
+/**
+ * MFCUK - Semi precalcolati delle metà dello stato
+ *
+ * Il recupero dello stato parte, per ogni metà, dai 2^20 prefissi e li
+ * estende un bit alla volta, e su ESP32 lo rifà a ogni gruppo di bucket.
+ * I prefissi estesi di un bit e compatibili con i primi due bit di
+ * keystream della metà dipendono solo da quei due bit: le 4 classi possibili
+ * sono precalcolate come bitmap su 2^21 bit (256 KB ciascuna) in una
+ * partizione dati in flash, letta tramite esp_partition_mmap senza copiarla
+ * in RAM. Su host la stessa immagine è un file mappato con mmap.
+ *
+ * L'immagine è generata da scripts/gen_crypto1_seeds.py; senza partizione
+ * (o con contenuto non valido) il recupero filtra i prefissi come prima.
+ */
+
+#ifndef _MFCUK_CRYPTO_SEEDS_H_
+#define _MFCUK_CRYPTO_SEEDS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Partizione dati (partitions_crypto1.csv): etichetta e sottotipo
+#define CRYPTO1_SEEDS_LABEL    "crypto1"
+#define CRYPTO1_SEEDS_SUBTYPE  0x40
+
+// Variabile d'ambiente con il percorso dell'immagine su host
+#define CRYPTO1_SEEDS_ENV      "CRYPTO1_SEEDS"
+
+#define CRYPTO1_SEEDS_MAGIC    0x44533143   // "C1SD"
+#define CRYPTO1_SEEDS_VERSION  1
+
+// Classi (primi due bit di keystream della metà) e parole a 32 bit per classe
+#define CRYPTO1_SEEDS_CLASSES  4
+#define CRYPTO1_SEEDS_WORDS    (1UL << 16)
+
+// Intestazione dell'immagine, seguita dalle bitmap delle classi
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t classes;
+    uint32_t class_words;
+    uint32_t reserved;
+} Crypto1SeedsHeader;
+
+#define CRYPTO1_SEEDS_BYTES  (sizeof(Crypto1SeedsHeader) + CRYPTO1_SEEDS_CLASSES * CRYPTO1_SEEDS_WORDS * 4)
+
+/**
+ * Mappa l'immagine dei semi e ne verifica intestazione e un campione delle
+ * bitmap (su ESP32 name è l'etichetta della partizione, su host un file)
+ * @return false se l'immagine manca o non è valida
+ */
+bool crypto1_seeds_open(const char* name);
+
+void crypto1_seeds_close();
+
+/**
+ * Abilita o disabilita l'uso dei semi senza smappare l'immagine (confronti)
+ */
+void crypto1_seeds_enable(bool on);
+
+/**
+ * Bitmap dei semi di una metà i cui primi due bit di keystream sono b0, b1:
+ * il bit y è impostato se filter(y >> 1) == b0 e filter(y) == b1 (y a 21 bit).
+ * Al primo uso prova ad aprire la partizione CRYPTO1_SEEDS_LABEL (su host il
+ * file indicato da CRYPTO1_SEEDS_ENV)
+ * @return NULL se i semi non sono disponibili
+ */
+const uint32_t* crypto1_seeds_class(uint32_t b0, uint32_t b1);
+
+#endif // _MFCUK_CRYPTO_SEEDS_H_
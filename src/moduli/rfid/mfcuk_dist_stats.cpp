@@ -0,0 +1,145 @@
+/**
+ * MFCUK - Statistiche in linea delle distanze tra nonce
+ */
+
+#include "mfcuk_dist_stats.h"
+#include <string.h>
+
+static inline uint32_t stats_absdiff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+void dist_stats_init(DistStats* s, uint32_t max_tolerance) {
+    memset(s, 0, sizeof(*s));
+    s->max_tolerance = max_tolerance < DIST_STATS_MIN_TOLERANCE ? DIST_STATS_MIN_TOLERANCE : max_tolerance;
+    s->tolerance = s->max_tolerance;
+}
+
+/**
+ * Inserisce nel bin b e sposta il bin della mediana: attraversa solo bin
+ * vuoti, quindi al più DIST_STATS_BINS passi e di solito nessuno
+ */
+static void stats_insert(DistStats* s, uint16_t b) {
+    uint32_t k;
+
+    if (s->count == 0) {
+        s->med = b;
+        s->below = 0;
+    } else if (b < s->med) {
+        s->below++;
+    }
+    s->hist[b]++;
+    s->count++;
+
+    k = (s->count - 1) / 2;
+    while (k < s->below) {
+        s->med--;
+        s->below -= s->hist[s->med];
+    }
+    while (k >= s->below + s->hist[s->med]) {
+        s->below += s->hist[s->med];
+        s->med++;
+    }
+}
+
+/**
+ * MAD (raggio minimo attorno alla mediana con metà delle distanze),
+ * tolleranza e distanze entro tolleranza: scansione limitata al raggio
+ */
+static void stats_update(DistStats* s) {
+    uint32_t half = (s->count + 1) / 2;
+    uint32_t n = s->hist[s->med];
+    uint32_t r = 0;
+    uint32_t tol;
+
+    while (n < half) {
+        r++;
+        if (s->med >= r) n += s->hist[s->med - r];
+        if (s->med + r < DIST_STATS_BINS) n += s->hist[s->med + r];
+    }
+    s->mad = r;
+
+    tol = DIST_STATS_MAD_K * r + 1;
+    if (tol < DIST_STATS_MIN_TOLERANCE) tol = DIST_STATS_MIN_TOLERANCE;
+    if (tol > s->max_tolerance) tol = s->max_tolerance;
+    s->tolerance = tol;
+
+    s->inliers = s->hist[s->med];
+    for (r = 1; r <= tol; r++) {
+        if (s->med >= r) s->inliers += s->hist[s->med - r];
+        if (s->med + r < DIST_STATS_BINS) s->inliers += s->hist[s->med + r];
+    }
+}
+
+static bool stats_accept(DistStats* s, uint32_t dist) {
+    uint32_t limit;
+
+    if (dist < s->base || dist >= s->base + DIST_STATS_BINS) {
+        s->outliers++;
+        return false;
+    }
+    if (s->count > 0) {
+        limit = DIST_STATS_OUTLIER_K * s->mad;
+        if (limit < s->max_tolerance) limit = s->max_tolerance;
+        if (stats_absdiff(dist, s->base + s->med) > limit) {
+            s->outliers++;
+            return false;
+        }
+    }
+
+    stats_insert(s, (uint16_t)(dist - s->base));
+    stats_update(s);
+    return true;
+}
+
+/**
+ * Centra l'istogramma sulla mediana delle distanze di riscaldamento e le
+ * inserisce dalla più vicina alla mediana, così una distanza anomala non
+ * diventa il riferimento del filtro
+ */
+static void stats_center(DistStats* s) {
+    uint8_t n = s->warm_count;
+    uint32_t c, x;
+    int i, j;
+
+    for (i = 1; i < n; i++) {
+        for (x = s->warm[i], j = i; j > 0 && s->warm[j - 1] > x; j--) s->warm[j] = s->warm[j - 1];
+        s->warm[j] = x;
+    }
+    c = s->warm[(n - 1) / 2];
+
+    for (i = 1; i < n; i++) {
+        for (x = s->warm[i], j = i; j > 0 && stats_absdiff(s->warm[j - 1], c) > stats_absdiff(x, c); j--) {
+            s->warm[j] = s->warm[j - 1];
+        }
+        s->warm[j] = x;
+    }
+
+    s->base = c > DIST_STATS_BINS / 2 ? c - DIST_STATS_BINS / 2 : 0;
+    s->centered = true;
+    for (i = 0; i < n; i++) stats_accept(s, s->warm[i]);
+}
+
+bool dist_stats_add(DistStats* s, uint32_t dist) {
+    // Durante il riscaldamento le distanze sono accettate con riserva
+    if (!s->centered) {
+        s->warm[s->warm_count++] = dist;
+        if (s->warm_count == DIST_STATS_WARMUP) stats_center(s);
+        return true;
+    }
+    return stats_accept(s, dist);
+}
+
+void dist_stats_finish(DistStats* s) {
+    if (!s->centered && s->warm_count > 0) stats_center(s);
+}
+
+uint32_t dist_stats_median(const DistStats* s) {
+    return s->count ? s->base + s->med : 0;
+}
+
+bool dist_stats_done(const DistStats* s, uint32_t min_count) {
+    if (s->count == 0 || s->count < min_count) return false;
+    if (s->inliers * 5 < s->count * 4) return false;
+    return s->count * 100 >= 345 * s->mad * s->mad;
+}
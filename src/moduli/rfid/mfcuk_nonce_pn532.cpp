@@ -0,0 +1,64 @@
+/**
+ * MFCUK - Link dell'acquisizione dei nonce sul PN532
+ *
+ * I frame impacchettati con i bit di parità passano da InCommunicateThru
+ * con CRC e parità automatici disattivati nel CIU.
+ */
+
+#include <Arduino.h>
+#include "mfcuk_nonce.h"
+#include "rfid.h"
+#include "rfid_session.h"
+
+// Campo spento e avvio della carta per ripartire dallo stato iniziale del PRNG (ms)
+#define NONCE_FIELD_OFF_MS  10
+#define NONCE_FIELD_ON_MS   5
+
+static bool pn532_xfer(void* ctx, const NonceFrame* tx, NonceFrame* rx) {
+    uint8_t out[NONCE_RAW_MAX];
+    uint8_t in[NONCE_RAW_MAX + 4];
+    uint8_t last, n;
+    uint8_t in_len = sizeof(in);
+    bool ok;
+
+    n = nonce_frame_pack(tx, out, &last);
+    ok = nfc.communicateThru(out, n, last, in, &in_len);
+
+    // Senza risposta attesa il timeout del PN532 è l'esito normale
+    if (rx == NULL) return true;
+    return ok && nonce_frame_unpack(in, in_len, rx);
+}
+
+static bool pn532_field_reset(void* ctx) {
+    if (!nfc.setField(false)) return false;
+    delay(NONCE_FIELD_OFF_MS);
+    if (!nfc.setField(true)) return false;
+    delay(NONCE_FIELD_ON_MS);
+    return true;
+}
+
+bool nonce_pn532_begin(NonceAcq* a, CardSession* session) {
+    NonceLink link = {pn532_xfer, pn532_field_reset, NULL};
+
+    if (!session->active && !rfid_session_reselect(session)) return false;
+    if (!nfc.setRawFraming(true)) {
+        Serial.println("[PN532] Configurazione CIU per i frame grezzi non riuscita");
+        nfc.setRawFraming(false);
+        return false;
+    }
+
+    nonce_acq_init(a, &link, session->uid, session->uid_len);
+
+    // La carta è selezionata dalla sessione: il primo nonce riparte da HALT + WUPA
+    a->pending = true;
+    rfid_session_invalidate(session);
+    return true;
+}
+
+void nonce_pn532_end(CardSession* session) {
+    nfc.setRawFraming(false);
+
+    // Lo stato della carta è noto solo all'acquisizione: la sessione la riseleziona
+    session->active = false;
+    rfid_session_invalidate(session);
+}
@@ -0,0 +1,288 @@
+/**
+ * MFCUK - Pipeline di acquisizione e analisi dei nonce
+ *
+ * Su ESP32 il produttore gira su MFCUK_PIPELINE_RADIO_CORE e il consumatore
+ * su MFCUK_PIPELINE_CRACK_CORE; su host si usano due thread. Se i task non
+ * possono essere creati la pipeline viene eseguita in linea, un nonce alla
+ * volta, con lo stesso risultato.
+ */
+
+#include "mfcuk_pipeline.h"
+#include "mfcuk_crypto_prng.h"
+
+#ifndef ARDUINO
+#include <time.h>
+#include <thread>
+#include <chrono>
+#endif
+
+// Accessi condivisi tra i due core
+#define PIPE_LOAD(x)      __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define PIPE_STORE(x, v)  __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+/**
+ * Tempo in millisecondi per le statistiche
+ */
+static uint32_t pipe_millis() {
+#ifdef ARDUINO
+    return millis();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+#endif
+}
+
+/**
+ * Cede la CPU mentre si attende l'altro task
+ */
+static void pipe_wait() {
+#ifdef ARDUINO
+    vTaskDelay(1);
+#else
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+#endif
+}
+
+// ----- Ring SPSC -----
+
+void mfcuk_ring_init(NonceRing* ring) {
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+bool mfcuk_ring_push(NonceRing* ring, const NonceRecord* rec) {
+    uint32_t head = ring->head;
+
+    if (head - PIPE_LOAD(ring->tail) >= MFCUK_RING_SIZE) return false;
+
+    ring->buf[head & (MFCUK_RING_SIZE - 1)] = *rec;
+    PIPE_STORE(ring->head, head + 1);
+    return true;
+}
+
+bool mfcuk_ring_pop(NonceRing* ring, NonceRecord* rec) {
+    uint32_t tail = ring->tail;
+
+    if (PIPE_LOAD(ring->head) == tail) return false;
+
+    *rec = ring->buf[tail & (MFCUK_RING_SIZE - 1)];
+    PIPE_STORE(ring->tail, tail + 1);
+    return true;
+}
+
+uint32_t mfcuk_ring_count(const NonceRing* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+// ----- Task -----
+
+/**
+ * Passa il nonce al consumatore; true quando i candidati rimasti bastano
+ * per fermare la raccolta
+ */
+static bool pipe_consume(AttackPipeline* p, const NonceRecord* rec) {
+    uint32_t remaining = p->consume(p->ctx, rec);
+
+    p->stats.consumed++;
+    p->stats.remaining = remaining;
+    if (remaining == MFCUK_PIPELINE_OPEN || remaining > p->stop_at) return false;
+
+    p->stats.converged = true;
+    return true;
+}
+
+/**
+ * Produttore: acquisisce finché la sorgente non termina o arriva lo stop
+ */
+static void pipe_producer(AttackPipeline* p) {
+    NonceRecord rec;
+
+    while (!PIPE_LOAD(p->stop) && p->produce(p->ctx, &rec)) {
+        uint32_t fill;
+
+        p->stats.produced++;
+        while (!mfcuk_ring_push(&p->ring, &rec)) {
+            if (PIPE_LOAD(p->stop)) break;
+            p->stats.stalls++;
+            pipe_wait();
+        }
+
+        fill = mfcuk_ring_count(&p->ring);
+        if (fill > p->stats.max_fill) p->stats.max_fill = fill;
+    }
+
+    PIPE_STORE(p->producer_done, 1);
+}
+
+/**
+ * Consumatore: analizza i nonce e ferma la raccolta alla convergenza
+ */
+static void pipe_consumer(AttackPipeline* p) {
+    NonceRecord rec;
+
+    for (;;) {
+        if (mfcuk_ring_pop(&p->ring, &rec)) {
+            if (pipe_consume(p, &rec)) {
+                PIPE_STORE(p->stop, 1);
+                break;
+            }
+        } else if (PIPE_LOAD(p->producer_done)) {
+            // Il produttore può aver inserito l'ultimo record prima di terminare
+            if (mfcuk_ring_count(&p->ring) == 0) break;
+        } else if (PIPE_LOAD(p->stop)) {
+            break;
+        } else {
+            pipe_wait();
+        }
+    }
+
+    PIPE_STORE(p->consumer_done, 1);
+}
+
+#ifdef ARDUINO
+/**
+ * Esecuzione in linea sul task chiamante
+ */
+static void pipe_run_inline(AttackPipeline* p) {
+    NonceRecord rec;
+
+    while (!PIPE_LOAD(p->stop) && p->produce(p->ctx, &rec)) {
+        p->stats.produced++;
+        if (pipe_consume(p, &rec)) break;
+        if (p->idle) p->idle(p->ctx);
+    }
+
+    PIPE_STORE(p->producer_done, 1);
+    PIPE_STORE(p->consumer_done, 1);
+}
+
+static void pipe_radio_task(void* arg) {
+    pipe_producer((AttackPipeline*)arg);
+    vTaskDelete(NULL);
+}
+
+static void pipe_crack_task(void* arg) {
+    pipe_consumer((AttackPipeline*)arg);
+    vTaskDelete(NULL);
+}
+#endif
+
+void mfcuk_pipeline_init(AttackPipeline* p, pipeline_produce_cb produce, pipeline_consume_cb consume,
+                         pipeline_idle_cb idle, void* ctx, uint32_t stop_at) {
+    memset(p, 0, sizeof(*p));
+    mfcuk_ring_init(&p->ring);
+    p->produce = produce;
+    p->consume = consume;
+    p->idle = idle;
+    p->ctx = ctx;
+    p->stop_at = stop_at;
+    p->stats.remaining = MFCUK_PIPELINE_OPEN;
+}
+
+void mfcuk_pipeline_cancel(AttackPipeline* p) {
+    p->stats.cancelled = true;
+    PIPE_STORE(p->stop, 1);
+}
+
+bool mfcuk_pipeline_stopping(const AttackPipeline* p) {
+    return __atomic_load_n(&p->stop, __ATOMIC_ACQUIRE) != 0;
+}
+
+bool mfcuk_pipeline_run(AttackPipeline* p) {
+    uint32_t start = pipe_millis();
+
+#ifdef ARDUINO
+    // Il consumatore parte per primo: se manca il produttore basta segnalarne la fine
+    if (xTaskCreatePinnedToCore(pipe_crack_task, "mfcuk_crack", MFCUK_PIPELINE_CRACK_STACK, p, 1, NULL,
+                                MFCUK_PIPELINE_CRACK_CORE) != pdPASS) {
+        pipe_run_inline(p);
+    } else if (xTaskCreatePinnedToCore(pipe_radio_task, "mfcuk_radio", MFCUK_PIPELINE_RADIO_STACK, p, 1, NULL,
+                                       MFCUK_PIPELINE_RADIO_CORE) != pdPASS) {
+        PIPE_STORE(p->producer_done, 1);
+        while (!PIPE_LOAD(p->consumer_done)) pipe_wait();
+        PIPE_STORE(p->producer_done, 0);
+        PIPE_STORE(p->consumer_done, 0);
+        pipe_run_inline(p);
+    } else {
+        p->stats.threaded = true;
+        while (!PIPE_LOAD(p->producer_done) || !PIPE_LOAD(p->consumer_done)) {
+            if (p->idle) p->idle(p->ctx);
+            delay(10);
+        }
+    }
+#else
+    std::thread consumer(pipe_consumer, p);
+    std::thread producer(pipe_producer, p);
+
+    p->stats.threaded = true;
+    while (!PIPE_LOAD(p->producer_done) || !PIPE_LOAD(p->consumer_done)) {
+        if (p->idle) p->idle(p->ctx);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    producer.join();
+    consumer.join();
+#endif
+
+    p->stats.elapsed_ms = pipe_millis() - start;
+
+#ifdef ARDUINO
+    Serial.printf("[MFCUK] Pipeline: %u nonce acquisiti, %u analizzati, ring max %u, attese %u, %u ms%s\n",
+                  (unsigned)p->stats.produced, (unsigned)p->stats.consumed, (unsigned)p->stats.max_fill,
+                  (unsigned)p->stats.stalls, (unsigned)p->stats.elapsed_ms,
+                  p->stats.converged ? " (convergenza)" : (p->stats.cancelled ? " (annullata)" : ""));
+#endif
+
+    return p->stats.converged;
+}
+
+// ----- Distanze tra nonce -----
+
+void mfcuk_distance_init(NonceDistanceTracker* t, uint32_t* buf, uint32_t max, uint32_t tolerance, uint32_t min_count) {
+    memset(t, 0, sizeof(*t));
+    t->distances = buf;
+    t->max = max;
+    t->min_count = min_count ? min_count : 1;
+    dist_stats_init(&t->stats, tolerance);
+    t->tolerance = t->stats.tolerance;
+}
+
+static void distance_sync(NonceDistanceTracker* t) {
+    t->median = dist_stats_median(&t->stats);
+    t->tolerance = t->stats.tolerance;
+    t->inliers = t->stats.inliers;
+    t->outliers = t->stats.outliers;
+}
+
+bool mfcuk_distance_add(NonceDistanceTracker* t, uint32_t nt) {
+    uint32_t dist;
+
+    if (!t->have_last) {
+        t->last_nt = nt;
+        t->have_last = true;
+        return false;
+    }
+
+    dist = nonce_distance(t->last_nt, nt);
+    t->last_nt = nt;
+    if (dist == PRNG_DISTANCE_INVALID || t->count >= t->max) return t->count >= t->max;
+
+    t->distances[t->count++] = dist;
+    dist_stats_add(&t->stats, dist);
+    if (t->count >= t->max) dist_stats_finish(&t->stats);
+    distance_sync(t);
+
+    if (t->count >= t->max) return true;
+    return dist_stats_done(&t->stats, t->min_count);
+}
+
+bool mfcuk_distance_add_pair(NonceDistanceTracker* t, uint32_t from, uint32_t to) {
+    t->last_nt = from;
+    t->have_last = true;
+    return mfcuk_distance_add(t, to);
+}
+
+void mfcuk_distance_finish(NonceDistanceTracker* t) {
+    dist_stats_finish(&t->stats);
+    distance_sync(t);
+}
@@ -0,0 +1,150 @@
+/**
+ * MFCUK - Pipeline di acquisizione e analisi dei nonce
+ *
+ * Un task produttore pilota il PN532 e inserisce i nonce in un ring
+ * lock-free a singolo produttore/singolo consumatore; un task consumatore
+ * sull'altro core li analizza e segnala quando i dati sono sufficienti,
+ * così la raccolta si ferma appena i candidati convergono. Il task
+ * chiamante resta libero per display e pulsanti.
+ */
+
+#ifndef _MFCUK_PIPELINE_H_
+#define _MFCUK_PIPELINE_H_
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_dist_stats.h"
+
+// Record nel ring (potenza di 2)
+#define MFCUK_RING_SIZE  64
+
+// Core dei due task su ESP32: il loop Arduino gira sul core 1
+#define MFCUK_PIPELINE_RADIO_CORE  0
+#define MFCUK_PIPELINE_CRACK_CORE  1
+
+// Stack dei task (byte)
+#define MFCUK_PIPELINE_RADIO_STACK  4096
+#define MFCUK_PIPELINE_CRACK_STACK  8192
+
+// Nonce acquisito dalla carta
+typedef struct {
+    uint32_t nt;            // Nonce in chiaro (o predetto dalla distanza)
+    uint32_t nt_enc;        // Nonce cifrato {nt}, 0 se non disponibile
+    uint32_t time_ms;       // Istante di acquisizione
+    uint8_t  par;           // Bit di parità ricevuti con {nt}
+    uint8_t  sector;
+    uint8_t  key_type;
+    uint8_t  flags;
+} NonceRecord;
+
+// Ring SPSC: head scritto solo dal produttore, tail solo dal consumatore
+typedef struct {
+    NonceRecord buf[MFCUK_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} NonceRing;
+
+void mfcuk_ring_init(NonceRing* ring);
+bool mfcuk_ring_push(NonceRing* ring, const NonceRecord* rec);
+bool mfcuk_ring_pop(NonceRing* ring, NonceRecord* rec);
+uint32_t mfcuk_ring_count(const NonceRing* ring);
+
+// Acquisisce un nonce; false quando la raccolta è terminata o fallita
+typedef bool (*pipeline_produce_cb)(void* ctx, NonceRecord* rec);
+
+// Candidati rimasti non ancora stimabili (dati insufficienti per il solver)
+#define MFCUK_PIPELINE_OPEN  UINT32_MAX
+
+// Analizza un nonce; restituisce i candidati rimasti o MFCUK_PIPELINE_OPEN
+typedef uint32_t (*pipeline_consume_cb)(void* ctx, const NonceRecord* rec);
+
+// Chiamata periodica nel task chiamante (display, pulsante RST)
+typedef void (*pipeline_idle_cb)(void* ctx);
+
+typedef struct {
+    uint32_t produced;      // Nonce acquisiti
+    uint32_t consumed;      // Nonce analizzati
+    uint32_t max_fill;      // Occupazione massima del ring
+    uint32_t stalls;        // Attese del produttore per ring pieno
+    uint32_t elapsed_ms;
+    uint32_t remaining;     // Candidati rimasti dopo l'ultimo nonce analizzato
+    bool     converged;     // Il consumatore ha fermato la raccolta
+    bool     cancelled;     // Interrotto dal chiamante
+    bool     threaded;      // Eseguito su due task (false = in linea)
+} PipelineStats;
+
+typedef struct {
+    NonceRing ring;
+    pipeline_produce_cb produce;
+    pipeline_consume_cb consume;
+    pipeline_idle_cb idle;
+    void* ctx;
+    uint32_t stop_at;           // La raccolta si ferma con al più tanti candidati rimasti
+    uint32_t stop;              // Produttore: smettere di acquisire
+    uint32_t producer_done;
+    uint32_t consumer_done;
+    PipelineStats stats;
+} AttackPipeline;
+
+/**
+ * @param stop_at Candidati rimasti (restituiti da consume) sotto cui la
+ *        raccolta si ferma: DARKSIDE_VERIFY_LIMIT per il Darkside, 0 per
+ *        un consumatore che segnala solo la convergenza
+ */
+void mfcuk_pipeline_init(AttackPipeline* p, pipeline_produce_cb produce, pipeline_consume_cb consume,
+                         pipeline_idle_cb idle, void* ctx, uint32_t stop_at);
+
+/**
+ * Esegue la pipeline fino all'esaurimento del produttore, alla convergenza
+ * (candidati rimasti <= stop_at) o all'annullamento; ritorna quando
+ * entrambi i task sono terminati
+ * @return true se il consumatore ha segnalato la convergenza
+ */
+bool mfcuk_pipeline_run(AttackPipeline* p);
+
+/**
+ * Richiede l'arresto (dal task chiamante, tipicamente nella callback idle)
+ */
+void mfcuk_pipeline_cancel(AttackPipeline* p);
+
+/**
+ * true se il produttore deve interrompere un'acquisizione in corso
+ */
+bool mfcuk_pipeline_stopping(const AttackPipeline* p);
+
+// Distanze tra nonce consecutivi con criterio di convergenza
+typedef struct {
+    uint32_t* distances;    // In ordine di arrivo, anomale comprese
+    uint32_t max;
+    uint32_t count;
+    uint32_t last_nt;
+    bool     have_last;
+    uint32_t tolerance;     // Scarto ammesso dalla mediana (adattivo, al più quello iniziale)
+    uint32_t min_count;     // Distanze minime prima di valutare la convergenza
+    uint32_t median;
+    uint32_t inliers;       // Distanze entro tolleranza dalla mediana
+    uint32_t outliers;      // Distanze scartate dalla statistica
+    DistStats stats;
+} NonceDistanceTracker;
+
+void mfcuk_distance_init(NonceDistanceTracker* t, uint32_t* buf, uint32_t max, uint32_t tolerance, uint32_t min_count);
+
+/**
+ * Aggiunge un nonce; la distanza dal precedente aggiorna mediana, MAD e
+ * tolleranza in tempo costante (DistStats)
+ * @return true quando le distanze bastano (dist_stats_done) o il buffer è pieno
+ */
+bool mfcuk_distance_add(NonceDistanceTracker* t, uint32_t nt);
+
+/**
+ * Aggiunge la distanza tra i due nonce di una coppia (nt di un'autenticazione
+ * e nt della nested che la segue), senza legarla al nonce precedente
+ */
+bool mfcuk_distance_add_pair(NonceDistanceTracker* t, uint32_t from, uint32_t to);
+
+/**
+ * Fissa mediana e tolleranza anche se la raccolta si è fermata prima del
+ * riscaldamento delle statistiche
+ */
+void mfcuk_distance_finish(NonceDistanceTracker* t);
+
+#endif // _MFCUK_PIPELINE_H_
@@ -60,7 +60,11 @@ typedef struct {
 enum MfcukAttackMode {
     ATTACK_MODE_NONE = 0,
     ATTACK_MODE_DARKSIDE,
-    ATTACK_MODE_NESTED
+    ATTACK_MODE_NESTED,
+    ATTACK_MODE_AUTO,                    // Scelto dal riconoscimento della carta
+    ATTACK_MODE_BACKDOOR,                // Carte magiche Gen1a (solo da AUTO)
+    ATTACK_MODE_HARDNESTED,              // PRNG rinforzato (solo da AUTO)
+    ATTACK_MODE_MFOC_NESTED              // PRNG debole e chiave nota: nested di MFOC (solo da AUTO)
 };
 
 // Stato dell'attacco
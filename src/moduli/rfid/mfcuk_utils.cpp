@@ -8,6 +8,8 @@
 #include <FS.h>
 #include <LittleFS.h>
 
+extern const int buttonPin_RST;
+
 // Funzioni di conversione
 
 /**
@@ -490,7 +492,7 @@ bool load_card_from_file(const char* filename, MifareCard* card) {
  * Imposta la configurazione predefinita
  */
 void set_default_config(MfcukConfig* config) {
-    config->mode = ATTACK_MODE_DARKSIDE;
+    config->mode = ATTACK_MODE_AUTO;
     config->target_sector = 0;
     config->target_key_type = KEY_A;
     config->known_sector = 0;
@@ -611,3 +613,11 @@ bool load_config_from_fs(MfcukConfig* config) {
     
     return true;
 }
+
+/**
+ * Annullamento cooperativo dei lavori lunghi dal pulsante RST
+ */
+bool mfcuk_idle_rst(void* ctx) {
+    (void)ctx;
+    return digitalRead(buttonPin_RST) == HIGH;
+}
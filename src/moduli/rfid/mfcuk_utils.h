@@ -45,4 +45,7 @@ bool parse_config_string(const String& str, MfcukConfig* config);
 void save_config_to_fs(const MfcukConfig* config);
 bool load_config_from_fs(MfcukConfig* config);
 
+// Callback per i lavori in background (crypto1_parallel_run): false se RST è premuto
+bool mfcuk_idle_rst(void* ctx);
+
 #endif // _MFCUK_UTILS_H_
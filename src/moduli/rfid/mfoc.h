@@ -14,6 +14,10 @@
 #include <Arduino.h>
 #include "mfcuk_types.h"
 #include "mfcuk_crypto.h"
+#include "mfoc_candidates.h"
+#include "mfcuk_arena.h"
+#include "mfoc_dict.h"
+#include "rfid_session.h"
 
 // Strutture dati per MFOC
 typedef struct mfoc_denonce {
@@ -26,6 +30,7 @@ typedef struct mfoc_denonce {
 typedef struct mfoc_pKeys {
     uint64_t* possibleKeys;
     uint32_t size;
+    MfocDict* dict;         // Dizionario letto da LittleFS (possibleKeys è NULL)
 } mfoc_pKeys;
 
 typedef struct mfoc_bKeys {
@@ -33,24 +38,38 @@ typedef struct mfoc_bKeys {
     uint32_t size;
 } mfoc_bKeys;
 
-typedef struct mfoc_countKeys {
-    uint64_t key;
-    uint32_t count;
-} mfoc_countKeys;
+// mfoc_countKeys è definita in mfoc_candidates.h
 
 // ----- COSTANTI -----
-// Numero predefinito di tentativi
+// Numero predefinito di tentativi (distanze massime raccolte per attacco)
 #define DEFAULT_PROBES_NR 20
 // Numero predefinito di set di chiavi
 #define DEFAULT_SETS_NR 5
-// Tolleranza per le distanze di nonce
+// Tolleranza massima per le distanze di nonce (quella usata si adatta al jitter)
 #define DEFAULT_TOLERANCE 20
-// Numero di distanze di nonce da raccogliere
+// Numero tipico di distanze di nonce raccolte (stima dei costi)
 #define DEFAULT_DIST_NR 15
+// Distanze minime prima di fermare la raccolta
+#define MFOC_DISTANCE_MIN 8
+// Autenticazioni nested sul bersaglio: una per il recupero, le altre verificano le chiavi
+#define MFOC_NESTED_PROBES 3
+// nt stimati al massimo per sonda (mediana ± tolleranza)
+#define MFOC_NESTED_MAX_GUESSES (2 * DEFAULT_TOLERANCE + 1)
+// Chiavi candidate per nt stimato (dimensiona il filtro di Bloom della prima sonda)
+#define MFOC_NESTED_KEYS_PER_NT (1UL << 16)
+// Chiavi comuni a più sonde conservate per l'intersezione
+#define MFOC_INTERSECT_KEYS 64
+// RAM riservata all'insieme su flash quando le chiavi comuni superano MFOC_INTERSECT_KEYS
+#define MFOC_INTERSECT_SPILL_BUDGET (8 * 1024)
+// Chiavi del dizionario su flash filtrate insieme con le sonde nested
+#define MFOC_DICT_FILTER_BLOCK 256
 // Numero di chiavi da provare per settore
 #define TRY_KEYS 15
 // Chunk di memoria per le chiavi possibili
 #define MEM_CHUNK 10000
+// Arena dell'attacco: minimo per partire e massimo da riservare
+#define MFOC_ARENA_MIN (4 * 1024)
+#define MFOC_ARENA_MAX (96 * 1024)
 
 // ----- TIPI DI DATI E STRUTTURE -----
 // Le strutture mfoc_denonce, mfoc_pKeys, mfoc_bKeys e mfoc_countKeys sono già definite sopra
@@ -82,6 +101,7 @@ typedef struct {
 typedef struct {
     uint8_t known_key_type;      // Tipo di chiave conosciuta (A o B)
     MifareKey known_key;         // Chiave conosciuta 
+    int8_t exploit_sector;       // Settore della chiave conosciuta (-1 = settore target)
     uint8_t target_sector;       // Settore target
     uint8_t target_key_type;     // Tipo di chiave target (A o B)
     uint32_t max_iterations;     // Numero massimo di iterazioni
@@ -92,12 +112,16 @@ typedef struct {
     char keys_file[32];          // Nome file per le chiavi
 } MfocConfig;
 
+// Chiavi Mifare Classic predefinite, in ordine di probabilità
+extern uint8_t mfoc_default_keys[][6];
+extern const int mfoc_default_keys_count;
+
 // ----- FUNZIONI VERSIONE ORIGINALE -----
 
 // Funzioni principali
 void mfoc_menu();
 void mfoc_config();
-bool mfoc_run(MfocConfig* config, MfocCard* card = nullptr);
+bool mfoc_run(MfocConfig* config, MfocCard* card = nullptr, CardSession* session = nullptr);
 
 // Funzioni di configurazione
 void mfoc_set_known_key();
@@ -107,20 +131,20 @@ void mfoc_set_key_file();
 void mfoc_set_iterations();
 
 // Funzioni di utilità
-bool mfoc_load_keys_from_file(const char* filename, mfoc_pKeys* keys);
+bool mfoc_load_keys_from_file(const char* filename, mfoc_pKeys* keys, MfocDict* dict, MfcukArena* arena);
 void mfoc_update_progress(int progress, const char* status);
-uint32_t mfoc_median(mfoc_denonce* d);
 int mfoc_compare_keys(const void* a, const void* b);
-mfoc_countKeys* mfoc_uniqsort_keys(uint64_t* possibleKeys, uint32_t size);
 bool mfoc_valid_nonce(uint32_t Nt, uint32_t NtEnc, uint32_t Ks1, uint8_t* parity);
 uint64_t bytes_to_num(uint8_t* src, uint32_t len);
+void num_to_bytes(uint64_t n, uint32_t len, uint8_t* dest);
 
 // Funzioni di attacco
 int mfoc_enhanced_auth(uint8_t e_sector, uint8_t a_sector, MfocCard* card, 
                      mfoc_denonce* d, mfoc_pKeys* pk, char mode, bool dumpKeysA);
 int mfoc_find_exploit_sector(MfocCard* card);
 bool mfoc_collect_nonces(MfocCard* card, uint8_t sector, mfoc_denonce* d);
-bool mfoc_recover_key(MfocCard* card, uint8_t sector, uint8_t key_type, mfoc_denonce* d, mfoc_pKeys* pk);
+bool mfoc_recover_key(MfocCard* card, uint8_t sector, uint8_t key_type, mfoc_denonce* d, mfoc_pKeys* pk,
+                      MfcukArena* arena);
 
 // ----- FUNZIONI VERSIONE MODIFICATA -----
 
@@ -160,8 +184,8 @@ String browse_files(const char* directory);
 
 // Funzione per dump completo (recupero di tutte le chiavi e dump della carta)
 void mfoc_dump_complete();
-bool mfoc_run_complete_dump(MfocCard* card);
+bool mfoc_run_complete_dump(MfocCard* card, CardSession* session);
 bool mfoc_save_keys(MfocCard* card, const char* filename);
-bool mfoc_save_dump(MfocCard* card, const char* mfd_filename, const char* txt_filename);
+bool mfoc_save_dump(MfocCard* card, CardSession* session, const char* mfd_filename, const char* txt_filename);
 
 #endif // MFOC_H
@@ -0,0 +1,129 @@
+/**
+ * MFOC - Filtro di Bloom a blocchi per l'intersezione tra sonde
+ *
+ * La chiave viene mescolata una volta (finalizzatore di splitmix64): i 32
+ * bit alti scelgono il blocco, i 18 bassi posizione iniziale e passo
+ * (dispari) dei k bit nel blocco, tutti distinti.
+ */
+
+#include "mfoc_bloom.h"
+#include <string.h>
+#include <math.h>
+
+static inline uint64_t bloom_mix(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+}
+
+static inline uint64_t* bloom_block(const MfocBloom* b, uint64_t h) {
+    uint32_t i = (uint32_t)(((h >> 32) * b->num_blocks) >> 32);
+
+    return b->words + (size_t)i * MFOC_BLOOM_BLOCK_WORDS;
+}
+
+uint32_t mfoc_bloom_size(uint32_t expected, uint32_t budget) {
+    uint64_t bytes = ((uint64_t)expected * MFOC_BLOOM_BITS_PER_KEY + 7) / 8;
+
+    if (bytes > budget) bytes = budget;
+    bytes -= bytes % MFOC_BLOOM_BLOCK_BYTES;
+    if (bytes == 0 && budget >= MFOC_BLOOM_BLOCK_BYTES) bytes = MFOC_BLOOM_BLOCK_BYTES;
+    return (uint32_t)bytes;
+}
+
+void mfoc_bloom_init(MfocBloom* b, void* mem, uint32_t bytes, uint32_t expected) {
+    uint64_t bits = (uint64_t)bytes * 8;
+    uint64_t k;
+
+    b->words = (uint64_t*)mem;
+    b->num_blocks = bytes / MFOC_BLOOM_BLOCK_BYTES;
+    b->added = 0;
+    memset(b->words, 0, (size_t)b->num_blocks * MFOC_BLOOM_BLOCK_BYTES);
+
+    // k ottimo = bit per chiave * ln 2
+    if (expected == 0) expected = 1;
+    k = (bits * 69 / 100 + expected / 2) / expected;
+    if (k < 1) k = 1;
+    if (k > MFOC_BLOOM_MAX_K) k = MFOC_BLOOM_MAX_K;
+    b->k = (uint8_t)k;
+}
+
+bool mfoc_bloom_init_arena(MfocBloom* b, MfcukArena* arena, uint32_t expected, uint32_t budget) {
+    uint32_t bytes = mfoc_bloom_size(expected, budget);
+    void* mem;
+
+    if (bytes == 0) return false;
+    mem = mfcuk_arena_alloc(arena, bytes);
+    if (mem == NULL) return false;
+
+    mfoc_bloom_init(b, mem, bytes, expected);
+    return true;
+}
+
+void mfoc_bloom_add(MfocBloom* b, uint64_t key) {
+    uint64_t h = bloom_mix(key);
+    uint64_t* w = bloom_block(b, h);
+    uint32_t pos = (uint32_t)h & 511;
+    uint32_t step = ((uint32_t)(h >> 9) & 511) | 1;
+
+    for (uint8_t i = 0; i < b->k; i++) {
+        w[pos >> 6] |= 1ULL << (pos & 63);
+        pos = (pos + step) & 511;
+    }
+    b->added++;
+}
+
+bool mfoc_bloom_contains(const MfocBloom* b, uint64_t key) {
+    uint64_t h = bloom_mix(key);
+    const uint64_t* w = bloom_block(b, h);
+    uint32_t pos = (uint32_t)h & 511;
+    uint32_t step = ((uint32_t)(h >> 9) & 511) | 1;
+
+    for (uint8_t i = 0; i < b->k; i++) {
+        if (!(w[pos >> 6] & (1ULL << (pos & 63)))) return false;
+        pos = (pos + step) & 511;
+    }
+    return true;
+}
+
+uint32_t mfoc_bloom_fp_permille(const MfocBloom* b) {
+    double bits = (double)b->num_blocks * MFOC_BLOOM_BLOCK_BYTES * 8;
+
+    if (b->num_blocks == 0) return 1000;
+    return (uint32_t)(pow(1.0 - exp(-(double)b->k * b->added / bits), b->k) * 1000.0 + 0.5);
+}
+
+bool mfoc_bloom_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    MfocBloom* b = (MfocBloom*)ctx;
+
+    for (uint32_t i = 0; i < n; i++) mfoc_bloom_add(b, keys[i]);
+    return true;
+}
+
+void mfoc_bloom_gate_init(MfocBloomGate* g, const MfocBloom* bloom, crypto1_key_sink next, void* ctx) {
+    g->bloom = bloom;
+    g->next = next;
+    g->ctx = ctx;
+    g->tested = 0;
+    g->passed = 0;
+}
+
+bool mfoc_bloom_gate_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    MfocBloomGate* g = (MfocBloomGate*)ctx;
+    uint32_t m = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (!mfoc_bloom_contains(g->bloom, keys[i])) continue;
+        g->pass[m++] = keys[i];
+        if (m == CRYPTO1_KEY_BATCH) {
+            g->passed += m;
+            if (!g->next(g->pass, m, g->ctx)) return false;
+            m = 0;
+        }
+    }
+    g->tested += n;
+    g->passed += m;
+    return m == 0 || g->next(g->pass, m, g->ctx);
+}
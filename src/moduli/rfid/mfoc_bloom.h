@@ -0,0 +1,92 @@
+/**
+ * MFOC - Filtro di Bloom a blocchi per l'intersezione tra sonde
+ *
+ * Ogni sonda nested produce decine di migliaia di chiavi candidate per nt
+ * stimato: conservarle tutte per intersecarle non sta nell'heap. Le chiavi
+ * della prima sonda vengono solo segnate nel filtro; quelle delle sonde
+ * successive passano al controllo esatto e all'insieme dei candidati solo se
+ * il filtro le contiene. Ogni chiave tocca un solo blocco di 64 byte (una
+ * riga di cache), quindi aggiunta e test costano un accesso in memoria
+ * indipendentemente da k.
+ */
+
+#ifndef MFOC_BLOOM_H
+#define MFOC_BLOOM_H
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_arena.h"
+
+// Blocco del filtro: 512 bit, un accesso in memoria per chiave
+#define MFOC_BLOOM_BLOCK_BYTES  64
+#define MFOC_BLOOM_BLOCK_WORDS  (MFOC_BLOOM_BLOCK_BYTES / 8)
+
+// Bit per chiave oltre i quali il filtro non cresce (~1% di falsi positivi)
+#define MFOC_BLOOM_BITS_PER_KEY 10
+
+// Bit impostati per chiave, scelti da bit per chiave * ln 2
+#define MFOC_BLOOM_MAX_K        8
+
+typedef struct {
+    uint64_t* words;            // num_blocks * MFOC_BLOOM_BLOCK_WORDS
+    uint32_t num_blocks;
+    uint8_t  k;
+    uint32_t added;             // Chiavi aggiunte (con ripetizioni)
+} MfocBloom;
+
+/**
+ * Byte del filtro per 'expected' chiavi entro 'budget' byte: al più
+ * MFOC_BLOOM_BITS_PER_KEY bit per chiave, in blocchi interi
+ * @return 0 se il budget non contiene un blocco
+ */
+uint32_t mfoc_bloom_size(uint32_t expected, uint32_t budget);
+
+/**
+ * Inizializza il filtro su 'bytes' byte di mem (allineati a 8, multipli di
+ * MFOC_BLOOM_BLOCK_BYTES) e sceglie k per 'expected' chiavi
+ */
+void mfoc_bloom_init(MfocBloom* b, void* mem, uint32_t bytes, uint32_t expected);
+
+/**
+ * Come mfoc_bloom_init, con il filtro dimensionato su budget e preso dall'arena
+ * @return false se l'arena non contiene un blocco
+ */
+bool mfoc_bloom_init_arena(MfocBloom* b, MfcukArena* arena, uint32_t expected, uint32_t budget);
+
+void mfoc_bloom_add(MfocBloom* b, uint64_t key);
+
+/**
+ * @return false se la chiave non è mai stata aggiunta; true se lo è stata
+ *         o per un falso positivo
+ */
+bool mfoc_bloom_contains(const MfocBloom* b, uint64_t key);
+
+/**
+ * Stima dei falsi positivi (per mille) con le chiavi aggiunte finora
+ */
+uint32_t mfoc_bloom_fp_permille(const MfocBloom* b);
+
+/**
+ * Sink per nested_recover_keys: ctx è MfocBloom*, le chiavi vengono aggiunte
+ */
+bool mfoc_bloom_sink(const uint64_t* keys, uint32_t n, void* ctx);
+
+// Filtro davanti a un altro sink: inoltra solo le chiavi contenute nel filtro
+typedef struct {
+    const MfocBloom* bloom;
+    crypto1_key_sink next;
+    void* ctx;
+    uint64_t pass[CRYPTO1_KEY_BATCH];
+    uint32_t tested;
+    uint32_t passed;
+} MfocBloomGate;
+
+void mfoc_bloom_gate_init(MfocBloomGate* g, const MfocBloom* bloom, crypto1_key_sink next, void* ctx);
+
+/**
+ * Sink per nested_recover_keys: ctx è MfocBloomGate*. I blocchi inoltrati
+ * mantengono l'ordine delle chiavi
+ * @return false se il sink successivo ha fermato il recupero
+ */
+bool mfoc_bloom_gate_sink(const uint64_t* keys, uint32_t n, void* ctx);
+
+#endif // MFOC_BLOOM_H
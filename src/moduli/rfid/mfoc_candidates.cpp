@@ -0,0 +1,215 @@
+/**
+ * MFOC - Insieme delle chiavi candidate
+ *
+ * Il merge mantiene un min-heap di run indicizzato dalla chiave corrente:
+ * estratta la chiave minima, tutte le run che la contengono sono in cima
+ * allo heap, quindi il conteggio costa O(log k) per chiave. Le chiavi più
+ * frequenti sono tenute in out come un secondo min-heap (per conteggio) di
+ * dimensione max_out, ordinato solo alla fine.
+ */
+
+#include "mfoc_candidates.h"
+
+bool mfoc_candidates_init(MfocCandidates* c, uint32_t capacity) {
+    memset(c, 0, sizeof(*c));
+
+    c->keys = (uint64_t*)malloc((size_t)capacity * sizeof(uint64_t));
+    if (c->keys == NULL) return false;
+
+    c->capacity = capacity;
+    c->owned = true;
+    return true;
+}
+
+bool mfoc_candidates_init_arena(MfocCandidates* c, MfcukArena* arena, uint32_t capacity) {
+    memset(c, 0, sizeof(*c));
+
+    c->keys = MFCUK_ARENA_NEW(arena, uint64_t, capacity);
+    if (c->keys == NULL) return false;
+
+    c->capacity = capacity;
+    return true;
+}
+
+void mfoc_candidates_free(MfocCandidates* c) {
+    if (c->keys && c->owned) free(c->keys);
+    memset(c, 0, sizeof(*c));
+}
+
+void mfoc_candidates_reset(MfocCandidates* c) {
+    c->size = 0;
+    c->num_runs = 0;
+    c->run_open = false;
+    c->dropped = 0;
+}
+
+bool mfoc_candidates_begin_run(MfocCandidates* c) {
+    if (c->run_open) mfoc_candidates_end_run(c);
+    if (c->num_runs >= MFOC_CAND_MAX_RUNS) return false;
+
+    c->run_start[c->num_runs] = c->size;
+    c->run_open = true;
+    return true;
+}
+
+bool mfoc_candidates_add(MfocCandidates* c, const uint64_t* keys, uint32_t n) {
+    uint32_t room;
+
+    if (!c->run_open) return false;
+
+    room = c->capacity - c->size;
+    if (n > room) {
+        c->dropped += n - room;
+        n = room;
+    }
+
+    memcpy(c->keys + c->size, keys, (size_t)n * sizeof(uint64_t));
+    c->size += n;
+    return c->size < c->capacity;
+}
+
+uint32_t mfoc_candidates_end_run(MfocCandidates* c) {
+    uint32_t start, n, i;
+    uint64_t* run;
+
+    if (!c->run_open) return 0;
+
+    start = c->run_start[c->num_runs];
+    run = c->keys + start;
+    n = c->size - start;
+
+    // Le run prodotte da crypto1_states_to_keys sono spesso già ordinate
+    for (i = 1; i < n && run[i - 1] < run[i]; i++);
+    if (i < n) n = crypto1_keys_sort_unique(run, n);
+
+    c->size = start + n;
+    c->num_runs++;
+    c->run_start[c->num_runs] = c->size;
+    c->run_open = false;
+    return n;
+}
+
+bool mfoc_candidates_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    mfoc_candidates_add((MfocCandidates*)ctx, keys, n);
+    return true;
+}
+
+// ----- Merge a k vie -----
+
+static inline uint64_t cand_head(const MfocCandidates* c, uint16_t run) {
+    return c->keys[c->cursor[run]];
+}
+
+/**
+ * Riporta in posizione l'elemento i del min-heap delle run
+ */
+static void cand_sift_down(MfocCandidates* c, uint32_t i, uint32_t n) {
+    uint16_t run = c->heap[i];
+    uint64_t key = cand_head(c, run);
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && cand_head(c, c->heap[child + 1]) < cand_head(c, c->heap[child])) child++;
+        if (cand_head(c, c->heap[child]) >= key) break;
+        c->heap[i] = c->heap[child];
+        i = child;
+    }
+    c->heap[i] = run;
+}
+
+/**
+ * Ordine del min-heap dei risultati: conteggio minore, poi chiave maggiore
+ * (in cima c'è l'elemento da sostituire per primo)
+ */
+static inline bool top_less(const mfoc_countKeys* a, const mfoc_countKeys* b) {
+    if (a->count != b->count) return a->count < b->count;
+    return a->key > b->key;
+}
+
+static void top_sift_down(mfoc_countKeys* h, uint32_t i, uint32_t n) {
+    mfoc_countKeys item = h[i];
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && top_less(&h[child + 1], &h[child])) child++;
+        if (!top_less(&h[child], &item)) break;
+        h[i] = h[child];
+        i = child;
+    }
+    h[i] = item;
+}
+
+static void top_sift_up(mfoc_countKeys* h, uint32_t i) {
+    mfoc_countKeys item = h[i];
+
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!top_less(&item, &h[parent])) break;
+        h[i] = h[parent];
+        i = parent;
+    }
+    h[i] = item;
+}
+
+uint32_t mfoc_candidates_top(MfocCandidates* c, mfoc_countKeys* out, uint32_t max_out, uint32_t min_count) {
+    uint32_t heap_n = 0, out_n = 0, i;
+
+    if (c->run_open) mfoc_candidates_end_run(c);
+    if (max_out == 0) return 0;
+    if (min_count == 0) min_count = 1;
+
+    // Heap iniziale con le run non vuote
+    for (i = 0; i < c->num_runs; i++) {
+        c->cursor[i] = c->run_start[i];
+        if (c->run_start[i] < c->run_start[i + 1]) c->heap[heap_n++] = (uint16_t)i;
+    }
+    for (i = heap_n / 2; i-- > 0;) cand_sift_down(c, i, heap_n);
+
+    while (heap_n > 0) {
+        uint64_t key = cand_head(c, c->heap[0]);
+        uint32_t count = 0;
+
+        // Tutte le run con la stessa chiave corrente emergono in cima
+        while (heap_n > 0 && cand_head(c, c->heap[0]) == key) {
+            uint16_t run = c->heap[0];
+            count++;
+            if (++c->cursor[run] < c->run_start[run + 1]) {
+                cand_sift_down(c, 0, heap_n);
+            } else {
+                c->heap[0] = c->heap[--heap_n];
+                if (heap_n > 0) cand_sift_down(c, 0, heap_n);
+            }
+        }
+
+        if (count >= min_count) mfoc_top_push(out, &out_n, max_out, key, count);
+    }
+
+    mfoc_top_sort(out, out_n);
+    return out_n;
+}
+
+void mfoc_top_push(mfoc_countKeys* heap, uint32_t* n, uint32_t max_out, uint64_t key, uint32_t count) {
+    mfoc_countKeys item = {key, count};
+
+    if (*n < max_out) {
+        heap[*n] = item;
+        top_sift_up(heap, (*n)++);
+    } else if (max_out > 0 && top_less(&heap[0], &item)) {
+        heap[0] = item;
+        top_sift_down(heap, 0, *n);
+    }
+}
+
+void mfoc_top_sort(mfoc_countKeys* heap, uint32_t n) {
+    uint32_t i;
+
+    // Heapsort: estraendo il minimo in coda si ottiene l'ordine decrescente
+    for (i = n; i > 1; i--) {
+        mfoc_countKeys t = heap[0];
+        heap[0] = heap[i - 1];
+        heap[i - 1] = t;
+        top_sift_down(heap, 0, i - 1);
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * MFOC - Insieme delle chiavi candidate
+ *
+ * Ogni probe produce una "run" di chiavi candidate ordinata e senza
+ * duplicati; la chiave giusta compare in quasi tutte le run. Le run sono
+ * conservate in un unico buffer e unite con un merge a k vie su un min-heap,
+ * così il conteggio delle occorrenze avviene in un solo passaggio senza
+ * riordinare l'insieme e senza allocazioni per chiamata.
+ */
+
+#ifndef MFOC_CANDIDATES_H
+#define MFOC_CANDIDATES_H
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_arena.h"
+
+// Run (probe) massime per insieme
+#define MFOC_CAND_MAX_RUNS  128
+
+// Chiave candidata con il numero di run in cui compare
+typedef struct mfoc_countKeys {
+    uint64_t key;
+    uint32_t count;
+} mfoc_countKeys;
+
+typedef struct {
+    uint64_t* keys;                             // Buffer unico di tutte le run
+    uint32_t capacity;
+    bool     owned;                             // keys allocato con malloc (non da un'arena)
+    uint32_t size;                              // Chiavi nel buffer
+    uint32_t run_start[MFOC_CAND_MAX_RUNS + 1]; // Inizio di ogni run (+ fine dell'ultima)
+    uint32_t num_runs;                          // Run chiuse
+    bool     run_open;
+    uint32_t dropped;                           // Chiavi scartate per buffer pieno
+    // Stato del merge, preallocato
+    uint32_t cursor[MFOC_CAND_MAX_RUNS];        // Prossima chiave di ogni run
+    uint16_t heap[MFOC_CAND_MAX_RUNS];          // Run ordinate per chiave corrente
+} MfocCandidates;
+
+/**
+ * Alloca il buffer per 'capacity' chiavi in totale
+ * @return false se la memoria non è sufficiente
+ */
+bool mfoc_candidates_init(MfocCandidates* c, uint32_t capacity);
+
+/**
+ * Come mfoc_candidates_init, con il buffer preso dall'arena dell'attacco
+ * (rilasciato con l'arena; mfoc_candidates_free non lo libera)
+ */
+bool mfoc_candidates_init_arena(MfocCandidates* c, MfcukArena* arena, uint32_t capacity);
+void mfoc_candidates_free(MfocCandidates* c);
+
+/**
+ * Svuota l'insieme mantenendo il buffer
+ */
+void mfoc_candidates_reset(MfocCandidates* c);
+
+/**
+ * Apre una nuova run; le chiavi aggiunte fino a mfoc_candidates_end_run
+ * appartengono allo stesso probe
+ * @return false se è stato raggiunto MFOC_CAND_MAX_RUNS
+ */
+bool mfoc_candidates_begin_run(MfocCandidates* c);
+
+/**
+ * Aggiunge chiavi alla run aperta (in qualsiasi ordine)
+ * @return false se il buffer è pieno (le chiavi in eccesso vengono contate in dropped)
+ */
+bool mfoc_candidates_add(MfocCandidates* c, const uint64_t* keys, uint32_t n);
+
+/**
+ * Chiude la run: viene ordinata solo se necessario e i duplicati eliminati
+ * @return chiavi uniche nella run
+ */
+uint32_t mfoc_candidates_end_run(MfocCandidates* c);
+
+/**
+ * Sink per crypto1_key_extractor / nested_recover_keys: ctx è MfocCandidates*
+ * con una run aperta
+ */
+bool mfoc_candidates_sink(const uint64_t* keys, uint32_t n, void* ctx);
+
+/**
+ * Merge a k vie delle run: restituisce le chiavi presenti in almeno
+ * min_count run, le max_out più frequenti in ordine di conteggio decrescente
+ * (a parità di conteggio, chiave crescente)
+ * @return numero di elementi scritti in out
+ */
+uint32_t mfoc_candidates_top(MfocCandidates* c, mfoc_countKeys* out, uint32_t max_out, uint32_t min_count);
+
+/**
+ * Selezione delle chiavi più frequenti da un flusso: heap ha spazio per
+ * max_out elementi, *n parte da 0
+ */
+void mfoc_top_push(mfoc_countKeys* heap, uint32_t* n, uint32_t max_out, uint64_t key, uint32_t count);
+
+/**
+ * Ordina lo heap di mfoc_top_push per conteggio decrescente (a parità, chiave crescente)
+ */
+void mfoc_top_sort(mfoc_countKeys* heap, uint32_t n);
+
+#endif // MFOC_CANDIDATES_H
@@ -0,0 +1,146 @@
+/**
+ * MFOC - Controllo rapido di un dizionario su tutti i settori
+ */
+
+#include <Arduino.h>
+#include "mfoc_check.h"
+#include "../../lib/input/input.h"
+
+// Chiavi tra un aggiornamento del display e il successivo
+#define CHECK_PROGRESS_EVERY  16
+
+static inline bool check_has_key(const MfocCard* card, uint8_t sector, uint8_t type) {
+    return type == 0 ? card->sectors[sector].foundKeyA : card->sectors[sector].foundKeyB;
+}
+
+static void check_store_key(MfocCard* card, uint8_t sector, uint8_t type, const uint8_t* key) {
+    if (type == 0) {
+        memcpy(card->sectors[sector].KeyA.bytes, key, MIFARE_KEY_SIZE);
+        card->sectors[sector].foundKeyA = true;
+    } else {
+        memcpy(card->sectors[sector].KeyB.bytes, key, MIFARE_KEY_SIZE);
+        card->sectors[sector].foundKeyB = true;
+    }
+}
+
+bool mfoc_check_begin(MfocCheck* c, CardSession* session, MfocCard* card, uint8_t key_types) {
+    uint32_t uid = rfid_session_uid32(session);
+
+    memset(c, 0, sizeof(*c));
+    c->card = card;
+    c->session = session;
+    c->key_types = key_types;
+
+    if (!session->active && !rfid_session_reselect(session)) return false;
+
+    if (card->uid != 0 && card->uid != uid) {
+        Serial.println("[MFOC] Carta diversa da quella attesa");
+        return false;
+    }
+    card->uid = uid;
+
+    c->start_ms = millis();
+    return true;
+}
+
+bool mfoc_check_done(const MfocCheck* c) {
+    for (uint8_t s = 0; s < c->card->num_sectors; s++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            if ((c->key_types & (1 << t)) && !check_has_key(c->card, s, t)) return false;
+        }
+    }
+    return true;
+}
+
+int mfoc_check_key(MfocCheck* c, uint64_t key) {
+    CardSession* s = c->session;
+    uint8_t keyBytes[MIFARE_KEY_SIZE];
+    int found = 0;
+
+    if (c->lost) return -1;
+    num_to_bytes(key, MIFARE_KEY_SIZE, keyBytes);
+    c->keys++;
+
+    for (uint8_t sector = 0; sector < c->card->num_sectors; sector++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            if (!(c->key_types & (1 << t)) || check_has_key(c->card, sector, t)) continue;
+
+            uint32_t auths = s->auths, reselects = s->reselects;
+            uint32_t t0 = micros();
+            int result = rfid_session_auth(s, sector, t, keyBytes);
+
+            c->auths += s->auths - auths;
+            c->reselects += s->reselects - reselects;
+            if (result < 0) {
+                c->lost = true;
+                return -1;
+            }
+            c->stats[sector][t].tested++;
+            c->stats[sector][t].busy_us += micros() - t0;
+
+            if (result > 0) {
+                check_store_key(c->card, sector, t, keyBytes);
+                c->found++;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+bool mfoc_check_keys(MfocCheck* c, const uint64_t* keys, uint32_t n) {
+    for (uint32_t i = 0; i < n && !mfoc_check_done(c); i++) {
+        if ((i % CHECK_PROGRESS_EVERY) == 0) {
+            mfoc_update_progress(i * 100 / n, "Controllo chiavi...");
+        }
+        if (digitalRead(buttonPin_RST) == LOW) return false;
+        if (mfoc_check_key(c, keys[i]) < 0) return false;
+    }
+    return true;
+}
+
+bool mfoc_check_dict(MfocCheck* c, MfocDict* d) {
+    mfoc_countKeys hot[MFOC_DICT_HOT_CAP];
+    uint32_t num_hot = mfoc_dict_hot(d, hot, MFOC_DICT_HOT_CAP);
+    uint32_t i = 0;
+    uint64_t key;
+
+    for (uint32_t h = 0; h < num_hot && !mfoc_check_done(c); h++) {
+        if (mfoc_check_key(c, hot[h].key) < 0) return false;
+    }
+
+    mfoc_dict_rewind(d);
+    while (!mfoc_check_done(c) && mfoc_dict_next(d, &key)) {
+        if ((i++ % CHECK_PROGRESS_EVERY) == 0) {
+            mfoc_update_progress(i * 100 / d->hdr.count, "Controllo dizionario...");
+        }
+        if (digitalRead(buttonPin_RST) == LOW) return false;
+        if (mfoc_check_key(c, key) < 0) return false;
+    }
+    return true;
+}
+
+void mfoc_check_end(MfocCheck* c) {
+    c->elapsed_ms = millis() - c->start_ms;
+}
+
+uint32_t mfoc_check_rate(const MfocCheck* c, uint8_t sector, uint8_t key_type) {
+    const MfocCheckStat* st = &c->stats[sector][key_type];
+
+    return st->busy_us ? (uint32_t)((uint64_t)st->tested * 1000000 / st->busy_us) : 0;
+}
+
+void mfoc_check_report(const MfocCheck* c) {
+    Serial.printf("[MFOC] Controllo dizionario: %u chiavi, %u autenticazioni, %u riselezioni, %u trovate in %u ms (%u aut/s)%s\n",
+                  (unsigned)c->keys, (unsigned)c->auths, (unsigned)c->reselects, (unsigned)c->found,
+                  (unsigned)c->elapsed_ms, (unsigned)(c->elapsed_ms ? c->auths * 1000 / c->elapsed_ms : 0),
+                  c->lost ? ", carta persa" : "");
+
+    for (uint8_t s = 0; s < c->card->num_sectors; s++) {
+        Serial.printf("[MFOC]   S%02u A: %c %5u chiavi %4u/s   B: %c %5u chiavi %4u/s\n", s,
+                      c->card->sectors[s].foundKeyA ? '*' : '-', (unsigned)c->stats[s][0].tested,
+                      (unsigned)mfoc_check_rate(c, s, 0),
+                      c->card->sectors[s].foundKeyB ? '*' : '-', (unsigned)c->stats[s][1].tested,
+                      (unsigned)mfoc_check_rate(c, s, 1));
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * MFOC - Controllo rapido di un dizionario su tutti i settori
+ *
+ * Ogni chiave viene provata su tutti i settori ancora senza chiave prima di
+ * passare alla successiva, con la carta sempre presente: un'autenticazione
+ * fallita costa un solo InDataExchange più la riselezione diretta per UID
+ * (rfid_session_auth), invece del ciclo completo readPassiveTargetID +
+ * mifareclassic_AuthenticateBlock.
+ */
+
+#ifndef MFOC_CHECK_H
+#define MFOC_CHECK_H
+
+#include "mfoc.h"
+#include "mfoc_dict.h"
+#include "rfid_session.h"
+
+// Tipi di chiave da cercare
+#define MFOC_CHECK_KEY_A  0x01
+#define MFOC_CHECK_KEY_B  0x02
+
+typedef struct {
+    uint32_t tested;            // Chiavi provate
+    uint32_t busy_us;           // Tempo speso in autenticazioni e riselezioni
+} MfocCheckStat;
+
+typedef struct {
+    MfocCard* card;
+    CardSession* session;
+    uint8_t key_types;          // MFOC_CHECK_KEY_A | MFOC_CHECK_KEY_B
+    MfocCheckStat stats[MIFARE_MAXSECTOR][2];
+    uint32_t keys;              // Chiavi del dizionario elaborate
+    uint32_t auths;             // Autenticazioni inviate
+    uint32_t reselects;         // Riselezioni dopo un'autenticazione fallita
+    uint32_t found;             // Chiavi trovate
+    uint32_t start_ms;
+    uint32_t elapsed_ms;
+    bool lost;                  // Carta persa durante il controllo
+} MfocCheck;
+
+/**
+ * Avvia il controllo sulla carta della sessione (deve avere l'UID di card,
+ * se già noto)
+ * @return false se la carta non è presente o è diversa
+ */
+bool mfoc_check_begin(MfocCheck* c, CardSession* session, MfocCard* card, uint8_t key_types);
+
+/**
+ * Prova una chiave su tutti i settori che non la hanno ancora
+ * @return Chiavi nuove trovate, -1 se la carta è stata persa
+ */
+int mfoc_check_key(MfocCheck* c, uint64_t key);
+
+/**
+ * true se tutte le chiavi richieste sono state trovate
+ */
+bool mfoc_check_done(const MfocCheck* c);
+
+/**
+ * Prova un array di chiavi fino a trovarle tutte
+ * @return false se la carta è stata persa o l'utente ha interrotto
+ */
+bool mfoc_check_keys(MfocCheck* c, const uint64_t* keys, uint32_t n);
+
+/**
+ * Come mfoc_check_keys, con le chiavi frequenti del dizionario per prime
+ */
+bool mfoc_check_dict(MfocCheck* c, MfocDict* d);
+
+/**
+ * Chiude il conteggio del tempo
+ */
+void mfoc_check_end(MfocCheck* c);
+
+/**
+ * Chiavi provate al secondo su un settore (key_type 0 = A, 1 = B)
+ */
+uint32_t mfoc_check_rate(const MfocCheck* c, uint8_t sector, uint8_t key_type);
+
+/**
+ * Stampa su seriale autenticazioni al secondo e chiavi/s per settore
+ */
+void mfoc_check_report(const MfocCheck* c);
+
+#endif // MFOC_CHECK_H
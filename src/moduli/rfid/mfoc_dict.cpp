@@ -0,0 +1,596 @@
+/**
+ * MFOC - Dizionario di chiavi compilato su LittleFS
+ *
+ * Il dizionario è tenuto aperto in sola lettura; l'aggiornamento delle
+ * frequenze lo chiude, riscrive intestazione e sezione delle frequenze
+ * (dimensione fissa, le chiavi non si spostano) e lo riapre.
+ */
+
+#include "mfoc_dict.h"
+#include "mfoc_spill.h"
+
+#ifdef ARDUINO
+#define DICT_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#include <time.h>
+#define DICT_LOG(...) printf(__VA_ARGS__)
+#endif
+
+#define DICT_KEY_MASK   0xFFFFFFFFFFFFULL
+#define DICT_HITS_MAX   0xFFFF
+
+// Riga di testo più lunga considerata (il resto viene ignorato)
+#define DICT_LINE_MAX   64
+
+// ----- File -----
+
+#ifdef ARDUINO
+static bool dict_fopen(MfocDictFile* f, const char* path, const char* mode) {
+    *f = LittleFS.open(path, mode);
+    return (bool)*f;
+}
+
+static uint32_t dict_fread(MfocDictFile* f, uint8_t* buf, uint32_t n) {
+    return (uint32_t)f->read(buf, n);
+}
+
+static bool dict_fwrite(MfocDictFile* f, const uint8_t* buf, uint32_t n) {
+    return f->write(buf, n) == n;
+}
+
+static bool dict_fseek(MfocDictFile* f, uint32_t pos) {
+    return f->seek(pos);
+}
+
+static void dict_fclose(MfocDictFile* f) {
+    f->close();
+}
+
+static void dict_remove(const char* path) {
+    LittleFS.remove(path);
+}
+
+static uint32_t dict_millis() {
+    return millis();
+}
+#else
+static bool dict_fopen(MfocDictFile* f, const char* path, const char* mode) {
+    char m[4];
+
+    // Modalità binaria su host ("r" -> "rb", "r+" -> "r+b")
+    snprintf(m, sizeof(m), "%sb", mode);
+    *f = fopen(path, m);
+    return *f != NULL;
+}
+
+static uint32_t dict_fread(MfocDictFile* f, uint8_t* buf, uint32_t n) {
+    return (uint32_t)fread(buf, 1, n, *f);
+}
+
+static bool dict_fwrite(MfocDictFile* f, const uint8_t* buf, uint32_t n) {
+    return fwrite(buf, 1, n, *f) == n;
+}
+
+static bool dict_fseek(MfocDictFile* f, uint32_t pos) {
+    return fseek(*f, (long)pos, SEEK_SET) == 0;
+}
+
+static void dict_fclose(MfocDictFile* f) {
+    fclose(*f);
+}
+
+static void dict_remove(const char* path) {
+    remove(path);
+}
+
+static uint32_t dict_millis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+#endif
+
+// ----- Codifica -----
+
+static uint32_t dict_crc32(uint32_t crc, const uint8_t* data, uint32_t len) {
+    static const uint32_t nibble[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ nibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static inline void dict_put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t dict_get32(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void dict_put_key(uint8_t* p, uint64_t key) {
+    for (int i = MFOC_DICT_KEY_SIZE - 1; i >= 0; i--) {
+        p[i] = (uint8_t)key;
+        key >>= 8;
+    }
+}
+
+static inline uint64_t dict_get_key(const uint8_t* p) {
+    uint64_t key = 0;
+
+    for (int i = 0; i < MFOC_DICT_KEY_SIZE; i++) key = (key << 8) | p[i];
+    return key;
+}
+
+static void dict_encode_header(const MfocDictHeader* h, uint8_t* p) {
+    dict_put32(p, h->magic);
+    p[4] = h->version;
+    p[5] = h->hot_cap;
+    p[6] = (uint8_t)h->num_hot;
+    p[7] = (uint8_t)(h->num_hot >> 8);
+    dict_put32(p + 8, h->count);
+    dict_put32(p + 12, h->source_crc);
+    dict_put32(p + 16, h->checksum);
+    dict_put32(p + 20, h->hot_checksum);
+}
+
+static void dict_decode_header(const uint8_t* p, MfocDictHeader* h) {
+    h->magic = dict_get32(p);
+    h->version = p[4];
+    h->hot_cap = p[5];
+    h->num_hot = p[6] | (p[7] << 8);
+    h->count = dict_get32(p + 8);
+    h->source_crc = dict_get32(p + 12);
+    h->checksum = dict_get32(p + 16);
+    h->hot_checksum = dict_get32(p + 20);
+}
+
+static inline uint64_t dict_hot_key(const uint8_t* hot, uint32_t i) {
+    return dict_get_key(hot + i * MFOC_DICT_HOT_SIZE);
+}
+
+static inline uint16_t dict_hot_hits(const uint8_t* hot, uint32_t i) {
+    const uint8_t* p = hot + i * MFOC_DICT_HOT_SIZE + MFOC_DICT_KEY_SIZE;
+    return p[0] | (p[1] << 8);
+}
+
+static inline void dict_hot_set(uint8_t* hot, uint32_t i, uint64_t key, uint16_t hits) {
+    uint8_t* p = hot + i * MFOC_DICT_HOT_SIZE;
+
+    dict_put_key(p, key);
+    p[MFOC_DICT_KEY_SIZE] = (uint8_t)hits;
+    p[MFOC_DICT_KEY_SIZE + 1] = (uint8_t)(hits >> 8);
+}
+
+/**
+ * Scrive intestazione e sezione delle frequenze all'inizio del file
+ */
+static bool dict_write_head(MfocDictFile* f, MfocDictHeader* h, const uint8_t* hot) {
+    uint8_t raw[MFOC_DICT_HEADER_SIZE];
+    uint32_t hot_len = h->hot_cap * MFOC_DICT_HOT_SIZE;
+
+    h->hot_checksum = dict_crc32(0, hot, hot_len);
+    dict_encode_header(h, raw);
+    return dict_fseek(f, 0) && dict_fwrite(f, raw, sizeof(raw)) && dict_fwrite(f, hot, hot_len);
+}
+
+// ----- Lettura -----
+
+/**
+ * Apre il file e legge intestazione e frequenze, senza verificare le chiavi
+ */
+static bool dict_open_head(MfocDict* d, const char* path) {
+    uint8_t raw[MFOC_DICT_HEADER_SIZE];
+    uint32_t hot_len;
+
+    memset(d->hot, 0, sizeof(d->hot));
+    d->open = false;
+    d->pos = 0;
+    d->buf_first = 0;
+    d->buf_n = 0;
+    strncpy(d->path, path, sizeof(d->path) - 1);
+    d->path[sizeof(d->path) - 1] = '\0';
+
+    if (!dict_fopen(&d->file, path, "r")) return false;
+    if (dict_fread(&d->file, raw, sizeof(raw)) != sizeof(raw)) {
+        dict_fclose(&d->file);
+        return false;
+    }
+    dict_decode_header(raw, &d->hdr);
+
+    hot_len = d->hdr.hot_cap * MFOC_DICT_HOT_SIZE;
+    if (d->hdr.magic != MFOC_DICT_MAGIC || d->hdr.version != MFOC_DICT_VERSION ||
+        d->hdr.hot_cap > MFOC_DICT_HOT_CAP || d->hdr.num_hot > d->hdr.hot_cap ||
+        dict_fread(&d->file, d->hot, hot_len) != hot_len || dict_crc32(0, d->hot, hot_len) != d->hdr.hot_checksum) {
+        dict_fclose(&d->file);
+        return false;
+    }
+
+    d->keys_offset = MFOC_DICT_HEADER_SIZE + hot_len;
+    d->open = true;
+    return true;
+}
+
+static bool dict_load_block(MfocDict* d, uint32_t first) {
+    uint32_t n = d->hdr.count - first;
+
+    if (n > MFOC_DICT_CHUNK) n = MFOC_DICT_CHUNK;
+    d->buf_n = 0;
+    if (!dict_fseek(&d->file, d->keys_offset + first * MFOC_DICT_KEY_SIZE) ||
+        dict_fread(&d->file, d->buf, n * MFOC_DICT_KEY_SIZE) != n * MFOC_DICT_KEY_SIZE) {
+        return false;
+    }
+    d->buf_first = first;
+    d->buf_n = n;
+    return true;
+}
+
+bool mfoc_dict_get(MfocDict* d, uint32_t index, uint64_t* key) {
+    if (!d->open || index >= d->hdr.count) return false;
+    if (index < d->buf_first || index >= d->buf_first + d->buf_n) {
+        if (!dict_load_block(d, index)) return false;
+    }
+    *key = dict_get_key(d->buf + (index - d->buf_first) * MFOC_DICT_KEY_SIZE);
+    return true;
+}
+
+bool mfoc_dict_next(MfocDict* d, uint64_t* key) {
+    if (!mfoc_dict_get(d, d->pos, key)) return false;
+    d->pos++;
+    return true;
+}
+
+void mfoc_dict_rewind(MfocDict* d) {
+    d->pos = 0;
+}
+
+bool mfoc_dict_contains(MfocDict* d, uint64_t key) {
+    uint32_t lo = 0, hi = d->hdr.count;
+    uint64_t k;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (!mfoc_dict_get(d, mid, &k)) return false;
+        if (k == key) return true;
+        if (k < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+bool mfoc_dict_open(MfocDict* d, const char* path) {
+    uint32_t crc = 0, i;
+
+    if (!dict_open_head(d, path)) return false;
+
+    // Checksum delle chiavi, un blocco alla volta
+    for (i = 0; i < d->hdr.count; i += d->buf_n) {
+        if (!dict_load_block(d, i)) break;
+        crc = dict_crc32(crc, d->buf, d->buf_n * MFOC_DICT_KEY_SIZE);
+    }
+    if (i < d->hdr.count || crc != d->hdr.checksum) {
+        DICT_LOG("[MFOC] Dizionario %s corrotto\n", path);
+        mfoc_dict_close(d);
+        return false;
+    }
+    return true;
+}
+
+void mfoc_dict_close(MfocDict* d) {
+    if (d->open) dict_fclose(&d->file);
+    d->open = false;
+    d->buf_n = 0;
+}
+
+bool mfoc_dict_is_dict(const char* path) {
+    MfocDictFile f;
+    uint8_t raw[4];
+    bool ok;
+
+    if (!dict_fopen(&f, path, "r")) return false;
+    ok = dict_fread(&f, raw, sizeof(raw)) == sizeof(raw) && dict_get32(raw) == MFOC_DICT_MAGIC;
+    dict_fclose(&f);
+    return ok;
+}
+
+// ----- Frequenze -----
+
+uint32_t mfoc_dict_hot(const MfocDict* d, mfoc_countKeys* out, uint32_t max_out) {
+    uint32_t i, n = d->hdr.num_hot < max_out ? d->hdr.num_hot : max_out;
+
+    for (i = 0; i < n; i++) {
+        out[i].key = dict_hot_key(d->hot, i);
+        out[i].count = dict_hot_hits(d->hot, i);
+    }
+    return n;
+}
+
+bool mfoc_dict_record_hit(MfocDict* d, uint64_t key) {
+    uint32_t i, hits = 1;
+    bool ok;
+
+    if (!d->open || d->hdr.hot_cap == 0) return false;
+    key &= DICT_KEY_MASK;
+
+    for (i = 0; i < d->hdr.num_hot && dict_hot_key(d->hot, i) != key; i++);
+    if (i < d->hdr.num_hot) {
+        hits = dict_hot_hits(d->hot, i);
+        if (hits < DICT_HITS_MAX) hits++;
+    } else if (d->hdr.num_hot < d->hdr.hot_cap) {
+        i = d->hdr.num_hot++;
+    } else {
+        // Sezione piena: la chiave nuova prende il posto della meno usata
+        i = d->hdr.num_hot - 1;
+    }
+    dict_hot_set(d->hot, i, key, (uint16_t)hits);
+
+    // Mantiene l'ordine per successi decrescenti
+    for (; i > 0 && dict_hot_hits(d->hot, i - 1) < hits; i--) {
+        uint8_t tmp[MFOC_DICT_HOT_SIZE];
+
+        memcpy(tmp, d->hot + (i - 1) * MFOC_DICT_HOT_SIZE, MFOC_DICT_HOT_SIZE);
+        memcpy(d->hot + (i - 1) * MFOC_DICT_HOT_SIZE, d->hot + i * MFOC_DICT_HOT_SIZE, MFOC_DICT_HOT_SIZE);
+        memcpy(d->hot + i * MFOC_DICT_HOT_SIZE, tmp, MFOC_DICT_HOT_SIZE);
+    }
+
+    dict_fclose(&d->file);
+    d->open = false;
+    ok = dict_fopen(&d->file, d->path, "r+");
+    if (ok) {
+        ok = dict_write_head(&d->file, &d->hdr, d->hot);
+        dict_fclose(&d->file);
+    }
+
+    // Le chiavi non cambiano: il blocco in memoria resta valido
+    d->open = dict_fopen(&d->file, d->path, "r");
+    return ok && d->open;
+}
+
+// ----- Importazione -----
+
+static inline bool dict_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline int dict_hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool mfoc_dict_parse_line(const char* line, uint32_t len, uint64_t* key) {
+    const char* p = line;
+    const char* end = line + len;
+    const char* body;
+    const char* sep;
+    uint64_t k = 0;
+    int i;
+
+    while (p < end && dict_is_space(*p)) p++;
+    if (p == end || *p == '#') return false;
+
+    // <settore>;<tipo>;<chiave>: la chiave è l'ultimo campo prima del commento
+    for (body = p; body < end && *body != '#'; body++);
+    for (sep = body; sep > p && sep[-1] != ';'; sep--);
+    p = sep;
+    while (p < end && dict_is_space(*p)) p++;
+
+    for (i = 0; i < 2 * MFOC_DICT_KEY_SIZE; i++) {
+        int v = p + i < end ? dict_hex_digit(p[i]) : -1;
+
+        if (v < 0) return false;
+        k = (k << 4) | (uint64_t)v;
+    }
+
+    // Dopo la chiave solo spazi o un commento
+    p += 2 * MFOC_DICT_KEY_SIZE;
+    if (p < end && !dict_is_space(*p) && *p != '#') return false;
+
+    *key = k;
+    return true;
+}
+
+static bool dict_line_is_blank(const char* line, uint32_t len) {
+    uint32_t i = 0;
+
+    while (i < len && dict_is_space(line[i])) i++;
+    return i == len || line[i] == '#';
+}
+
+// Scrittura delle chiavi ordinate dal merge
+typedef struct {
+    MfocDictFile* f;
+    uint8_t blk[MFOC_DICT_CHUNK * MFOC_DICT_KEY_SIZE];
+    uint32_t n;
+    uint32_t count;
+    uint32_t crc;
+    bool ok;
+} DictWriter;
+
+static void dict_writer_flush(DictWriter* w) {
+    uint32_t len = w->n * MFOC_DICT_KEY_SIZE;
+
+    if (len == 0) return;
+    w->crc = dict_crc32(w->crc, w->blk, len);
+    if (!dict_fwrite(w->f, w->blk, len)) w->ok = false;
+    w->n = 0;
+}
+
+static bool dict_writer_cb(uint64_t key, uint32_t count, void* ctx) {
+    DictWriter* w = (DictWriter*)ctx;
+
+    (void)count;
+    dict_put_key(w->blk + w->n * MFOC_DICT_KEY_SIZE, key);
+    w->count++;
+    if (++w->n == MFOC_DICT_CHUNK) dict_writer_flush(w);
+    return w->ok;
+}
+
+/**
+ * Legge il file di testo una volta sola, riga per riga, verso la run aperta
+ */
+static bool dict_read_text(const char* src, MfocSpill* spill, MfocDictImportStats* stats, uint32_t* crc) {
+    MfocDictFile in;
+    uint8_t blk[128];
+    char line[DICT_LINE_MAX];
+    uint64_t batch[MFOC_SPILL_CHUNK];
+    uint32_t len = 0, nb = 0, n, i;
+    bool eof = false;
+
+    if (!dict_fopen(&in, src, "r")) return false;
+
+    while (!eof) {
+        n = dict_fread(&in, blk, sizeof(blk));
+        eof = (n == 0);
+        *crc = dict_crc32(*crc, blk, n);
+
+        for (i = 0; i <= n; i++) {
+            // A fine file l'ultima riga può non avere il ritorno a capo
+            if (i == n && !(eof && len > 0)) break;
+
+            if (i < n && blk[i] != '\n') {
+                if (len < DICT_LINE_MAX) line[len++] = (char)blk[i];
+                continue;
+            }
+
+            stats->lines++;
+            if (mfoc_dict_parse_line(line, len, &batch[nb])) {
+                stats->keys++;
+                if (++nb == MFOC_SPILL_CHUNK) {
+                    mfoc_spill_add(spill, batch, nb);
+                    nb = 0;
+                }
+            } else if (!dict_line_is_blank(line, len)) {
+                stats->invalid++;
+            }
+            len = 0;
+        }
+    }
+    mfoc_spill_add(spill, batch, nb);
+    dict_fclose(&in);
+    return true;
+}
+
+bool mfoc_dict_import(const char* src, const char* dst, MfcukArena* arena, MfocDictImportStats* stats) {
+    MfcukArenaScope scope(arena);
+    MfocDictImportStats local;
+    MfocDictHeader hdr;
+    MfocDict* old;
+    MfocSpill* spill;
+    DictWriter* w;
+    MfocDictFile out;
+    uint32_t budget = MFOC_SPILL_BUDGET;
+    uint32_t start = dict_millis();
+    bool ok;
+
+    if (stats == NULL) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = MFOC_DICT_MAGIC;
+    hdr.version = MFOC_DICT_VERSION;
+    hdr.hot_cap = MFOC_DICT_HOT_CAP;
+
+    old = MFCUK_ARENA_NEW(arena, MfocDict, 1);
+    w = MFCUK_ARENA_NEW(arena, DictWriter, 1);
+    spill = MFCUK_ARENA_NEW(arena, MfocSpill, 1);
+    if (old == NULL || w == NULL || spill == NULL) return false;
+
+    // Le frequenze del dizionario precedente sopravvivono alla ricompilazione
+    memset(old->hot, 0, sizeof(old->hot));
+    if (dict_open_head(old, dst)) {
+        hdr.num_hot = old->hdr.num_hot < MFOC_DICT_HOT_CAP ? old->hdr.num_hot : MFOC_DICT_HOT_CAP;
+        mfoc_dict_close(old);
+    }
+
+    if (budget > mfcuk_arena_remaining(arena)) budget = (uint32_t)mfcuk_arena_remaining(arena);
+    if (!mfoc_spill_init(spill, arena, budget, MFOC_SPILL_DIR)) {
+        DICT_LOG("[MFOC] Memoria insufficiente per importare %s\n", src);
+        return false;
+    }
+
+    mfoc_spill_begin_run(spill);
+    ok = dict_read_text(src, spill, stats, &hdr.source_crc);
+    mfoc_spill_end_run(spill);
+
+    if (ok && dict_fopen(&out, dst, "w")) {
+        memset(w, 0, sizeof(*w));
+        w->f = &out;
+        w->ok = dict_write_head(&out, &hdr, old->hot);
+
+        ok = w->ok && mfoc_spill_merge(spill, dict_writer_cb, w);
+        dict_writer_flush(w);
+
+        hdr.count = w->count;
+        hdr.checksum = w->crc;
+        ok = ok && w->ok && !spill->error && dict_write_head(&out, &hdr, old->hot);
+        dict_fclose(&out);
+        if (!ok) dict_remove(dst);
+    } else {
+        ok = false;
+    }
+    mfoc_spill_free(spill);
+
+    stats->count = hdr.count;
+    stats->elapsed_ms = dict_millis() - start;
+    DICT_LOG("[MFOC] Importate %u chiavi da %s (%u righe, %u non valide, %u duplicati) in %u ms%s\n",
+             (unsigned)stats->count, src, (unsigned)stats->lines, (unsigned)stats->invalid,
+             (unsigned)(stats->keys - stats->count), (unsigned)stats->elapsed_ms, ok ? "" : ": ERRORE");
+    return ok;
+}
+
+void mfoc_dict_path(const char* src, char* out, size_t len) {
+    const char* dot = strrchr(src, '.');
+    const char* slash = strrchr(src, '/');
+    size_t base = (dot != NULL && (slash == NULL || dot > slash)) ? (size_t)(dot - src) : strlen(src);
+
+    snprintf(out, len, "%.*s%s", (int)base, src, MFOC_DICT_EXT);
+}
+
+/**
+ * CRC32 del file di testo, con la stessa lettura a blocchi dell'importazione
+ */
+static bool dict_text_crc(const char* path, uint32_t* crc) {
+    MfocDictFile in;
+    uint8_t blk[128];
+    uint32_t n, total = 0;
+
+    *crc = 0;
+    if (!dict_fopen(&in, path, "r")) return false;
+    while ((n = dict_fread(&in, blk, sizeof(blk))) > 0) {
+        *crc = dict_crc32(*crc, blk, n);
+        total += n;
+    }
+    dict_fclose(&in);
+    return total > 0;
+}
+
+bool mfoc_dict_load(MfocDict* d, const char* path, MfcukArena* arena) {
+    char bin[sizeof(d->path)];
+    uint32_t crc;
+
+    if (mfoc_dict_is_dict(path)) return mfoc_dict_open(d, path);
+
+    if (!dict_text_crc(path, &crc)) return false;
+
+    // Il .mkd viene riusato finché il contenuto del file di testo non cambia
+    mfoc_dict_path(path, bin, sizeof(bin));
+    if (mfoc_dict_open(d, bin)) {
+        if (d->hdr.source_crc == crc) return true;
+        mfoc_dict_close(d);
+    }
+
+    return mfoc_dict_import(path, bin, arena, NULL) && mfoc_dict_open(d, bin);
+}
@@ -0,0 +1,146 @@
+/**
+ * MFOC - Dizionario di chiavi compilato su LittleFS
+ *
+ * Formato binario (.mkd), interi little-endian:
+ *   intestazione   MFOC_DICT_HEADER_SIZE byte (MfocDictHeader)
+ *   frequenze      hot_cap voci da 8 byte: chiave (6 byte) + successi (uint16),
+ *                  ordinate per successi decrescenti, valide le prime num_hot
+ *   chiavi         count chiavi da 6 byte, big-endian come nel file di testo,
+ *                  in ordine crescente e senza duplicati
+ *
+ * Le chiavi vengono lette dalla flash a blocchi di MFOC_DICT_CHUNK senza
+ * copiarle nell'heap; l'ordine permette la ricerca binaria. La sezione
+ * delle frequenze ha dimensione fissa e viene aggiornata sul posto quando
+ * una chiave funziona, così le chiavi più fortunate vengono provate per prime.
+ */
+
+#ifndef MFOC_DICT_H
+#define MFOC_DICT_H
+
+#include "mfoc_candidates.h"
+#include "mfcuk_arena.h"
+
+#ifdef ARDUINO
+#include <LittleFS.h>
+typedef File MfocDictFile;
+#else
+#include <stdio.h>
+typedef FILE* MfocDictFile;
+#endif
+
+#define MFOC_DICT_MAGIC        0x31444B4DUL    // "MKD1"
+#define MFOC_DICT_VERSION      2
+#define MFOC_DICT_EXT          ".mkd"
+#define MFOC_DICT_KEY_SIZE     6
+#define MFOC_DICT_HOT_SIZE     8
+#define MFOC_DICT_HEADER_SIZE  24
+
+// Voci della sezione delle frequenze
+#define MFOC_DICT_HOT_CAP  32
+
+// Chiavi per lettura dalla flash (384 byte)
+#define MFOC_DICT_CHUNK  64
+
+typedef struct {
+    uint32_t magic;
+    uint8_t  version;
+    uint8_t  hot_cap;           // Voci riservate alla sezione delle frequenze
+    uint16_t num_hot;           // Voci valide
+    uint32_t count;             // Chiavi del dizionario
+    uint32_t source_crc;        // CRC32 del file di testo importato (0 = nessuno)
+    uint32_t checksum;          // CRC32 delle chiavi
+    uint32_t hot_checksum;      // CRC32 della sezione delle frequenze
+} MfocDictHeader;
+
+typedef struct {
+    MfocDictHeader hdr;
+    MfocDictFile file;
+    char path[40];
+    uint8_t  hot[MFOC_DICT_HOT_CAP * MFOC_DICT_HOT_SIZE];
+    uint32_t keys_offset;       // Prima chiave nel file
+    uint32_t pos;               // Prossima chiave di mfoc_dict_next
+    uint32_t buf_first;         // Indice della prima chiave nel blocco
+    uint32_t buf_n;             // Chiavi nel blocco
+    uint8_t  buf[MFOC_DICT_CHUNK * MFOC_DICT_KEY_SIZE];
+    bool     open;
+} MfocDict;
+
+typedef struct {
+    uint32_t lines;             // Righe lette
+    uint32_t keys;              // Chiavi valide (duplicati compresi)
+    uint32_t invalid;           // Righe non vuote e non commenti scartate
+    uint32_t count;             // Chiavi nel dizionario
+    uint32_t elapsed_ms;
+} MfocDictImportStats;
+
+/**
+ * Apre un dizionario e ne verifica intestazione e checksum (una lettura
+ * sequenziale delle chiavi)
+ * @return false se il file manca, non è un dizionario o è corrotto
+ */
+bool mfoc_dict_open(MfocDict* d, const char* path);
+
+void mfoc_dict_close(MfocDict* d);
+
+/**
+ * true se il file inizia con l'intestazione di un dizionario
+ */
+bool mfoc_dict_is_dict(const char* path);
+
+/**
+ * Chiave successiva in ordine crescente
+ * @return false a fine dizionario o per errore di lettura
+ */
+bool mfoc_dict_next(MfocDict* d, uint64_t* key);
+
+void mfoc_dict_rewind(MfocDict* d);
+
+/**
+ * Chiave in posizione index (lettura dal blocco o dalla flash)
+ */
+bool mfoc_dict_get(MfocDict* d, uint32_t index, uint64_t* key);
+
+/**
+ * Ricerca binaria sulla flash
+ */
+bool mfoc_dict_contains(MfocDict* d, uint64_t key);
+
+/**
+ * Chiavi della sezione delle frequenze, dalla più usata
+ * @return Voci copiate in out (count = successi)
+ */
+uint32_t mfoc_dict_hot(const MfocDict* d, mfoc_countKeys* out, uint32_t max_out);
+
+/**
+ * Conta un successo della chiave (anche se non è nel dizionario) e
+ * riscrive sul posto intestazione e sezione delle frequenze
+ */
+bool mfoc_dict_record_hit(MfocDict* d, uint64_t key);
+
+/**
+ * Legge una chiave da una riga di testo: 12 cifre esadecimali oppure
+ * <settore>;<tipo>;<chiave> come in mfoc_save_keys
+ * @return false per righe vuote, commenti (#) o non valide
+ */
+bool mfoc_dict_parse_line(const char* line, uint32_t len, uint64_t* key);
+
+/**
+ * Compila un file di testo in un dizionario con una sola lettura: le
+ * chiavi vengono ordinate e filtrate su LittleFS tramite MfocSpill, con i
+ * buffer presi dall'arena e restituiti all'uscita. Le frequenze di un
+ * dizionario già presente in dst vengono conservate.
+ */
+bool mfoc_dict_import(const char* src, const char* dst, MfcukArena* arena, MfocDictImportStats* stats);
+
+/**
+ * Percorso del dizionario compilato di un file di testo (estensione .mkd)
+ */
+void mfoc_dict_path(const char* src, char* out, size_t len);
+
+/**
+ * Apre il file chiavi: un dizionario direttamente, un file di testo
+ * tramite il suo .mkd, ricompilato se manca o se il testo è cambiato
+ */
+bool mfoc_dict_load(MfocDict* d, const char* path, MfcukArena* arena);
+
+#endif // MFOC_DICT_H
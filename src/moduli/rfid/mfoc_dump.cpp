@@ -4,6 +4,8 @@
 #include "core/common/common.h"
 #include "moduli/rfid/rfid.h"
 #include "moduli/rfid/mfoc_keys.h"
+#include "moduli/rfid/mfoc_check.h"
+#include "moduli/rfid/mfoc_plan.h"
 #include <input.h>
 #include "core/littlefs/littlefs.h"
 #include <FS.h>
@@ -15,6 +17,9 @@
 #define MFOC_KEY_TYPE_A 0
 #define MFOC_KEY_TYPE_B 1
 
+// Settori salvati da mfoc_save_dump (MIFARE Classic 1K)
+#define MFOC_DUMP_MAX_SECTORS 16
+
 // Riferimento al display OLED
 extern Adafruit_SSD1306 display;
 extern Extended_PN532 nfc;
@@ -28,6 +33,16 @@ extern Extended_PN532 nfc;
  * 4. Dump completo della carta nei formati .mfd (binario) e .txt (testo)
  */
 void mfoc_dump_complete() {
+    // Lettore inizializzato una sola volta per tutto il dump
+    if (!rfid_reader_init()) {
+        display.clearDisplay();
+        common::println("ERROR!", 0, 0, 1, SSD1306_WHITE);
+        common::println("PN532 non trovato", 0, 12, 1, SSD1306_WHITE);
+        display.display();
+        delay(2000);
+        return;
+    }
+    
     display.clearDisplay();
     common::println("MFOC Dump Completo", 0, 0, 1, SSD1306_WHITE);
     common::println("Avvicinare la carta", 0, 16, 1, SSD1306_WHITE);
@@ -49,21 +64,20 @@ void mfoc_dump_complete() {
             rstPressStart = 0;
         }
 
-        // Controlla se c'è una carta presente
-        uint8_t uid[] = {0, 0, 0, 0, 0, 0, 0};
-        uint8_t uidLength;
+        // Controlla se c'è una carta presente: la selezione vale per tutto il dump
+        CardSession session;
         
-        if (nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength)) {
+        if (rfid_session_open(&session, RFID_SESSION_POLL_MS)) {
             // Carta rilevata, inizia il dump
             display.clearDisplay();
             common::println("Carta rilevata", 0, 0, 1, SSD1306_WHITE);
             char uidStr[32];
             sprintf(uidStr, "UID: ");
-            for (uint8_t i = 0; i < uidLength; i++) {
+            for (uint8_t i = 0; i < session.uid_len; i++) {
                 char byte[3];
-                sprintf(byte, "%02X", uid[i]);
+                sprintf(byte, "%02X", session.uid[i]);
                 strcat(uidStr, byte);
-                if (i < uidLength - 1) strcat(uidStr, ":");
+                if (i < session.uid_len - 1) strcat(uidStr, ":");
             }
             common::println(uidStr, 0, 16, 1, SSD1306_WHITE);
             display.display();
@@ -74,14 +88,17 @@ void mfoc_dump_complete() {
             memset(&card, 0, sizeof(MfocCard));
             
             // Converti l'UID in un formato numerico
-            card.uid = (uint32_t)uid[0] << 24 | (uint32_t)uid[1] << 16 | (uint32_t)uid[2] << 8 | (uint32_t)uid[3];
+            card.uid = rfid_session_uid32(&session);
             
-            // Determina il tipo di carta (numero di settori)
-            // Assumiamo che sia una MIFARE Classic da 1K (16 settori)
-            card.num_sectors = 16;
+            // Numero di settori dal SAK, entro quelli che il dump sa salvare
+            card.num_sectors = min(session.num_sectors, (uint8_t)MFOC_DUMP_MAX_SECTORS);
             
             // Esegui il dump completo
-            if (mfoc_run_complete_dump(&card)) {
+            bool dumped = mfoc_run_complete_dump(&card, &session);
+            rfid_session_report(&session);
+            rfid_session_close(&session);
+            
+            if (dumped) {
                 display.clearDisplay();
                 common::println("Dump completato", 0, 0, 1, SSD1306_WHITE);
                 common::println("con successo!", 0, 16, 1, SSD1306_WHITE);
@@ -125,7 +142,7 @@ void mfoc_dump_complete() {
  * @param card Puntatore alla struttura della carta
  * @return true se il dump è stato completato con successo, false altrimenti
  */
-bool mfoc_run_complete_dump(MfocCard* card) {
+bool mfoc_run_complete_dump(MfocCard* card, CardSession* session) {
     display.clearDisplay();
     common::println("Recupero chiavi...", 0, 0, 1, SSD1306_WHITE);
     display.display();
@@ -141,96 +158,80 @@ bool mfoc_run_complete_dump(MfocCard* card) {
     MfocConfig config;
     config.known_key_type = 0;  // 0 = Chiave A
     memcpy(&config.known_key, &defaultKey, sizeof(MifareKey));
+    config.exploit_sector = -1;
     config.max_iterations = 2000;  // Più iterazioni per aumentare le probabilità di successo
     config.num_probes = 15;
     config.sets = 1;
     config.tolerance = 20;
     config.load_keys_from_file = false;
-
-    // Array per tenere traccia dei settori già processati
-    bool processed_sectors[MIFARE_MAXSECTOR] = {false};
-    bool found_at_least_one_key = false;
     
-    // Primo tentativo con la chiave di fabbrica
-    for (uint8_t sector = 0; sector < card->num_sectors; sector++) {
+    // Primo passaggio: tutte le chiavi predefinite su tutti i settori, con la
+    // carta sempre presente e un solo comando PN532 per tentativo; misura
+    // anche la latenza di autenticazione di ogni settore
+    MfocCheck check;
+    if (!mfoc_check_begin(&check, session, card, MFOC_CHECK_KEY_A | MFOC_CHECK_KEY_B)) {
+        return false;
+    }
+    for (int i = 0; i < mfoc_default_keys_count && !mfoc_check_done(&check); i++) {
+        mfoc_update_progress(i * 100 / mfoc_default_keys_count, "Chiavi predefinite...");
+        if (mfoc_check_key(&check, bytes_to_num(mfoc_default_keys[i], 6)) < 0) break;
+    }
+    
+    // Le chiavi note vengono provate su tutte le posizioni ancora senza chiave
+    // prima di qualsiasi attacco
+    MfocPlan plan;
+    mfoc_plan_init(&plan, card, &check, mfoc_default_keys_count);
+    mfoc_plan_reuse_known(&plan);
+    
+    // Piano degli attacchi nested, stampato prima di partire
+    if (mfoc_plan_build(&plan)) {
+        char estMsg[32];
+        mfoc_plan_print(&plan);
+        
         display.clearDisplay();
-        char statusMsg[32];
-        sprintf(statusMsg, "Settore %d/16", sector);
-        common::println("Recupero chiavi...", 0, 0, 1, SSD1306_WHITE);
-        common::println(statusMsg, 0, 16, 1, SSD1306_WHITE);
-        common::println("Chiave: FFFFFFFFFFFF", 0, 32, 1, SSD1306_WHITE);
+        common::println("Piano recupero", 0, 0, 1, SSD1306_WHITE);
+        sprintf(estMsg, "%d attacchi", plan.num_steps);
+        common::println(estMsg, 0, 16, 1, SSD1306_WHITE);
+        sprintf(estMsg, "Stima: %lu s", (unsigned long)(plan.est_ms / 1000));
+        common::println(estMsg, 0, 28, 1, SSD1306_WHITE);
         display.display();
+        delay(1000);
         
-        // Prova con chiave A
-        config.target_sector = sector;
-        config.target_key_type = MFOC_KEY_TYPE_A; // 0 = Chiave A
-        
-        if (mfoc_run(&config, card)) {
-            processed_sectors[sector] = true;
-            found_at_least_one_key = true;
-        }
+        uint8_t e_sector = plan.exploit_sector;
+        config.exploit_sector = e_sector;
+        config.known_key_type = plan.exploit_key_type;
+        memcpy(&config.known_key, plan.exploit_key_type == 0 ? &card->sectors[e_sector].KeyA : &card->sectors[e_sector].KeyB,
+               sizeof(MifareKey));
         
-        // Prova con chiave B
-        config.target_key_type = MFOC_KEY_TYPE_B; // 1 = Chiave B
-        if (mfoc_run(&config, card)) {
-            processed_sectors[sector] = true;
-            found_at_least_one_key = true;
+        for (uint8_t i = 0; i < plan.num_steps; i++) {
+            MfocPlanStep* step = &plan.steps[i];
+            
+            // Chiave già trovata riusando quelle degli attacchi precedenti
+            if (plan.slots[step->sector][step->key_type] == MFOC_SLOT_KNOWN) continue;
+            if (digitalRead(buttonPin_RST) == LOW) break;
+            
+            display.clearDisplay();
+            char statusMsg[32];
+            sprintf(statusMsg, "Settore %d -> %d%c", e_sector, step->sector, step->key_type ? 'B' : 'A');
+            common::println("Recupero chiavi...", 0, 0, 1, SSD1306_WHITE);
+            common::println(statusMsg, 0, 16, 1, SSD1306_WHITE);
+            display.display();
+            
+            uint32_t t0 = millis();
+            config.target_sector = step->sector;
+            config.target_key_type = step->key_type;
+            step->found = mfoc_run(&config, card, session);
+            step->actual_ms = millis() - t0;
+            
+            // Una chiave nuova può aprire altre posizioni
+            mfoc_plan_update(&plan);
+            if (step->found && mfoc_plan_reuse_known(&plan) < 0) break;
         }
     }
+    mfoc_plan_print(&plan);
     
-    // Se abbiamo trovato almeno una chiave, possiamo usarla per trovare le altre
-    if (found_at_least_one_key) {
-        // Cicla attraverso tutti i settori per trovare quelli senza chiavi
-        for (uint8_t exploit_sector = 0; exploit_sector < card->num_sectors; exploit_sector++) {
-            // Se questo settore ha una chiave trovata, usala come chiave nota
-            if (processed_sectors[exploit_sector]) {
-                if (card->sectors[exploit_sector].foundKeyA) {
-                    memcpy(&config.known_key, &card->sectors[exploit_sector].KeyA, sizeof(MifareKey));
-                    config.known_key_type = 0; // MFOC_KEY_TYPE_A
-                } else if (card->sectors[exploit_sector].foundKeyB) {
-                    memcpy(&config.known_key, &card->sectors[exploit_sector].KeyB, sizeof(MifareKey));
-                    config.known_key_type = 1; // MFOC_KEY_TYPE_B
-                } else {
-                    continue;  // Non dovrebbe accadere
-                }
-                
-                // Usa questa chiave nota per trovare le altre chiavi
-                for (uint8_t target_sector = 0; target_sector < card->num_sectors; target_sector++) {
-                    // Salta i settori già processati
-                    if (processed_sectors[target_sector] && 
-                        card->sectors[target_sector].foundKeyA && 
-                        card->sectors[target_sector].foundKeyB) {
-                        continue;
-                    }
-                    
-                    display.clearDisplay();
-                    char statusMsg[32];
-                    sprintf(statusMsg, "Settore %d -> %d", exploit_sector, target_sector);
-                    common::println("Recupero chiavi...", 0, 0, 1, SSD1306_WHITE);
-                    common::println(statusMsg, 0, 16, 1, SSD1306_WHITE);
-                    display.display();
-                    
-                    // Prova a recuperare la chiave A se non è ancora stata trovata
-                    if (!card->sectors[target_sector].foundKeyA) {
-                        config.target_sector = target_sector;
-                        config.target_key_type = 0; // 0 = Chiave A
-                        if (mfoc_run(&config, card)) {
-                            processed_sectors[target_sector] = true;
-                        }
-                    }
-                    
-                    // Prova a recuperare la chiave B se non è ancora stata trovata
-                    if (!card->sectors[target_sector].foundKeyB) {
-                        config.target_sector = target_sector;
-                        config.target_key_type = 1; // 1 = Chiave B
-                        if (mfoc_run(&config, card)) {
-                            processed_sectors[target_sector] = true;
-                        }
-                    }
-                }
-            }
-        }
-    }
+    mfoc_check_end(&check);
+    mfoc_check_report(&check);
     
     // Verifica quante chiavi sono state trovate
     int keys_found = 0;
@@ -287,7 +288,7 @@ bool mfoc_run_complete_dump(MfocCard* card) {
     common::println(mfd_filename, 0, 16, 1, SSD1306_WHITE);
     display.display();
     
-    if (!mfoc_save_dump(card, mfd_filename, txt_filename)) {
+    if (!mfoc_save_dump(card, session, mfd_filename, txt_filename)) {
         display.clearDisplay();
         common::println("Errore salvataggio", 0, 0, 1, SSD1306_WHITE);
         common::println("dump", 0, 16, 1, SSD1306_WHITE);
@@ -343,93 +344,44 @@ bool mfoc_save_keys(MfocCard* card, const char* filename) {
 /**
  * Salva il dump completo della carta in formato MFD (binario) e TXT (testo)
  * @param card Puntatore alla struttura della carta
+ * @param session Sessione aperta sulla carta
  * @param mfd_filename Nome del file MFD in cui salvare il dump binario
  * @param txt_filename Nome del file TXT in cui salvare il dump in formato testo
  * @return true se il salvataggio è riuscito, false altrimenti
  */
-bool mfoc_save_dump(MfocCard* card, const char* mfd_filename, const char* txt_filename) {
-    uint8_t dump_data[16][64];  // Buffer per i dati dei settori
+bool mfoc_save_dump(MfocCard* card, CardSession* session, const char* mfd_filename, const char* txt_filename) {
+    uint8_t dump_data[MFOC_DUMP_MAX_SECTORS][64];  // Buffer per i dati dei settori
     memset(dump_data, 0, sizeof(dump_data));
     
-    // Crea uid_bytes una sola volta per tutto il metodo
-    uint8_t uid_bytes[4];
-    uid_bytes[0] = (card->uid >> 24) & 0xFF;
-    uid_bytes[1] = (card->uid >> 16) & 0xFF;
-    uid_bytes[2] = (card->uid >> 8) & 0xFF;
-    uid_bytes[3] = card->uid & 0xFF;
-    uint8_t uid_length = 4;  // Lunghezza UID 4 byte
-    
-    // Per ogni settore, leggi i dati se abbiamo almeno una chiave
+    // Un'autenticazione per settore, poi i 4 blocchi; la sessione riseleziona
+    // la carta dopo un'autenticazione fallita
     for (uint8_t sector = 0; sector < card->num_sectors; sector++) {
-        bool sector_read = false;
-        
-        // Prova a leggere con la chiave A
-        if (card->sectors[sector].foundKeyA) {
-            uint8_t key[6];
-            memcpy(key, card->sectors[sector].KeyA.bytes, 6);
-            
-            display.clearDisplay();
-            char statusMsg[32];
-            sprintf(statusMsg, "Lettura settore %d", sector);
-            common::println("Dump in corso...", 0, 0, 1, SSD1306_WHITE);
-            common::println(statusMsg, 0, 16, 1, SSD1306_WHITE);
-            common::println("Uso chiave A", 0, 32, 1, SSD1306_WHITE);
-            display.display();
-            
-            // Converti il numero di settore in block address
-            uint8_t firstBlock = sector * 4;
-            uint8_t trailerBlock = firstBlock + 3;
-            
-            // Leggi i primi 3 blocchi del settore
-            for (uint8_t block = firstBlock; block < trailerBlock; block++) {
-                // Autenticazione con la chiave A
-                if (nfc.mifareclassic_AuthenticateBlock(uid_bytes, uid_length, block, 0, key)) {
-                    // Leggi il blocco
-                    if (nfc.mifareclassic_ReadDataBlock(block, dump_data[sector] + ((block - firstBlock) * 16))) {
-                        sector_read = true;
-                    }
-                }
-            }
-            
-            // Leggi il blocco trailer (contiene i permessi e le chiavi)
-            // Riutilizzo uid_bytes creato sopra
-            if (nfc.mifareclassic_AuthenticateBlock(uid_bytes, uid_length, trailerBlock, 0, key)) {
-                nfc.mifareclassic_ReadDataBlock(trailerBlock, dump_data[sector] + 48);
-            }
-        }
-        // Se non è stato possibile leggere con la chiave A, prova con la chiave B
-        else if (!sector_read && card->sectors[sector].foundKeyB) {
-            uint8_t key[6];
-            memcpy(key, card->sectors[sector].KeyB.bytes, 6);
+        for (uint8_t keyType = MFOC_KEY_TYPE_A; keyType <= MFOC_KEY_TYPE_B; keyType++) {
+            bool found = (keyType == MFOC_KEY_TYPE_A) ? card->sectors[sector].foundKeyA : card->sectors[sector].foundKeyB;
+            const uint8_t* key = (keyType == MFOC_KEY_TYPE_A) ? card->sectors[sector].KeyA.bytes : card->sectors[sector].KeyB.bytes;
+            if (!found) continue;
             
             display.clearDisplay();
             char statusMsg[32];
             sprintf(statusMsg, "Lettura settore %d", sector);
             common::println("Dump in corso...", 0, 0, 1, SSD1306_WHITE);
             common::println(statusMsg, 0, 16, 1, SSD1306_WHITE);
-            common::println("Uso chiave B", 0, 32, 1, SSD1306_WHITE);
+            common::println(keyType == MFOC_KEY_TYPE_A ? "Uso chiave A" : "Uso chiave B", 0, 32, 1, SSD1306_WHITE);
             display.display();
             
             // Converti il numero di settore in block address
             uint8_t firstBlock = sector * 4;
             uint8_t trailerBlock = firstBlock + 3;
             
-            // Leggi i primi 3 blocchi del settore
-            for (uint8_t block = firstBlock; block < trailerBlock; block++) {
-                // Autenticazione con la chiave B
-                if (nfc.mifareclassic_AuthenticateBlock(uid_bytes, uid_length, block, 1, key)) {
-                    // Leggi il blocco
-                    if (nfc.mifareclassic_ReadDataBlock(block, dump_data[sector] + ((block - firstBlock) * 16))) {
-                        sector_read = true;
-                    }
-                }
-            }
+            int auth = rfid_session_auth(session, sector, keyType, key);
+            if (auth < 0) break;
+            if (auth == 0) continue;
             
-            // Leggi il blocco trailer (contiene i permessi e le chiavi)
-            // Riutilizzo uid_bytes creato sopra
-            if (nfc.mifareclassic_AuthenticateBlock(uid_bytes, uid_length, trailerBlock, 1, key)) {
-                nfc.mifareclassic_ReadDataBlock(trailerBlock, dump_data[sector] + 48);
+            // Blocchi dati e trailer (permessi e chiavi) con la stessa autenticazione
+            for (uint8_t block = firstBlock; block <= trailerBlock; block++) {
+                rfid_session_read(session, block, dump_data[sector] + ((block - firstBlock) * 16));
             }
+            break;
         }
     }
     
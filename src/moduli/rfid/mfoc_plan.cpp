@@ -0,0 +1,193 @@
+/**
+ * MFOC - Pianificazione del recupero di tutte le chiavi di una carta
+ */
+
+#include <Arduino.h>
+#include "mfoc_plan.h"
+
+static inline bool plan_has_key(const MfocCard* card, uint8_t sector, uint8_t type) {
+    return type == 0 ? card->sectors[sector].foundKeyA : card->sectors[sector].foundKeyB;
+}
+
+static inline const uint8_t* plan_key_bytes(const MfocCard* card, uint8_t sector, uint8_t type) {
+    return type == 0 ? card->sectors[sector].KeyA.bytes : card->sectors[sector].KeyB.bytes;
+}
+
+void mfoc_plan_init(MfocPlan* p, MfocCard* card, MfocCheck* check, uint32_t keys_per_attack) {
+    memset(p, 0, sizeof(*p));
+    p->card = card;
+    p->check = check;
+    p->exploit_sector = -1;
+    p->keys_per_attack = keys_per_attack;
+    mfoc_plan_update(p);
+
+    // Il controllo ha già provato ogni chiave trovata su tutte le posizioni
+    memset(p->tried, p->num_known, sizeof(p->tried));
+    mfoc_plan_update(p);
+}
+
+void mfoc_plan_update(MfocPlan* p) {
+    for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            const MfocCheckStat* st = &p->check->stats[s][t];
+
+            if (st->tested > 0) p->auth_us[s][t] = st->busy_us / st->tested;
+            if (!plan_has_key(p->card, s, t)) continue;
+
+            // Nuova chiave distinta: diventa candidata per le posizioni sconosciute
+            uint64_t key = bytes_to_num((uint8_t*)plan_key_bytes(p->card, s, t), MIFARE_KEY_SIZE);
+            uint8_t i;
+            for (i = 0; i < p->num_known && p->known[i] != key; i++);
+            if (i == p->num_known && p->num_known < MFOC_PLAN_MAX_KNOWN) p->known[p->num_known++] = key;
+        }
+    }
+
+    for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            if (plan_has_key(p->card, s, t)) {
+                p->slots[s][t] = MFOC_SLOT_KNOWN;
+            } else {
+                p->slots[s][t] = p->tried[s][t] < p->num_known ? MFOC_SLOT_CANDIDATE : MFOC_SLOT_UNKNOWN;
+            }
+        }
+    }
+}
+
+int mfoc_plan_reuse_known(MfocPlan* p) {
+    int found = 0;
+
+    // Ogni chiave trovata può aggiungerne di nuove: si ripete finché ci sono candidate
+    for (uint8_t k = 0; k < p->num_known; k++) {
+        uint8_t pending = 0;
+
+        for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+            for (uint8_t t = 0; t < 2; t++) {
+                if (p->slots[s][t] == MFOC_SLOT_CANDIDATE && p->tried[s][t] <= k) pending++;
+            }
+        }
+        if (pending > 0) {
+            int n = mfoc_check_key(p->check, p->known[k]);
+            if (n < 0) return -1;
+            found += n;
+        }
+
+        for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+            for (uint8_t t = 0; t < 2; t++) {
+                if (p->tried[s][t] <= k) p->tried[s][t] = k + 1;
+            }
+        }
+        mfoc_plan_update(p);
+    }
+    return found;
+}
+
+uint32_t mfoc_plan_auth_us(const MfocPlan* p, uint8_t sector, uint8_t key_type) {
+    uint64_t sum = 0;
+    uint32_t n = 0;
+
+    if (p->auth_us[sector][key_type] != 0) return p->auth_us[sector][key_type];
+
+    // Posizione mai misurata: media della carta
+    for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            if (p->auth_us[s][t] != 0) {
+                sum += p->auth_us[s][t];
+                n++;
+            }
+        }
+    }
+    return n ? (uint32_t)(sum / n) : MFOC_PLAN_DEFAULT_AUTH_US;
+}
+
+static int plan_compare_steps(const void* a, const void* b) {
+    const MfocPlanStep* sa = (const MfocPlanStep*)a;
+    const MfocPlanStep* sb = (const MfocPlanStep*)b;
+
+    if (sa->est_ms != sb->est_ms) return sa->est_ms < sb->est_ms ? -1 : 1;
+    if (sa->sector != sb->sector) return sa->sector < sb->sector ? -1 : 1;
+    return (int)sa->key_type - (int)sb->key_type;
+}
+
+bool mfoc_plan_build(MfocPlan* p) {
+    uint32_t best_us = UINT32_MAX;
+    uint64_t nonce_us, recovery_us;
+
+    p->exploit_sector = -1;
+    p->num_steps = 0;
+    p->est_ms = 0;
+
+    for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            uint32_t us = mfoc_plan_auth_us(p, s, t);
+
+            if (p->slots[s][t] == MFOC_SLOT_KNOWN && us < best_us) {
+                best_us = us;
+                p->exploit_sector = s;
+                p->exploit_key_type = t;
+            }
+        }
+    }
+    if (p->exploit_sector < 0) return false;
+
+    nonce_us = (uint64_t)DEFAULT_DIST_NR * MFOC_PLAN_AUTHS_PER_NONCE * best_us;
+
+    // In media la chiave esce a metà degli nt superstiti, ognuno con ~2^16 candidati
+    recovery_us = (uint64_t)(MFOC_PLAN_RECOVERY_GUESSES + 1) / 2 * MFOC_NESTED_KEYS_PER_NT *
+                  MFOC_PLAN_RECOVERY_US_PER_CANDIDATE;
+    p->recovery_ms = (uint32_t)(recovery_us / 1000);
+
+    for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+        for (uint8_t t = 0; t < 2; t++) {
+            if (p->slots[s][t] == MFOC_SLOT_KNOWN) continue;
+
+            MfocPlanStep* step = &p->steps[p->num_steps++];
+            uint64_t keys_us = (uint64_t)(p->keys_per_attack + 1) / 2 * mfoc_plan_auth_us(p, s, t);
+
+            step->sector = s;
+            step->key_type = t;
+            step->est_ms = (uint32_t)((nonce_us + recovery_us + keys_us) / 1000);
+            step->actual_ms = 0;
+            step->found = false;
+            p->est_ms += step->est_ms;
+        }
+    }
+
+    qsort(p->steps, p->num_steps, sizeof(MfocPlanStep), plan_compare_steps);
+    return true;
+}
+
+void mfoc_plan_print(const MfocPlan* p) {
+    static const char state_chars[] = {'-', '?', '*'};
+    uint32_t actual = 0;
+
+    Serial.println("[MFOC] Matrice chiavi (* nota, ? candidata, - sconosciuta), latenza aut. us:");
+    for (uint8_t s = 0; s < p->card->num_sectors; s++) {
+        Serial.printf("[MFOC]   S%02u A: %c %6u   B: %c %6u\n", s,
+                      state_chars[p->slots[s][0]], (unsigned)mfoc_plan_auth_us(p, s, 0),
+                      state_chars[p->slots[s][1]], (unsigned)mfoc_plan_auth_us(p, s, 1));
+    }
+
+    if (p->exploit_sector < 0) {
+        Serial.println("[MFOC] Piano: nessuna chiave nota, attacco nested impossibile");
+        return;
+    }
+
+    Serial.printf("[MFOC] Piano: exploit S%02u/%c, %u attacchi nested, %u chiavi per attacco, "
+                  "recupero ~%u ms per attacco, stima %u ms\n",
+                  p->exploit_sector, p->exploit_key_type ? 'B' : 'A', p->num_steps,
+                  (unsigned)p->keys_per_attack, (unsigned)p->recovery_ms, (unsigned)p->est_ms);
+    for (uint8_t i = 0; i < p->num_steps; i++) {
+        const MfocPlanStep* step = &p->steps[i];
+
+        if (step->actual_ms != 0) {
+            Serial.printf("[MFOC]   %2u. S%02u/%c stima %6u ms, effettivo %6u ms%s\n", i + 1, step->sector,
+                          step->key_type ? 'B' : 'A', (unsigned)step->est_ms, (unsigned)step->actual_ms,
+                          step->found ? ", trovata" : "");
+            actual += step->actual_ms;
+        } else {
+            Serial.printf("[MFOC]   %2u. S%02u/%c stima %6u ms\n", i + 1, step->sector,
+                          step->key_type ? 'B' : 'A', (unsigned)step->est_ms);
+        }
+    }
+    if (actual != 0) Serial.printf("[MFOC] Tempo effettivo degli attacchi: %u ms\n", (unsigned)actual);
+}
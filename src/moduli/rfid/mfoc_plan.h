@@ -0,0 +1,108 @@
+/**
+ * MFOC - Pianificazione del recupero di tutte le chiavi di una carta
+ *
+ * Il piano tiene una matrice settore x tipo di chiave con lo stato di ogni
+ * posizione: nota, sconosciuta, oppure candidata (ci sono chiavi già
+ * trovate altrove non ancora provate lì). Le chiavi note vengono provate su
+ * tutte le posizioni candidate prima di qualsiasi attacco; poi si sceglie
+ * come settore di exploit quello con l'autenticazione misurata più veloce e
+ * gli attacchi nested vengono ordinati per costo stimato.
+ *
+ * Il costo di un attacco nested è la raccolta dei nonce (due autenticazioni
+ * per nonce sul settore di exploit), il recupero dello stato sugli nt che
+ * superano il filtro di parità (tempo CPU per candidato prodotto) e metà
+ * delle chiavi da provare sul settore bersaglio, con le latenze misurate
+ * da MfocCheck.
+ */
+
+#ifndef MFOC_PLAN_H
+#define MFOC_PLAN_H
+
+#include "mfoc.h"
+#include "mfoc_check.h"
+
+// Stato di una posizione (settore, tipo di chiave)
+#define MFOC_SLOT_UNKNOWN    0
+#define MFOC_SLOT_CANDIDATE  1
+#define MFOC_SLOT_KNOWN      2
+
+// Latenza di autenticazione usata se nessuna è stata misurata (us)
+#define MFOC_PLAN_DEFAULT_AUTH_US  15000
+
+// Autenticazioni per nonce raccolto: settore di exploit + nested sul bersaglio
+#define MFOC_PLAN_AUTHS_PER_NONCE  2
+
+// Tempo CPU di lfsr_recovery32 per stato candidato prodotto (us): misura
+// lfsr_recovery32_candidate di test_crypto1_bench (~10 us su host x86-64)
+// scalata per l'ESP32 come BENCH_BUDGET_SCALE
+#ifndef MFOC_PLAN_RECOVERY_US_PER_CANDIDATE
+#define MFOC_PLAN_RECOVERY_US_PER_CANDIDATE  80
+#endif
+
+// nt per sonda che superano il filtro di parità (3 bit: circa 1 su 8)
+#define MFOC_PLAN_RECOVERY_GUESSES  ((MFOC_NESTED_MAX_GUESSES + 7) / 8)
+
+// Chiavi note distinte (al massimo una per posizione)
+#define MFOC_PLAN_MAX_KNOWN  (MIFARE_MAXSECTOR * 2)
+
+typedef struct {
+    uint8_t  sector;
+    uint8_t  key_type;
+    uint32_t est_ms;            // Costo stimato
+    uint32_t actual_ms;         // Tempo effettivo (0 = non eseguito)
+    bool     found;
+} MfocPlanStep;
+
+typedef struct {
+    MfocCard* card;
+    MfocCheck* check;
+    uint8_t  slots[MIFARE_MAXSECTOR][2];
+    uint8_t  tried[MIFARE_MAXSECTOR][2];    // Chiavi note già provate (prefisso di known)
+    uint32_t auth_us[MIFARE_MAXSECTOR][2];  // Latenza media misurata (0 = non misurata)
+    uint64_t known[MFOC_PLAN_MAX_KNOWN];
+    uint8_t  num_known;
+    int8_t   exploit_sector;    // -1 = nessuna chiave nota
+    uint8_t  exploit_key_type;
+    uint32_t keys_per_attack;   // Chiavi candidate provate da un attacco nested
+    uint32_t recovery_ms;       // Recupero dello stato stimato per attacco
+    MfocPlanStep steps[MFOC_PLAN_MAX_KNOWN];
+    uint8_t  num_steps;
+    uint32_t est_ms;            // Stima totale degli attacchi
+} MfocPlan;
+
+/**
+ * Prepara il piano sulla carta e sul controllo già eseguito (latenze); le
+ * chiavi trovate dal controllo sono già state provate ovunque
+ * @param keys_per_attack Chiavi candidate che un attacco nested prova
+ */
+void mfoc_plan_init(MfocPlan* p, MfocCard* card, MfocCheck* check, uint32_t keys_per_attack);
+
+/**
+ * Aggiorna stati, chiavi note e latenze dalla carta e dal controllo
+ */
+void mfoc_plan_update(MfocPlan* p);
+
+/**
+ * Prova le chiavi note su tutte le posizioni candidate
+ * @return Chiavi nuove trovate, -1 se la carta è stata persa
+ */
+int mfoc_plan_reuse_known(MfocPlan* p);
+
+/**
+ * Sceglie il settore di exploit e ordina gli attacchi nested per costo
+ * @return false se non c'è nessuna chiave nota da cui partire
+ */
+bool mfoc_plan_build(MfocPlan* p);
+
+/**
+ * Latenza di autenticazione di una posizione (misurata o stimata, us)
+ */
+uint32_t mfoc_plan_auth_us(const MfocPlan* p, uint8_t sector, uint8_t key_type);
+
+/**
+ * Stampa su seriale matrice delle chiavi, exploit e attacchi con la stima
+ * (e il tempo effettivo di quelli già eseguiti)
+ */
+void mfoc_plan_print(const MfocPlan* p);
+
+#endif // MFOC_PLAN_H
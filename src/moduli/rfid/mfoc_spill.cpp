@@ -0,0 +1,447 @@
+/**
+ * MFOC - Insieme di chiavi candidate su LittleFS
+ *
+ * Un segmento è un file di record a 64 bit ordinati per chiave: nei
+ * segmenti di una singola run il record è la chiave (48 bit), nei segmenti
+ * MFOC_SPILL_MERGED i 16 bit alti portano il numero di run. Quando i
+ * segmenti raggiungono MFOC_SPILL_FANIN vengono compattati: le run chiuse
+ * in un unico segmento con i conteggi, oppure i pezzi della run aperta in
+ * un unico segmento della stessa run. Così il merge finale apre sempre al
+ * più MFOC_SPILL_FANIN file.
+ */
+
+#include "mfoc_spill.h"
+
+#ifdef ARDUINO
+#include <LittleFS.h>
+#define SPILL_LOG(...) Serial.printf(__VA_ARGS__)
+#else
+#include <stdio.h>
+#include <sys/stat.h>
+#define SPILL_LOG(...) printf(__VA_ARGS__)
+#endif
+
+#define SPILL_KEY_MASK     0xFFFFFFFFFFFFULL
+#define SPILL_COUNT_MAX    0xFFFF
+#define SPILL_REC(k, c)    (((uint64_t)(c) << 48) | ((k) & SPILL_KEY_MASK))
+
+// ----- File -----
+
+#ifdef ARDUINO
+typedef File SpillFile;
+
+static bool spill_open(SpillFile* f, const char* path, bool write) {
+    *f = LittleFS.open(path, write ? "w" : "r");
+    return (bool)*f;
+}
+
+static uint32_t spill_read(SpillFile* f, uint64_t* buf, uint32_t n) {
+    return (uint32_t)(f->read((uint8_t*)buf, n * sizeof(uint64_t)) / sizeof(uint64_t));
+}
+
+static bool spill_write(SpillFile* f, const uint64_t* buf, uint32_t n) {
+    return f->write((const uint8_t*)buf, n * sizeof(uint64_t)) == n * sizeof(uint64_t);
+}
+
+static void spill_close(SpillFile* f) {
+    f->close();
+}
+
+static void spill_remove(const char* path) {
+    LittleFS.remove(path);
+}
+
+static void spill_mkdir(const char* dir) {
+    if (!LittleFS.exists(dir)) LittleFS.mkdir(dir);
+}
+#else
+typedef FILE* SpillFile;
+
+static bool spill_open(SpillFile* f, const char* path, bool write) {
+    *f = fopen(path, write ? "wb" : "rb");
+    return *f != NULL;
+}
+
+static uint32_t spill_read(SpillFile* f, uint64_t* buf, uint32_t n) {
+    return (uint32_t)fread(buf, sizeof(uint64_t), n, *f);
+}
+
+static bool spill_write(SpillFile* f, const uint64_t* buf, uint32_t n) {
+    return fwrite(buf, sizeof(uint64_t), n, *f) == n;
+}
+
+static void spill_close(SpillFile* f) {
+    fclose(*f);
+}
+
+static void spill_remove(const char* path) {
+    remove(path);
+}
+
+static void spill_mkdir(const char* dir) {
+    mkdir(dir, 0755);
+}
+#endif
+
+static void spill_path(const MfocSpill* s, uint16_t id, char* path, size_t len) {
+    snprintf(path, len, "%s/%04x.bin", s->dir, (unsigned)id);
+}
+
+// ----- Scrittura dei segmenti -----
+
+typedef struct {
+    SpillFile f;
+    uint64_t* blk;
+    uint32_t n;
+    uint32_t count;
+    bool ok;
+} SpillWriter;
+
+static bool spill_writer_open(MfocSpill* s, SpillWriter* w, uint16_t id, uint64_t* blk) {
+    char path[40];
+
+    spill_path(s, id, path, sizeof(path));
+    w->blk = blk;
+    w->n = 0;
+    w->count = 0;
+    w->ok = spill_open(&w->f, path, true);
+    return w->ok;
+}
+
+static void spill_writer_flush(MfocSpill* s, SpillWriter* w) {
+    if (w->n == 0) return;
+    if (!spill_write(&w->f, w->blk, w->n)) w->ok = false;
+    s->bytes_written += w->n * sizeof(uint64_t);
+    w->n = 0;
+}
+
+static inline void spill_writer_put(MfocSpill* s, SpillWriter* w, uint64_t rec) {
+    w->blk[w->n++] = rec;
+    w->count++;
+    if (w->n == MFOC_SPILL_CHUNK) spill_writer_flush(s, w);
+}
+
+static bool spill_writer_close(MfocSpill* s, SpillWriter* w) {
+    spill_writer_flush(s, w);
+    spill_close(&w->f);
+    return w->ok;
+}
+
+/**
+ * Segmento della run aperta con le chiavi del buffer (ordinate e senza duplicati)
+ */
+static bool spill_write_buffer(MfocSpill* s) {
+    SpillWriter w;
+    uint32_t i;
+
+    if (!spill_writer_open(s, &w, s->next_id, s->io + MFOC_SPILL_FANIN * MFOC_SPILL_CHUNK)) return false;
+
+    // Il buffer è già ordinato: scritto a blocchi senza copia
+    for (i = 0; i < s->buf_n; i += MFOC_SPILL_CHUNK) {
+        uint32_t n = s->buf_n - i < MFOC_SPILL_CHUNK ? s->buf_n - i : MFOC_SPILL_CHUNK;
+        if (!spill_write(&w.f, s->buf + i, n)) w.ok = false;
+        s->bytes_written += n * sizeof(uint64_t);
+    }
+    spill_close(&w.f);
+    if (!w.ok) return false;
+
+    s->segs[s->num_segs].id = s->next_id++;
+    s->segs[s->num_segs].run = (uint8_t)s->num_runs;
+    s->segs[s->num_segs].count = s->buf_n;
+    s->num_segs++;
+    s->buf_n = 0;
+    return true;
+}
+
+// ----- Merge -----
+
+typedef struct {
+    SpillFile f;
+    uint64_t* blk;
+    uint32_t pos;
+    uint32_t n;
+    uint32_t left;          // Record ancora da leggere dal file
+    uint8_t  run;
+    bool     open;
+} SpillReader;
+
+static bool spill_reader_fill(SpillReader* r) {
+    uint32_t want = r->left < MFOC_SPILL_CHUNK ? r->left : MFOC_SPILL_CHUNK;
+
+    r->pos = 0;
+    r->n = want ? spill_read(&r->f, r->blk, want) : 0;
+    r->left -= want;
+    return r->n == want;
+}
+
+// Emette una chiave unita con il suo conteggio
+typedef bool (*spill_emit_fn)(MfocSpill* s, uint64_t key, uint32_t count, void* ctx);
+
+/**
+ * Unisce i segmenti indicati in ordine di chiave. Il conteggio di una chiave
+ * è la somma dei conteggi nei segmenti uniti più il numero di run distinte
+ * tra i segmenti di singola run (i pezzi della stessa run contano una volta)
+ * @return false se interrotto da emit o per errore di I/O
+ */
+static bool spill_merge_segs(MfocSpill* s, const uint32_t* idx, uint32_t k, spill_emit_fn emit, void* ctx) {
+    SpillReader rd[MFOC_SPILL_FANIN];
+    uint32_t seen[(MFOC_SPILL_MAX_RUNS + 32) / 32];
+    uint32_t i;
+    bool ok = true, io_ok = true;
+
+    for (i = 0; i < k; i++) {
+        const MfocSpillSegment* seg = &s->segs[idx[i]];
+        char path[40];
+
+        spill_path(s, seg->id, path, sizeof(path));
+        rd[i].blk = s->io + i * MFOC_SPILL_CHUNK;
+        rd[i].left = seg->count;
+        rd[i].run = seg->run;
+        rd[i].open = spill_open(&rd[i].f, path, false);
+        if (!rd[i].open || !spill_reader_fill(&rd[i])) io_ok = false;
+    }
+    ok = io_ok;
+
+    while (ok) {
+        uint64_t key = UINT64_MAX;
+        uint32_t count = 0;
+        bool any = false;
+
+        // Pochi segmenti: la chiave minima si cerca linearmente
+        for (i = 0; i < k; i++) {
+            if (rd[i].pos < rd[i].n) {
+                uint64_t kk = rd[i].blk[rd[i].pos] & SPILL_KEY_MASK;
+                if (kk < key) key = kk;
+                any = true;
+            }
+        }
+        if (!any) break;
+
+        memset(seen, 0, sizeof(seen));
+        for (i = 0; i < k; i++) {
+            while (rd[i].pos < rd[i].n && (rd[i].blk[rd[i].pos] & SPILL_KEY_MASK) == key) {
+                if (rd[i].run == MFOC_SPILL_MERGED) {
+                    count += (uint32_t)(rd[i].blk[rd[i].pos] >> 48);
+                } else if (!(seen[rd[i].run >> 5] & (1u << (rd[i].run & 31)))) {
+                    seen[rd[i].run >> 5] |= 1u << (rd[i].run & 31);
+                    count++;
+                }
+                if (++rd[i].pos == rd[i].n && rd[i].left > 0 && !spill_reader_fill(&rd[i])) io_ok = false;
+            }
+        }
+
+        if (!io_ok || !emit(s, key, count, ctx)) ok = false;
+    }
+
+    for (i = 0; i < k; i++) {
+        if (rd[i].open) spill_close(&rd[i].f);
+    }
+    if (!io_ok) s->error = true;
+    return ok;
+}
+
+static bool spill_emit_raw(MfocSpill* s, uint64_t key, uint32_t count, void* ctx) {
+    (void)count;
+    spill_writer_put(s, (SpillWriter*)ctx, key);
+    return true;
+}
+
+static bool spill_emit_merged(MfocSpill* s, uint64_t key, uint32_t count, void* ctx) {
+    spill_writer_put(s, (SpillWriter*)ctx, SPILL_REC(key, count > SPILL_COUNT_MAX ? SPILL_COUNT_MAX : count));
+    return true;
+}
+
+/**
+ * Sostituisce i segmenti indicati con un unico segmento (della run 'run' o MFOC_SPILL_MERGED)
+ */
+static bool spill_compact_segs(MfocSpill* s, const uint32_t* idx, uint32_t k, uint8_t run) {
+    MfocSpillSegment keep[MFOC_SPILL_FANIN];
+    SpillWriter w;
+    uint32_t i, j, n = 0;
+    char path[40];
+    bool ok;
+
+    if (!spill_writer_open(s, &w, s->next_id, s->io + MFOC_SPILL_FANIN * MFOC_SPILL_CHUNK)) return false;
+    ok = spill_merge_segs(s, idx, k, run == MFOC_SPILL_MERGED ? spill_emit_merged : spill_emit_raw, &w);
+    ok &= spill_writer_close(s, &w);
+    if (!ok) {
+        spill_path(s, s->next_id, path, sizeof(path));
+        spill_remove(path);
+        return false;
+    }
+
+    // Elimina i segmenti uniti e mantiene gli altri nell'ordine originale
+    for (i = 0; i < s->num_segs; i++) {
+        bool merged = false;
+        for (j = 0; j < k; j++) merged |= (idx[j] == i);
+        if (merged) {
+            spill_path(s, s->segs[i].id, path, sizeof(path));
+            spill_remove(path);
+        } else {
+            keep[n++] = s->segs[i];
+        }
+    }
+    keep[n].id = s->next_id++;
+    keep[n].run = run;
+    keep[n].count = w.count;
+    n++;
+
+    memcpy(s->segs, keep, n * sizeof(MfocSpillSegment));
+    s->num_segs = n;
+    s->compactions++;
+    return true;
+}
+
+/**
+ * Libera un posto per un nuovo segmento: unisce le run chiuse o, se ce n'è
+ * al più una, i pezzi della run aperta
+ */
+static bool spill_make_room(MfocSpill* s) {
+    uint32_t closed[MFOC_SPILL_FANIN], cur[MFOC_SPILL_FANIN];
+    uint32_t nc = 0, no = 0, i;
+
+    if (s->num_segs < MFOC_SPILL_FANIN) return true;
+
+    for (i = 0; i < s->num_segs; i++) {
+        if (s->run_open && s->segs[i].run == (uint8_t)s->num_runs) cur[no++] = i;
+        else closed[nc++] = i;
+    }
+
+    if (nc >= 2) return spill_compact_segs(s, closed, nc, MFOC_SPILL_MERGED);
+    return spill_compact_segs(s, cur, no, (uint8_t)s->num_runs);
+}
+
+/**
+ * Ordina il buffer della run aperta e lo scrive come segmento
+ */
+static bool spill_flush_run(MfocSpill* s) {
+    if (s->buf_n == 0) return true;
+
+    s->buf_n = crypto1_keys_sort_unique(s->buf, s->buf_n);
+    if (!spill_make_room(s) || !spill_write_buffer(s)) {
+        s->error = true;
+        return false;
+    }
+    return true;
+}
+
+// ----- API -----
+
+bool mfoc_spill_init(MfocSpill* s, MfcukArena* arena, uint32_t budget, const char* dir) {
+    const uint32_t io_keys = (MFOC_SPILL_FANIN + 1) * MFOC_SPILL_CHUNK;
+
+    memset(s, 0, sizeof(*s));
+    if (budget < (io_keys + MFOC_SPILL_CHUNK) * sizeof(uint64_t)) return false;
+
+    s->io = MFCUK_ARENA_NEW(arena, uint64_t, io_keys);
+    s->buf_cap = budget / sizeof(uint64_t) - io_keys;
+    s->buf = MFCUK_ARENA_NEW(arena, uint64_t, s->buf_cap);
+    if (s->io == NULL || s->buf == NULL) return false;
+
+    strncpy(s->dir, dir ? dir : MFOC_SPILL_DIR, sizeof(s->dir) - 1);
+    spill_mkdir(s->dir);
+    return true;
+}
+
+void mfoc_spill_free(MfocSpill* s) {
+    char path[40];
+    uint32_t i;
+
+    for (i = 0; i < s->num_segs; i++) {
+        spill_path(s, s->segs[i].id, path, sizeof(path));
+        spill_remove(path);
+    }
+    s->num_segs = 0;
+    s->buf_n = 0;
+    s->run_open = false;
+}
+
+bool mfoc_spill_begin_run(MfocSpill* s) {
+    if (s->run_open) mfoc_spill_end_run(s);
+    if (s->num_runs >= MFOC_SPILL_MAX_RUNS) return false;
+
+    s->run_open = true;
+    return true;
+}
+
+bool mfoc_spill_add(MfocSpill* s, const uint64_t* keys, uint32_t n) {
+    if (!s->run_open || s->error) return false;
+
+    s->keys_added += n;
+    while (n > 0) {
+        uint32_t room = s->buf_cap - s->buf_n;
+        uint32_t take = n < room ? n : room;
+
+        memcpy(s->buf + s->buf_n, keys, take * sizeof(uint64_t));
+        s->buf_n += take;
+        keys += take;
+        n -= take;
+
+        if (s->buf_n == s->buf_cap && !spill_flush_run(s)) return false;
+    }
+    return true;
+}
+
+bool mfoc_spill_end_run(MfocSpill* s) {
+    bool ok;
+
+    if (!s->run_open) return false;
+
+    ok = spill_flush_run(s);
+    s->run_open = false;
+    s->num_runs++;
+    return ok;
+}
+
+bool mfoc_spill_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    mfoc_spill_add((MfocSpill*)ctx, keys, n);
+    return true;
+}
+
+typedef struct {
+    mfoc_spill_cb cb;
+    void* ctx;
+} SpillStream;
+
+static bool spill_emit_stream(MfocSpill* s, uint64_t key, uint32_t count, void* ctx) {
+    SpillStream* st = (SpillStream*)ctx;
+    (void)s;
+    return st->cb(key, count, st->ctx);
+}
+
+bool mfoc_spill_merge(MfocSpill* s, mfoc_spill_cb cb, void* ctx) {
+    uint32_t idx[MFOC_SPILL_FANIN], i;
+    SpillStream st = {cb, ctx};
+
+    if (s->run_open) mfoc_spill_end_run(s);
+    if (s->error) return false;
+
+    for (i = 0; i < s->num_segs; i++) idx[i] = i;
+    return spill_merge_segs(s, idx, s->num_segs, spill_emit_stream, &st);
+}
+
+typedef struct {
+    mfoc_countKeys* out;
+    uint32_t n;
+    uint32_t max_out;
+    uint32_t min_count;
+} SpillTop;
+
+static bool spill_top_cb(uint64_t key, uint32_t count, void* ctx) {
+    SpillTop* t = (SpillTop*)ctx;
+
+    if (count >= t->min_count) mfoc_top_push(t->out, &t->n, t->max_out, key, count);
+    return true;
+}
+
+uint32_t mfoc_spill_top(MfocSpill* s, mfoc_countKeys* out, uint32_t max_out, uint32_t min_count) {
+    SpillTop t = {out, 0, max_out, min_count ? min_count : 1};
+
+    if (max_out == 0) return 0;
+    if (!mfoc_spill_merge(s, spill_top_cb, &t)) {
+        SPILL_LOG("[MFOC] Merge dei segmenti su flash fallito\n");
+    }
+
+    mfoc_top_sort(out, t.n);
+    return t.n;
+}
@@ -0,0 +1,105 @@
+/**
+ * MFOC - Insieme di chiavi candidate su LittleFS
+ *
+ * Variante in memoria esterna di MfocCandidates per gli insiemi che non
+ * entrano nell'heap: ogni run viene raccolta in un buffer di RAM, ordinata
+ * e scritta come segmento su LittleFS a blocchi di dimensione fissa. I
+ * segmenti vengono poi uniti in streaming con un merge a k vie, contando
+ * in quante run compare ogni chiave. La RAM usata è limitata dal budget
+ * passato a mfoc_spill_init, indipendentemente dal numero di chiavi.
+ */
+
+#ifndef MFOC_SPILL_H
+#define MFOC_SPILL_H
+
+#include "mfoc_candidates.h"
+#include "mfcuk_arena.h"
+
+// Cartella dei segmenti su LittleFS
+#define MFOC_SPILL_DIR  "/mfoc_spill"
+
+// Chiavi per lettura/scrittura (512 byte)
+#define MFOC_SPILL_CHUNK  64
+
+// Segmenti uniti in una passata, cioè file aperti insieme
+// (LittleFS su ESP32 ne consente 10 di default)
+#define MFOC_SPILL_FANIN  8
+
+// Run massime per insieme
+#define MFOC_SPILL_MAX_RUNS  255
+
+// RAM massima di default (buffer della run + blocchi del merge)
+#ifndef MFOC_SPILL_BUDGET
+#define MFOC_SPILL_BUDGET  (16 * 1024)
+#endif
+
+// Segmento che unisce più run chiuse (i record portano il conteggio)
+#define MFOC_SPILL_MERGED  0xFF
+
+typedef struct {
+    uint16_t id;            // Nome del file
+    uint8_t  run;           // Run di provenienza o MFOC_SPILL_MERGED
+    uint32_t count;         // Record nel segmento
+} MfocSpillSegment;
+
+typedef struct {
+    char dir[24];
+    uint64_t* buf;                  // Chiavi della run aperta
+    uint32_t buf_cap;
+    uint32_t buf_n;
+    uint64_t* io;                   // Blocchi di lettura/scrittura del merge
+    MfocSpillSegment segs[MFOC_SPILL_FANIN];
+    uint32_t num_segs;
+    uint16_t next_id;
+    uint32_t num_runs;              // Run chiuse
+    bool     run_open;
+    // Statistiche
+    uint32_t keys_added;
+    uint32_t bytes_written;         // Scritti su flash, merge compresi
+    uint32_t compactions;
+    bool     error;                 // Errore di I/O: il contenuto non è affidabile
+} MfocSpill;
+
+// Riceve le chiavi in ordine crescente con il numero di run in cui compaiono
+typedef bool (*mfoc_spill_cb)(uint64_t key, uint32_t count, void* ctx);
+
+/**
+ * Prende i buffer dall'arena (budget byte in tutto) e prepara la cartella
+ * @return false se il budget non basta per i blocchi del merge
+ */
+bool mfoc_spill_init(MfocSpill* s, MfcukArena* arena, uint32_t budget, const char* dir);
+
+/**
+ * Elimina i segmenti dalla flash (i buffer restano all'arena)
+ */
+void mfoc_spill_free(MfocSpill* s);
+
+bool mfoc_spill_begin_run(MfocSpill* s);
+
+/**
+ * Aggiunge chiavi alla run aperta; quando il buffer è pieno viene scritto
+ * un segmento
+ * @return false in caso di errore di I/O
+ */
+bool mfoc_spill_add(MfocSpill* s, const uint64_t* keys, uint32_t n);
+
+bool mfoc_spill_end_run(MfocSpill* s);
+
+/**
+ * Sink per crypto1_key_extractor / nested_recover_keys: ctx è MfocSpill*
+ * con una run aperta
+ */
+bool mfoc_spill_sink(const uint64_t* keys, uint32_t n, void* ctx);
+
+/**
+ * Scorre tutte le chiavi in ordine crescente con il loro conteggio
+ * @return false se interrotto dalla callback o per errore di I/O
+ */
+bool mfoc_spill_merge(MfocSpill* s, mfoc_spill_cb cb, void* ctx);
+
+/**
+ * Come mfoc_candidates_top, sul merge in streaming dei segmenti
+ */
+uint32_t mfoc_spill_top(MfocSpill* s, mfoc_countKeys* out, uint32_t max_out, uint32_t min_count);
+
+#endif // MFOC_SPILL_H
@@ -2,6 +2,7 @@
 #include <Adafruit_SSD1306.h>
 #include <LittleFS.h>
 #include "rfid.h"
+#include "rfid_session.h"
 #include "input.h"
 #include "core/config/config.h"
 #include "core/common/common.h"
@@ -476,8 +477,6 @@ void dump() {
   char buffer[64];
   unsigned long rstPressStart = 0;
   bool needRedraw = true;
-  uint8_t uid[7];
-  uint8_t uidLength;
   unsigned long lastScanTime = 0;
 
   if (!LittleFS.begin()) {
@@ -491,10 +490,8 @@ void dump() {
     return;
   }
 
-  // Inizializzazione esplicita del modulo NFC
-  nfc.begin();
-  if (!nfc.getFirmwareVersion()) {
-    Serial.println("PN532 non trovato!");
+  // Inizializzazione del modulo NFC (una sola volta dall'avvio)
+  if (!rfid_reader_init()) {
     display.clearDisplay();
     common::println("ERROR!", 0, 0, 1, SSD1306_WHITE);
     common::println("PN532 non trovato", 0, 12, 1, SSD1306_WHITE);
@@ -502,7 +499,6 @@ void dump() {
     delay(2000);
     return;
   }
-  nfc.SAMConfig();
   
   Serial.println("Avvicina il tag...");
   
@@ -532,18 +528,17 @@ void dump() {
     // Limitare la frequenza di scansione per ridurre il carico CPU
     if (millis() - lastScanTime > 100) {
       lastScanTime = millis();
-      uint8_t uid[7];
-      uint8_t uidLength;
+      CardSession session;
 
-    if (nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength)) {
+    if (rfid_session_open(&session, RFID_SESSION_POLL_MS)) {
       Serial.println("Tag trovato!");
       display.clearDisplay();
       common::println("Tag trovato!", 0, 0, 1, SSD1306_WHITE);
 
       // Costruisci nome file con UUID e gestisci duplicati con tastiera
       char uuid[32] = {0};
-      for (uint8_t i = 0; i < uidLength; i++) {
-        sprintf(uuid + strlen(uuid), "%02X", uid[i]);
+      for (uint8_t i = 0; i < session.uid_len; i++) {
+        sprintf(uuid + strlen(uuid), "%02X", session.uid[i]);
       }
       String baseName = String("dump_") + String(uuid) + ".mfd";
       String suggested = baseName;
@@ -571,16 +566,20 @@ void dump() {
       File file = LittleFS.open(filename.c_str(), "w");
       if (!file) {
         Serial.println("Errore apertura file");
+        rfid_session_close(&session);
         return;
       }
 
+      // Un'autenticazione per settore invece che per blocco; se fallisce la
+      // sessione riseleziona la carta per UID senza ripetere la rilevazione
       for (uint8_t sector = 0; sector < 16; sector++) {
+        uint8_t keyA[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+        bool authOk = rfid_session_auth(&session, sector, 0, keyA) > 0;
         for (uint8_t block = 0; block < 4; block++) {
           uint8_t blockNumber = sector * 4 + block;
           uint8_t data[16];
-          uint8_t keyA[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
-          if (nfc.mifareclassic_AuthenticateBlock(uid, uidLength, blockNumber, 0, keyA)) {
-            if (nfc.mifareclassic_ReadDataBlock(blockNumber, data)) {
+          if (authOk) {
+            if (rfid_session_read(&session, blockNumber, data)) {
               file.write(data, 16);
               String line = "S";
               if (sector < 10) line += "0";
@@ -610,6 +609,8 @@ void dump() {
           }
         }
       }
+      rfid_session_report(&session);
+      rfid_session_close(&session);
       file.close();
       Serial.print("Dump salvato su "); Serial.println(filename);
 
@@ -721,9 +722,8 @@ void rfid_read() {
     unsigned long lastScanTime = 0;
     unsigned long rstPressStart = 0;
     
-    // Inizializzazione esplicita del modulo NFC
-    nfc.begin();
-    if (!nfc.getFirmwareVersion()) {
+    // Inizializzazione del modulo NFC (una sola volta dall'avvio)
+    if (!rfid_reader_init()) {
         display.clearDisplay();
         common::println("ERROR!", 0, 0, 1, SSD1306_WHITE);
         common::println("PN532 non trovato", 0, 12, 1, SSD1306_WHITE);
@@ -731,7 +731,6 @@ void rfid_read() {
         delay(2000);
         return;
     }
-    nfc.SAMConfig();
     while(true) {
         // Controllo per uscita con RST
         if(digitalRead(buttonPin_RST) == LOW) {
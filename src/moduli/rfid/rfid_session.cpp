@@ -0,0 +1,188 @@
+/**
+ * Sessione con una carta MIFARE Classic
+ */
+
+#include <Arduino.h>
+#include "rfid_session.h"
+#include "rfid.h"
+#include "mfcuk_utils.h"
+#include <input.h>
+
+static bool reader_ready = false;
+static uint32_t reader_inits = 0;
+static CardSession* current_session = NULL;
+
+bool rfid_reader_init() {
+    if (reader_ready) return true;
+
+    nfc.begin();
+    if (!nfc.getFirmwareVersion()) {
+        Serial.println("[ERROR] PN532 non trovato!");
+        return false;
+    }
+    nfc.SAMConfig();
+    reader_ready = true;
+    reader_inits++;
+    Serial.println("[INFO] Modulo NFC inizializzato correttamente");
+    return true;
+}
+
+uint32_t rfid_reader_init_count() {
+    return reader_inits;
+}
+
+/**
+ * Numero di settori dal SAK (Mini, 1K, 4K)
+ */
+static uint8_t session_sectors_from_sak(uint8_t sak) {
+    switch (sak) {
+        case 0x09: return 5;
+        case 0x18:
+        case 0x38: return 40;
+        default:   return 16;
+    }
+}
+
+/**
+ * Selezione con anticollisione; in una sessione già aperta la carta deve
+ * essere la stessa
+ */
+static bool session_select(CardSession* s) {
+    uint8_t uid[7];
+    uint8_t uid_len;
+    uint16_t atqa;
+    uint8_t sak;
+
+    if (!nfc.fastListTarget(uid, &uid_len, &atqa, &sak)) return false;
+    if (s->uid_len != 0 && (uid_len != s->uid_len || memcmp(uid, s->uid, uid_len) != 0)) {
+        Serial.println("[RFID] Carta diversa da quella della sessione");
+        return false;
+    }
+
+    memcpy(s->uid, uid, uid_len);
+    s->uid_len = uid_len;
+    s->atqa = atqa;
+    s->sak = sak;
+    s->num_sectors = session_sectors_from_sak(sak);
+    s->auth_sector = -1;
+    s->active = true;
+    s->selects++;
+    return true;
+}
+
+bool rfid_session_open(CardSession* s, uint32_t timeout_ms) {
+    uint32_t start = millis();
+
+    memset(s, 0, sizeof(*s));
+    s->auth_sector = -1;
+    s->reader_inits = reader_inits;
+    if (!rfid_reader_init()) return false;
+    s->reader_inits = reader_inits - s->reader_inits;
+
+    nfc.setPassiveActivationRetries(RFID_SESSION_ACTIVATION_RETRIES);
+    do {
+        if (digitalRead(buttonPin_RST) == LOW) break;
+
+        if (session_select(s)) {
+            s->start_ms = millis();
+            current_session = s;
+            Serial.print("[RFID] Sessione aperta, UID: ");
+            for (uint8_t i = 0; i < s->uid_len; i++) Serial.printf("%02X", s->uid[i]);
+            Serial.printf(" ATQA: %04X SAK: %02X (%u settori)\n", s->atqa, s->sak, s->num_sectors);
+            return true;
+        }
+        delay(RFID_SESSION_POLL_MS);
+    } while (timeout_ms == 0 || millis() - start < timeout_ms);
+
+    nfc.setPassiveActivationRetries(0xFF);
+    return false;
+}
+
+void rfid_session_close(CardSession* s) {
+    if (current_session == s) current_session = NULL;
+    s->active = false;
+    s->auth_sector = -1;
+    nfc.setPassiveActivationRetries(0xFF);
+}
+
+CardSession* rfid_session_current() {
+    return current_session;
+}
+
+bool rfid_session_reselect(CardSession* s) {
+    s->auth_sector = -1;
+    s->reselects++;
+    s->active = nfc.fastReselect(s->uid, s->uid_len);
+    return s->active;
+}
+
+void rfid_session_invalidate(CardSession* s) {
+    s->auth_sector = -1;
+}
+
+int rfid_session_auth(CardSession* s, uint8_t sector, uint8_t key_type, const uint8_t* key) {
+    uint8_t block = get_block_number_by_sector(sector, 3);
+    int8_t result = -1;
+
+    if (!s->active && !rfid_session_reselect(s)) return -1;
+
+    if (s->auth_sector == sector && s->auth_key_type == key_type && memcmp(s->auth_key, key, 6) == 0) {
+        s->auths_cached++;
+        return 1;
+    }
+
+    // Una risposta persa vale un secondo tentativo, una chiave sbagliata no
+    for (uint8_t attempt = 0; attempt < 2 && result < 0; attempt++) {
+        result = nfc.fastAuth(block, key_type, key, rfid_session_uid4(s));
+        s->auths++;
+
+        // Dopo un errore la carta va riselezionata
+        if (result <= 0) {
+            s->auth_failures++;
+            if (!rfid_session_reselect(s)) return -1;
+        }
+    }
+    // Nessuna risposta nemmeno al secondo tentativo: la chiave non è stata provata
+    if (result < 0) return -1;
+    if (result == 0) return 0;
+
+    s->auth_sector = sector;
+    s->auth_key_type = key_type;
+    memcpy(s->auth_key, key, 6);
+    return 1;
+}
+
+bool rfid_session_read(CardSession* s, uint8_t block, uint8_t* data) {
+    if (!s->active || s->auth_sector != get_sector_by_block(block)) return false;
+
+    s->reads++;
+    if (nfc.fastReadBlock(block, data)) return true;
+
+    // Dopo un errore la carta esce dallo stato autenticato
+    rfid_session_reselect(s);
+    return false;
+}
+
+bool rfid_session_write(CardSession* s, uint8_t block, const uint8_t* data) {
+    if (!s->active || s->auth_sector != get_sector_by_block(block)) return false;
+
+    s->writes++;
+    if (nfc.fastWriteBlock(block, data)) return true;
+
+    rfid_session_reselect(s);
+    return false;
+}
+
+uint32_t rfid_session_uid32(const CardSession* s) {
+    const uint8_t* uid = rfid_session_uid4(s);
+    
+    return (uint32_t)uid[0] << 24 | (uint32_t)uid[1] << 16 | (uint32_t)uid[2] << 8 | uid[3];
+}
+
+void rfid_session_report(const CardSession* s) {
+    Serial.printf("[RFID] Sessione: %u selezioni, %u riselezioni, %u autenticazioni (%u evitate, %u fallite), "
+                  "%u letture, %u scritture, %u init lettore, %u ms\n",
+                  (unsigned)s->selects, (unsigned)s->reselects, (unsigned)s->auths, (unsigned)s->auths_cached,
+                  (unsigned)s->auth_failures, (unsigned)s->reads, (unsigned)s->writes, (unsigned)s->reader_inits,
+                  (unsigned)(millis() - s->start_ms));
+}
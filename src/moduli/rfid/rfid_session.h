@@ -0,0 +1,126 @@
+/**
+ * Sessione con una carta MIFARE Classic
+ *
+ * Il lettore viene inizializzato una sola volta (rfid_reader_init) e la carta
+ * selezionata una sola volta all'apertura; da lì in poi autenticazioni,
+ * letture, scritture e riselezioni passano dal percorso rapido di
+ * Extended_PN532 con l'UID già noto. La sessione ricorda il settore
+ * autenticato, così una lettura dello stesso settore con la stessa chiave
+ * non ripete l'autenticazione.
+ *
+ * Tutti i percorsi che lavorano su una carta (MFOC, MFCUK, dump) aprono una
+ * sessione o riusano quella aperta dal chiamante.
+ */
+
+#ifndef _RFID_SESSION_H_
+#define _RFID_SESSION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Tentativi di attivazione del PN532 durante una sessione (0xFF = infiniti):
+// una carta assente deve far fallire subito selezione e riselezione
+#define RFID_SESSION_ACTIVATION_RETRIES  2
+
+// Pausa tra due tentativi di selezione durante l'attesa della carta (ms)
+#define RFID_SESSION_POLL_MS  100
+
+typedef struct CardSession {
+    uint8_t  uid[7];
+    uint8_t  uid_len;
+    uint16_t atqa;              // SENS_RES
+    uint8_t  sak;               // SEL_RES
+    uint8_t  num_sectors;       // Dedotto dal SAK
+    int8_t   auth_sector;       // Settore autenticato, -1 = nessuno
+    uint8_t  auth_key_type;     // 0 = A, 1 = B
+    uint8_t  auth_key[6];
+    bool     active;            // Carta selezionata e raggiungibile
+
+    // Statistiche
+    uint32_t selects;           // Selezioni con anticollisione
+    uint32_t reselects;         // Riselezioni per UID
+    uint32_t auths;             // Autenticazioni inviate
+    uint32_t auths_cached;      // Autenticazioni evitate (settore già autenticato)
+    uint32_t auth_failures;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t reader_inits;      // Inizializzazioni del lettore durante la sessione
+    uint32_t start_ms;
+} CardSession;
+
+/**
+ * Inizializza il PN532 alla prima chiamata; le successive non fanno nulla
+ * @return false se il PN532 non risponde
+ */
+bool rfid_reader_init();
+
+/**
+ * Inizializzazioni del lettore dall'avvio
+ */
+uint32_t rfid_reader_init_count();
+
+/**
+ * Attende una carta e la seleziona (RST interrompe l'attesa)
+ * @param timeout_ms Tempo massimo di attesa (0 = attesa infinita); viene
+ *                   fatto almeno un tentativo
+ * @return false se nessuna carta è stata selezionata
+ */
+bool rfid_session_open(CardSession* s, uint32_t timeout_ms);
+
+/**
+ * Chiude la sessione e ripristina i tentativi di attivazione del PN532
+ */
+void rfid_session_close(CardSession* s);
+
+/**
+ * Sessione aperta in questo momento, NULL se nessuna
+ */
+CardSession* rfid_session_current();
+
+/**
+ * Riseleziona la carta per UID; l'autenticazione corrente viene persa
+ * @return false se la carta non risponde più
+ */
+bool rfid_session_reselect(CardSession* s);
+
+/**
+ * Dimentica il settore autenticato (da chiamare dopo comandi inviati alla
+ * carta fuori dalla sessione)
+ */
+void rfid_session_invalidate(CardSession* s);
+
+/**
+ * Autentica un settore; non invia nulla se il settore è già autenticato con
+ * la stessa chiave. Dopo un fallimento la carta viene riselezionata.
+ * @return 1 chiave corretta, 0 chiave sbagliata (rifiutata dalla carta),
+ *         -1 carta persa o nessuna risposta dopo i tentativi
+ */
+int rfid_session_auth(CardSession* s, uint8_t sector, uint8_t key_type, const uint8_t* key);
+
+/**
+ * Legge/scrive un blocco del settore autenticato
+ * @return false se il settore del blocco non è autenticato o per errore
+ */
+bool rfid_session_read(CardSession* s, uint8_t block, uint8_t* data);
+bool rfid_session_write(CardSession* s, uint8_t block, const uint8_t* data);
+
+/**
+ * UID numerico come in MfocCard::uid: i 4 byte dell'autenticazione
+ * (rfid_session_uid4, gli ultimi per UID da 7 byte), big-endian, come
+ * NonceAcq::uid32
+ */
+uint32_t rfid_session_uid32(const CardSession* s);
+
+/**
+ * I 4 byte di UID usati dall'autenticazione (gli ultimi per UID da 7 byte)
+ */
+static inline const uint8_t* rfid_session_uid4(const CardSession* s) {
+    return s->uid + s->uid_len - 4;
+}
+
+/**
+ * Stampa su seriale selezioni, autenticazioni e tempo della sessione
+ */
+void rfid_session_report(const CardSession* s);
+
+#endif // _RFID_SESSION_H_
@@ -3,6 +3,7 @@
  */
 
 #include "rfid.h"
+#include "rfid_session.h"
 #include <Arduino.h>
 #include <input.h>
 
@@ -17,17 +18,15 @@ bool rfid_get_uid(uint32_t* uid) {
         return false;
     }
     
-    // Verifica che NFC sia inizializzato correttamente
-    static bool nfc_initialized = false;
-    if (!nfc_initialized) {
-        nfc.begin();
-        if (!nfc.getFirmwareVersion()) {
-            Serial.println("[ERROR] PN532 non trovato in rfid_get_uid!");
-            return false;
-        }
-        nfc.SAMConfig();
-        nfc_initialized = true;
-        Serial.println("[INFO] Modulo NFC inizializzato in rfid_get_uid");
+    // Con una sessione aperta la carta è già selezionata
+    CardSession* session = rfid_session_current();
+    if (session != nullptr && session->active) {
+        *uid = rfid_session_uid32(session);
+        return true;
+    }
+    
+    if (!rfid_reader_init()) {
+        return false;
     }
     
     uint8_t uid_bytes[7];
@@ -55,14 +54,14 @@ bool rfid_get_uid(uint32_t* uid) {
                ((uint32_t)uid_bytes[2] << 8) | 
                (uint32_t)uid_bytes[3];
     } 
-    // Per carte con UID a 7 byte, prendiamo solo i primi 4
+    // Per carte con UID a 7 byte, gli ultimi 4 (quelli dell'autenticazione Crypto1)
     else if (uid_length == 7) {
-        *uid = ((uint32_t)uid_bytes[0] << 24) | 
-               ((uint32_t)uid_bytes[1] << 16) | 
-               ((uint32_t)uid_bytes[2] << 8) | 
-               (uint32_t)uid_bytes[3];
+        *uid = ((uint32_t)uid_bytes[3] << 24) | 
+               ((uint32_t)uid_bytes[4] << 16) | 
+               ((uint32_t)uid_bytes[5] << 8) | 
+               (uint32_t)uid_bytes[6];
         
-        Serial.println("[RFID] Avviso: UID a 7 byte, utilizzati solo i primi 4 byte");
+        Serial.println("[RFID] Avviso: UID a 7 byte, utilizzati gli ultimi 4 byte");
     }
     // Per altri formati di UID non supportati
     else {
@@ -84,17 +83,8 @@ bool rfid_wait_for_tag(uint32_t timeout_ms) {
     bool found = false;
     uint32_t startTime = millis();
     
-    // Verifica che NFC sia inizializzato correttamente
-    static bool nfc_initialized = false;
-    if (!nfc_initialized) {
-        nfc.begin();
-        if (!nfc.getFirmwareVersion()) {
-            Serial.println("[ERROR] PN532 non trovato in rfid_wait_for_tag!");
-            return false;
-        }
-        nfc.SAMConfig();
-        nfc_initialized = true;
-        Serial.println("[INFO] Modulo NFC inizializzato in rfid_wait_for_tag");
+    if (!rfid_reader_init()) {
+        return false;
     }
     
     Serial.print("[RFID] Attesa carta (timeout: ");
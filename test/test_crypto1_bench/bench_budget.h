@@ -0,0 +1,45 @@
+/**
+ * Benchmark Crypto1 - budget delle primitive
+ *
+ * Limiti espressi come multipli del ciclo di riferimento (xorshift32) di
+ * test_main.cpp, quindi indipendenti dalla frequenza della macchina. I
+ * valori base sono i rapporti misurati su host x86-64 (-O2, tabelle PRNG
+ * generate) arrotondati per eccesso; BENCH_BUDGET_SCALE lascia margine per
+ * il rumore della misura e per le differenze di architettura (su Xtensa le
+ * operazioni a 64 bit e le letture da flash pesano di più).
+ *
+ * Dopo un'ottimizzazione voluta aggiornare qui il valore base; compilare
+ * con -DBENCH_NO_BUDGET per le sole misure.
+ */
+
+#ifndef _BENCH_BUDGET_H_
+#define _BENCH_BUDGET_H_
+
+#ifndef BENCH_BUDGET_SCALE
+#ifdef ARDUINO
+#define BENCH_BUDGET_SCALE  8
+#else
+#define BENCH_BUDGET_SCALE  3
+#endif
+#endif
+
+// Primitive Crypto1 (per chiamata)
+#define BENCH_BUDGET_INIT               32
+#define BENCH_BUDGET_BIT                8
+#define BENCH_BUDGET_BYTE               64
+#define BENCH_BUDGET_BYTE_FAST          16
+#define BENCH_BUDGET_WORD               200
+#define BENCH_BUDGET_WORD_FAST          64
+#define BENCH_BUDGET_FILTER             4
+#define BENCH_BUDGET_FILTER_FAST        3
+#define BENCH_BUDGET_ROLLBACK_WORD      200
+
+// PRNG dei nonce (percorso a tabella)
+#define BENCH_BUDGET_PRNG_SUCCESSOR     10
+#define BENCH_BUDGET_NONCE_DISTANCE     5
+
+// Verifica bitsliced (per chiave) e recupero di stato (per candidato)
+#define BENCH_BUDGET_BS_KEY             16
+#define BENCH_BUDGET_RECOVERY_CANDIDATE 5000
+
+#endif // _BENCH_BUDGET_H_
@@ -0,0 +1,451 @@
+/**
+ * Benchmark Crypto1 - microbenchmark delle primitive del cracker
+ *
+ * Misura ns/op e bit di keystream al secondo delle primitive Crypto1 e del
+ * PRNG, i candidati/secondo del recupero di stato e i picchi di memoria.
+ * Ogni misura viene stampata come riga "BENCH {json}" per il confronto
+ * automatico tra build; un test fallisce se una primitiva supera il budget
+ * di bench_budget.h, così una regressione nel percorso critico fa fallire
+ * la run.
+ *
+ * Host:  pio test -e native
+ * ESP32: pio test -e esp32dev_bench
+ */
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "mfcuk_crypto.h"
+#include "mfcuk_crypto_bs.h"
+#include "mfcuk_crypto_prng.h"
+#include "mfcuk_crypto_recovery.h"
+#include "mfcuk_crypto_seeds.h"
+
+#include "bench_budget.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+// Ripetizioni per misura (su ESP32 circa 16 volte meno)
+#ifdef ARDUINO
+#define BENCH_SCALE  16
+#else
+#define BENCH_SCALE  1
+#endif
+
+#define BENCH_OPS(n)  ((uint32_t)((n) / BENCH_SCALE))
+
+// Traccia reale con chiave FFFFFFFFFFFF (come test_crypto1_recovery)
+static const uint32_t bench_uid = 0x9c599b32, bench_nt = 0x82a4166c;
+static const uint64_t bench_key = 0xFFFFFFFFFFFFULL;
+
+// Evita che il compilatore elimini i cicli misurati
+static volatile uint32_t bench_sink;
+
+// ns per iterazione del ciclo di riferimento
+static double bench_ref_ns = 0;
+
+/**
+ * Tempo in nanosecondi
+ */
+static uint64_t bench_now_ns() {
+#ifdef ARDUINO
+    return (uint64_t)esp_timer_get_time() * 1000ULL;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * Stampa la misura e la confronta con il budget (multipli del ciclo di riferimento)
+ * @param bits_per_op bit di keystream prodotti per operazione (0 se non applicabile)
+ */
+static void bench_report(const char* name, uint32_t ops, uint64_t elapsed_ns, uint32_t bits_per_op, double budget) {
+    double ns_op = ops ? (double)elapsed_ns / ops : 0;
+    double ratio = bench_ref_ns > 0 ? ns_op / bench_ref_ns : 0;
+    double bits_s = (bits_per_op && elapsed_ns) ? (double)ops * bits_per_op * 1e9 / elapsed_ns : 0;
+    double limit = budget * BENCH_BUDGET_SCALE;
+    char msg[96];
+
+    printf("BENCH {\"name\":\"%s\",\"ops\":%u,\"ns_op\":%.2f,\"bits_s\":%.0f,\"ref_ratio\":%.2f,\"budget\":%.2f}\n",
+           name, (unsigned)ops, ns_op, bits_s, ratio, limit);
+
+#ifndef BENCH_NO_BUDGET
+    snprintf(msg, sizeof(msg), "%s: %.2f x riferimento, budget %.2f", name, ratio, limit);
+    TEST_ASSERT_TRUE_MESSAGE(ratio <= limit, msg);
+#else
+    (void)msg;
+    (void)limit;
+#endif
+}
+
+/**
+ * Ciclo di riferimento (xorshift32 dipendente): rende i budget
+ * indipendenti dalla velocità della macchina
+ */
+static void bench_calibrate() {
+    const uint32_t ops = BENCH_OPS(20000000);
+    uint32_t x = 0x12345678, i;
+    uint64_t t0 = bench_now_ns();
+
+    for (i = 0; i < ops; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+    }
+    bench_sink = x;
+    bench_ref_ns = (double)(bench_now_ns() - t0) / ops;
+
+    printf("BENCH {\"name\":\"reference\",\"ops\":%u,\"ns_op\":%.3f}\n", (unsigned)ops, bench_ref_ns);
+}
+
+// ----- Primitive Crypto1 -----
+
+void test_crypto1_init() {
+    const uint32_t ops = BENCH_OPS(2000000);
+    Crypto1State s;
+    uint32_t acc = 0, i;
+    uint64_t t0 = bench_now_ns();
+
+    for (i = 0; i < ops; i++) {
+        crypto1_init(&s, bench_key ^ i);
+        acc ^= s.odd ^ s.even;
+    }
+    bench_sink = acc;
+    bench_report("crypto1_init", ops, bench_now_ns() - t0, 0, BENCH_BUDGET_INIT);
+}
+
+void test_crypto1_bit() {
+    const uint32_t ops = BENCH_OPS(20000000);
+    Crypto1State s;
+    uint32_t acc = 0, i;
+    uint64_t t0;
+
+    crypto1_init(&s, bench_key);
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_bit(&s, (uint8_t)i, 0);
+    }
+    bench_sink = acc;
+    bench_report("crypto1_bit", ops, bench_now_ns() - t0, 1, BENCH_BUDGET_BIT);
+}
+
+void test_crypto1_byte() {
+    const uint32_t ops = BENCH_OPS(4000000);
+    Crypto1State s;
+    uint8_t in = 0, out = 0;
+    uint32_t acc = 0, i;
+    uint64_t t0;
+
+    crypto1_init(&s, bench_key);
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        in = (uint8_t)i;
+        crypto1_byte(&s, &in, &out, 0);
+        acc ^= out;
+    }
+    bench_sink = acc;
+    bench_report("crypto1_byte", ops, bench_now_ns() - t0, 8, BENCH_BUDGET_BYTE);
+}
+
+void test_crypto1_byte_fast() {
+    const uint32_t ops = BENCH_OPS(4000000);
+    Crypto1State s;
+    uint32_t acc = 0, i;
+    uint64_t t0;
+
+    crypto1_tables_init();
+    crypto1_init(&s, bench_key);
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_byte_fast(&s, (uint8_t)i, 0);
+    }
+    bench_sink = acc;
+    bench_report("crypto1_byte_fast", ops, bench_now_ns() - t0, 8, BENCH_BUDGET_BYTE_FAST);
+}
+
+void test_crypto1_word() {
+    const uint32_t ops = BENCH_OPS(1000000);
+    Crypto1State s;
+    uint32_t acc = 0, i;
+    uint64_t t0;
+
+    crypto1_init(&s, bench_key);
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_word(&s, i, 0);
+    }
+    bench_sink = acc;
+    bench_report("crypto1_word", ops, bench_now_ns() - t0, 32, BENCH_BUDGET_WORD);
+}
+
+void test_crypto1_word_fast() {
+    const uint32_t ops = BENCH_OPS(1000000);
+    Crypto1State s;
+    uint32_t acc = 0, i;
+    uint64_t t0;
+
+    crypto1_tables_init();
+    crypto1_init(&s, bench_key);
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_word_fast(&s, i, 0);
+    }
+    bench_sink = acc;
+    bench_report("crypto1_word_fast", ops, bench_now_ns() - t0, 32, BENCH_BUDGET_WORD_FAST);
+}
+
+void test_crypto1_filter() {
+    const uint32_t ops = BENCH_OPS(20000000);
+    uint32_t acc = 0, x = 0x9c599b32, i;
+    uint64_t t0 = bench_now_ns();
+
+    // L'ingresso dipende dall'uscita precedente: misura la latenza
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_filter(x);
+        x = x * 1664525 + 1013904223 + acc;
+    }
+    bench_sink = acc;
+    bench_report("crypto1_filter", ops, bench_now_ns() - t0, 1, BENCH_BUDGET_FILTER);
+}
+
+void test_crypto1_filter_fast() {
+    const uint32_t ops = BENCH_OPS(20000000);
+    uint32_t acc = 0, x = 0x9c599b32, i;
+    uint64_t t0;
+
+    crypto1_tables_init();
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_filter_fast(x);
+        x = x * 1664525 + 1013904223 + acc;
+    }
+    bench_sink = acc;
+    bench_report("crypto1_filter_fast", ops, bench_now_ns() - t0, 1, BENCH_BUDGET_FILTER_FAST);
+}
+
+void test_crypto1_rollback_word() {
+    const uint32_t ops = BENCH_OPS(1000000);
+    Crypto1State s;
+    uint32_t acc = 0, i;
+    uint64_t t0;
+
+    crypto1_init(&s, bench_key);
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc ^= crypto1_rollback_word(&s, i, 0);
+    }
+    bench_sink = acc;
+    bench_report("crypto1_rollback_word", ops, bench_now_ns() - t0, 32, BENCH_BUDGET_ROLLBACK_WORD);
+}
+
+// ----- PRNG dei nonce -----
+
+void test_prng_successor() {
+    const uint32_t ops = BENCH_OPS(4000000);
+    uint32_t nt = PRNG_REFERENCE_NONCE, i;
+    uint64_t t0 = bench_now_ns();
+
+    // Catena dipendente di salti lunghi (tabella) o passi iterativi (senza tabella)
+    for (i = 0; i < ops; i++) {
+        nt = prng_successor(nt, 160 + (i & 0x3ff));
+    }
+    bench_sink = nt;
+    bench_report("prng_successor", ops, bench_now_ns() - t0, 0, BENCH_BUDGET_PRNG_SUCCESSOR);
+}
+
+void test_nonce_distance() {
+    const uint32_t ops = BENCH_OPS(4000000);
+    uint32_t chain[256], acc = 0, i;
+    uint64_t t0;
+
+    // Nonce consecutivi a distanze diverse, preparati fuori dalla misura
+    chain[0] = PRNG_REFERENCE_NONCE;
+    for (i = 1; i < 256; i++) chain[i] = prng_successor_slow(chain[i - 1], 160 + i * 37);
+
+    t0 = bench_now_ns();
+    for (i = 0; i < ops; i++) {
+        acc += nonce_distance(chain[i & 0xff], chain[(i + 1) & 0xff]);
+    }
+    bench_sink = acc;
+    bench_report("nonce_distance", ops, bench_now_ns() - t0, 0, BENCH_BUDGET_NONCE_DISTANCE);
+}
+
+// ----- Verifica e recupero -----
+
+void test_crypto1_bs_test_batch() {
+    const uint32_t batches = BENCH_OPS(200000) / CRYPTO1_BS_LANES;
+    uint64_t keys[CRYPTO1_BS_LANES];
+    Crypto1Auth auth;
+    Crypto1State s;
+    crypto1_bs_t acc = 0;
+    uint32_t b, i;
+    uint64_t t0;
+
+    // Autenticazione simulata con una chiave fuori dal lotto
+    crypto1_init(&s, bench_key);
+    auth.uid = bench_uid;
+    auth.nt = bench_nt;
+    crypto1_word(&s, bench_uid ^ bench_nt, 0);
+    auth.nr_enc = 0x12345678 ^ crypto1_word(&s, 0x12345678, 0);
+    auth.ar_enc = prng_successor(bench_nt, 64) ^ crypto1_word(&s, 0, 0);
+
+    t0 = bench_now_ns();
+    for (b = 0; b < batches; b++) {
+        for (i = 0; i < CRYPTO1_BS_LANES; i++) keys[i] = ((uint64_t)b << 16) | i;
+        acc |= crypto1_bs_test_batch(&auth, keys, CRYPTO1_BS_LANES);
+    }
+    bench_sink = (uint32_t)acc;
+    // Un'operazione = una chiave verificata
+    bench_report("crypto1_bs_key", batches * CRYPTO1_BS_LANES, bench_now_ns() - t0, 0, BENCH_BUDGET_BS_KEY);
+}
+
+static bool bench_count_state(const Crypto1State* state, void* ctx) {
+    (void)state;
+    (*(uint32_t*)ctx)++;
+    return true;
+}
+
+void test_lfsr_recovery32() {
+    Crypto1RecoveryStats stats;
+    Crypto1State s;
+    uint32_t ks, count = 0;
+    uint64_t t0, elapsed;
+
+    crypto1_init(&s, bench_key);
+    ks = crypto1_word(&s, bench_uid ^ bench_nt, 0);
+
+    t0 = bench_now_ns();
+    TEST_ASSERT_TRUE(lfsr_recovery32(ks, bench_uid ^ bench_nt, bench_count_state, &count, &stats));
+    elapsed = bench_now_ns() - t0;
+    TEST_ASSERT_TRUE(stats.complete);
+
+    printf("BENCH {\"name\":\"lfsr_recovery32\",\"candidates\":%u,\"candidates_s\":%.0f,\"passes\":%u,"
+           "\"peak_bytes\":%u}\n",
+           (unsigned)count, elapsed ? (double)count * 1e9 / elapsed : 0, (unsigned)stats.passes,
+           (unsigned)stats.peak_bytes);
+
+    TEST_ASSERT_TRUE(stats.peak_bytes <= CRYPTO1_RECOVERY_HEAP);
+    // Un'operazione = un candidato prodotto
+    bench_report("lfsr_recovery32_candidate", count, elapsed, 0, BENCH_BUDGET_RECOVERY_CANDIDATE);
+}
+
+// Stati candidati di un recupero: numero e impronta indipendente dall'ordine
+typedef struct {
+    uint32_t count;
+    uint64_t sum;
+    uint64_t xor_mix;
+} BenchStateSet;
+
+static bool bench_collect_state(const Crypto1State* state, void* ctx) {
+    BenchStateSet* set = (BenchStateSet*)ctx;
+    uint64_t v = ((uint64_t)state->odd << 32 | state->even) * 0x9E3779B97F4A7C15ULL;
+
+    set->count++;
+    set->sum += v;
+    set->xor_mix ^= v ^ (v >> 29);
+    return true;
+}
+
+/**
+ * Recupero a più passate (budget dell'ESP32) con e senza i semi in flash:
+ * devono uscire gli stessi stati; il rapporto dei tempi è solo stampato
+ * (dipende dal carico della macchina)
+ * Su host richiede CRYPTO1_SEEDS=<immagine di scripts/gen_crypto1_seeds.py>
+ */
+void test_lfsr_recovery32_seeds() {
+    Crypto1RecoveryStats stats;
+    Crypto1State s;
+    BenchStateSet plain = {0, 0, 0}, seeded = {0, 0, 0};
+    uint32_t ks;
+    uint64_t t0, t_plain, t_seeded;
+
+    if (crypto1_seeds_class(0, 0) == NULL) {
+        TEST_IGNORE_MESSAGE("semi delle metà dello stato non disponibili");
+    }
+
+    crypto1_init(&s, bench_key);
+    ks = crypto1_word(&s, bench_uid ^ bench_nt, 0);
+    lfsr_recovery_set_budget(96 * 1024);
+
+    crypto1_seeds_enable(false);
+    t0 = bench_now_ns();
+    TEST_ASSERT_TRUE(lfsr_recovery32(ks, bench_uid ^ bench_nt, bench_collect_state, &plain, &stats));
+    t_plain = bench_now_ns() - t0;
+
+    crypto1_seeds_enable(true);
+    t0 = bench_now_ns();
+    TEST_ASSERT_TRUE(lfsr_recovery32(ks, bench_uid ^ bench_nt, bench_collect_state, &seeded, &stats));
+    t_seeded = bench_now_ns() - t0;
+    lfsr_recovery_set_budget(0);
+
+    printf("BENCH {\"name\":\"lfsr_recovery32_seeds\",\"passes\":%u,\"ms_plain\":%.0f,\"ms_seeds\":%.0f,"
+           "\"speedup\":%.2f}\n",
+           (unsigned)stats.passes, t_plain / 1e6, t_seeded / 1e6, t_seeded ? (double)t_plain / t_seeded : 0);
+    TEST_ASSERT_EQUAL_UINT32(plain.count, seeded.count);
+    TEST_ASSERT_TRUE(plain.sum == seeded.sum);
+    TEST_ASSERT_TRUE(plain.xor_mix == seeded.xor_mix);
+}
+
+// ----- Memoria -----
+
+void test_memory_high_water() {
+#ifdef ARDUINO
+    printf("BENCH {\"name\":\"memory\",\"heap_free\":%u,\"heap_min_free\":%u,\"heap_max_alloc\":%u,"
+           "\"stack_free\":%u}\n",
+           (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMinFreeHeap(), (unsigned)ESP.getMaxAllocHeap(),
+           (unsigned)uxTaskGetStackHighWaterMark(NULL));
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("BENCH {\"name\":\"memory\",\"max_rss_kb\":%ld}\n", (long)ru.ru_maxrss);
+#endif
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int bench_run() {
+    UNITY_BEGIN();
+    bench_calibrate();
+    RUN_TEST(test_crypto1_init);
+    RUN_TEST(test_crypto1_bit);
+    RUN_TEST(test_crypto1_byte);
+    RUN_TEST(test_crypto1_byte_fast);
+    RUN_TEST(test_crypto1_word);
+    RUN_TEST(test_crypto1_word_fast);
+    RUN_TEST(test_crypto1_filter);
+    RUN_TEST(test_crypto1_filter_fast);
+    RUN_TEST(test_crypto1_rollback_word);
+    RUN_TEST(test_prng_successor);
+    RUN_TEST(test_nonce_distance);
+    RUN_TEST(test_crypto1_bs_test_batch);
+    RUN_TEST(test_lfsr_recovery32);
+    RUN_TEST(test_lfsr_recovery32_seeds);
+    RUN_TEST(test_memory_high_water);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    bench_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return bench_run();
+}
+#endif
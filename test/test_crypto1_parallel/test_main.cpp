@@ -0,0 +1,160 @@
+/**
+ * Verifica parallela delle chiavi candidate
+ *
+ * Il work-stealing su tutti i worker deve trovare le stesse chiavi della
+ * verifica bitsliced su un solo blocco, sia contro una traccia completa sia
+ * contro le parità di {nt} nested; l'annullamento dal task chiamante ferma
+ * tutti i worker.
+ *
+ * Host:  pio test -e native -f test_crypto1_parallel
+ */
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "mfcuk_crypto_parallel.h"
+#include "mfcuk_nonce.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Chiavi verificate: più blocchi per worker, con un resto non multiplo delle lane
+#define PAR_TEST_KEYS  (16 * CRYPTO1_PAR_CHUNK + 37)
+
+// Traccia reale con chiave FFFFFFFFFFFF (come crypto1_bs_benchmark)
+static const Crypto1Auth par_auth = {0x9c599b32, 0x82a4166c, 0xa1e458ce, 0x6eea41e0};
+static const uint64_t par_key = 0xFFFFFFFFFFFFULL;
+
+static uint64_t par_keys[PAR_TEST_KEYS];
+static uint64_t par_matches[PAR_TEST_KEYS];
+
+static uint64_t par_lcg(uint64_t* x) {
+    *x = *x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *x >> 16;
+}
+
+/**
+ * Chiavi pseudo-casuali con la chiave vera in mezzo
+ */
+static void par_fill_keys(uint64_t key) {
+    uint64_t x = 0x5EED;
+
+    for (uint32_t i = 0; i < PAR_TEST_KEYS; i++) par_keys[i] = par_lcg(&x) & 0xFFFFFFFFFFFFULL;
+    par_keys[PAR_TEST_KEYS / 2] = key;
+}
+
+static bool par_cancel_now(void* ctx) {
+    (void)ctx;
+    return false;
+}
+
+static bool par_empty_chunk(void* ctx, uint64_t begin, uint64_t end, int worker) {
+    (void)ctx;
+    (void)begin;
+    (void)end;
+    (void)worker;
+    return true;
+}
+
+void test_parallel_test_keys() {
+    Crypto1ParallelStats stats;
+    size_t found;
+
+    par_fill_keys(par_key);
+    found = crypto1_parallel_test_keys(&par_auth, par_keys, PAR_TEST_KEYS, par_matches, PAR_TEST_KEYS, false, NULL,
+                                       NULL, &stats);
+
+    printf("[CRYPTO] Parallelo: %u chiavi in %u blocchi su %d worker, %u furti\n", (unsigned)stats.processed,
+           (unsigned)stats.chunks, stats.workers, (unsigned)stats.steals);
+    TEST_ASSERT_EQUAL_UINT32(1, found);
+    TEST_ASSERT_TRUE(par_matches[0] == par_key);
+    TEST_ASSERT_TRUE(stats.processed == PAR_TEST_KEYS);
+    TEST_ASSERT_FALSE(stats.cancelled);
+}
+
+/**
+ * Parità di tre {nt} nested: passano la chiave vera e poche sbagliate (ogni
+ * nonce ne lascia passare circa 1/8), le stesse trovate blocco per blocco
+ */
+void test_parallel_test_nonces() {
+    const uint32_t uid = 0x9c599b32;
+    Crypto1EncNonce nonces[3];
+    Crypto1ParallelStats stats;
+    uint64_t x = 7;
+    uint32_t expected = 0;
+    size_t found;
+    bool key_found = false;
+
+    for (uint8_t n = 0; n < 3; n++) {
+        uint32_t nt_enc = (uint32_t)par_lcg(&x);
+        uint32_t nt = nonce_decrypt_nt(par_key, uid, nt_enc);
+        uint32_t ks = nt ^ nt_enc;
+
+        nonces[n].uid = uid;
+        nonces[n].nt_enc = nt_enc;
+        nonces[n].par = 0;
+        for (uint8_t i = 0; i < 3; i++) {
+            uint8_t plain = nt >> (24 - 8 * i);
+
+            nonces[n].par |= (crypto1_parity(plain) ^ 1 ^ ((ks >> (16 - 8 * i)) & 1)) << i;
+        }
+    }
+
+    par_fill_keys(par_key);
+    for (uint32_t i = 0; i < PAR_TEST_KEYS; i += CRYPTO1_BS_LANES) {
+        int count = PAR_TEST_KEYS - i < (uint32_t)CRYPTO1_BS_LANES ? PAR_TEST_KEYS - i : CRYPTO1_BS_LANES;
+        crypto1_bs_t mask = crypto1_bs_test_nonce_batch(nonces, 3, par_keys + i, count);
+
+        for (; mask; mask >>= 1) expected += (uint32_t)(mask & 1);
+    }
+
+    found = crypto1_parallel_test_nonces(nonces, 3, par_keys, PAR_TEST_KEYS, par_matches, PAR_TEST_KEYS, false, NULL,
+                                         NULL, &stats);
+    for (size_t i = 0; i < found; i++) key_found |= par_matches[i] == par_key;
+
+    printf("[CRYPTO] Parallelo sulle parità: %u chiavi compatibili su %u\n", (unsigned)found, PAR_TEST_KEYS);
+    TEST_ASSERT_EQUAL_UINT32(expected, found);
+    TEST_ASSERT_TRUE(key_found);
+    TEST_ASSERT_LESS_THAN_UINT32(PAR_TEST_KEYS / 128, found);
+}
+
+/**
+ * Spazio che non finirebbe mai: solo l'annullamento lo ferma
+ */
+void test_parallel_cancel() {
+    const uint64_t total = 1ULL << 48;
+    Crypto1ParallelStats stats;
+
+    TEST_ASSERT_FALSE(crypto1_parallel_run(total, 0, 0, par_empty_chunk, NULL, par_cancel_now, NULL, &stats));
+    TEST_ASSERT_TRUE(stats.cancelled);
+    TEST_ASSERT_TRUE(stats.processed < total);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int parallel_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parallel_test_keys);
+    RUN_TEST(test_parallel_test_nonces);
+    RUN_TEST(test_parallel_cancel);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    parallel_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return parallel_run();
+}
+#endif
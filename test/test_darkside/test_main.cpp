@@ -0,0 +1,104 @@
+/**
+ * Solver Darkside
+ *
+ * Round simulati con nt diversi finché resta un solo candidato, che deve
+ * coincidere con la chiave della carta simulata.
+ *
+ * Host:  pio test -e native -f test_darkside
+ */
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "mfcuk_crypto_darkside.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Round massimi prima di dichiarare il solver bloccato
+#define DS_TEST_ROUNDS  8
+
+static const uint32_t ds_uid = 0x9c599b32;
+
+/**
+ * Aggiunge round simulati della carta con la chiave data fino a un solo
+ * candidato, che deve essere la chiave
+ */
+static void ds_test_key(uint64_t key, uint32_t nt) {
+    uint32_t nr_enc = 0x12345600 ^ (uint32_t)(key >> 8);
+    DarksideSolver ds;
+    DarksideRun run;
+    int round;
+
+    TEST_ASSERT_TRUE(darkside_solver_init(&ds));
+    for (round = 0; round < DS_TEST_ROUNDS && ds.count != 1; round++) {
+        darkside_simulate_run(key, ds_uid, prng_successor(nt, round * 160), nr_enc + round * 0x100, 0x00000000,
+                              &run);
+        darkside_solver_add_run(&ds, ds_uid, &run);
+    }
+
+    printf("[CRYPTO] Darkside chiave %012llX: %u candidati dopo %d round (%u scartati)\n", (unsigned long long)key,
+           (unsigned)ds.count, round, (unsigned)ds.discarded);
+    TEST_ASSERT_EQUAL_UINT32(1, ds.count);
+    TEST_ASSERT_TRUE(ds.keys[0] == key);
+    darkside_solver_free(&ds);
+}
+
+void test_darkside_key_ffff() {
+    ds_test_key(0xFFFFFFFFFFFFULL, 0x01200145);
+}
+
+void test_darkside_key_a0a1() {
+    ds_test_key(0xA0A1A2A3A4A5ULL, 0x01201256);
+}
+
+void test_darkside_key_4d3a() {
+    ds_test_key(0x4D3A99C351DDULL, 0x01202367);
+}
+
+/**
+ * Più round insieme: darkside_crack deve arrivare alla stessa chiave
+ */
+void test_darkside_crack() {
+    const uint64_t key = 0x4D3A99C351DDULL;
+    const uint32_t nt = 0x01202367;
+    DarksideRun runs[DS_TEST_ROUNDS];
+    uint64_t found = 0;
+
+    for (int i = 0; i < DS_TEST_ROUNDS; i++) {
+        darkside_simulate_run(key, ds_uid, prng_successor(nt, i * 160), (0x12345600 ^ (uint32_t)(key >> 8)) + i * 0x100,
+                              0x00000000, &runs[i]);
+    }
+    TEST_ASSERT_TRUE(darkside_crack(ds_uid, runs, DS_TEST_ROUNDS, &found));
+    TEST_ASSERT_TRUE(found == key);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int darkside_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_darkside_key_ffff);
+    RUN_TEST(test_darkside_key_a0a1);
+    RUN_TEST(test_darkside_key_4d3a);
+    RUN_TEST(test_darkside_crack);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    darkside_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return darkside_run();
+}
+#endif
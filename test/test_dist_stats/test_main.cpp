@@ -0,0 +1,112 @@
+/**
+ * Statistiche in linea delle distanze tra nonce
+ *
+ * Mediana e MAD dell'istogramma contro quelli calcolati ordinando le
+ * distanze, scarto delle anomalie tra le prime distanze, arresto anticipato
+ * con poco jitter e nessun arresto con jitter ampio.
+ *
+ * Host:  pio test -e native -f test_dist_stats
+ */
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "mfcuk_dist_stats.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static uint32_t stats_lcg(uint32_t* x) {
+    *x = *x * 1103515245u + 12345u;
+    return *x >> 16;
+}
+
+static inline uint32_t stats_absdiff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+void test_median_mad_exact() {
+    enum { N = 200 };
+    uint32_t v[N], x = 1, m, r, n;
+    DistStats s;
+    int i, j;
+
+    dist_stats_init(&s, 64);
+    for (i = 0; i < N; i++) {
+        v[i] = 300 + stats_lcg(&x) % 41;
+        dist_stats_add(&s, v[i]);
+    }
+    for (i = 1; i < N; i++) {
+        for (m = v[i], j = i; j > 0 && v[j - 1] > m; j--) v[j] = v[j - 1];
+        v[j] = m;
+    }
+    m = v[(N - 1) / 2];
+
+    // MAD: raggio minimo che contiene metà delle distanze
+    for (r = 0;; r++) {
+        for (n = 0, i = 0; i < N; i++) n += stats_absdiff(v[i], m) <= r;
+        if (n >= (N + 1) / 2) break;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(N, s.count);
+    TEST_ASSERT_EQUAL_UINT32(0, s.outliers);
+    TEST_ASSERT_EQUAL_UINT32(m, dist_stats_median(&s));
+    TEST_ASSERT_EQUAL_UINT32(r, s.mad);
+}
+
+void test_outliers_and_early_stop() {
+    static const uint32_t jitter[] = {320, 322, 318, 900, 320, 321, 12, 319, 320, 323, 320, 319, 321, 320};
+    const uint8_t total = sizeof(jitter) / sizeof(jitter[0]);
+    DistStats s;
+    uint8_t used = 0;
+
+    // Jitter di pochi passi con due anomalie tra le prime distanze
+    dist_stats_init(&s, 20);
+    while (used < total && !dist_stats_done(&s, 8)) dist_stats_add(&s, jitter[used++]);
+
+    printf("[MFCUK] Statistiche distanze: arresto dopo %u distanze, tolleranza %u\n", used, (unsigned)s.tolerance);
+    TEST_ASSERT_EQUAL_UINT32(320, dist_stats_median(&s));
+    TEST_ASSERT_EQUAL_UINT32(2, s.outliers);
+    TEST_ASSERT_LESS_THAN_UINT32(20, s.tolerance);
+    TEST_ASSERT_TRUE(dist_stats_done(&s, 8));
+    TEST_ASSERT_LESS_THAN(total, used);
+}
+
+void test_wide_jitter_not_done() {
+    DistStats s;
+    uint32_t x = 7;
+
+    // Jitter di decine di passi: 8 distanze non bastano a fissare la mediana
+    dist_stats_init(&s, 64);
+    for (int i = 0; i < 8; i++) dist_stats_add(&s, 290 + stats_lcg(&x) % 61);
+    TEST_ASSERT_FALSE(dist_stats_done(&s, 8));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int dist_stats_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_median_mad_exact);
+    RUN_TEST(test_outliers_and_early_stop);
+    RUN_TEST(test_wide_jitter_not_done);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    dist_stats_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return dist_stats_run();
+}
+#endif
@@ -0,0 +1,153 @@
+/**
+ * Riconoscimento della carta e del suo PRNG
+ *
+ * Ogni carta simulata (PRNG debole, statico, rinforzato, Gen1a) viene
+ * classificata e l'attacco scelto deve poter partire: il Darkside ritrova
+ * la chiave tra i candidati di un round, il nested di MFOC misura la
+ * distanza tra i nonce, l'hardnested riceve {nt} senza relazione con il
+ * PRNG a 16 bit, la backdoor legge il trailer con la chiave in chiaro.
+ *
+ * Host:  pio test -e native -f test_fingerprint
+ */
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "mfcuk_fingerprint.h"
+#include "mfcuk_crypto_prng.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static const uint8_t fp_uid[4] = {0x9c, 0x59, 0x9b, 0x32};
+static const uint64_t fp_key = 0xA0A1A2A3A4A5ULL;
+
+/**
+ * true se l'attacco può partire sulla carta con la chiave nota
+ */
+static bool fp_attack_starts(NonceAcq* a, uint8_t attack, uint64_t key) {
+    NonceNested n;
+    uint8_t trailer[16];
+    uint64_t read = 0;
+    bool ok = false;
+
+    switch (attack) {
+        case FINGERPRINT_ATTACK_DARKSIDE: {
+            DarksideSolver ds;
+            DarksideRun run;
+
+            if (!darkside_solver_init(&ds)) return false;
+            if (nonce_darkside_run(a, 3, 0, 0x12345678, 0x00000000, 1024, &run)) {
+                darkside_solver_add_run(&ds, a->uid32, &run);
+                for (uint32_t i = 0; i < ds.count; i++) ok |= ds.keys[i] == key;
+            }
+            darkside_solver_free(&ds);
+            return ok;
+        }
+        case FINGERPRINT_ATTACK_MFOC_NESTED:
+            return nonce_nested(a, key, 3, 0, 3, 0, true, &n) == 1 && n.distance != PRNG_DISTANCE_INVALID;
+        case FINGERPRINT_ATTACK_HARDNESTED:
+            return nonce_nested(a, key, 3, 0, 3, 0, true, &n) == 1 && n.distance == PRNG_DISTANCE_INVALID;
+        case FINGERPRINT_ATTACK_BACKDOOR:
+            ok = nonce_gen1a_unlock(a) && nonce_gen1a_read(a, 3, trailer);
+            for (uint8_t i = 0; i < 6; i++) read = read << 8 | trailer[i];
+            return ok && read == key;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Classifica una carta simulata e verifica PRNG, attacco scelto e che
+ * l'attacco possa partire sulla carta
+ */
+static void fp_check_card(bool static_nonce, bool hardened, bool gen1a, bool have_key, uint8_t expect_prng,
+                          uint8_t expect_attack) {
+    NonceMockCard m;
+    NonceLink link;
+    NonceAcq a;
+    CardFingerprint fp;
+    const char* reason = "";
+    uint8_t attack;
+
+    nonce_mock_init(&m, fp_uid, sizeof(fp_uid), fp_key, 0xFFFFFFFFFFFFULL);
+    m.static_nonce = static_nonce;
+    m.hardened = hardened;
+    m.gen1a = gen1a;
+    nonce_mock_link(&m, &link);
+    nonce_acq_init(&a, &link, fp_uid, sizeof(fp_uid));
+
+    fingerprint_classify(&fp, m.sak, m.atqa, m.uid_len);
+    TEST_ASSERT_TRUE(fingerprint_probe(&fp, &a, 3));
+    TEST_ASSERT_EQUAL_UINT8(FINGERPRINT_CARD_1K, fp.card);
+    TEST_ASSERT_EQUAL_UINT8(expect_prng, fp.prng);
+    TEST_ASSERT_EQUAL(gen1a, fp.backdoor);
+
+    attack = fingerprint_select_attack(&fp, have_key, &reason);
+    printf("[MFCUK] Fingerprint: PRNG %s, %s\n", fingerprint_prng_name(fp.prng), reason);
+    TEST_ASSERT_EQUAL_UINT8(expect_attack, attack);
+    TEST_ASSERT_TRUE(fp_attack_starts(&a, attack, fp_key));
+}
+
+void test_weak_prng() {
+    fp_check_card(false, false, false, false, FINGERPRINT_PRNG_WEAK, FINGERPRINT_ATTACK_DARKSIDE);
+}
+
+void test_weak_prng_known_key() {
+    fp_check_card(false, false, false, true, FINGERPRINT_PRNG_WEAK, FINGERPRINT_ATTACK_MFOC_NESTED);
+}
+
+void test_static_nonce() {
+    fp_check_card(true, false, false, false, FINGERPRINT_PRNG_STATIC, FINGERPRINT_ATTACK_DARKSIDE);
+}
+
+void test_hardened_prng() {
+    fp_check_card(false, true, false, true, FINGERPRINT_PRNG_HARDENED, FINGERPRINT_ATTACK_HARDNESTED);
+}
+
+void test_gen1a() {
+    fp_check_card(false, false, true, false, FINGERPRINT_PRNG_WEAK, FINGERPRINT_ATTACK_BACKDOOR);
+}
+
+void test_not_classic() {
+    CardFingerprint fp;
+
+    // NTAG (SAK 00) e DESFire (SAK 20): nessun attacco Crypto1
+    fingerprint_classify(&fp, 0x00, 0x0044, 7);
+    TEST_ASSERT_EQUAL_UINT8(FINGERPRINT_CARD_NOT_CLASSIC, fp.card);
+    TEST_ASSERT_EQUAL_UINT8(FINGERPRINT_ATTACK_NONE, fingerprint_select_attack(&fp, true, NULL));
+    fingerprint_classify(&fp, 0x20, 0x0344, 7);
+    TEST_ASSERT_EQUAL_UINT8(FINGERPRINT_CARD_NOT_CLASSIC, fp.card);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int fingerprint_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_weak_prng);
+    RUN_TEST(test_weak_prng_known_key);
+    RUN_TEST(test_static_nonce);
+    RUN_TEST(test_hardened_prng);
+    RUN_TEST(test_gen1a);
+    RUN_TEST(test_not_classic);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    fingerprint_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return fingerprint_run();
+}
+#endif
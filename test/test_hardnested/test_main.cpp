@@ -0,0 +1,217 @@
+/**
+ * Attacco hardnested
+ *
+ * Formula della somma e proprietà di bitflip su chiavi note: il piano
+ * esatto deve ammettere le classi delle metà della chiave. Sulla carta
+ * simulata con PRNG rinforzato statistiche, verifica bitsliced contro
+ * quella scalare e forza bruta su un intorno della chiave; infine il file
+ * di lavoro riletto.
+ *
+ * Host:  pio test -e native -f test_hardnested
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mfcuk_hardnested.h"
+#include "mfcuk_nonce.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static uint64_t hn_x = 0x5EED;
+
+static uint64_t hn_lcg(uint64_t* x) {
+    *x = *x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *x >> 16;
+}
+
+/**
+ * {nt} con primo byte b e parità di una carta con la chiave data
+ */
+static void hn_test_nonce(uint64_t key, uint32_t uid, uint32_t nt_enc, Crypto1EncNonce* n) {
+    uint32_t nt = nonce_decrypt_nt(key, uid, nt_enc);
+    uint32_t ks = nt ^ nt_enc;
+
+    n->uid = uid;
+    n->nt_enc = nt_enc;
+    n->par = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        uint8_t plain = nt >> (24 - 8 * i);
+
+        n->par |= (crypto1_parity(plain) ^ 1 ^ ((ks >> (16 - 8 * i)) & 1)) << i;
+    }
+}
+
+/**
+ * Verifica scalare di una chiave sui nonce
+ */
+static bool hn_key_ok(uint64_t key, const Crypto1EncNonce* nonces, uint8_t num_nonces) {
+    for (uint8_t i = 0; i < num_nonces; i++) {
+        uint32_t nt = nonce_decrypt_nt(key, nonces[i].uid, nonces[i].nt_enc);
+
+        if (!nonce_nested_parity_ok(nt, nonces[i].nt_enc, nonces[i].par)) return false;
+    }
+    return true;
+}
+
+/**
+ * Tutti i 256 primi byte di una chiave casuale: il piano esatto deve
+ * ammettere le classi delle metà della chiave e le proprietà devono essere
+ * decise
+ */
+void test_hardnested_classes() {
+    for (uint8_t i = 0; i < 4; i++) {
+        uint64_t key = hn_lcg(&hn_x) & 0xFFFFFFFFFFFFULL;
+        uint32_t uid = (uint32_t)hn_lcg(&hn_x);
+        Hardnested hn;
+        HardnestedEstimate est;
+        HardnestedPlan plan;
+        Crypto1State s;
+        Crypto1EncNonce n;
+        uint8_t oc, ec;
+
+        hardnested_init(&hn, uid);
+        for (uint32_t b = 0; b < HN_FIRST_BYTES; b++) {
+            hn_test_nonce(key, uid, b << 24 | (uint32_t)(hn_lcg(&hn_x) & 0xffffff), &n);
+            hardnested_add(&hn, n.nt_enc, n.par);
+        }
+        hardnested_estimate(&hn, &est, &plan);
+
+        crypto1_init(&s, key);
+        oc = hardnested_odd_class(s.odd);
+        ec = hardnested_even_class(s.even);
+        printf("[MFCUK] Hardnested chiave %012llX: classi %u/%u, piano 2^%.1f\n", (unsigned long long)key, oc, ec,
+               est.log2_plan);
+
+        TEST_ASSERT_TRUE(est.complete);
+        TEST_ASSERT_EQUAL_UINT32(0, hn.conflicts);
+        TEST_ASSERT_TRUE(hardnested_plan_allows(&plan, oc, ec));
+        TEST_ASSERT_EQUAL_UINT8(oc & 1, est.odd_prop);
+        TEST_ASSERT_EQUAL_UINT8(ec & 1, est.even_prop);
+        TEST_ASSERT_TRUE(est.log2_plan < 46.0f);
+    }
+}
+
+/**
+ * Nonce nested dalla carta simulata con PRNG rinforzato fino a vedere tutti
+ * i primi byte, poi forza bruta su un intorno delle parti basse della chiave
+ */
+void test_hardnested_mock_card() {
+    static const uint8_t uid[4] = {0x9c, 0x59, 0x9b, 0x32};
+    const uint64_t key_a = 0xA0A1A2A3A4A5ULL;
+    const uint64_t key_b = 0x4D3A99C351DDULL;
+    uint64_t keys[CRYPTO1_BS_LANES];
+    uint32_t even[32];
+    NonceMockCard m;
+    NonceLink link;
+    NonceAcq a;
+    NonceNested nn;
+    Hardnested hn;
+    HardnestedEstimate est;
+    HardnestedPlan plan;
+    Crypto1State s;
+    crypto1_bs_t expected = 0;
+    uint64_t found = 0;
+    uint32_t o_low, e_low, num_even;
+    int r = 1;
+
+    nonce_mock_init(&m, uid, sizeof(uid), key_a, key_b);
+    m.hardened = true;
+    nonce_mock_link(&m, &link);
+    nonce_acq_init(&a, &link, uid, sizeof(uid));
+
+    hardnested_init(&hn, a.uid32);
+    while (hn.seen_count < HN_FIRST_BYTES && hn.nonces < 8 * 1024 && r == 1) {
+        r = nonce_nested(&a, key_a, 3, 0, 7, 1, false, &nn);
+        if (r == 1) hardnested_add(&hn, nn.nt_enc, nn.par);
+    }
+    hardnested_estimate(&hn, &est, &plan);
+    hardnested_report(&hn, &est);
+
+    crypto1_init(&s, key_b);
+    TEST_ASSERT_EQUAL_INT(1, r);
+    TEST_ASSERT_TRUE(est.complete);
+    TEST_ASSERT_EQUAL_UINT32(0, hn.conflicts);
+    TEST_ASSERT_TRUE(hardnested_plan_allows(&plan, hardnested_odd_class(s.odd), hardnested_even_class(s.even)));
+
+    // Verifica bitsliced contro quella scalare, chiave vera in mezzo
+    for (int i = 0; i < CRYPTO1_BS_LANES; i++) {
+        keys[i] = i == CRYPTO1_BS_LANES / 2 ? key_b : hn_lcg(&hn_x) & 0xFFFFFFFFFFFFULL;
+        if (hn_key_ok(keys[i], hn.check, 1)) expected |= (crypto1_bs_t)1 << i;
+    }
+    TEST_ASSERT_TRUE(crypto1_bs_test_nonce_batch(hn.check, 1, keys, CRYPTO1_BS_LANES) == expected);
+    TEST_ASSERT_TRUE(crypto1_bs_test_nonce_batch(hn.check, hn.num_check, keys, CRYPTO1_BS_LANES) ==
+                     (crypto1_bs_t)1 << (CRYPTO1_BS_LANES / 2));
+
+    // Intorno di 16 parti basse per metà: la chiave vera è tra le coppie
+    o_low = s.odd & ((1UL << HN_ODD_LOW_BITS) - 1);
+    e_low = s.even & ((1UL << HN_EVEN_LOW_BITS) - 1);
+    o_low = o_low >= 8 ? o_low - 8 : 0;
+    e_low = e_low >= 8 ? e_low - 8 : 0;
+    num_even = hardnested_even_list(&plan, e_low, e_low + 16, even, 32);
+    r = hardnested_search(&plan, hn.check, hn.num_check, even, num_even, o_low, o_low + 16, NULL, NULL, &found);
+
+    printf("[MFCUK] Hardnested carta simulata: %u nonce, chiave %012llX\n", (unsigned)hn.nonces,
+           (unsigned long long)found);
+    TEST_ASSERT_EQUAL_INT(1, r);
+    TEST_ASSERT_TRUE(found == key_b);
+}
+
+/**
+ * Intestazione e righe del file di lavoro rilette
+ */
+void test_hardnested_job() {
+    const Crypto1EncNonce in = {0x9c599b32, 0x0a1b2c3d, 0x5};
+    Crypto1EncNonce out = {0, 0, 0};
+    char buf[HN_JOB_LINE_MAX];
+    uint8_t sector = 0, type = 0;
+    char* line2;
+
+    hardnested_job_header(buf, sizeof(buf), 5, 1);
+    line2 = strchr(buf, '\n');
+    TEST_ASSERT_NOT_NULL(line2);
+    TEST_ASSERT_EQUAL_INT(0, hardnested_job_parse(buf, &out, &sector, &type));
+    TEST_ASSERT_EQUAL_INT(2, hardnested_job_parse(line2 + 1, &out, &sector, &type));
+    TEST_ASSERT_EQUAL_UINT8(5, sector);
+    TEST_ASSERT_EQUAL_UINT8(1, type);
+
+    hardnested_job_line(buf, sizeof(buf), &in);
+    TEST_ASSERT_EQUAL_INT(1, hardnested_job_parse(buf, &out, &sector, &type));
+    TEST_ASSERT_EQUAL_HEX32(in.uid, out.uid);
+    TEST_ASSERT_EQUAL_HEX32(in.nt_enc, out.nt_enc);
+    TEST_ASSERT_EQUAL_HEX8(in.par, out.par);
+    TEST_ASSERT_EQUAL_INT(-1, hardnested_job_parse("zz;1;2\n", &out, &sector, &type));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int hardnested_run() {
+    UNITY_BEGIN();
+    // Tabelle delle somme una sola volta per tutti i test
+    hardnested_tables_init();
+    RUN_TEST(test_hardnested_classes);
+    RUN_TEST(test_hardnested_mock_card);
+    RUN_TEST(test_hardnested_job);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    hardnested_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return hardnested_run();
+}
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Catena di generazione delle chiavi candidate
+ *
+ * Chiavi predefinite e recupero nested attraverso filtro dei duplicati e
+ * verifica sulla traccia, poi il nested completo sulla carta simulata:
+ * nt stimati attorno alla distanza calibrata, filtro di parità, recupero
+ * solo sui superstiti e verifica sulle altre sonde.
+ *
+ * Host:  pio test -e native -f test_keygen
+ */
+
+#include <unity.h>
+#include <stdio.h>
+
+#include "mfcuk_keygen.h"
+#include "mfcuk_crypto_prng.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Traccia reale con chiave FFFFFFFFFFFF (come test_crypto1_recovery)
+static const uint32_t kg_uid = 0x9c599b32, kg_nt = 0x82a4166c, kg_nr = 0x12345678;
+static const uint64_t kg_key = 0xFFFFFFFFFFFFULL;
+
+static bool kg_count_cb(const Crypto1State* state, void* ctx) {
+    (void)state;
+    (*(uint32_t*)ctx)++;
+    return true;
+}
+
+static int kg_verify_cb(void* ctx, uint64_t key) {
+    return key == *(const uint64_t*)ctx;
+}
+
+void test_keygen_chain() {
+    static uint64_t slots[1024];
+    const uint64_t defaults[] = {0xA0A1A2A3A4A5ULL, 0xD3F7D3F7D3F7ULL, 0xA0A1A2A3A4A5ULL, 0x000000000000ULL};
+    KeyDedupStage dedup;
+    KeyAuthStage verify;
+    Crypto1RecoveryStats stats = {}, full;
+    Crypto1Auth auth;
+    Crypto1State s;
+    uint32_t nt_enc, all = 0;
+
+    // Traccia nested e autenticazione completa con la stessa chiave
+    crypto1_init(&s, kg_key);
+    nt_enc = kg_nt ^ crypto1_word(&s, kg_uid ^ kg_nt, 0);
+    auth.uid = kg_uid;
+    auth.nt = kg_nt;
+    auth.nr_enc = kg_nr ^ crypto1_word(&s, kg_nr, 0);
+    auth.ar_enc = prng_successor(kg_nt, 64) ^ crypto1_word(&s, 0, 0);
+
+    // Riferimento: numero totale di stati candidati
+    nested_key_recovery(kg_uid, kg_nt, nt_enc, kg_count_cb, &all, &full);
+
+    // Chiavi predefinite ripetute (filtrate) poi il recupero nested
+    keygen_auth_init(&verify, &auth, NULL);
+    keygen_dedup_init(&dedup, slots, 1024, &verify.base);
+    if (keygen_from_keys(defaults, 4, &dedup.base) && keygen_from_nested(kg_uid, kg_nt, nt_enc, &dedup.base, &stats)) {
+        keygen_flush(&dedup.base);
+    }
+
+    printf("[CRYPTO] Catena chiavi: %u stati su %u, %u duplicati, %u verificate\n", (unsigned)stats.states,
+           (unsigned)all, (unsigned)dedup.duplicates, (unsigned)verify.base.in);
+
+    TEST_ASSERT_TRUE(verify.found);
+    TEST_ASSERT_TRUE(verify.key == kg_key);
+    TEST_ASSERT_EQUAL_UINT32(1, dedup.duplicates);
+    // La chiave trovata deve aver fermato il recupero prima della fine
+    TEST_ASSERT_FALSE(stats.complete);
+    TEST_ASSERT_TRUE(stats.states < all);
+}
+
+void test_keygen_nested_parity() {
+    static const uint8_t uid[4] = {0x9c, 0x59, 0x9b, 0x32};
+    const uint64_t key_a = 0xA0A1A2A3A4A5ULL;
+    uint64_t key_b = 0x1A2B3C4D5E6FULL;
+    NonceMockCard m;
+    NonceLink link;
+    NonceAcq a;
+    NonceNested calib, probes[3];
+    KeyNestedStage check;
+    KeyVerifyStage verify;
+    Crypto1RecoveryStats stats;
+    uint32_t guesses[41], num_guesses, lo, hi, runs = 0;
+
+    nonce_mock_init(&m, uid, sizeof(uid), key_a, key_b);
+    nonce_mock_link(&m, &link);
+    nonce_acq_init(&a, &link, uid, sizeof(uid));
+
+    TEST_ASSERT_EQUAL_INT(1, nonce_nested(&a, key_a, 3, 0, 3, 0, true, &calib));
+    TEST_ASSERT_TRUE(calib.distance != PRNG_DISTANCE_INVALID);
+    for (uint8_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_INT(1, nonce_nested(&a, key_a, 3, 0, 7, 1, false, &probes[i]));
+
+    lo = calib.distance - 20;
+    hi = calib.distance + 20;
+    num_guesses = nonce_nested_guesses(&probes[0], lo, hi, guesses, 41);
+
+    keygen_verify_init(&verify, kg_verify_cb, &key_b, NULL);
+    keygen_nested_init(&check, a.uid32, probes + 1, 2, lo, hi, &verify.base);
+    for (uint32_t i = 0; i < num_guesses && !verify.found; i++, runs++) {
+        keygen_from_nested(a.uid32, guesses[i], probes[0].nt_enc, &check.base, &stats);
+    }
+    if (!verify.found) keygen_flush(&check.base);
+
+    printf("[CRYPTO] Nested con filtro di parità: %u nt su 41, %u recuperi, %u chiavi scartate\n",
+           (unsigned)num_guesses, (unsigned)runs, (unsigned)check.rejected);
+
+    TEST_ASSERT_TRUE(verify.found);
+    TEST_ASSERT_TRUE(verify.key == key_b);
+    TEST_ASSERT_TRUE(num_guesses < 41);
+    // Solo la chiave giusta supera le altre sonde
+    TEST_ASSERT_EQUAL_UINT32(1, check.base.out);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int keygen_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_keygen_chain);
+    RUN_TEST(test_keygen_nested_parity);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    keygen_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return keygen_run();
+}
+#endif
@@ -0,0 +1,142 @@
+/**
+ * Filtro di Bloom a blocchi per l'intersezione tra sonde
+ *
+ * Nessun falso negativo e falsi positivi vicini alla stima, con budget
+ * ampio e ridotto; il filtro davanti a un sink inoltra in ordine le chiavi
+ * presenti più i falsi positivi.
+ *
+ * Host:  pio test -e native -f test_mfoc_bloom
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mfoc_bloom.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Chiavi sondate mai aggiunte al filtro
+#define BLOOM_PROBES  20000
+
+static uint64_t bloom_lcg(uint64_t* x) {
+    *x = *x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *x >> 16;
+}
+
+/**
+ * Aggiunge n chiavi in un filtro di 'budget' byte e conta i falsi positivi
+ */
+static void bloom_check_rate(uint32_t n, uint32_t budget) {
+    uint32_t bytes = mfoc_bloom_size(n, budget);
+    uint32_t fp = 0, fn = 0, est;
+    uint64_t x = n;
+    MfocBloom b;
+    void* mem = malloc(bytes);
+
+    TEST_ASSERT_NOT_NULL(mem);
+    mfoc_bloom_init(&b, mem, bytes, n);
+
+    for (uint32_t i = 0; i < n; i++) mfoc_bloom_add(&b, bloom_lcg(&x));
+    x = n;
+    for (uint32_t i = 0; i < n; i++) fn += !mfoc_bloom_contains(&b, bloom_lcg(&x));
+    for (uint32_t i = 0; i < BLOOM_PROBES; i++) fp += mfoc_bloom_contains(&b, bloom_lcg(&x));
+    free(mem);
+
+    est = mfoc_bloom_fp_permille(&b);
+    fp = (fp * 1000 + BLOOM_PROBES / 2) / BLOOM_PROBES;
+    printf("[MFOC] Bloom: %u chiavi in %u byte (k=%u), falsi positivi %u.%u%% (stima %u.%u%%)\n", (unsigned)n,
+           (unsigned)bytes, b.k, (unsigned)fp / 10, (unsigned)fp % 10, (unsigned)est / 10, (unsigned)est % 10);
+
+    TEST_ASSERT_EQUAL_UINT32(0, fn);
+    // I blocchi non sono caricati in modo uniforme: tolleranza sulla stima
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(est * 3 / 2 + 5, fp);
+}
+
+void test_bloom_rate_wide_budget() {
+    bloom_check_rate(2000, 32 * 1024);
+}
+
+void test_bloom_rate_small_budget() {
+    bloom_check_rate(20000, 4096);
+}
+
+typedef struct {
+    uint64_t last;
+    uint32_t count;
+    bool sorted;
+} BloomTestSink;
+
+static bool bloom_test_sink(const uint64_t* keys, uint32_t n, void* ctx) {
+    BloomTestSink* s = (BloomTestSink*)ctx;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (s->count > 0 && keys[i] <= s->last) s->sorted = false;
+        s->last = keys[i];
+        s->count++;
+    }
+    return true;
+}
+
+/**
+ * Chiavi pari nel filtro, tutte le chiavi 0..999 attraverso il filtro in
+ * blocchi più grandi di CRYPTO1_KEY_BATCH
+ */
+void test_bloom_gate() {
+    uint32_t bytes = mfoc_bloom_size(500, 4096);
+    uint64_t keys[100];
+    BloomTestSink out = {0, 0, true};
+    MfocBloomGate g;
+    MfocBloom b;
+    uint32_t fp = 0;
+    void* mem = malloc(bytes);
+    bool ok = true;
+
+    TEST_ASSERT_NOT_NULL(mem);
+    mfoc_bloom_init(&b, mem, bytes, 500);
+    for (uint64_t k = 0; k < 1000; k += 2) mfoc_bloom_add(&b, k);
+    for (uint64_t k = 1; k < 1000; k += 2) fp += mfoc_bloom_contains(&b, k);
+
+    mfoc_bloom_gate_init(&g, &b, bloom_test_sink, &out);
+    for (uint32_t base = 0; base < 1000 && ok; base += 100) {
+        for (uint32_t i = 0; i < 100; i++) keys[i] = base + i;
+        ok = mfoc_bloom_gate_sink(keys, 100, &g);
+    }
+    free(mem);
+
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_TRUE(out.sorted);
+    TEST_ASSERT_EQUAL_UINT32(1000, g.tested);
+    TEST_ASSERT_EQUAL_UINT32(out.count, g.passed);
+    TEST_ASSERT_EQUAL_UINT32(500 + fp, out.count);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int bloom_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bloom_rate_wide_budget);
+    RUN_TEST(test_bloom_rate_small_budget);
+    RUN_TEST(test_bloom_gate);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    bloom_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return bloom_run();
+}
+#endif
@@ -0,0 +1,179 @@
+/**
+ * Acquisizione dei nonce a livello di frame
+ *
+ * Impacchettamento dei frame con parità e CRC_A, poi selezione, nonce in
+ * chiaro, nested (calibrato, chiave sbagliata, settore con chiave diversa)
+ * e round Darkside sulla carta simulata, con UID da 4 e da 7 byte.
+ *
+ * Host:  pio test -e native -f test_nonce_acq
+ */
+
+#include <unity.h>
+#include <string.h>
+
+#include "mfcuk_nonce.h"
+#include "mfcuk_crypto_prng.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static const uint8_t acq_uid4[4] = {0x9c, 0x59, 0x9b, 0x32};
+static const uint8_t acq_uid7[7] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+static const uint64_t acq_key_a = 0xA0A1A2A3A4A5ULL, acq_key_b = 0x4D3A99C351DDULL;
+
+static NonceMockCard acq_card;
+static NonceLink acq_link;
+static NonceAcq acq;
+
+static void acq_open(const uint8_t* uid, uint8_t uid_len, uint64_t key_a, uint64_t key_b) {
+    nonce_mock_init(&acq_card, uid, uid_len, key_a, key_b);
+    nonce_mock_link(&acq_card, &acq_link);
+    nonce_acq_init(&acq, &acq_link, uid, uid_len);
+}
+
+void test_frame_pack_crc() {
+    static const uint8_t halt[2] = {NONCE_CMD_HALT, 0x00};
+    NonceFrame f, g;
+    uint8_t raw[NONCE_RAW_MAX], crc[2], n, last;
+
+    // CRC_A di HALT (ISO14443-3): 57 CD
+    nonce_crc_a(halt, sizeof(halt), crc);
+    TEST_ASSERT_EQUAL_HEX8(0x57, crc[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xCD, crc[1]);
+
+    // Frame da 9 byte = 81 bit: 11 byte grezzi, l'ultimo con 1 bit
+    for (uint8_t i = 0; i < 9; i++) {
+        f.data[i] = i * 37 + 1;
+        f.par[i] = i & 1;
+    }
+    f.len = 9;
+    f.bits = 0;
+    g.len = 9;
+    g.bits = 0;
+    n = nonce_frame_pack(&f, raw, &last);
+    TEST_ASSERT_EQUAL_UINT8(11, n);
+    TEST_ASSERT_EQUAL_UINT8(1, last);
+    TEST_ASSERT_TRUE(nonce_frame_unpack(raw, n, &g));
+    TEST_ASSERT_EQUAL_MEMORY(f.data, g.data, 9);
+    TEST_ASSERT_EQUAL_MEMORY(f.par, g.par, 9);
+}
+
+/**
+ * Selezione, nonce in chiaro e nested su una carta simulata
+ */
+static void acq_check_card(const uint8_t* uid, uint8_t uid_len) {
+    NonceNested n1, n2 = {};
+    uint32_t nt, guesses[201], num_guesses;
+    bool filter = false;
+
+    acq_open(uid, uid_len, acq_key_a, acq_key_b);
+
+    TEST_ASSERT_TRUE(nonce_get_nt(&acq, 4, 0, &nt));
+    TEST_ASSERT_EQUAL_HEX32(acq_card.nt, nt);
+    TEST_ASSERT_TRUE(prng_valid_nonce(nt));
+
+    // Con tempi costanti la distanza di calibrazione non cambia
+    TEST_ASSERT_EQUAL_INT(1, nonce_nested(&acq, acq_key_b, 7, 1, 7, 1, true, &n1));
+    TEST_ASSERT_EQUAL_HEX32(acq_card.nt, n1.nt2);
+    TEST_ASSERT_EQUAL_INT(1, nonce_nested(&acq, acq_key_b, 7, 1, 7, 1, true, &n2));
+    TEST_ASSERT_EQUAL_HEX32(acq_card.nt, n2.nt2);
+    TEST_ASSERT_TRUE(n1.distance != PRNG_DISTANCE_INVALID);
+    TEST_ASSERT_EQUAL_UINT32(n1.distance, n2.distance);
+
+    TEST_ASSERT_EQUAL_INT(0, nonce_nested(&acq, acq_key_a ^ 1, 3, 0, 3, 0, false, &n1));
+
+    TEST_ASSERT_EQUAL_INT(1, nonce_nested(&acq, acq_key_a, 3, 0, 7, 1, false, &n1));
+    TEST_ASSERT_EQUAL_HEX32(acq_card.nt, nonce_decrypt_nt(acq_key_b, acq.uid32, n1.nt_enc));
+
+    // Filtro di parità su 201 distanze attorno a quella calibrata: passa il
+    // nt vero e circa un nt sbagliato su 8
+    num_guesses = nonce_nested_guesses(&n1, n2.distance - 100, n2.distance + 100, guesses, 201);
+    for (uint32_t i = 0; i < num_guesses; i++) filter |= guesses[i] == acq_card.nt;
+    TEST_ASSERT_TRUE(filter);
+    TEST_ASSERT_LESS_THAN_UINT32(201 / 4, num_guesses);
+
+    nonce_acq_report(&acq, 0);
+}
+
+void test_card_uid4() {
+    acq_check_card(acq_uid4, sizeof(acq_uid4));
+}
+
+void test_card_uid7() {
+    acq_check_card(acq_uid7, sizeof(acq_uid7));
+}
+
+/**
+ * Verifica a blocchi delle chiavi sulle sonde nested: passa solo la chiave
+ * vera, e non passa più fuori dalla finestra di distanze
+ */
+void test_nested_keys_batch() {
+    uint64_t keys[CRYPTO1_BS_LANES], x = 1;
+    NonceNested calib, probes[3];
+    const int mid = CRYPTO1_BS_LANES / 2;
+    uint32_t lo, hi;
+
+    acq_open(acq_uid4, sizeof(acq_uid4), acq_key_a, acq_key_b);
+    TEST_ASSERT_EQUAL_INT(1, nonce_nested(&acq, acq_key_a, 3, 0, 3, 0, true, &calib));
+    for (uint8_t i = 0; i < 3; i++) TEST_ASSERT_EQUAL_INT(1, nonce_nested(&acq, acq_key_a, 3, 0, 7, 1, false, &probes[i]));
+    lo = calib.distance - 20;
+    hi = calib.distance + 20;
+
+    for (int i = 0; i < CRYPTO1_BS_LANES; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        keys[i] = i == mid ? acq_key_b : (x >> 16) & 0xFFFFFFFFFFFFULL;
+    }
+    TEST_ASSERT_TRUE(nonce_nested_keys_ok(probes, 3, acq.uid32, keys, CRYPTO1_BS_LANES, lo, hi) ==
+                     (crypto1_bs_t)1 << mid);
+    TEST_ASSERT_TRUE(nonce_nested_keys_ok(probes, 3, acq.uid32, keys, mid, lo, hi) == 0);
+    TEST_ASSERT_TRUE(nonce_nested_keys_ok(probes, 3, acq.uid32, keys, CRYPTO1_BS_LANES, hi + 1, hi + 40) == 0);
+}
+
+/**
+ * Il round Darkside sulla carta simulata deve coincidere con quello
+ * calcolato da darkside_simulate_run con la chiave della carta
+ */
+void test_darkside_round() {
+    const uint64_t key = 0xFFFFFFFFFFFFULL;
+    DarksideRun run, expect;
+
+    acq_open(acq_uid4, sizeof(acq_uid4), key, key);
+
+    TEST_ASSERT_TRUE(nonce_darkside_run(&acq, 3, 0, 0x12345678, 0x00000000, 1024, &run));
+    darkside_simulate_run(key, acq.uid32, run.nt, 0x12345678, 0x00000000, &expect);
+    TEST_ASSERT_EQUAL_HEX32(expect.nt, run.nt);
+    TEST_ASSERT_EQUAL_HEX32(expect.nr_enc, run.nr_enc);
+    TEST_ASSERT_EQUAL_MEMORY(expect.par, run.par, sizeof(run.par));
+    TEST_ASSERT_EQUAL_MEMORY(expect.ks, run.ks, sizeof(run.ks));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static int nonce_acq_run() {
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_pack_crc);
+    RUN_TEST(test_card_uid4);
+    RUN_TEST(test_card_uid7);
+    RUN_TEST(test_nested_keys_batch);
+    RUN_TEST(test_darkside_round);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    // Attesa per l'apertura della seriale da parte di PlatformIO
+    delay(2000);
+    nonce_acq_run();
+}
+
+void loop() {}
+#else
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    return nonce_acq_run();
+}
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Hardnested su host - Pool di thread della forza bruta
+ */
+
+#include "hn_pool.h"
+#include "hn_simd.h"
+
+/**
+ * Corpo di un thread: blocchi di HN_POOL_CHUNK parti basse finché ce ne
+ * sono, la chiave trovata ferma anche gli altri
+ */
+static void hn_pool_worker(HnPool* pool, int id) {
+    uint64_t key;
+
+    for (;;) {
+        uint32_t begin = pool->next_odd.fetch_add(HN_POOL_CHUNK, std::memory_order_relaxed);
+        uint32_t end = begin + HN_POOL_CHUNK;
+        int r;
+
+        if (begin >= pool->odd_end || pool->stop.load(std::memory_order_relaxed)) break;
+        if (end > pool->odd_end) end = pool->odd_end;
+
+        r = hn_simd_search(pool->plan, pool->odd_any, pool->nonces, pool->num_nonces, pool->even,
+                           pool->num_even, begin, end, &pool->workers[id].tested, &pool->stop, &key);
+        if (r == 1) {
+            bool expected = false;
+
+            if (pool->found.compare_exchange_strong(expected, true)) pool->key = key;
+            pool->stop.store(true);
+        }
+        if (r != 0) break;
+    }
+    pool->running.fetch_sub(1);
+}
+
+void hn_pool_init(HnPool* pool, const HardnestedPlan* plan, const Crypto1EncNonce* nonces, uint8_t num_nonces,
+                  const uint32_t* even, uint32_t num_even, uint32_t odd_begin, uint32_t odd_end) {
+    pool->plan = plan;
+    pool->nonces = nonces;
+    pool->num_nonces = num_nonces;
+    pool->even = even;
+    pool->num_even = num_even;
+    pool->odd_end = odd_end;
+    pool->next_odd.store(odd_begin);
+    pool->stop.store(false);
+    pool->running.store(0);
+    pool->found.store(false);
+    pool->key = 0;
+    pool->threads = 0;
+
+    // Classi di odd con almeno una classe di even ammessa dal piano
+    for (int oc = 0; oc < HN_CLASSES; oc++) {
+        pool->odd_any[oc] = false;
+        for (int ec = 0; ec < HN_CLASSES && !pool->odd_any[oc]; ec++) {
+            pool->odd_any[oc] = hardnested_plan_allows(plan, (uint8_t)oc, (uint8_t)ec);
+        }
+    }
+    for (int i = 0; i < HN_POOL_MAX_THREADS; i++) pool->workers[i].tested.store(0);
+}
+
+void hn_pool_start(HnPool* pool, int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > HN_POOL_MAX_THREADS) threads = HN_POOL_MAX_THREADS;
+
+    pool->threads = threads;
+    pool->running.store(threads);
+    for (int i = 0; i < threads; i++) pool->workers[i].handle = std::thread(hn_pool_worker, pool, i);
+}
+
+bool hn_pool_running(const HnPool* pool) {
+    return pool->running.load() > 0;
+}
+
+void hn_pool_stop(HnPool* pool) {
+    pool->stop.store(true);
+}
+
+void hn_pool_join(HnPool* pool) {
+    for (int i = 0; i < pool->threads; i++) {
+        if (pool->workers[i].handle.joinable()) pool->workers[i].handle.join();
+    }
+}
+
+uint64_t hn_pool_tested(const HnPool* pool, int thread) {
+    return pool->workers[thread].tested.load(std::memory_order_relaxed);
+}
+
+uint64_t hn_pool_tested_total(const HnPool* pool) {
+    uint64_t total = 0;
+
+    for (int i = 0; i < pool->threads; i++) total += hn_pool_tested(pool, i);
+    return total;
+}
@@ -0,0 +1,76 @@
+/**
+ * Hardnested su host - Pool di thread della forza bruta
+ *
+ * I thread prendono blocchi di parti basse di odd da un contatore comune
+ * finché il piano non è esaurito: nessuna divisione statica, quindi anche
+ * con core di velocità diverse finiscono insieme. Ogni thread ha il suo
+ * contatore di chiavi su una linea di cache separata, letto dal chiamante
+ * per la velocità per thread.
+ */
+
+#ifndef _HN_POOL_H_
+#define _HN_POOL_H_
+
+#include "mfcuk_hardnested.h"
+#include <atomic>
+#include <thread>
+
+#define HN_POOL_MAX_THREADS  256
+
+// Parti basse di odd per blocco (2^14 blocchi sull'intero spazio)
+#define HN_POOL_CHUNK        64
+
+typedef struct {
+    alignas(64) std::atomic<uint64_t> tested;   // Chiavi provate dal thread
+    std::thread handle;
+} HnPoolWorker;
+
+typedef struct {
+    const HardnestedPlan* plan;
+    bool odd_any[HN_CLASSES];
+    const Crypto1EncNonce* nonces;
+    uint8_t num_nonces;
+    const uint32_t* even;
+    uint32_t num_even;
+    uint32_t odd_end;
+
+    std::atomic<uint32_t> next_odd;             // Primo blocco non ancora assegnato
+    std::atomic<bool> stop;
+    std::atomic<int> running;
+    std::atomic<bool> found;
+    uint64_t key;
+
+    int threads;
+    HnPoolWorker workers[HN_POOL_MAX_THREADS];
+} HnPool;
+
+/**
+ * Prepara la ricerca sulle parti basse di odd in [odd_begin, odd_end)
+ */
+void hn_pool_init(HnPool* pool, const HardnestedPlan* plan, const Crypto1EncNonce* nonces, uint8_t num_nonces,
+                  const uint32_t* even, uint32_t num_even, uint32_t odd_begin, uint32_t odd_end);
+
+/**
+ * Avvia i thread (al più HN_POOL_MAX_THREADS) e ritorna subito
+ */
+void hn_pool_start(HnPool* pool, int threads);
+
+/**
+ * true finché almeno un thread lavora
+ */
+bool hn_pool_running(const HnPool* pool);
+
+/**
+ * Chiede ai thread di fermarsi alla prossima parte bassa di odd
+ */
+void hn_pool_stop(HnPool* pool);
+
+/**
+ * Attende la fine di tutti i thread
+ */
+void hn_pool_join(HnPool* pool);
+
+uint64_t hn_pool_tested(const HnPool* pool, int thread);
+uint64_t hn_pool_tested_total(const HnPool* pool);
+
+#endif // _HN_POOL_H_
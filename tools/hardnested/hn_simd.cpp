@@ -0,0 +1,294 @@
+/**
+ * Hardnested su host - Backend bitsliced vettoriale
+ *
+ * Le slice hanno la stessa disposizione di mfcuk_crypto_bs.cpp (bit i di
+ * odd a età 2i, bit i di even a età 2i+1). Gli operatori bit a bit sui tipi
+ * vettoriali sono quelli di GCC/Clang, quindi filtro e feedback restano
+ * identici a quelli del firmware; servono intrinseche solo per caricare le
+ * lane e per il test "nessuna lane viva".
+ */
+
+#include "hn_simd.h"
+#include "mfcuk_nonce.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HN_SIMD_STATE_BITS  CRYPTO1_BS_STATE_BITS
+#define HN_SIMD_NONCE_STEPS 25
+
+// Bit alti liberi delle metà: 4 di odd e 5 di even
+#define HN_SIMD_TOP_BITS    9
+
+// Età dei bit che entrano nel feedback lineare (come BS_FEEDBACK)
+#define HN_SIMD_FEEDBACK(s) ((s)[4] ^ (s)[5] ^ (s)[6] ^ (s)[8] ^ (s)[12] ^ (s)[18] ^ \
+                             (s)[20] ^ (s)[22] ^ (s)[23] ^ (s)[28] ^ (s)[30] ^ (s)[32] ^ \
+                             (s)[33] ^ (s)[35] ^ (s)[37] ^ (s)[38] ^ (s)[42] ^ (s)[47])
+
+#define HN_SIMD_BIT(x, n)   (((x) >> (n)) & 1)
+
+// Lane in cui il bit j dell'indice di lane (all'interno della parola) vale 1
+static const uint64_t hn_simd_word_bits[6] = {
+    0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL,
+};
+
+// ----- Primitive -----
+
+static inline hn_vec_t hn_simd_load(const uint64_t* w) {
+#if defined(__AVX2__)
+    return _mm256_loadu_si256((const __m256i*)w);
+#elif defined(__ARM_NEON)
+    return vld1q_u64(w);
+#else
+    return w[0];
+#endif
+}
+
+static inline void hn_simd_store(uint64_t* w, hn_vec_t v) {
+#if defined(__AVX2__)
+    _mm256_storeu_si256((__m256i*)w, v);
+#elif defined(__ARM_NEON)
+    vst1q_u64(w, v);
+#else
+    w[0] = v;
+#endif
+}
+
+static inline hn_vec_t hn_simd_fill(bool bit) {
+#if defined(__AVX2__)
+    return _mm256_set1_epi64x(bit ? -1LL : 0);
+#elif defined(__ARM_NEON)
+    return vdupq_n_u64(bit ? ~0ULL : 0);
+#else
+    return bit ? ~(hn_vec_t)0 : 0;
+#endif
+}
+
+static inline bool hn_simd_any(hn_vec_t v) {
+#if defined(__AVX2__)
+    return !_mm256_testz_si256(v, v);
+#elif defined(__ARM_NEON)
+    return (vgetq_lane_u64(v, 0) | vgetq_lane_u64(v, 1)) != 0;
+#else
+    return v != 0;
+#endif
+}
+
+// ----- Filtro (tabelle 0xd938, 0xf22c, 0xEC57E80A) -----
+
+static inline hn_vec_t hn_simd_fa(hn_vec_t y0, hn_vec_t y1, hn_vec_t y2, hn_vec_t y3) {
+    return ((y0 | y1) ^ (y0 & y3)) ^ (y2 & ((y0 ^ y1) | y3));
+}
+
+static inline hn_vec_t hn_simd_fb(hn_vec_t y0, hn_vec_t y1, hn_vec_t y2, hn_vec_t y3) {
+    return ((y0 & y1) | y2) ^ ((y0 ^ y1) & (y2 | y3));
+}
+
+static inline hn_vec_t hn_simd_fc(hn_vec_t y0, hn_vec_t y1, hn_vec_t y2, hn_vec_t y3, hn_vec_t y4) {
+    return (y0 | ((y1 | y4) & (y3 ^ y4))) ^ ((y0 ^ (y1 & y3)) & ((y2 ^ y3) | (y1 & y4)));
+}
+
+static inline hn_vec_t hn_simd_filter(const hn_vec_t* s) {
+    hn_vec_t n0 = hn_simd_fb(s[6],  s[4],  s[2],  s[0]);
+    hn_vec_t n1 = hn_simd_fa(s[14], s[12], s[10], s[8]);
+    hn_vec_t n2 = hn_simd_fb(s[22], s[20], s[18], s[16]);
+    hn_vec_t n3 = hn_simd_fb(s[30], s[28], s[26], s[24]);
+    hn_vec_t n4 = hn_simd_fa(s[38], s[36], s[34], s[32]);
+    return hn_simd_fc(n4, n3, n2, n1, n0);
+}
+
+/**
+ * Parità dei primi 3 byte di ogni {nt}, come crypto1_bs_test_nonces: il
+ * test sulle lane vive si fa solo alle verifiche, una volta per byte
+ */
+static hn_vec_t hn_simd_test_nonces(const hn_vec_t* state, const Crypto1EncNonce* nonces, int num_nonces,
+                                    hn_vec_t alive) {
+    hn_vec_t slices[HN_SIMD_STATE_BITS + HN_SIMD_NONCE_STEPS];
+
+    for (int n = 0; n < num_nonces; n++) {
+        uint32_t in_word = nonces[n].uid ^ nonces[n].nt_enc;
+        hn_vec_t acc = hn_simd_fill(false);
+        int pos = HN_SIMD_NONCE_STEPS;
+
+        memcpy(&slices[pos], state, sizeof(hn_vec_t) * HN_SIMD_STATE_BITS);
+        for (int i = 0; i < HN_SIMD_NONCE_STEPS; i++) {
+            hn_vec_t ks = hn_simd_filter(&slices[pos]);
+            hn_vec_t fb;
+
+            if (i > 0 && (i & 7) == 0) {
+                int byte = (i >> 3) - 1;
+                uint8_t enc = nonces[n].nt_enc >> (24 - 8 * byte);
+                uint8_t expected = ((nonces[n].par >> byte) & 1) ^ crypto1_parity(enc) ^ 1;
+
+                alive &= ~(acc ^ ks ^ hn_simd_fill(expected));
+                if (!hn_simd_any(alive)) return alive;
+                acc = hn_simd_fill(false);
+            }
+            if (i == HN_SIMD_NONCE_STEPS - 1) break;
+
+            acc ^= ks;
+            fb = HN_SIMD_FEEDBACK(&slices[pos]) ^ hn_simd_fill(CRYPTO1_BEBIT(in_word, i)) ^ ks;
+            slices[--pos] = fb;
+        }
+    }
+    return alive;
+}
+
+// ----- Forza bruta -----
+
+/**
+ * Registro con il bit j dell'indice di lane: nella parola per j < 6,
+ * dall'indice della parola per i bit successivi
+ */
+static hn_vec_t hn_simd_lane_bit(int j) {
+    uint64_t w[HN_SIMD_WORDS];
+
+    for (int k = 0; k < HN_SIMD_WORDS; k++) {
+        w[k] = j < 6 ? hn_simd_word_bits[j] : (HN_SIMD_BIT(k, j - 6) ? ~0ULL : 0);
+    }
+    return hn_simd_load(w);
+}
+
+/**
+ * Verifica scalare di una chiave trovata dalle lane
+ */
+static bool hn_simd_key_ok(uint64_t key, const Crypto1EncNonce* nonces, uint8_t num_nonces) {
+    for (uint8_t i = 0; i < num_nonces; i++) {
+        uint32_t nt = nonce_decrypt_nt(key, nonces[i].uid, nonces[i].nt_enc);
+
+        if (!nonce_nested_parity_ok(nt, nonces[i].nt_enc, nonces[i].par)) return false;
+    }
+    return true;
+}
+
+/**
+ * Chiave della lane: t0..t3 sono i bit 20..23 di odd, t4..t8 i bit 19..23 di even
+ */
+static uint64_t hn_simd_lane_key(uint32_t odd, uint32_t even, uint32_t t) {
+    Crypto1State st = {odd | (t & 0xf) << HN_ODD_LOW_BITS, even | (t >> 4) << HN_EVEN_LOW_BITS};
+
+    return crypto1_get_key(&st);
+}
+
+int hn_simd_search(const HardnestedPlan* plan, const bool* odd_any, const Crypto1EncNonce* nonces,
+                   uint8_t num_nonces, const uint32_t* even, uint32_t num_even, uint32_t odd_begin,
+                   uint32_t odd_end, std::atomic<uint64_t>* tested, const std::atomic<bool>* stop,
+                   uint64_t* key) {
+    hn_vec_t s[HN_SIMD_STATE_BITS];
+    hn_vec_t lane[HN_SIMD_TOP_BITS];
+    const int lane_bits = __builtin_ctz(HN_SIMD_LANES);
+    const hn_vec_t ones = hn_simd_fill(true);
+
+    for (int j = 0; j < HN_SIMD_TOP_BITS && j < lane_bits; j++) lane[j] = hn_simd_lane_bit(j);
+    if (odd_end > (1UL << HN_ODD_LOW_BITS)) odd_end = 1UL << HN_ODD_LOW_BITS;
+
+    for (uint32_t o = odd_begin; o < odd_end; o++) {
+        uint8_t oc = hardnested_odd_class(o);
+        uint64_t pairs = 0;
+
+        if (stop->load(std::memory_order_relaxed)) return -1;
+        if (!odd_any[oc]) continue;
+        for (int i = 0; i < HN_ODD_LOW_BITS; i++) s[2 * i] = hn_simd_fill(HN_SIMD_BIT(o, i));
+
+        for (uint32_t k = 0; k < num_even; k++) {
+            uint32_t e = even[k] & ((1UL << HN_EVEN_LOW_BITS) - 1);
+
+            if (!hardnested_plan_allows(plan, oc, (uint8_t)(even[k] >> HN_EVEN_LOW_BITS))) continue;
+            for (int i = 0; i < HN_EVEN_LOW_BITS; i++) s[2 * i + 1] = hn_simd_fill(HN_SIMD_BIT(e, i));
+
+            for (uint32_t base = 0; base < HN_TOP_KEYS; base += HN_SIMD_LANES) {
+                uint64_t w[HN_SIMD_WORDS];
+                hn_vec_t mask;
+
+                for (int j = 0; j < HN_SIMD_TOP_BITS; j++) {
+                    int age = j < 4 ? 2 * (HN_ODD_LOW_BITS + j) : 2 * (HN_EVEN_LOW_BITS + j - 4) + 1;
+
+                    s[age] = j < lane_bits ? lane[j] : hn_simd_fill(HN_SIMD_BIT(base, j));
+                }
+                mask = hn_simd_test_nonces(s, nonces, num_nonces, ones);
+                if (!hn_simd_any(mask)) continue;
+
+                hn_simd_store(w, mask);
+                for (int k = 0; k < HN_SIMD_WORDS; k++) {
+                    while (w[k]) {
+                        uint32_t t = base + k * 64 + __builtin_ctzll(w[k]);
+                        uint64_t k64 = hn_simd_lane_key(o, e, t);
+
+                        if (hn_simd_key_ok(k64, nonces, num_nonces)) {
+                            *key = k64;
+                            return 1;
+                        }
+                        w[k] &= w[k] - 1;
+                    }
+                }
+            }
+            pairs++;
+        }
+        tested->fetch_add(pairs * HN_TOP_KEYS, std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+// ----- Self-test -----
+
+void hn_simd_nonce(uint64_t key, uint32_t uid, uint32_t nt_enc, Crypto1EncNonce* n) {
+    uint32_t nt = nonce_decrypt_nt(key, uid, nt_enc);
+    uint32_t ks = nt ^ nt_enc;
+
+    n->uid = uid;
+    n->nt_enc = nt_enc;
+    n->par = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        uint8_t plain = nt >> (24 - 8 * i);
+
+        n->par |= (crypto1_parity(plain) ^ 1 ^ ((ks >> (16 - 8 * i)) & 1)) << i;
+    }
+}
+
+static uint64_t hn_simd_lcg(uint64_t* x) {
+    *x = *x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *x >> 16;
+}
+
+bool hn_simd_selftest() {
+    const uint64_t key = 0x4D3A99C351DDULL;
+    const uint32_t uid = 0x9c599b32;
+    Crypto1EncNonce nonces[8];
+    uint64_t keys[HN_SIMD_LANES];
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    bool ok = true;
+
+    for (int i = 0; i < 8; i++) hn_simd_nonce(key, uid, (uint32_t)hn_simd_lcg(&x), &nonces[i]);
+
+    // Con un solo nonce passa 1/8 delle chiavi: le maschere devono coincidere lane per lane
+    for (int round = 0; round < 16 && ok; round++) {
+        hn_vec_t s[HN_SIMD_STATE_BITS];
+        uint64_t w[HN_SIMD_STATE_BITS][HN_SIMD_WORDS];
+        uint64_t got[HN_SIMD_WORDS];
+
+        memset(w, 0, sizeof(w));
+        for (int l = 0; l < HN_SIMD_LANES; l++) {
+            Crypto1State st;
+
+            keys[l] = l == round * 7 % HN_SIMD_LANES ? key : hn_simd_lcg(&x) & 0xFFFFFFFFFFFFULL;
+            crypto1_init(&st, keys[l]);
+            for (int a = 0; a < HN_SIMD_STATE_BITS; a++) {
+                uint32_t half = a & 1 ? st.even : st.odd;
+
+                w[a][l / 64] |= (uint64_t)HN_SIMD_BIT(half, a >> 1) << (l % 64);
+            }
+        }
+        for (int a = 0; a < HN_SIMD_STATE_BITS; a++) s[a] = hn_simd_load(w[a]);
+
+        hn_simd_store(got, hn_simd_test_nonces(s, nonces, round & 1 ? 8 : 1, hn_simd_fill(true)));
+        for (int k = 0; k < HN_SIMD_WORDS; k++) {
+            uint64_t ref = crypto1_bs_test_nonce_batch(nonces, round & 1 ? 8 : 1, &keys[k * 64], 64);
+
+            ok = ok && got[k] == ref;
+        }
+        ok = ok && HN_SIMD_BIT(got[round * 7 % HN_SIMD_LANES / 64], round * 7 % 64);
+    }
+
+    printf("[MFCUK] Backend %s (%d lane) self-test: %s\n", HN_SIMD_NAME, HN_SIMD_LANES, ok ? "OK" : "ERRORE");
+    return ok;
+}
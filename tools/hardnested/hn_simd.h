@@ -0,0 +1,61 @@
+/**
+ * Hardnested su host - Backend bitsliced vettoriale
+ *
+ * Stessa verifica delle parità di crypto1_bs_test_nonces, ma ogni slice è
+ * un registro vettoriale: 256 lane con AVX2, 128 con NEON, 64 (parola del
+ * progetto) altrimenti. Le 512 combinazioni dei bit alti delle metà si
+ * coprono così in 2 o 4 blocchi per coppia di parti basse invece di 8.
+ * Il backend si sceglie in compilazione (-march=native sull'host).
+ */
+
+#ifndef _HN_SIMD_H_
+#define _HN_SIMD_H_
+
+#include "mfcuk_hardnested.h"
+#include <atomic>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i hn_vec_t;
+#define HN_SIMD_NAME   "AVX2"
+#define HN_SIMD_WORDS  4
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+typedef uint64x2_t hn_vec_t;
+#define HN_SIMD_NAME   "NEON"
+#define HN_SIMD_WORDS  2
+#else
+typedef crypto1_bs_t hn_vec_t;
+#define HN_SIMD_NAME   "scalare 64 bit"
+#define HN_SIMD_WORDS  1
+#endif
+
+// Lane per registro: parole a 64 bit, lane = parola * 64 + bit
+#define HN_SIMD_LANES  (HN_SIMD_WORDS * 64)
+
+/**
+ * Forza bruta sulle parti basse di odd in [odd_begin, odd_end), come
+ * hardnested_search ma sul backend vettoriale
+ * @param odd_any Classi di odd ammesse da qualche classe di even del piano
+ * @param tested Chiavi provate, aggiornato a ogni parte bassa di odd
+ * @param stop Interrompe la ricerca appena vale true
+ * @return 1 chiave trovata, 0 nessuna chiave, -1 interrotta
+ */
+int hn_simd_search(const HardnestedPlan* plan, const bool* odd_any, const Crypto1EncNonce* nonces,
+                   uint8_t num_nonces, const uint32_t* even, uint32_t num_even, uint32_t odd_begin,
+                   uint32_t odd_end, std::atomic<uint64_t>* tested, const std::atomic<bool>* stop,
+                   uint64_t* key);
+
+/**
+ * {nt} con le parità (primi 3 byte) che darebbe una carta con la chiave
+ * data: nonce sintetici per self-test e benchmark
+ */
+void hn_simd_nonce(uint64_t key, uint32_t uid, uint32_t nt_enc, Crypto1EncNonce* n);
+
+/**
+ * Confronta il backend con crypto1_bs_test_nonce_batch del progetto su
+ * chiavi pseudo-casuali e sulla chiave dei nonce
+ */
+bool hn_simd_selftest();
+
+#endif // _HN_SIMD_H_
@@ -0,0 +1,291 @@
+/**
+ * Hardnested su host
+ *
+ * Completa su PC l'attacco hardnested, la cui forza bruta non gira mai
+ * sull'ESP32: legge il file di lavoro scritto dal firmware su
+ * LittleFS (formato in mfcuk_hardnested.h), ricalcola statistiche, stima e
+ * piano con lo stesso codice del firmware e percorre il piano con il
+ * backend vettoriale su tutti i core. La chiave trovata viene aggiunta a un
+ * file di chiavi nel formato letto da mfoc_load_keys_file
+ * (<settore>;<A|B>;<chiave>), da ricopiare su LittleFS.
+ *
+ * Compilazione ed esecuzione (ambiente native):
+ *   pio run -e native_hardnested
+ *   .pio/build/native_hardnested/program [-t thread] [-o chiavi.txt] mfcuk_hn_s05B.txt
+ * Altre opzioni: -s self-test del backend SIMD, -b <secondi> benchmark di
+ * scalabilità su un lavoro sintetico (1 thread e poi tutti). I vettori di
+ * test dell'attacco sono in test/test_hardnested.
+ */
+
+#include "mfcuk_hardnested.h"
+#include "hn_simd.h"
+#include "hn_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+
+// Intervallo tra due righe di stato e tra due controlli dei thread
+#define HN_HOST_REPORT_MS  5000
+#define HN_HOST_POLL_MS    100
+
+#define HN_HOST_KEYS_FILE  "hardnested_keys.txt"
+
+static double hn_host_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void hn_host_usage(const char* argv0) {
+    printf("Uso: %s [-t thread] [-o file chiavi] <file di lavoro>\n", argv0);
+    printf("     %s -s                  self-test SIMD\n", argv0);
+    printf("     %s [-t thread] -b <s>  benchmark di scalabilità\n", argv0);
+}
+
+/**
+ * Legge il file di lavoro: il primo uid incontrato è quello della carta,
+ * righe di altre carte o non valide vengono scartate
+ */
+static bool hn_host_read_job(const char* path, Hardnested* hn, uint8_t* sector, uint8_t* key_type) {
+    char line[HN_JOB_LINE_MAX * 2];
+    bool have_target = false, have_uid = false;
+    unsigned bad = 0, line_no = 0;
+    FILE* f = fopen(path, "r");
+
+    if (f == NULL) {
+        printf("[MFCUK] Impossibile aprire %s\n", path);
+        return false;
+    }
+    if (fgets(line, sizeof(line), f) == NULL || strncmp(line, HN_JOB_MAGIC, strlen(HN_JOB_MAGIC)) != 0) {
+        printf("[MFCUK] %s non è un file di lavoro hardnested\n", path);
+        fclose(f);
+        return false;
+    }
+
+    do {
+        Crypto1EncNonce n;
+        int r = hardnested_job_parse(line, &n, sector, key_type);
+
+        line_no++;
+        if (r == 2) {
+            have_target = true;
+        } else if (r == 1) {
+            if (!have_uid) {
+                hardnested_init(hn, n.uid);
+                have_uid = true;
+            }
+            if (n.uid == hn->uid) hardnested_add(hn, n.nt_enc, n.par);
+            else bad++;
+        } else if (r < 0) {
+            if (bad++ < 4) printf("[MFCUK] Riga %u non valida, ignorata\n", line_no);
+        }
+    } while (fgets(line, sizeof(line), f) != NULL);
+    fclose(f);
+
+    if (bad > 0) printf("[MFCUK] %u righe scartate\n", bad);
+    if (!have_target || !have_uid) {
+        printf("[MFCUK] File di lavoro senza %s\n", have_target ? "nonce" : "bersaglio");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Aggiunge la chiave al file di chiavi, con l'intestazione di
+ * mfoc_save_keys se il file è nuovo
+ */
+static bool hn_host_write_key(const char* path, const char* job, uint32_t uid, uint8_t sector, uint8_t key_type,
+                              uint64_t key) {
+    FILE* f = fopen(path, "a");
+
+    if (f == NULL) {
+        printf("[MFCUK] Impossibile scrivere %s\n", path);
+        return false;
+    }
+    if (ftell(f) == 0) {
+        fprintf(f, "# MFOC Keys - VolcanoEsp\n");
+        fprintf(f, "# Formato: <settore>;<tipo>;<chiave>\n\n");
+    }
+    fprintf(f, "# hardnested da %s, UID %08lX\n", job, (unsigned long)uid);
+    fprintf(f, "%u;%c;%012llX\n", sector, key_type == 0 ? 'A' : 'B', (unsigned long long)key);
+    fclose(f);
+    return true;
+}
+
+/**
+ * Velocità per thread dall'inizio (milioni di chiavi/s)
+ */
+static void hn_host_print_threads(const HnPool* pool, double elapsed) {
+    printf("[MFCUK]   Mchiavi/s per thread:");
+    for (int i = 0; i < pool->threads; i++) printf(" %.1f", hn_pool_tested(pool, i) / elapsed / 1e6);
+    printf("\n");
+}
+
+/**
+ * Attende la fine della ricerca stampando avanzamento, velocità e tempo
+ * stimato; con limit_s > 0 ferma i thread dopo limit_s secondi
+ * @return Secondi trascorsi
+ */
+static double hn_host_wait(HnPool* pool, uint64_t total, double limit_s, bool verbose) {
+    double start = hn_host_seconds();
+    double last = start;
+    double now = start;
+
+    while (hn_pool_running(pool)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(HN_HOST_POLL_MS));
+        now = hn_host_seconds();
+        if (limit_s > 0 && now - start >= limit_s) hn_pool_stop(pool);
+
+        if (verbose && (now - last) * 1000 >= HN_HOST_REPORT_MS) {
+            uint64_t tested = hn_pool_tested_total(pool);
+            double rate = tested / (now - start);
+
+            last = now;
+            printf("[MFCUK] %.1f%%: 2^%.1f chiavi, %.1f Mchiavi/s, fine stimata tra %.0f s\n",
+                   total ? 100.0 * tested / total : 0.0, tested ? log2((double)tested) : 0.0, rate / 1e6,
+                   rate > 0 && total > tested ? (total - tested) / rate : 0.0);
+            hn_host_print_threads(pool, now - start);
+        }
+    }
+    hn_pool_join(pool);
+    return hn_host_seconds() - start;
+}
+
+/**
+ * Benchmark: lavoro sintetico con tutti i primi byte, limit_s secondi con
+ * un thread e poi con tutti; l'efficienza è la velocità totale rispetto a
+ * threads volte quella di un thread solo
+ */
+static int hn_host_bench(int threads, double limit_s) {
+    static HnPool pool;
+    static Hardnested hn;
+    HardnestedEstimate est;
+    HardnestedPlan plan;
+    int configs[2] = {1, threads};
+    uint32_t* even;
+    uint32_t num_even;
+    double single = 0;
+
+    hardnested_init(&hn, 0x9c599b32);
+    for (uint32_t b = 0; b < HN_FIRST_BYTES; b++) {
+        Crypto1EncNonce n;
+
+        hn_simd_nonce(0x4D3A99C351DDULL, hn.uid, b << 24 | (b * 0x9E3779B1UL & 0xffffff), &n);
+        hardnested_add(&hn, n.nt_enc, n.par);
+    }
+    // Nonce di controllo di un'altra chiave: nessuna lane arriva alla verifica scalare
+    hn.num_check = 0;
+    for (uint32_t i = 0; i < HN_CHECK_NONCES; i++) {
+        hn_simd_nonce(0x0123456789ABULL, hn.uid, i * 0x2545F491UL, &hn.check[hn.num_check++]);
+    }
+    hardnested_estimate(&hn, &est, &plan);
+
+    even = (uint32_t*)malloc(plan.even_lows * sizeof(uint32_t));
+    if (even == NULL) return 1;
+    num_even = hardnested_even_list(&plan, 0, 1UL << HN_EVEN_LOW_BITS, even, plan.even_lows);
+    printf("[MFCUK] Benchmark backend %s (%d lane), piano 2^%.1f chiavi\n", HN_SIMD_NAME, HN_SIMD_LANES,
+           est.log2_plan);
+
+    for (int c = 0; c < (threads > 1 ? 2 : 1); c++) {
+        int t = configs[c];
+        double elapsed;
+        double rate;
+
+        hn_pool_init(&pool, &plan, hn.check, hn.num_check, even, num_even, 0, 1UL << HN_ODD_LOW_BITS);
+        hn_pool_start(&pool, t);
+        elapsed = hn_host_wait(&pool, plan.keys, limit_s, false);
+        rate = hn_pool_tested_total(&pool) / elapsed;
+        if (t == 1) single = rate;
+
+        printf("[MFCUK] %d thread: %.1f Mchiavi/s totali, %.1f per thread, efficienza %.0f%%\n", t, rate / 1e6,
+               rate / t / 1e6, single > 0 ? 100.0 * rate / (t * single) : 0.0);
+        hn_host_print_threads(&pool, elapsed);
+    }
+    free(even);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    static HnPool pool;
+    static Hardnested hn;
+    const char* keys_path = HN_HOST_KEYS_FILE;
+    int threads = (int)std::thread::hardware_concurrency();
+    double bench_s = 0;
+    bool selftest = false;
+    HardnestedEstimate est;
+    HardnestedPlan plan;
+    uint8_t sector = 0, key_type = 0;
+    uint32_t* even;
+    uint32_t num_even;
+    double start, elapsed;
+    int opt;
+
+    // Righe di stato subito visibili anche su file o pipe
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    while ((opt = getopt(argc, argv, "t:o:b:s")) != -1) {
+        switch (opt) {
+            case 't': threads = atoi(optarg); break;
+            case 'o': keys_path = optarg; break;
+            case 'b': bench_s = atof(optarg); break;
+            case 's': selftest = true; break;
+            default:
+                hn_host_usage(argv[0]);
+                return 2;
+        }
+    }
+    if (threads < 1) threads = 1;
+    if (threads > HN_POOL_MAX_THREADS) threads = HN_POOL_MAX_THREADS;
+
+    start = hn_host_seconds();
+    hardnested_tables_init();
+    printf("[MFCUK] Tabelle delle classi in %.1f s, backend %s (%d lane), %d thread\n",
+           hn_host_seconds() - start, HN_SIMD_NAME, HN_SIMD_LANES, threads);
+
+    if (selftest) return hn_simd_selftest() ? 0 : 1;
+    if (bench_s > 0) return hn_host_bench(threads, bench_s);
+    if (optind >= argc) {
+        hn_host_usage(argv[0]);
+        return 2;
+    }
+    if (!hn_simd_selftest()) return 1;
+
+    if (!hn_host_read_job(argv[optind], &hn, &sector, &key_type)) return 1;
+    hardnested_estimate(&hn, &est, &plan);
+    hardnested_report(&hn, &est);
+    if (hn.num_check < HN_CHECK_NONCES) {
+        printf("[MFCUK] Servono almeno %d nonce per verificare le chiavi\n", HN_CHECK_NONCES);
+        return 1;
+    }
+    if (!est.complete) {
+        printf("[MFCUK] Attenzione: primi byte incompleti, il piano potrebbe escludere la chiave\n");
+    }
+
+    even = (uint32_t*)malloc(plan.even_lows * sizeof(uint32_t));
+    if (even == NULL) {
+        printf("[MFCUK] Memoria insufficiente per %lu parti basse di even\n", (unsigned long)plan.even_lows);
+        return 1;
+    }
+    num_even = hardnested_even_list(&plan, 0, 1UL << HN_EVEN_LOW_BITS, even, plan.even_lows);
+    printf("[MFCUK] Settore %u chiave %c: %lu parti basse di odd, %lu di even, 2^%.1f chiavi\n", sector,
+           key_type == 0 ? 'A' : 'B', (unsigned long)plan.odd_lows, (unsigned long)num_even, est.log2_plan);
+
+    hn_pool_init(&pool, &plan, hn.check, hn.num_check, even, num_even, 0, 1UL << HN_ODD_LOW_BITS);
+    hn_pool_start(&pool, threads);
+    elapsed = hn_host_wait(&pool, plan.keys, 0, true);
+    free(even);
+
+    printf("[MFCUK] %.1f s, 2^%.1f chiavi, %.1f Mchiavi/s totali\n", elapsed,
+           log2((double)hn_pool_tested_total(&pool) + 1), hn_pool_tested_total(&pool) / elapsed / 1e6);
+    hn_host_print_threads(&pool, elapsed);
+
+    if (!pool.found.load()) {
+        printf("[MFCUK] Nessuna chiave compatibile con i nonce\n");
+        return 1;
+    }
+    printf("[MFCUK] Chiave trovata: %012llX\n", (unsigned long long)pool.key);
+    if (!hn_host_write_key(keys_path, argv[optind], hn.uid, sector, key_type, pool.key)) return 1;
+    printf("[MFCUK] Chiave aggiunta a %s\n", keys_path);
+    return 0;
+}